@@ -0,0 +1,395 @@
+#pragma once
+
+#include "ParallelFor.h"
+#include "ShapedLUT.h"
+#include "ToneMapping.h"
+
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+
+// C++ port of "shaders/HDRComposite/ACES.hlsl": the ACES RRT (with the reference gamut compression) and the SSTS ODT tone map of any display range.
+// Formulas and operation order follow the shader ("half3x3" matrices are full floats, as they are without 16 bit types).
+// The shader rebuilds the SSTS spline ("init_aces_params()") for every pixel, here "MakeParams()" sets it up once per min/max luminance pair.
+// Colors are linear BT.709 in and out: scene linear (0.18 is mid gray) into the RRT, display linear out of the ODT (1 is "a_maxY" nits).
+// "RRTODT()" also runs over channel arrays on all cores, and "BakeLUT()" bakes the whole transform into a "ShapedLUT" for a display.
+namespace ToneMapping::ACESTransform
+{
+	using Color::Matrix3x3;
+
+	constexpr Matrix3x3 MulMatrices(const Matrix3x3& a_a, const Matrix3x3& a_b)
+	{
+		Matrix3x3 result = {};
+		for (int row = 0; row < 3; ++row) {
+			for (int column = 0; column < 3; ++column) {
+				result[row][column] = a_a[row][0] * a_b[0][column] + a_a[row][1] * a_b[1][column] + a_a[row][2] * a_b[2][column];
+			}
+		}
+		return result;
+	}
+
+	inline constexpr Matrix3x3 kSRGB_To_AP0 = { {
+		{ 0.4397010f, 0.3829780f, 0.1773350f },
+		{ 0.0897923f, 0.8134230f, 0.0967616f },
+		{ 0.0175440f, 0.1115440f, 0.8707040f },
+	} };
+
+	inline constexpr Matrix3x3 kAP1_To_SRGB = { {
+		{ 1.7048586763f, -0.6217160219f, -0.0832993717f },
+		{ -0.1300768242f, 1.1407357748f, -0.0105598017f },
+		{ -0.0239640729f, -0.1289755083f, 1.1530140189f },
+	} };
+
+	inline constexpr Matrix3x3 kAP0_To_AP1 = { {
+		{ 1.4514393161f, -0.2365107469f, -0.2149285693f },
+		{ -0.0765537734f, 1.1762296998f, -0.0996759264f },
+		{ 0.0083161484f, -0.0060324498f, 0.9977163014f },
+	} };
+
+	inline constexpr Matrix3x3 kAP1_To_AP0 = { {
+		{ 0.6954522414f, 0.1406786965f, 0.1638690622f },
+		{ 0.0447945634f, 0.8596711185f, 0.0955343182f },
+		{ -0.0055258826f, 0.0040252103f, 1.0015006723f },
+	} };
+
+	inline constexpr Float3 kAP1_RGB2Y = { 0.2722287168f, 0.6740817658f, 0.0536895174f };
+
+	inline constexpr Matrix3x3 kBlueCorrect = { {
+		{ 0.9404372683f, -0.0183068787f, 0.0778696104f },
+		{ 0.0083786969f, 0.8286599939f, 0.1629613092f },
+		{ 0.0005471261f, -0.0008833746f, 1.0003362486f },
+	} };
+
+	inline constexpr Matrix3x3 kBlueCorrectInv = { {
+		{ 1.06318f, 0.0233956f, -0.0865726f },
+		{ -0.0106337f, 1.20632f, -0.19569f },
+		{ -0.000590887f, 0.00105248f, 0.999538f },
+	} };
+
+	inline constexpr Matrix3x3 kBlueCorrectAP1 = MulMatrices(kAP0_To_AP1, MulMatrices(kBlueCorrect, kAP1_To_AP0));
+	inline constexpr Matrix3x3 kBlueCorrectInvAP1 = MulMatrices(kAP0_To_AP1, MulMatrices(kBlueCorrectInv, kAP1_To_AP0));
+
+	// Quadratic B-spline basis of the SSTS segments
+	inline constexpr Matrix3x3 kM = { {
+		{ 0.5f, -1.0f, 0.5f },
+		{ -1.0f, 1.0f, 0.0f },
+		{ 0.5f, 0.5f, 0.0f },
+	} };
+
+	inline constexpr float kMinStopSDR = -6.5f;
+	inline constexpr float kMaxStopSDR = 6.5f;
+	inline constexpr float kMinStopRRT = -15.f;
+	inline constexpr float kMaxStopRRT = 18.f;
+	inline constexpr float kMinLumSDR = 0.02f;
+	inline constexpr float kMaxLumSDR = 48.f;
+	inline constexpr float kMinLumRRT = 0.0001f;
+	inline constexpr float kMaxLumRRT = 10000.f;
+
+	// Two (x, y) points, interpolated linearly between them and clamped outside
+	using Table2x2 = std::array<std::array<float, 2>, 2>;
+
+	inline float Interpolate1D(const Table2x2& a_table, float a_p)
+	{
+		if (a_p < a_table[0][0]) {
+			return a_table[0][1];
+		}
+		if (a_p >= a_table[1][0]) {
+			return a_table[1][1];
+		}
+		const float s = (a_p - a_table[0][0]) / (a_table[1][0] - a_table[0][0]);
+		return a_table[0][1] * (1.f - s) + a_table[1][1] * s;
+	}
+
+	inline float LookupACESMin(float a_minLumLog10)
+	{
+		const Table2x2 minLumTable = { { { std::log10(kMinLumRRT), kMinStopRRT }, { std::log10(kMinLumSDR), kMinStopSDR } } };
+		return 0.18f * std::exp2(Interpolate1D(minLumTable, a_minLumLog10));
+	}
+
+	inline float LookupACESMax(float a_maxLumLog10)
+	{
+		const Table2x2 maxLumTable = { { { std::log10(kMaxLumSDR), kMaxStopSDR }, { std::log10(kMaxLumRRT), kMaxStopRRT } } };
+		return 0.18f * std::exp2(Interpolate1D(maxLumTable, a_maxLumLog10));
+	}
+
+	// The SSTS spline of a display ("AcesParams"): log10 of the min, mid and max points (x is the scene, y the display, z the slope),
+	// and the coefficients of the segments below and above mid gray (the last one is repeated so the top segment can read 3 of them)
+	struct Params
+	{
+		Float3               min;
+		Float3               mid;
+		Float3               max;
+		std::array<float, 6> coefsLow;
+		std::array<float, 6> coefsHigh;
+	};
+
+	// "init_aces_params()", "a_minLum" and "a_maxLum" are the display's black and peak in nits
+	inline Params MakeParams(float a_minLum, float a_maxLum)
+	{
+		const float  minLumLog10 = std::log10(a_minLum);
+		const float  maxLumLog10 = std::log10(a_maxLum);
+		const float  acesMin = LookupACESMin(minLumLog10);
+		const float  acesMax = LookupACESMax(maxLumLog10);
+		const Float3 midPoint = { 0.18f, 4.8f, 1.55f };
+
+		const float logMin[2] = { std::log10(acesMin), minLumLog10 };
+		const float logMid[2] = { std::log10(midPoint.x), std::log10(midPoint.y) };
+		const float logMax[2] = { std::log10(acesMax), maxLumLog10 };
+
+		float coefsLow[5];
+		float coefsHigh[5];
+
+		// The two lowest coefficients straddle the min point, with a slope of 0 they're both its y
+		const float knotIncLow = (logMid[0] - logMin[0]) / 3.f;
+		coefsLow[0] = logMin[1];
+		coefsLow[1] = coefsLow[0];
+
+		// The two highest straddle the mid point
+		const float minCoef = (logMid[1] - midPoint.z * logMid[0]);
+		coefsLow[3] = (midPoint.z * (logMid[0] - 0.5f * knotIncLow)) + (logMid[1] - midPoint.z * logMid[0]);
+		coefsLow[4] = (midPoint.z * (logMid[0] + 0.5f * knotIncLow)) + (logMid[1] - midPoint.z * logMid[0]);
+
+		// The middle one (the "sharpness of the bend") is interpolated
+		const Table2x2 bendsLowTable = { { { kMinStopRRT, 0.18f }, { kMinStopSDR, 0.35f } } };
+		const float    pctLow = Interpolate1D(bendsLowTable, std::log2(acesMin / 0.18f));
+		coefsLow[2] = logMin[1] + pctLow * (logMid[1] - logMin[1]);
+
+		// Same above mid gray, the two highest coefficients straddle the max point
+		const float knotIncHigh = (logMax[0] - logMid[0]) / 3.f;
+		coefsHigh[0] = (midPoint.z * (logMid[0] - 0.5f * knotIncHigh)) + minCoef;
+		coefsHigh[1] = (midPoint.z * (logMid[0] + 0.5f * knotIncHigh)) + minCoef;
+		coefsHigh[3] = logMax[1];
+		coefsHigh[4] = coefsHigh[3];
+
+		const Table2x2 bendsHighTable = { { { kMaxStopSDR, 0.89f }, { kMaxStopRRT, 0.90f } } };
+		const float    pctHigh = Interpolate1D(bendsHighTable, std::log2(acesMax / 0.18f));
+		coefsHigh[2] = logMid[1] + pctHigh * (logMax[1] - logMid[1]);
+
+		return {
+			{ logMin[0], logMin[1], 0.f },
+			{ logMid[0], logMid[1], midPoint.z },
+			{ logMax[0], logMax[1], 0.f },
+			{ coefsLow[0], coefsLow[1], coefsLow[2], coefsLow[3], coefsLow[4], coefsLow[4] },
+			{ coefsHigh[0], coefsHigh[1], coefsHigh[2], coefsHigh[3], coefsHigh[4], coefsHigh[4] }
+		};
+	}
+
+	// Single segmented tone scale, scene linear to display nits
+	inline float SSTS(float a_x, const Params& a_params)
+	{
+		constexpr int kKnotsLow = 4;
+		constexpr int kKnotsHigh = 4;
+
+		// Zero and negatives are clamped before the log
+		const float logx = std::log10(std::fmax(a_x, FLT_MIN));
+
+		const auto evaluateSegment = [&](const std::array<float, 6>& a_coefs, float a_knotCoordinate) {
+			const int    j = static_cast<int>(a_knotCoordinate);
+			const float  t = a_knotCoordinate - static_cast<float>(j);
+			const Float3 cf = { a_coefs[j], a_coefs[j + 1], a_coefs[j + 2] };
+			const Float3 monomials = { t * t, t, 1.f };
+			return Color::Dot(monomials, Color::Mul(kM, cf));
+		};
+
+		float logy;
+		if (logx > a_params.max.x) {
+			// Above the max point the slope is 0
+			logy = a_params.max.y;
+		} else if (logx >= a_params.mid.x) {
+			logy = evaluateSegment(a_params.coefsHigh, (kKnotsHigh - 1) * (logx - a_params.mid.x) / (a_params.max.x - a_params.mid.x));
+		} else if (logx > a_params.min.x) {
+			logy = evaluateSegment(a_params.coefsLow, (kKnotsLow - 1) * (logx - a_params.min.x) / (a_params.mid.x - a_params.min.x));
+		} else {
+			// Below the min point the slope is 0
+			logy = a_params.min.y;
+		}
+		return std::pow(10.f, logy);
+	}
+
+	// Sigmoid from 0 to 1 spanning -2 to +2
+	inline float SigmoidShaper(float a_x)
+	{
+		const float t = std::fmax(1.f - std::abs(0.5f * a_x), 0.f);
+		const float y = 1.f + Sign(a_x) * (1.f - t * t);
+		return 0.5f * y;
+	}
+
+	inline float RGBToSaturation(const Float3& a_rgb)
+	{
+		const float minrgb = MinChannel(a_rgb);
+		const float maxrgb = MaxChannel(a_rgb);
+		return (std::fmax(maxrgb, 1e-10f) - std::fmax(minrgb, 1e-10f)) / std::fmax(maxrgb, 1e-2f);
+	}
+
+	inline float GlowForward(float a_ycIn, float a_glowGainIn, float a_glowMid)
+	{
+		if (a_ycIn <= 2.f / 3.f * a_glowMid) {
+			return a_glowGainIn;
+		}
+		if (a_ycIn >= 2.f * a_glowMid) {
+			return 0.f;
+		}
+		return a_glowGainIn * (a_glowMid / a_ycIn - 0.5f);
+	}
+
+	// Geometric hue angle in degrees (0-360), 0 for neutral colors
+	inline float RGBToHue(const Float3& a_rgb)
+	{
+		float hue = 0.f;
+		if (a_rgb.x != a_rgb.y || a_rgb.y != a_rgb.z) {
+			hue = (180.f / 3.14159265359f) * std::atan2(std::sqrt(3.f) * (a_rgb.y - a_rgb.z), 2.f * a_rgb.x - a_rgb.y - a_rgb.z);
+		}
+		if (hue < 0.f) {
+			hue = hue + 360.f;
+		}
+		return std::fmin(std::fmax(hue, 0.f), 360.f);
+	}
+
+	// Luminance proxy "YC" (~ Y + K * chroma), RGB 1 1 1 is YC 1
+	inline float RGBToYC(const Float3& a_rgb, float a_ycRadiusWeight = 1.75f)
+	{
+		const float r = a_rgb.x;
+		const float g = a_rgb.y;
+		const float b = a_rgb.z;
+		const float chroma = std::sqrt(b * (b - g) + g * (g - r) + r * (r - b));
+		return (b + g + r + a_ycRadiusWeight * chroma) / 3.f;
+	}
+
+	inline float CenterHue(float a_hue, float a_centerH)
+	{
+		float hueCentered = a_hue - a_centerH;
+		if (hueCentered < -180.f) {
+			hueCentered += 360.f;
+		} else if (hueCentered > 180.f) {
+			hueCentered -= 360.f;
+		}
+		return hueCentered;
+	}
+
+	inline float GamutCompressChannel(float a_dist, float a_lim, float a_thr, float a_pwr)
+	{
+		if (a_dist < a_thr) {
+			return a_dist;
+		}
+
+		// Scale factor for y = 1 intersect
+		const float scl = (a_lim - a_thr) / std::pow(std::pow((1.f - a_thr) / (a_lim - a_thr), -a_pwr) - 1.f, 1.f / a_pwr);
+
+		// Normalize the distance outside the threshold by the scale factor, and compress it
+		const float nd = (a_dist - a_thr) / scl;
+		const float p = std::pow(nd, a_pwr);
+		return a_thr + scl * nd / (std::pow(1.f + p, 1.f / a_pwr));
+	}
+
+	// ACES 1.3 reference gamut compression, in linear AP1
+	inline Float3 GamutCompress(const Float3& a_linAP1)
+	{
+		constexpr Float3 kLimits = { 1.147f, 1.264f, 1.312f };     // cyan, magenta, yellow
+		constexpr Float3 kThresholds = { 0.815f, 0.803f, 0.880f };  // cyan, magenta, yellow
+		constexpr float  kPower = 1.2f;
+
+		// Distance from the achromatic axis of each channel, aka inverse RGB ratios
+		const float  ach = MaxChannel(a_linAP1);
+		const float  absAch = std::abs(ach);
+		const Float3 dist = ach != 0.f ? (ach - a_linAP1) / absAch : Color::Broadcast(0.f);
+
+		const Float3 comprDist = {
+			GamutCompressChannel(dist.x, kLimits.x, kThresholds.x, kPower),
+			GamutCompressChannel(dist.y, kLimits.y, kThresholds.y, kPower),
+			GamutCompressChannel(dist.z, kLimits.z, kThresholds.z, kPower)
+		};
+		return ach - comprDist * absAch;
+	}
+
+	// Reference rendering transform, linear BT.709 to AP1 before the ODT's tone scale
+	inline Float3 RRT(const Float3& a_rgb)
+	{
+		Float3 aces = Color::Mul(kSRGB_To_AP0, a_rgb);
+
+		// Glow
+		constexpr float kGlowGain = 0.05f;
+		constexpr float kGlowMid = 0.08f;
+		const float     saturation = RGBToSaturation(aces);
+		const float     ycIn = RGBToYC(aces);
+		const float     s = SigmoidShaper((saturation - 0.4f) / 0.2f);
+		const float     addedGlow = 1.f + GlowForward(ycIn, kGlowGain * s, kGlowMid);
+		aces = aces * addedGlow;
+
+		// Red modifier
+		constexpr float kRedScale = 0.82f;
+		constexpr float kRedPivot = 0.03f;
+		constexpr float kRedHue = 0.f;
+		constexpr float kRedWidth = 135.f;
+		const float     hue = RGBToHue(aces);
+		const float     centeredHue = CenterHue(hue, kRedHue);
+		const float     hueRamp = Saturate(1.f - std::abs(2.f * centeredHue / kRedWidth));
+		float           hueWeight = hueRamp * hueRamp * (3.f - 2.f * hueRamp);  // smoothstep()
+		hueWeight *= hueWeight;
+		aces.x += hueWeight * saturation * (kRedPivot - aces.x) * (1.f - kRedScale);
+
+		// ACES to the RGB rendering space
+		aces = Clamp(aces, 0.f, 65535.f);
+		Float3 rgbPre = Color::Mul(kAP0_To_AP1, aces);
+		rgbPre = Clamp(rgbPre, 0.f, 65504.f);
+
+		// Global desaturation
+		constexpr float kSaturationFactor = 0.96f;
+		const float     luminance = Color::Dot(rgbPre, kAP1_RGB2Y);
+		rgbPre = luminance + (rgbPre - luminance) * kSaturationFactor;
+
+		rgbPre = rgbPre + (Color::Mul(kBlueCorrectAP1, rgbPre) - rgbPre) * 0.6f;
+		return GamutCompress(rgbPre);
+	}
+
+	// The ODT's tone scale of every channel, to 0-1 between the display's black ("a_minY") and peak ("a_maxY")
+	inline Float3 ODTToneMap(const Float3& a_rgbPre, const Params& a_params, float a_minY, float a_maxY)
+	{
+		const Float3 rgbPost = { SSTS(a_rgbPre.x, a_params), SSTS(a_rgbPre.y, a_params), SSTS(a_rgbPre.z, a_params) };
+
+		// Not clamping may produce pink dots
+		const Float3 linearCV = (rgbPost - a_minY) / (a_maxY - a_minY);
+		return Clamp(linearCV, 0.f, 65535.f);
+	}
+
+	// Output device transform, AP1 from "RRT()" to linear BT.709 (1 is "a_maxY" nits). "a_params" must be made from the same "a_minY" and "a_maxY".
+	inline Float3 ODT(const Float3& a_rgbPre, const Params& a_params, float a_minY, float a_maxY)
+	{
+		Float3 scaled = ODTToneMap(a_rgbPre, a_params, a_minY, a_maxY);
+		scaled = scaled + (Color::Mul(kBlueCorrectInvAP1, scaled) - scaled) * 0.6f;
+
+		Float3 linearCV = Color::Mul(kAP1_To_SRGB, scaled);
+		linearCV = Clamp(linearCV, 0.f, 65535.f);
+		Float3 outputCV = linearCV * a_maxY;  // "linCV_2_Y()" with a black of 0
+		outputCV = Clamp(outputCV, 0.f, 65535.f);
+		return outputCV / a_maxY;
+	}
+
+	inline Float3 RRTODT(const Float3& a_rgb, const Params& a_params, float a_minY, float a_maxY)
+	{
+		return ODT(RRT(a_rgb), a_params, a_minY, a_maxY);
+	}
+
+	// "RRTODT()" in place over "a_count" colors stored as three channel arrays, in chunks spread over "a_threadCount" threads (0 is all cores)
+	inline void RRTODT(float* a_r, float* a_g, float* a_b, std::size_t a_count, const Params& a_params, float a_minY, float a_maxY, std::size_t a_threadCount = 0)
+	{
+		constexpr std::size_t kChunkSize = 4096;
+
+		ParallelFor((a_count + kChunkSize - 1) / kChunkSize, a_threadCount, [&](std::size_t a_chunk) {
+			const std::size_t end = std::min(a_count, (a_chunk + 1) * kChunkSize);
+			for (std::size_t i = a_chunk * kChunkSize; i < end; ++i) {
+				const Float3 color = RRTODT(Float3{ a_r[i], a_g[i], a_b[i] }, a_params, a_minY, a_maxY);
+				a_r[i] = color.x;
+				a_g[i] = color.y;
+				a_b[i] = color.z;
+			}
+		});
+	}
+
+	// Fills "a_outLUT" (which sets the size and shaper) with the whole transform for a display, on "a_threadCount" threads (0 is all cores)
+	inline void BakeLUT(float a_minY, float a_maxY, ShapedLUT& a_outLUT, std::size_t a_threadCount = 0)
+	{
+		const Params params = MakeParams(a_minY, a_maxY);
+		BakeShapedLUT([&](const Float3& a_rgb) { return RRTODT(a_rgb, params, a_minY, a_maxY); }, a_outLUT, a_threadCount);
+	}
+}
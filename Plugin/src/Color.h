@@ -0,0 +1,939 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <type_traits>
+
+#include <immintrin.h>
+
+// C++ port of "shaders/color.hlsl", for the CPU side (screenshots, LUT baking, analysis tools).
+// Every function is a template over the lane type:
+// - "float" is the scalar reference, it uses the standard library math and matches the shaders' formulas exactly.
+// - "__m128" (SSE2, always available on x64, and the same type as DirectXMath's XMVECTOR) and "__m256" (only when building with AVX2)
+//   process 4 or 8 colors at a time in SoA layout, with polynomial log2/exp2/trig approximations. "ForEach()" runs a function over channel arrays.
+// The SIMD lanes are written as separate multiplies and adds, but builds that allow FMA contraction (the plugin's /fp:contract, or GCC and Clang
+// targeting FMA) fuse some of them, so their results can differ from SSE2 builds by a few ulps. Within one build, "__m128" and "__m256" return the same bits.
+// Max errors of the SIMD versions against double precision references, measured on every float of each domain by "tools/ColorSweep", the larger of an
+// SSE2 and an FMA contracted AVX2 build (the scalar float versions are listed for comparison). In brackets are the bounds ColorSweep fails past,
+// about twice the measured errors, so another compiler or libm doesn't trip them:
+// - "Log2()": 7.7e-6 absolute [1.6e-5] (scalar 7.6e-6). "Exp2()": 1e-7 relative [2.5e-7] (scalar 6e-8). "Pow()" inherits the log2 error times the exponent.
+// - sRGB and gamma 2.2 over [0, 1]: 2.4e-7 absolute [5e-7] (scalar 2.4e-7), beyond 1: 8.6e-7 relative [1.8e-6] (scalar 5.4e-7).
+// - PQ over [0, 10000] nits: encode 1.4e-5 absolute [3e-5], decode 5.6e-5 absolute [1.2e-4], the same as the scalar versions as both are dominated by float rounding.
+// - "Sin()"/"Cos()": 2.7e-7 absolute over [-2pi, 2pi] [6e-7]. "Atan2()": 1.9e-6 radians [4e-6].
+namespace Color
+{
+	// Row major like HLSL's float3x3, "Mul()" is "mul(matrix, vector)"
+	using Matrix3x3 = std::array<std::array<float, 3>, 3>;
+
+	template <class T>
+	struct Vec3
+	{
+		T x;
+		T y;
+		T z;
+	};
+
+	using Float3 = Vec3<float>;
+
+	// sRGB SDR white is meant to be mapped to 80 nits (not 100, even if some game engine (UE) and consoles (PS5) interpret it as such)
+	inline constexpr float kWhiteNits_sRGB = 80.f;
+	inline constexpr float kReferenceWhiteNits_BT2408 = 203.f;
+	inline constexpr float kMidGray = 0.18f;
+	// SMPTE ST 2084 (PQ) is only defined until this amount of nits
+	inline constexpr float kPQMaxNits = 10000.f;
+	inline constexpr float kPQMaxWhitePoint = kPQMaxNits / kWhiteNits_sRGB;
+
+	inline constexpr float kPQ_M1 = 0.1593017578125f;
+	inline constexpr float kPQ_M2 = 78.84375f;
+	inline constexpr float kPQ_C1 = 0.8359375f;
+	inline constexpr float kPQ_C2 = 18.8515625f;
+	inline constexpr float kPQ_C3 = 18.6875f;
+
+	// These have been calculated to be as accurate as possible
+	inline constexpr Matrix3x3 kBT709_To_BT2020 = { {
+		{ 0.627403914928436279296875f, 0.3292830288410186767578125f, 0.0433130674064159393310546875f },
+		{ 0.069097287952899932861328125f, 0.9195404052734375f, 0.011362315155565738677978515625f },
+		{ 0.01639143936336040496826171875f, 0.08801330626010894775390625f, 0.895595252513885498046875f } } };
+
+	inline constexpr Matrix3x3 kBT2020_To_BT709 = { {
+		{ 1.66049098968505859375f, -0.58764111995697021484375f, -0.072849862277507781982421875f },
+		{ -0.12455047667026519775390625f, 1.13289988040924072265625f, -0.0083494223654270172119140625f },
+		{ -0.01815076358616352081298828125f, -0.100578896701335906982421875f, 1.11872971057891845703125f } } };
+
+	// BT.2020 but a little wider, for headroom while processing
+	inline constexpr Matrix3x3 kBT709_To_WBT2020 = { {
+		{ 0.610571384429931640625f, 0.3318304717540740966796875f, 0.0575981400907039642333984375f },
+		{ 0.075206600129604339599609375f, 0.896992862224578857421875f, 0.02780056186020374298095703125f },
+		{ 0.02199115790426731109619140625f, 0.09672014415264129638671875f, 0.881288707256317138671875f } } };
+
+	inline constexpr Matrix3x3 kWBT2020_To_BT709 = { {
+		{ 1.71820735931396484375f, -0.625647246837615966796875f, -0.0925601422786712646484375f },
+		{ -0.14321804046630859375f, 1.17079079151153564453125f, -0.02757274545729160308837890625f },
+		{ -0.027157165110111236572265625f, -0.112880535423755645751953125f, 1.14003765583038330078125f } } };
+
+	inline constexpr Matrix3x3 kWBT2020_To_BT2020 = { {
+		{ 1.029674530029296875f, -0.011901193298399448394775390625f, -0.0177733041346073150634765625f },
+		{ -0.01327986083924770355224609375f, 1.032076358795166015625f, -0.0187964402139186859130859375f },
+		{ -0.008763029240071773529052734375f, -0.008305363357067108154296875f, 1.017068386077880859375f } } };
+
+	inline constexpr Matrix3x3 kBT709_To_XYZ = { {
+		{ 0.4123907983303070068359375f, 0.3575843274593353271484375f, 0.18048079311847686767578125f },
+		{ 0.2126390039920806884765625f, 0.715168654918670654296875f, 0.072192318737506866455078125f },
+		{ 0.0193308182060718536376953125f, 0.119194783270359039306640625f, 0.950532138347625732421875f } } };
+
+	inline constexpr Matrix3x3 kXYZ_To_BT709 = { {
+		{ 3.2409698963165283203125f, -1.53738319873809814453125f, -0.4986107647418975830078125f },
+		{ -0.96924364566802978515625f, 1.875967502593994140625f, 0.0415550582110881805419921875f },
+		{ 0.055630080401897430419921875f, -0.2039769589900970458984375f, 1.05697154998779296875f } } };
+
+	inline constexpr Matrix3x3 kBT2020_To_XYZ = { {
+		{ 0.636958062648773193359375f, 0.144616901874542236328125f, 0.1688809692859649658203125f },
+		{ 0.26270020008087158203125f, 0.677998065948486328125f, 0.0593017153441905975341796875f },
+		{ 0.f, 0.028072692453861236572265625f, 1.060985088348388671875f } } };
+
+	inline constexpr Matrix3x3 kXYZ_To_BT2020 = { {
+		{ 1.7166512012481689453125f, -0.3556707799434661865234375f, -0.253366291522979736328125f },
+		{ -0.666684329509735107421875f, 1.61648118495941162109375f, 0.0157685466110706329345703125f },
+		{ 0.0176398567855358123779296875f, -0.0427706129848957061767578125f, 0.9421031475067138671875f } } };
+
+	inline constexpr Matrix3x3 kBT709_To_AP1D65 = { {
+		{ 0.61702883243560791015625f, 0.333867609500885009765625f, 0.04910354316234588623046875f },
+		{ 0.069922320544719696044921875f, 0.91734969615936279296875f, 0.012727967463433742523193359375f },
+		{ 0.02054978720843791961669921875f, 0.107552029192447662353515625f, 0.871898174285888671875f } } };
+
+	inline constexpr Matrix3x3 kAP1D65_To_BT709 = { {
+		{ 1.69219148159027099609375f, -0.6057331562042236328125f, -0.08645831048488616943359375f },
+		{ -0.1286492049694061279296875f, 1.13801670074462890625f, -0.00936750136315822601318359375f },
+		{ -0.0240139178931713104248046875f, -0.1261022388935089111328125f, 1.1501162052154541015625f } } };
+
+	inline constexpr Matrix3x3 kAP1D65_To_XYZ = { {
+		{ 0.647507190704345703125f, 0.13437913358211517333984375f, 0.1685695946216583251953125f },
+		{ 0.266086399555206298828125f, 0.67596781253814697265625f, 0.057945795357227325439453125f },
+		{ -0.00544886849820613861083984375f, 0.004072095267474651336669921875f, 1.090434551239013671875f } } };
+
+	inline constexpr Matrix3x3 kWide_To_AP1D65 = { {
+		{ 0.8346002101898193359375f, 0.16017483174800872802734375f, 0.0052249575965106487274169921875f },
+		{ 0.02556082420051097869873046875f, 0.97308480739593505859375f, 0.001354344072751700878143310546875f },
+		{ 0.00192553340457379817962646484375f, 0.0303490459918975830078125f, 0.96772539615631103515625f } } };
+
+	// Linear BT.709/sRGB to Oklab's LMS
+	inline constexpr Matrix3x3 kBT709_To_OklabLMS = { {
+		{ 0.4122214708f, 0.5363325363f, 0.0514459929f },
+		{ 0.2119034982f, 0.6806995451f, 0.1073969566f },
+		{ 0.0883024619f, 0.2817188376f, 0.6299787005f } } };
+
+	// Linear BT.2020 to Oklab's LMS
+	inline constexpr Matrix3x3 kBT2020_To_OklabLMS = { {
+		{ 0.616688430309295654296875f, 0.3601590692996978759765625f, 0.0230432935059070587158203125f },
+		{ 0.2651402056217193603515625f, 0.63585650920867919921875f, 0.099030233919620513916015625f },
+		{ 0.100150644779205322265625f, 0.2040043175220489501953125f, 0.69632470607757568359375f } } };
+
+	// Oklab's L'M'S' to Oklab
+	inline constexpr Matrix3x3 kOklabLMS_To_Oklab = { {
+		{ 0.2104542553f, 0.7936177850f, -0.0040720468f },
+		{ 1.9779984951f, -2.4285922050f, 0.4505937099f },
+		{ 0.0259040371f, 0.7827717662f, -0.8086757660f } } };
+
+	// Oklab to Oklab's L'M'S'
+	inline constexpr Matrix3x3 kOklab_To_OklabLMS = { {
+		{ 1.f, 0.3963377774f, 0.2158037573f },
+		{ 1.f, -0.1055613458f, -0.0638541728f },
+		{ 1.f, -0.0894841775f, -1.2914855480f } } };
+
+	// Oklab's LMS to linear BT.709/sRGB
+	inline constexpr Matrix3x3 kOklabLMS_To_BT709 = { {
+		{ 4.0767416621f, -3.3077115913f, 0.2309699292f },
+		{ -1.2684380046f, 2.6097574011f, -0.3413193965f },
+		{ -0.0041960863f, -0.7034186147f, 1.7076147010f } } };
+
+	// Oklab's LMS to linear BT.2020
+	inline constexpr Matrix3x3 kOklabLMS_To_BT2020 = { {
+		{ 2.1401402950286865234375f, -1.24635589122772216796875f, 0.1064317226409912109375f },
+		{ -0.884832441806793212890625f, 2.16317272186279296875f, -0.2783615887165069580078125f },
+		{ -0.048579059541225433349609375f, -0.4544909000396728515625f, 1.5023562908172607421875f } } };
+
+	// L'M'S' to ICtCp
+	inline constexpr Matrix3x3 kPQLMS_To_ICtCp = { {
+		{ 0.5f, 0.5f, 0.f },
+		{ 1.61376953125f, -3.323486328125f, 1.709716796875f },
+		{ 4.378173828125f, -4.24560546875f, -0.132568359375f } } };
+
+	// ICtCp to L'M'S'
+	inline constexpr Matrix3x3 kICtCp_To_PQLMS = { {
+		{ 1.f, 0.008609036915004253387451171875f, 0.11102962493896484375f },
+		{ 1.f, -0.008609036915004253387451171875f, -0.11102962493896484375f },
+		{ 1.f, 0.560031354427337646484375f, -0.3206271827220916748046875f } } };
+
+	// Linear BT.709 to ICtCp's LMS
+	inline constexpr Matrix3x3 kBT709_To_LMS = { {
+		{ 0.295654296875f, 0.623291015625f, 0.0810546875f },
+		{ 0.156005859375f, 0.7275390625f, 0.116455078125f },
+		{ 0.03515625f, 0.15673828125f, 0.807861328125f } } };
+
+	// ICtCp's LMS to linear BT.709
+	inline constexpr Matrix3x3 kLMS_To_BT709 = { {
+		{ 6.171343326568603515625f, -5.318845272064208984375f, 0.14753799140453338623046875f },
+		{ -1.3213660717010498046875f, 2.5573856830596923828125f, -0.23607718944549560546875f },
+		{ -0.012195955030620098114013671875f, -0.2647107541561126708984375f, 1.27721846103668212890625f } } };
+
+	// Lane primitives. Comparisons return a mask ("bool" for scalars) that "Select()" consumes.
+
+	template <class T>
+	T Splat(float a_value);
+
+	template <>
+	inline float Splat<float>(float a_value) { return a_value; }
+	inline float Add(float a_a, float a_b) { return a_a + a_b; }
+	inline float Sub(float a_a, float a_b) { return a_a - a_b; }
+	inline float Mul(float a_a, float a_b) { return a_a * a_b; }
+	inline float Div(float a_a, float a_b) { return a_a / a_b; }
+	inline float MulAdd(float a_a, float a_b, float a_c) { return a_a * a_b + a_c; }
+	inline float Min(float a_a, float a_b) { return a_a < a_b ? a_a : a_b; }
+	inline float Max(float a_a, float a_b) { return a_a > a_b ? a_a : a_b; }
+	inline float Abs(float a_value) { return std::abs(a_value); }
+	inline float Sqrt(float a_value) { return std::sqrt(a_value); }
+	inline bool  Less(float a_a, float a_b) { return a_a < a_b; }
+	inline bool  LessEqual(float a_a, float a_b) { return a_a <= a_b; }
+	inline bool  Greater(float a_a, float a_b) { return a_a > a_b; }
+	inline bool  And(bool a_a, bool a_b) { return a_a && a_b; }
+	inline bool  Or(bool a_a, bool a_b) { return a_a || a_b; }
+	inline float Select(bool a_mask, float a_ifTrue, float a_ifFalse) { return a_mask ? a_ifTrue : a_ifFalse; }
+	inline float Log2(float a_value) { return std::log2(a_value); }
+	inline float Exp2(float a_value) { return std::exp2(a_value); }
+	inline float Pow(float a_base, float a_exponent) { return std::pow(a_base, a_exponent); }
+	inline float Sin(float a_value) { return std::sin(a_value); }
+	inline float Cos(float a_value) { return std::cos(a_value); }
+	inline float Atan2(float a_y, float a_x) { return std::atan2(a_y, a_x); }
+
+	template <>
+	inline __m128 Splat<__m128>(float a_value) { return _mm_set1_ps(a_value); }
+	inline __m128 Add(__m128 a_a, __m128 a_b) { return _mm_add_ps(a_a, a_b); }
+	inline __m128 Sub(__m128 a_a, __m128 a_b) { return _mm_sub_ps(a_a, a_b); }
+	inline __m128 Mul(__m128 a_a, __m128 a_b) { return _mm_mul_ps(a_a, a_b); }
+	inline __m128 Div(__m128 a_a, __m128 a_b) { return _mm_div_ps(a_a, a_b); }
+	inline __m128 MulAdd(__m128 a_a, __m128 a_b, __m128 a_c) { return _mm_add_ps(_mm_mul_ps(a_a, a_b), a_c); }
+	inline __m128 Min(__m128 a_a, __m128 a_b) { return _mm_min_ps(a_a, a_b); }
+	inline __m128 Max(__m128 a_a, __m128 a_b) { return _mm_max_ps(a_a, a_b); }
+	inline __m128 Abs(__m128 a_value) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a_value); }
+	inline __m128 Sqrt(__m128 a_value) { return _mm_sqrt_ps(a_value); }
+	inline __m128 Less(__m128 a_a, __m128 a_b) { return _mm_cmplt_ps(a_a, a_b); }
+	inline __m128 LessEqual(__m128 a_a, __m128 a_b) { return _mm_cmple_ps(a_a, a_b); }
+	inline __m128 Greater(__m128 a_a, __m128 a_b) { return _mm_cmpgt_ps(a_a, a_b); }
+	inline __m128 And(__m128 a_a, __m128 a_b) { return _mm_and_ps(a_a, a_b); }
+	inline __m128 Or(__m128 a_a, __m128 a_b) { return _mm_or_ps(a_a, a_b); }
+	inline __m128 Select(__m128 a_mask, __m128 a_ifTrue, __m128 a_ifFalse) { return _mm_or_ps(_mm_and_ps(a_mask, a_ifTrue), _mm_andnot_ps(a_mask, a_ifFalse)); }
+	inline __m128 Round(__m128 a_value) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a_value)); }  // to nearest, |value| < 2^31
+
+	// Splits a positive normal float into its unbiased exponent and its mantissa in [1, 2)
+	inline __m128 SplitExponent(__m128 a_value, __m128& a_outMantissa)
+	{
+		const __m128i bits = _mm_castps_si128(a_value);
+		a_outMantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+		return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	}
+
+	// 2^n for integral n in [-126, 127]
+	inline __m128 PowerOfTwo(__m128 a_integer)
+	{
+		return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(a_integer), _mm_set1_epi32(127)), 23));
+	}
+
+	inline void Store(float* a_out, __m128 a_value) { _mm_storeu_ps(a_out, a_value); }
+
+#ifdef __AVX2__
+	template <>
+	inline __m256 Splat<__m256>(float a_value) { return _mm256_set1_ps(a_value); }
+	inline __m256 Add(__m256 a_a, __m256 a_b) { return _mm256_add_ps(a_a, a_b); }
+	inline __m256 Sub(__m256 a_a, __m256 a_b) { return _mm256_sub_ps(a_a, a_b); }
+	inline __m256 Mul(__m256 a_a, __m256 a_b) { return _mm256_mul_ps(a_a, a_b); }
+	inline __m256 Div(__m256 a_a, __m256 a_b) { return _mm256_div_ps(a_a, a_b); }
+	inline __m256 MulAdd(__m256 a_a, __m256 a_b, __m256 a_c) { return _mm256_add_ps(_mm256_mul_ps(a_a, a_b), a_c); }
+	inline __m256 Min(__m256 a_a, __m256 a_b) { return _mm256_min_ps(a_a, a_b); }
+	inline __m256 Max(__m256 a_a, __m256 a_b) { return _mm256_max_ps(a_a, a_b); }
+	inline __m256 Abs(__m256 a_value) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a_value); }
+	inline __m256 Sqrt(__m256 a_value) { return _mm256_sqrt_ps(a_value); }
+	inline __m256 Less(__m256 a_a, __m256 a_b) { return _mm256_cmp_ps(a_a, a_b, _CMP_LT_OQ); }
+	inline __m256 LessEqual(__m256 a_a, __m256 a_b) { return _mm256_cmp_ps(a_a, a_b, _CMP_LE_OQ); }
+	inline __m256 Greater(__m256 a_a, __m256 a_b) { return _mm256_cmp_ps(a_a, a_b, _CMP_GT_OQ); }
+	inline __m256 And(__m256 a_a, __m256 a_b) { return _mm256_and_ps(a_a, a_b); }
+	inline __m256 Or(__m256 a_a, __m256 a_b) { return _mm256_or_ps(a_a, a_b); }
+	inline __m256 Select(__m256 a_mask, __m256 a_ifTrue, __m256 a_ifFalse) { return _mm256_blendv_ps(a_ifFalse, a_ifTrue, a_mask); }
+	inline __m256 Round(__m256 a_value) { return _mm256_cvtepi32_ps(_mm256_cvtps_epi32(a_value)); }
+
+	inline __m256 SplitExponent(__m256 a_value, __m256& a_outMantissa)
+	{
+		const __m256i bits = _mm256_castps_si256(a_value);
+		a_outMantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)));
+		return _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+	}
+
+	inline __m256 PowerOfTwo(__m256 a_integer)
+	{
+		return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(a_integer), _mm256_set1_epi32(127)), 23));
+	}
+
+	inline void Store(float* a_out, __m256 a_value) { _mm256_storeu_ps(a_out, a_value); }
+
+	// Widest lanes of this build
+	using Wide = __m256;
+	inline __m256 LoadWide(const float* a_values) { return _mm256_loadu_ps(a_values); }
+#else
+	using Wide = __m128;
+	inline __m128 LoadWide(const float* a_values) { return _mm_loadu_ps(a_values); }
+#endif
+	inline constexpr std::size_t kWideLanes = sizeof(Wide) / sizeof(float);
+
+	// A color of "Wide" lanes. It's deduced rather than spelled "Vec3<Wide>", as GCC warns that the attributes of vector types are ignored in template arguments.
+	using WideVec3 = decltype(Vec3{ Wide{}, Wide{}, Wide{} });
+
+	// Log2 for positive inputs, zero and denormals included (log2(0) is -150 instead of -inf).
+	// The mantissa is reduced to [sqrt(0.5), sqrt(2)) and ln(m) is evaluated with the atanh series of s = (m - 1) / (m + 1) up to s^9,
+	// whose truncation error (|s| <= 0.1716) is below 1e-9.
+	template <class V>
+	V Log2(V a_value)
+	{
+		// Denormals are scaled up to normal floats first
+		const V denormal = Less(a_value, Splat<V>(FLT_MIN));
+		const V value = Select(denormal, Mul(a_value, Splat<V>(8388608.f)), a_value);  // 2^23
+
+		V mantissa;
+		V exponent = SplitExponent(value, mantissa);
+		exponent = Select(denormal, Sub(exponent, Splat<V>(23.f)), exponent);
+
+		const V bigger = Greater(mantissa, Splat<V>(std::numbers::sqrt2_v<float>));
+		mantissa = Select(bigger, Mul(mantissa, Splat<V>(0.5f)), mantissa);
+		exponent = Select(bigger, Add(exponent, Splat<V>(1.f)), exponent);
+
+		const V one = Splat<V>(1.f);
+		const V s = Div(Sub(mantissa, one), Add(mantissa, one));
+		const V s2 = Mul(s, s);
+		V       series = Splat<V>(2.f / 9.f);
+		series = MulAdd(series, s2, Splat<V>(2.f / 7.f));
+		series = MulAdd(series, s2, Splat<V>(2.f / 5.f));
+		series = MulAdd(series, s2, Splat<V>(2.f / 3.f));
+		series = MulAdd(series, s2, Splat<V>(2.f));
+		const V lnMantissa = Mul(series, s);
+
+		return MulAdd(lnMantissa, Splat<V>(std::numbers::log2e_v<float>), exponent);
+	}
+
+	// Exp2, results below FLT_MIN are flushed to zero and inputs above 127 are clamped.
+	// 2^f with f in [-0.5, 0.5] uses the Taylor series of e^(f * ln(2)) up to the 7th power.
+	template <class V>
+	V Exp2(V a_value)
+	{
+		const V value = Min(Max(a_value, Splat<V>(-126.f)), Splat<V>(127.f));
+		const V integer = Round(value);
+		const V fraction = Mul(Sub(value, integer), Splat<V>(std::numbers::ln2_v<float>));
+
+		V series = Splat<V>(1.f / 5040.f);
+		series = MulAdd(series, fraction, Splat<V>(1.f / 720.f));
+		series = MulAdd(series, fraction, Splat<V>(1.f / 120.f));
+		series = MulAdd(series, fraction, Splat<V>(1.f / 24.f));
+		series = MulAdd(series, fraction, Splat<V>(1.f / 6.f));
+		series = MulAdd(series, fraction, Splat<V>(0.5f));
+		series = MulAdd(series, fraction, Splat<V>(1.f));
+		series = MulAdd(series, fraction, Splat<V>(1.f));
+
+		return Select(Less(a_value, Splat<V>(-126.f)), Splat<V>(0.f), Mul(series, PowerOfTwo(integer)));
+	}
+
+	// Like HLSL's pow(), bases must be positive. Zero returns zero, negative bases aren't supported.
+	template <class V>
+	V Pow(V a_base, V a_exponent)
+	{
+		return Select(Greater(a_base, Splat<V>(0.f)), Exp2(Mul(Log2(a_base), a_exponent)), Splat<V>(0.f));
+	}
+
+	// Sine, for the hue angles of OkLCh. The angle is wrapped to [-pi, pi] and folded to [-pi/2, pi/2], where its Taylor series up to x^11 is used.
+	template <class V>
+	V Sin(V a_value)
+	{
+		constexpr float pi = std::numbers::pi_v<float>;
+		V               x = Sub(a_value, Mul(Round(Mul(a_value, Splat<V>(0.5f / pi))), Splat<V>(2.f * pi)));
+		x = Select(Greater(x, Splat<V>(pi / 2.f)), Sub(Splat<V>(pi), x), x);
+		x = Select(Less(x, Splat<V>(-pi / 2.f)), Sub(Splat<V>(-pi), x), x);
+
+		const V x2 = Mul(x, x);
+		V       series = Splat<V>(-1.f / 39916800.f);
+		series = MulAdd(series, x2, Splat<V>(1.f / 362880.f));
+		series = MulAdd(series, x2, Splat<V>(-1.f / 5040.f));
+		series = MulAdd(series, x2, Splat<V>(1.f / 120.f));
+		series = MulAdd(series, x2, Splat<V>(-1.f / 6.f));
+		series = MulAdd(series, x2, Splat<V>(1.f));
+		return Mul(series, x);
+	}
+
+	template <class V>
+	V Cos(V a_value)
+	{
+		return Sin(Add(a_value, Splat<V>(std::numbers::pi_v<float> / 2.f)));
+	}
+
+	// Arc tangent of y/x in [-pi, pi], a minimax polynomial of atan() over [0, 1] after folding the octants
+	template <class V>
+	V Atan2(V a_y, V a_x)
+	{
+		constexpr float pi = std::numbers::pi_v<float>;
+		const V         absX = Abs(a_x);
+		const V         absY = Abs(a_y);
+		const V         ratio = Div(Min(absX, absY), Max(Max(absX, absY), Splat<V>(FLT_MIN)));
+		const V         ratio2 = Mul(ratio, ratio);
+
+		V series = Splat<V>(-0.0117212f);
+		series = MulAdd(series, ratio2, Splat<V>(0.05265332f));
+		series = MulAdd(series, ratio2, Splat<V>(-0.11643287f));
+		series = MulAdd(series, ratio2, Splat<V>(0.19354346f));
+		series = MulAdd(series, ratio2, Splat<V>(-0.33262347f));
+		series = MulAdd(series, ratio2, Splat<V>(0.99997726f));
+		V angle = Mul(series, ratio);
+
+		angle = Select(Greater(absY, absX), Sub(Splat<V>(pi / 2.f), angle), angle);
+		angle = Select(Less(a_x, Splat<V>(0.f)), Sub(Splat<V>(pi), angle), angle);
+		return Select(Less(a_y, Splat<V>(0.f)), Sub(Splat<V>(0.f), angle), angle);
+	}
+
+	// HLSL's sign(): -1, 0 or 1
+	template <class T>
+	T Sign(T a_value)
+	{
+		const T zero = Splat<T>(0.f);
+		return Select(Greater(a_value, zero), Splat<T>(1.f), Select(Less(a_value, zero), Splat<T>(-1.f), zero));
+	}
+
+	template <class T>
+	T Saturate(T a_value)
+	{
+		return Min(Max(a_value, Splat<T>(0.f)), Splat<T>(1.f));
+	}
+
+	template <class T, class F>
+	Vec3<T> Apply(const Vec3<T>& a_color, F&& a_function)
+	{
+		return { a_function(a_color.x), a_function(a_color.y), a_function(a_color.z) };
+	}
+
+	// Per channel arithmetic, with scalars broadcast to all channels like in HLSL, so shader code ports read the same
+	template <class T>
+	Vec3<T> operator+(const Vec3<T>& a_a, const Vec3<T>& a_b) { return { Add(a_a.x, a_b.x), Add(a_a.y, a_b.y), Add(a_a.z, a_b.z) }; }
+	template <class T>
+	Vec3<T> operator-(const Vec3<T>& a_a, const Vec3<T>& a_b) { return { Sub(a_a.x, a_b.x), Sub(a_a.y, a_b.y), Sub(a_a.z, a_b.z) }; }
+	template <class T>
+	Vec3<T> operator*(const Vec3<T>& a_a, const Vec3<T>& a_b) { return { Mul(a_a.x, a_b.x), Mul(a_a.y, a_b.y), Mul(a_a.z, a_b.z) }; }
+	template <class T>
+	Vec3<T> operator/(const Vec3<T>& a_a, const Vec3<T>& a_b) { return { Div(a_a.x, a_b.x), Div(a_a.y, a_b.y), Div(a_a.z, a_b.z) }; }
+	template <class T>
+	Vec3<T> operator-(const Vec3<T>& a_value) { return Vec3<T>{ Splat<T>(0.f), Splat<T>(0.f), Splat<T>(0.f) } - a_value; }
+
+	template <class T>
+	Vec3<T> Broadcast(T a_value) { return { a_value, a_value, a_value }; }
+
+	template <class T>
+	Vec3<T> operator+(const Vec3<T>& a_a, std::type_identity_t<T> a_b) { return a_a + Broadcast(a_b); }
+	template <class T>
+	Vec3<T> operator-(const Vec3<T>& a_a, std::type_identity_t<T> a_b) { return a_a - Broadcast(a_b); }
+	template <class T>
+	Vec3<T> operator*(const Vec3<T>& a_a, std::type_identity_t<T> a_b) { return a_a * Broadcast(a_b); }
+	template <class T>
+	Vec3<T> operator/(const Vec3<T>& a_a, std::type_identity_t<T> a_b) { return a_a / Broadcast(a_b); }
+	template <class T>
+	Vec3<T> operator+(std::type_identity_t<T> a_a, const Vec3<T>& a_b) { return Broadcast(a_a) + a_b; }
+	template <class T>
+	Vec3<T> operator-(std::type_identity_t<T> a_a, const Vec3<T>& a_b) { return Broadcast(a_a) - a_b; }
+	template <class T>
+	Vec3<T> operator*(std::type_identity_t<T> a_a, const Vec3<T>& a_b) { return Broadcast(a_a) * a_b; }
+	template <class T>
+	Vec3<T> operator/(std::type_identity_t<T> a_a, const Vec3<T>& a_b) { return Broadcast(a_a) / a_b; }
+
+	template <class T, class U>
+	Vec3<T>& operator+=(Vec3<T>& a_a, const U& a_b) { return a_a = a_a + a_b; }
+	template <class T, class U>
+	Vec3<T>& operator-=(Vec3<T>& a_a, const U& a_b) { return a_a = a_a - a_b; }
+	template <class T, class U>
+	Vec3<T>& operator*=(Vec3<T>& a_a, const U& a_b) { return a_a = a_a * a_b; }
+	template <class T, class U>
+	Vec3<T>& operator/=(Vec3<T>& a_a, const U& a_b) { return a_a = a_a / a_b; }
+
+	template <class T>
+	Vec3<T> Mul(const Matrix3x3& a_matrix, const Vec3<T>& a_color)
+	{
+		const auto row = [&](const std::array<float, 3>& a_row) {
+			return MulAdd(Splat<T>(a_row[2]), a_color.z, MulAdd(Splat<T>(a_row[1]), a_color.y, Mul(Splat<T>(a_row[0]), a_color.x)));
+		};
+		return { row(a_matrix[0]), row(a_matrix[1]), row(a_matrix[2]) };
+	}
+
+	template <class T>
+	T Dot(const Vec3<T>& a_a, const Vec3<T>& a_b)
+	{
+		return MulAdd(a_a.z, a_b.z, MulAdd(a_a.y, a_b.y, Mul(a_a.x, a_b.x)));
+	}
+
+	template <class T>
+	Vec3<T> BT709_To_BT2020(const Vec3<T>& a_color) { return Mul(kBT709_To_BT2020, a_color); }
+	template <class T>
+	Vec3<T> BT2020_To_BT709(const Vec3<T>& a_color) { return Mul(kBT2020_To_BT709, a_color); }
+	template <class T>
+	Vec3<T> BT709_To_WBT2020(const Vec3<T>& a_color) { return Mul(kBT709_To_WBT2020, a_color); }
+	template <class T>
+	Vec3<T> WBT2020_To_BT709(const Vec3<T>& a_color) { return Mul(kWBT2020_To_BT709, a_color); }
+	template <class T>
+	Vec3<T> WBT2020_To_BT2020(const Vec3<T>& a_color) { return Mul(kWBT2020_To_BT2020, a_color); }
+
+	// Luminance of linear BT.709/sRGB
+	template <class T>
+	T Luminance(const Vec3<T>& a_color)
+	{
+		return Dot(a_color, Vec3<T>{ Splat<T>(kBT709_To_XYZ[1][0]), Splat<T>(kBT709_To_XYZ[1][1]), Splat<T>(kBT709_To_XYZ[1][2]) });
+	}
+
+	template <class T>
+	Vec3<T> Saturation(const Vec3<T>& a_color, float a_saturation)
+	{
+		const T luminance = Luminance(a_color);
+		return Apply(a_color, [&](T a_channel) { return MulAdd(Sub(a_channel, luminance), Splat<T>(a_saturation), luminance); });
+	}
+
+	// sRGB transfer function ("gamma_linear_to_sRGB")
+	template <class T>
+	T LinearToSRGB(T a_channel)
+	{
+		return Select(LessEqual(a_channel, Splat<T>(0.0031308f)),
+			Mul(a_channel, Splat<T>(12.92f)),
+			Sub(Mul(Splat<T>(1.055f), Pow(a_channel, Splat<T>(1.f / 2.4f))), Splat<T>(0.055f)));
+	}
+
+	template <class T>
+	T SRGBToLinear(T a_channel)
+	{
+		return Select(LessEqual(a_channel, Splat<T>(0.04045f)),
+			Div(a_channel, Splat<T>(12.92f)),
+			Pow(Div(Add(a_channel, Splat<T>(0.055f)), Splat<T>(1.055f)), Splat<T>(2.4f)));
+	}
+
+	// Mirroring the curve on negative values makes it closer to gamma 2.2 and perception space in general
+	template <class T>
+	T LinearToSRGBMirrored(T a_channel) { return Mul(LinearToSRGB(Abs(a_channel)), Sign(a_channel)); }
+	template <class T>
+	T SRGBToLinearMirrored(T a_channel) { return Mul(SRGBToLinear(Abs(a_channel)), Sign(a_channel)); }
+
+	template <class T>
+	T LinearToGamma(T a_channel, float a_gamma = 2.2f) { return Pow(a_channel, Splat<T>(1.f / a_gamma)); }
+	template <class T>
+	T GammaToLinear(T a_channel, float a_gamma = 2.2f) { return Pow(a_channel, Splat<T>(a_gamma)); }
+	template <class T>
+	T LinearToGammaMirrored(T a_channel, float a_gamma = 2.2f) { return Mul(LinearToGamma(Abs(a_channel), a_gamma), Sign(a_channel)); }
+	template <class T>
+	T GammaToLinearMirrored(T a_channel, float a_gamma = 2.2f) { return Mul(GammaToLinear(Abs(a_channel), a_gamma), Sign(a_channel)); }
+
+	// Applies a transfer function only to part of the range, what's left out is added back linearly ("*_custom" in color.hlsl).
+	// "a_mirrored" curve is used below zero when "a_applyBelowZero" is set, "a_function" otherwise.
+	template <class T, class F, class M>
+	T ApplyCustom(T a_channel, bool a_applyBelowZero, bool a_applyBeyondOne, F&& a_function, M&& a_mirrored)
+	{
+		const T zero = Splat<T>(0.f);
+		const T one = Splat<T>(1.f);
+		T       clamped = a_channel;
+		if (!a_applyBelowZero && !a_applyBeyondOne) {
+			clamped = Saturate(a_channel);
+		} else if (!a_applyBelowZero) {
+			clamped = Max(a_channel, zero);
+		} else if (!a_applyBeyondOne) {
+			clamped = Min(a_channel, one);
+		}
+		const T excess = Sub(a_channel, clamped);
+		return Add(a_applyBelowZero ? a_mirrored(clamped) : a_function(clamped), excess);
+	}
+
+	// Defaults match "ApplyGammaBelowZeroDefault" and "ApplyGammaBeyondOneDefault"
+	template <class T>
+	T LinearToSRGBCustom(T a_channel, bool a_mirrorBelowZero = true, bool a_applyBelowZero = true, bool a_applyBeyondOne = false)
+	{
+		return ApplyCustom(a_channel, a_applyBelowZero, a_applyBeyondOne,
+			[](T a_value) { return LinearToSRGB(a_value); },
+			[&](T a_value) { return a_mirrorBelowZero ? LinearToSRGBMirrored(a_value) : LinearToSRGB(a_value); });
+	}
+
+	template <class T>
+	T SRGBToLinearCustom(T a_channel, bool a_mirrorBelowZero = true, bool a_applyBelowZero = true, bool a_applyBeyondOne = false)
+	{
+		return ApplyCustom(a_channel, a_applyBelowZero, a_applyBeyondOne,
+			[](T a_value) { return SRGBToLinear(a_value); },
+			[&](T a_value) { return a_mirrorBelowZero ? SRGBToLinearMirrored(a_value) : SRGBToLinear(a_value); });
+	}
+
+	template <class T>
+	T LinearToGammaCustom(T a_channel, float a_gamma = 2.2f, bool a_applyBelowZero = true, bool a_applyBeyondOne = false)
+	{
+		return ApplyCustom(a_channel, a_applyBelowZero, a_applyBeyondOne,
+			[&](T a_value) { return LinearToGamma(a_value, a_gamma); },
+			[&](T a_value) { return LinearToGammaMirrored(a_value, a_gamma); });
+	}
+
+	template <class T>
+	T GammaToLinearCustom(T a_channel, float a_gamma = 2.2f, bool a_applyBelowZero = true, bool a_applyBeyondOne = false)
+	{
+		return ApplyCustom(a_channel, a_applyBelowZero, a_applyBeyondOne,
+			[&](T a_value) { return GammaToLinear(a_value, a_gamma); },
+			[&](T a_value) { return GammaToLinearMirrored(a_value, a_gamma); });
+	}
+
+	// PQ (ST.2084) encode, 1 is 10000 nits
+	template <class T>
+	T LinearToPQ(T a_value)
+	{
+		const T colorPow = Pow(Max(a_value, Splat<T>(0.f)), Splat<T>(kPQ_M1));
+		const T numerator = MulAdd(Splat<T>(kPQ_C2), colorPow, Splat<T>(kPQ_C1));
+		const T denominator = MulAdd(Splat<T>(kPQ_C3), colorPow, Splat<T>(1.f));
+		return Pow(Div(numerator, denominator), Splat<T>(kPQ_M2));
+	}
+
+	// "a_maxValue" is the linear value of 10000 nits, e.g. "kPQMaxWhitePoint" for scRGB
+	template <class T>
+	T LinearToPQ(T a_value, float a_maxValue) { return LinearToPQ(Div(a_value, Splat<T>(a_maxValue))); }
+
+	template <class T>
+	T PQToLinear(T a_value)
+	{
+		const T colorPow = Pow(Max(a_value, Splat<T>(0.f)), Splat<T>(1.f / kPQ_M2));
+		const T numerator = Max(Sub(colorPow, Splat<T>(kPQ_C1)), Splat<T>(0.f));
+		const T denominator = Sub(Splat<T>(kPQ_C2), Mul(Splat<T>(kPQ_C3), colorPow));
+		return Pow(Div(numerator, denominator), Splat<T>(1.f / kPQ_M1));
+	}
+
+	template <class T>
+	T PQToLinear(T a_value, float a_maxValue) { return Mul(PQToLinear(a_value), Splat<T>(a_maxValue)); }
+
+	// Oklab: L is the perceived lightness, a how green/red the color is, b how blue/yellow it is.
+	// The cube root is mirrored below zero, so colors outside of the Oklab gamut don't break.
+	template <class T>
+	Vec3<T> LMSToOklab(const Vec3<T>& a_lms)
+	{
+		return Mul(kOklabLMS_To_Oklab, Apply(a_lms, [](T a_value) { return Mul(Pow(Abs(a_value), Splat<T>(1.f / 3.f)), Sign(a_value)); }));
+	}
+
+	template <class T>
+	Vec3<T> OklabToLMS(const Vec3<T>& a_lab)
+	{
+		return Apply(Mul(kOklab_To_OklabLMS, a_lab), [](T a_value) { return Mul(Mul(a_value, a_value), a_value); });
+	}
+
+	template <class T>
+	Vec3<T> BT709_To_Oklab(const Vec3<T>& a_color) { return LMSToOklab(Mul(kBT709_To_OklabLMS, a_color)); }
+	template <class T>
+	Vec3<T> BT2020_To_Oklab(const Vec3<T>& a_color) { return LMSToOklab(Mul(kBT2020_To_OklabLMS, a_color)); }
+	template <class T>
+	Vec3<T> Oklab_To_BT709(const Vec3<T>& a_lab) { return Mul(kOklabLMS_To_BT709, OklabToLMS(a_lab)); }
+	template <class T>
+	Vec3<T> Oklab_To_BT2020(const Vec3<T>& a_lab) { return Mul(kOklabLMS_To_BT2020, OklabToLMS(a_lab)); }
+
+	// OkLCh: lightness, chroma (range 0+) and hue (range -pi/+pi)
+	template <class T>
+	Vec3<T> Oklab_To_OkLCh(const Vec3<T>& a_lab)
+	{
+		return { a_lab.x, Sqrt(MulAdd(a_lab.y, a_lab.y, Mul(a_lab.z, a_lab.z))), Atan2(a_lab.z, a_lab.y) };
+	}
+
+	template <class T>
+	Vec3<T> OkLCh_To_Oklab(const Vec3<T>& a_lch)
+	{
+		return { a_lch.x, Mul(a_lch.y, Cos(a_lch.z)), Mul(a_lch.y, Sin(a_lch.z)) };
+	}
+
+	template <class T>
+	Vec3<T> BT709_To_OkLCh(const Vec3<T>& a_color) { return Oklab_To_OkLCh(BT709_To_Oklab(a_color)); }
+	template <class T>
+	Vec3<T> BT2020_To_OkLCh(const Vec3<T>& a_color) { return Oklab_To_OkLCh(BT2020_To_Oklab(a_color)); }
+	template <class T>
+	Vec3<T> OkLCh_To_BT709(const Vec3<T>& a_lch) { return Oklab_To_BT709(OkLCh_To_Oklab(a_lch)); }
+	template <class T>
+	Vec3<T> OkLCh_To_BT2020(const Vec3<T>& a_lch) { return Oklab_To_BT2020(OkLCh_To_Oklab(a_lch)); }
+
+	// ICtCp of linear BT.709 (scRGB, 1 is 80 nits)
+	template <class T>
+	Vec3<T> BT709_To_ICtCp(const Vec3<T>& a_color)
+	{
+		// The division by "kPQMaxWhitePoint" happens before the LMS conversion for floating point accuracy
+		const T scale = Splat<T>(1.f / kPQMaxWhitePoint);
+		const Vec3<T> lms = Mul(kBT709_To_LMS, Apply(a_color, [&](T a_value) { return Mul(a_value, scale); }));
+		return Mul(kPQLMS_To_ICtCp, Apply(lms, [](T a_value) { return LinearToPQ(a_value); }));
+	}
+
+	template <class T>
+	Vec3<T> ICtCp_To_BT709(const Vec3<T>& a_ictcp)
+	{
+		const Vec3<T> lms = Apply(Mul(kICtCp_To_PQLMS, a_ictcp), [](T a_value) { return Max(PQToLinear(a_value), Splat<T>(0.f)); });
+		return Apply(Mul(kLMS_To_BT709, lms), [](T a_value) { return Mul(a_value, Splat<T>(kPQMaxWhitePoint)); });
+	}
+
+	// Expands bright saturated BT.709 colors onto BT.2020 for a fake HDR look. Input and output are linear BT.709, with paper white at ~80-100 nits.
+	// An amount of 0 still changes colors, above 1 has diminishing returns.
+	template <class T>
+	Vec3<T> ExtendGamut(const Vec3<T>& a_color, float a_amount = 1.f)
+	{
+		const Vec3<T> colorAP1 = Mul(kBT709_To_AP1D65, a_color);
+		const Vec3<T> colorExpand = Mul(kWide_To_AP1D65, a_color);
+
+		const T       lumaAP1 = Dot(colorAP1, Vec3<T>{ Splat<T>(kAP1D65_To_XYZ[1][0]), Splat<T>(kAP1D65_To_XYZ[1][1]), Splat<T>(kAP1D65_To_XYZ[1][2]) });
+		const Vec3<T> chromaMinusOne = Apply(colorAP1, [&](T a_value) { return Sub(Div(a_value, lumaAP1), Splat<T>(1.f)); });
+		const T       chromaDistanceSquared = Dot(chromaMinusOne, chromaMinusOne);
+		const T       alphaChroma = Sub(Splat<T>(1.f), Exp2(Mul(Splat<T>(-4.f), chromaDistanceSquared)));
+		const T       alphaLuma = Sub(Splat<T>(1.f), Exp2(Mul(Splat<T>(-4.f * a_amount), Mul(lumaAP1, lumaAP1))));
+		const T       alpha = Mul(alphaChroma, alphaLuma);
+
+		const Vec3<T> expandedAP1 = {
+			MulAdd(Sub(colorExpand.x, colorAP1.x), alpha, colorAP1.x),
+			MulAdd(Sub(colorExpand.y, colorAP1.y), alpha, colorAP1.y),
+			MulAdd(Sub(colorExpand.z, colorAP1.z), alpha, colorAP1.z)
+		};
+		const Vec3<T> expanded = Mul(kAP1D65_To_BT709, expandedAP1);
+
+		// Colors without a valid luminance are left untouched
+		const auto valid = Greater(lumaAP1, Splat<T>(0.f));
+		return { Select(valid, expanded.x, a_color.x), Select(valid, expanded.y, a_color.y), Select(valid, expanded.z, a_color.z) };
+	}
+
+	// Scalar only, it branches on which channels are negative.
+	// Moves colors with negative channels onto the gamut edge, along their line to the D65 white point on the CIE xy chart, keeping their luminance.
+	// Input and output are linear BT.2020 if "a_bt2020", BT.709 otherwise. "a_clampToSDRRange" then scales colors down so no channel is beyond 1.
+	inline Float3 SimpleGamutClip(Float3 a_color, bool a_bt2020, bool a_clampToSDRRange = false)
+	{
+		using Float2 = std::array<float, 2>;
+		constexpr Float2 kD65xy = { 0.3127f, 0.3290f };
+		const Float2     rxy = a_bt2020 ? Float2{ 0.708f, 0.292f } : Float2{ 0.64f, 0.33f };
+		const Float2     gxy = a_bt2020 ? Float2{ 0.170f, 0.797f } : Float2{ 0.30f, 0.60f };
+		const Float2     bxy = a_bt2020 ? Float2{ 0.131f, 0.046f } : Float2{ 0.15f, 0.06f };
+
+		const auto getM = [](const Float2& a_a, const Float2& a_b) { return (a_b[1] - a_a[1]) / (a_b[0] - a_a[0]); };
+		// Where the line of slope "a_mp" through the white point crosses the "a_from" to "a_to" gamut edge
+		const auto lineIntercept = [&](float a_mp, const Float2& a_from, const Float2& a_to) {
+			const float m = getM(a_from, a_to);
+			const float mMulFromX = m * a_from[0];
+			const float mMinusMP = m - a_mp;
+			const float mpMulWhitePointX = a_mp * kD65xy[0];
+			return Float2{
+				(-mpMulWhitePointX + kD65xy[1] - a_from[1] + mMulFromX) / mMinusMP,
+				(-kD65xy[1] * m + m * mpMulWhitePointX + a_from[1] * a_mp - mMulFromX * a_mp) / -mMinusMP
+			};
+		};
+
+		const bool rNegative = a_color.x < 0.f;
+		const bool gNegative = a_color.y < 0.f;
+		const bool bNegative = a_color.z < 0.f;
+		if (rNegative && gNegative && bNegative) {
+			// The hue of an all negative color is invalid
+			return { 0.f, 0.f, 0.f };
+		}
+		if (rNegative || gNegative || bNegative) {
+			const Float3 XYZ = Mul(a_bt2020 ? kBT2020_To_XYZ : kBT709_To_XYZ, a_color);
+			const float  sum = XYZ.x + XYZ.y + XYZ.z;
+			const Float2 xy = { XYZ.x / sum, XYZ.y / sum };
+			const float  m = getM(xy, kD65xy);
+
+			// The intercept is on the side opposite to the primary of the most negative channel
+			Float2 clippedxy;
+			if (rNegative && gNegative) {
+				clippedxy = a_color.x <= a_color.y ? lineIntercept(m, gxy, bxy) : lineIntercept(m, bxy, rxy);
+			} else if (rNegative && bNegative) {
+				clippedxy = a_color.x <= a_color.z ? lineIntercept(m, gxy, bxy) : lineIntercept(m, rxy, gxy);
+			} else if (gNegative && bNegative) {
+				clippedxy = a_color.y <= a_color.z ? lineIntercept(m, bxy, rxy) : lineIntercept(m, rxy, gxy);
+			} else if (rNegative) {
+				clippedxy = lineIntercept(m, gxy, bxy);
+			} else if (gNegative) {
+				clippedxy = lineIntercept(m, bxy, rxy);
+			} else {
+				clippedxy = lineIntercept(m, rxy, gxy);
+			}
+
+			const Float3 clippedXYZ = { (clippedxy[0] / clippedxy[1]) * XYZ.y, XYZ.y, ((1.f - clippedxy[0] - clippedxy[1]) / clippedxy[1]) * XYZ.y };
+			a_color = Mul(a_bt2020 ? kXYZ_To_BT2020 : kXYZ_To_BT709, clippedXYZ);
+		}
+		// Reduce brightness instead of reducing saturation
+		if (a_clampToSDRRange) {
+			const float maxChannel = std::max({ 1.f, a_color.x, a_color.y, a_color.z });
+			a_color = a_color / maxChannel;
+		}
+		return a_color;
+	}
+
+	// Lightness and chroma of the cusp of a hue: the most saturated color of the gamut, where the gamut triangle of the hue peaks in Oklab
+	struct OklabLC
+	{
+		float L;
+		float C;
+	};
+
+	// Scalar only, like the Oklab gamut clipping functions below (Björn Ottosson's, as in "color.hlsl").
+	// Max saturation (C/L) of a hue within BT.709 (or BT.2020), "a_a" and "a_b" must be normalized so a^2 + b^2 == 1.
+	// A polynomial fit refined by one step of Halley's method. The fit was made for BT.709, BT.2020 only relies on the refinement.
+	inline float OklabComputeMaxSaturation(float a_a, float a_b, bool a_bt2020)
+	{
+		// Max saturation will be when one of r, g or b goes below zero
+		const Matrix3x3& oklmsToRGB = a_bt2020 ? kOklabLMS_To_BT2020 : kOklabLMS_To_BT709;
+
+		// Select different coefficients depending on which component goes below zero first
+		float                       k0, k1, k2, k3, k4;
+		const std::array<float, 3>* w;
+		if (-1.88170328f * a_a - 0.80936493f * a_b > 1.f) {
+			// Red component
+			k0 = +1.19086277f; k1 = +1.76576728f; k2 = +0.59662641f; k3 = +0.75515197f; k4 = +0.56771245f;
+			w = &oklmsToRGB[0];
+		} else if (1.81444104f * a_a - 1.19445276f * a_b > 1.f) {
+			// Green component
+			k0 = +0.73956515f; k1 = -0.45954404f; k2 = +0.08285427f; k3 = +0.12541070f; k4 = +0.14503204f;
+			w = &oklmsToRGB[1];
+		} else {
+			// Blue component
+			k0 = +1.35733652f; k1 = -0.00915799f; k2 = -1.15130210f; k3 = -0.50559606f; k4 = +0.00692167f;
+			w = &oklmsToRGB[2];
+		}
+
+		// Approximate max saturation using a polynomial
+		float S = k0 + k1 * a_a + k2 * a_b + k3 * a_a * a_a + k4 * a_a * a_b;
+
+		// One step of Halley's method to get closer, the error is below 1e-6 except for some blue hues where dS/dh is close to infinite
+		const Float3 kLMS = Mul(kOklab_To_OklabLMS, Float3{ 0.f, a_a, a_b });
+		const Float3 lms_ = 1.f + S * kLMS;
+		const Float3 lms = lms_ * lms_ * lms_;
+		const Float3 lmsdS = 3.f * kLMS * lms_ * lms_;
+		const Float3 lmsdS2 = 6.f * kLMS * kLMS * lms_;
+
+		const Float3 weights = { (*w)[0], (*w)[1], (*w)[2] };
+		const float  f = Dot(weights, lms);
+		const float  f1 = Dot(weights, lmsdS);
+		const float  f2 = Dot(weights, lmsdS2);
+		return S - f * f1 / (f1 * f1 - 0.5f * f * f2);
+	}
+
+	// "a_a" and "a_b" must be normalized so a^2 + b^2 == 1
+	inline OklabLC OklabFindCusp(float a_a, float a_b, bool a_bt2020)
+	{
+		// First, find the maximum saturation (saturation S = C/L)
+		const float S = OklabComputeMaxSaturation(a_a, a_b, a_bt2020);
+
+		// Convert to linear RGB to find the first point where at least one of r, g or b >= 1
+		const Float3 rgbAtMax = a_bt2020 ? Oklab_To_BT2020(Float3{ 1.f, S * a_a, S * a_b }) : Oklab_To_BT709(Float3{ 1.f, S * a_a, S * a_b });
+		const float  L = std::pow(1.f / std::max({ rgbAtMax.x, rgbAtMax.y, rgbAtMax.z }), 1.f / 3.f);
+		return { L, L * S };
+	}
+
+	// Finds where the line from (L0, 0) to (L1, C1) of a hue leaves the gamut, as the "t" of L = L0 * (1 - t) + t * L1, C = t * C1.
+	// "a_a" and "a_b" must be normalized so a^2 + b^2 == 1, "a_cusp" is the cusp of their hue.
+	inline float OklabFindGamutIntersection(float a_a, float a_b, float a_L1, float a_C1, float a_L0, bool a_bt2020, const OklabLC& a_cusp)
+	{
+		// Find the intersection for upper and lower half separately
+		if (((a_L1 - a_L0) * a_cusp.C - (a_cusp.L - a_L0) * a_C1) <= 0.f) {
+			// Lower half
+			return a_cusp.C * a_L0 / (a_C1 * a_cusp.L + a_cusp.C * (a_L0 - a_L1));
+		}
+
+		// Upper half, first intersect with the triangle
+		float t = a_cusp.C * (a_L0 - 1.f) / (a_C1 * (a_cusp.L - 1.f) + a_cusp.C * (a_L0 - a_L1));
+
+		// Then one step of Halley's method
+		const Matrix3x3& oklmsToRGB = a_bt2020 ? kOklabLMS_To_BT2020 : kOklabLMS_To_BT709;
+		const float      dL = a_L1 - a_L0;
+		const float      dC = a_C1;
+		const Float3     kLMS = Mul(kOklab_To_OklabLMS, Float3{ 0.f, a_a, a_b });
+		const Float3     lmsdt = dL + dC * kLMS;
+
+		const float  L = a_L0 * (1.f - t) + t * a_L1;
+		const float  C = t * a_C1;
+		const Float3 lms_ = L + C * kLMS;
+		const Float3 lms = lms_ * lms_ * lms_;
+		const Float3 lmsdt1 = 3.f * lmsdt * lms_ * lms_;
+		const Float3 lmsdt2 = 6.f * lmsdt * lmsdt * lms_;
+
+		// The step towards the edge of each channel, channels moving away from it are ignored
+		float minStep = FLT_MAX;
+		for (const auto& weights : oklmsToRGB) {
+			const Float3 w = { weights[0], weights[1], weights[2] };
+			const float  value = Dot(w, lms) - 1.f;
+			const float  value1 = Dot(w, lmsdt1);
+			const float  value2 = Dot(w, lmsdt2);
+			const float  u = value1 / (value1 * value1 - 0.5f * value * value2);
+			minStep = std::min(minStep, u >= 0.f ? -value * u : FLT_MAX);
+		}
+		return t + minStep;
+	}
+
+	// Gamut maps by projecting colors towards the lightness of the cusp of their hue ("gamut_clip_project_to_L_cusp").
+	// "a_findCusp(a, b, bt2020)" returns the cusp of a hue, either "OklabFindCusp()" or a lookup table.
+	template <class F>
+	Float3 GamutClipProjectToLCusp(const Float3& a_color, bool a_inBT2020, bool a_clampBT2020, bool a_outBT2020, F&& a_findCusp)
+	{
+		const bool bIsInSDRRange = a_color.x <= 1.f && a_color.y <= 1.f && a_color.z <= 1.f && a_color.x >= 0.f && a_color.y >= 0.f && a_color.z >= 0.f;
+		if (bIsInSDRRange && !a_inBT2020 && !a_clampBT2020 && !a_outBT2020) {
+			return a_color;
+		}
+
+		const Float3 lab = a_inBT2020 ? BT2020_To_Oklab(a_color) : BT709_To_Oklab(a_color);
+		const float  L = lab.x;
+		const float  C = std::max(FLT_MIN, std::sqrt(lab.y * lab.y + lab.z * lab.z));
+		const float  a = lab.y / C;
+		const float  b = lab.z / C;
+
+		const OklabLC cusp = a_findCusp(a, b, a_clampBT2020);
+		const float   L0 = cusp.L;
+		const float   t = OklabFindGamutIntersection(a, b, L, C, L0, a_clampBT2020, cusp);
+
+		const float  clippedL = L0 * (1.f - t) + t * L;
+		const float  clippedC = t * C;
+		const Float3 clippedLab = { clippedL, clippedC * a, clippedC * b };
+		return a_outBT2020 ? Oklab_To_BT2020(clippedLab) : Oklab_To_BT709(clippedLab);
+	}
+
+	inline Float3 GamutClipProjectToLCusp(const Float3& a_color, bool a_inBT2020, bool a_clampBT2020, bool a_outBT2020)
+	{
+		return GamutClipProjectToLCusp(a_color, a_inBT2020, a_clampBT2020, a_outBT2020, [](float a_a, float a_b, bool a_bt2020) { return OklabFindCusp(a_a, a_b, a_bt2020); });
+	}
+
+	// Runs "a_function" (a generic lambda taking and returning a "Vec3" of lanes) over "a_count" colors stored as three channel arrays, in place.
+	// The tail is padded with zeros and goes through the same lanes, so every color gets the exact same math.
+	template <class F>
+	void ForEach(float* a_x, float* a_y, float* a_z, std::size_t a_count, F&& a_function)
+	{
+		std::size_t i = 0;
+		for (; i + kWideLanes <= a_count; i += kWideLanes) {
+			const WideVec3 result = a_function(WideVec3{ LoadWide(a_x + i), LoadWide(a_y + i), LoadWide(a_z + i) });
+			Store(a_x + i, result.x);
+			Store(a_y + i, result.y);
+			Store(a_z + i, result.z);
+		}
+		if (i < a_count) {
+			float x[kWideLanes] = {}, y[kWideLanes] = {}, z[kWideLanes] = {};
+			const std::size_t tail = a_count - i;
+			std::copy(a_x + i, a_x + a_count, x);
+			std::copy(a_y + i, a_y + a_count, y);
+			std::copy(a_z + i, a_z + a_count, z);
+			const WideVec3 result = a_function(WideVec3{ LoadWide(x), LoadWide(y), LoadWide(z) });
+			Store(x, result.x);
+			Store(y, result.y);
+			Store(z, result.z);
+			std::copy(x, x + tail, a_x + i);
+			std::copy(y, y + tail, a_y + i);
+			std::copy(z, z + tail, a_z + i);
+		}
+	}
+
+	// Single channel version, "a_function" takes and returns lanes
+	template <class F>
+	void ForEach(float* a_values, std::size_t a_count, F&& a_function)
+	{
+		std::size_t i = 0;
+		for (; i + kWideLanes <= a_count; i += kWideLanes) {
+			Store(a_values + i, a_function(LoadWide(a_values + i)));
+		}
+		if (i < a_count) {
+			float values[kWideLanes] = {};
+			std::copy(a_values + i, a_values + a_count, values);
+			Store(values, a_function(LoadWide(values)));
+			std::copy(values, values + (a_count - i), a_values + i);
+		}
+	}
+}
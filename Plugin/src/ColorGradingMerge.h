@@ -0,0 +1,287 @@
+#pragma once
+
+#include "Color.h"
+#include "ParallelFor.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// CPU port of "shaders/ColorGradingMerge/ColorGradingMerge_cs.hlsl", with the defines the shader ships with ("LUT_IMPROVEMENT_TYPE" 2, Oklab blending,
+// "SDR_USE_GAMMA_2_2" without "GAMMA_CORRECTION_IN_LUTS" nor "GAMMA_CORRECTION_BY_LUMINANCE", linear outputs for "LUT_MAPPING_TYPE" 4).
+// It normalizes the game's 16^3 LUTs (removes their raised blacks and lowered whites) and blends up to four of them with the neutral LUT,
+// into the mixed LUT HDRComposite samples, so LUTs can be corrected offline and the correction settings tested away from the game.
+// "CLAMP_INPUT_OUTPUT_TYPE" 1 never clamps LUTs to the SDR range, so the display mode doesn't matter here.
+// "StrictLUTApplication" isn't part of the merge, HDRComposite reads it when applying the mixed LUT.
+// Differences with the shader, none of which change results beyond float rounding:
+// - every LUT is analyzed (black, white and mid gray texels) once per merge instead of once per texel.
+// - the saturation scales Oklab's a and b directly, which is what going through OkLCh does, without the atan2(), cos() and sin().
+// - LUTs without a share of the mix are skipped.
+// Texels go through SIMD lanes ("Color.h") a slice of 256 at a time, and the slices of a batch of merges are spread over all cores.
+// The SIMD lanes are within 0.001 Delta E ITP of the scalar reference ("MergeTexel()" of a texel), as checked by "tools/LUTMerger".
+namespace ColorGradingMerge
+{
+	using Color::Float3;
+	using Color::Vec3;
+
+	inline constexpr std::size_t kLUTSize = 16;
+	inline constexpr std::size_t kLUTTexels = kLUTSize * kLUTSize * kLUTSize;
+	inline constexpr std::size_t kMaxLUTs = 4;
+
+	// A LUT as the game stores it: a 256x16 texture of the 16 blue slices side by side ("ThreeToTwoDimensionCoordinates()"), with gamma space values
+	struct GameLUT
+	{
+		const Float3& Load(std::size_t a_r, std::size_t a_g, std::size_t a_b) const { return texels[a_g * kLUTSize * kLUTSize + a_b * kLUTSize + a_r]; }
+
+		std::array<Float3, kLUTTexels> texels;  // row major, top to bottom
+	};
+
+	// "OutMixedLUT", linear BT.709
+	struct MixedLUT
+	{
+		Float3& At(std::size_t a_r, std::size_t a_g, std::size_t a_b) { return texels[(a_b * kLUTSize + a_g) * kLUTSize + a_r]; }
+
+		std::array<Float3, kLUTTexels> texels;  // red first, then green, then blue, like the Texture3D
+	};
+
+	// What the shader reads from "HdrDllPluginConstants", named like in "Settings::ShaderConstants"
+	struct PluginConstants
+	{
+		float Saturation = 1.f;  // "ToneMapperSaturation"
+		float LUTCorrectionStrength = 1.f;
+		float GammaCorrectionStrength = 1.f;  // "GammaCorrection"
+	};
+
+	// "PushConstantWrapper_ColorGradingMerge": the share of every LUT in the mix
+	struct PushConstants
+	{
+		std::array<float, kMaxLUTs> LUTPercentages = { 1.f, 0.f, 0.f, 0.f };  // "LUT1Percentage" to "LUT4Percentage"
+		float                       neutralLUTPercentage = 0.f;
+	};
+
+	struct MergeInputs
+	{
+		std::array<const GameLUT*, kMaxLUTs> luts = {};  // "LUT1" to "LUT4", null ones are skipped like ones with no share
+		PushConstants                        pushConstants;
+		PluginConstants                      pluginConstants;
+	};
+
+	template <class T>
+	T Lerp(T a_a, T a_b, float a_alpha)
+	{
+		return Color::MulAdd(Color::Sub(a_b, a_a), Color::Splat<T>(a_alpha), a_a);
+	}
+
+	// "LINEARIZE()": LUTs are interpreted as sRGB, gamma 2.2, or a mix of both, following the gamma correction
+	template <class T>
+	T Linearize(T a_channel, float a_gammaCorrection)
+	{
+		return Lerp(Color::SRGBToLinear(a_channel), Color::GammaToLinear(a_channel), a_gammaCorrection);
+	}
+
+	// "LINEARIZE_SAFE()": the same, mirrored below zero
+	template <class T>
+	T LinearizeSafe(T a_channel, float a_gammaCorrection)
+	{
+		return Lerp(Color::SRGBToLinearCustom(a_channel, true, true, true), Color::GammaToLinearCustom(a_channel, 2.2f, true, true), a_gammaCorrection);
+	}
+
+	// "CORRECT_GAMMA()": goes from the gamma 2.2 interpretation back to sRGB, so outputs have the same gamma as the LUT coordinates
+	// (HDRComposite then corrects the gamma mismatch baked into the game's look)
+	template <class T>
+	T CorrectGamma(T a_channel, float a_gammaCorrection)
+	{
+		return Color::SRGBToLinearCustom(Lerp(Color::LinearToSRGBCustom(a_channel), Color::LinearToGammaCustom(a_channel), a_gammaCorrection));
+	}
+
+	// What "PatchLUTColor()" reads from a LUT besides the texel it patches
+	struct LUTAnalysis
+	{
+		Float3 blackGamma;
+		Float3 whiteGamma;
+		float  midGrayAverage;
+		bool   bInverted;  // white is darker than black (e.g. a photo negative), such LUTs are left as they are
+	};
+
+	inline LUTAnalysis AnalyzeLUT(const GameLUT& a_lut, float a_gammaCorrection)
+	{
+		const auto linearize = [&](float a_channel) { return Linearize(a_channel, a_gammaCorrection); };
+
+		LUTAnalysis analysis;
+		analysis.blackGamma = a_lut.Load(0, 0, 0);
+		analysis.whiteGamma = a_lut.Load(kLUTSize - 1, kLUTSize - 1, kLUTSize - 1);
+		analysis.bInverted = Color::Luminance(Color::Apply(analysis.whiteGamma, linearize)) < Color::Luminance(Color::Apply(analysis.blackGamma, linearize));
+
+		// Halfway between the two texels around the middle of the gray diagonal
+		constexpr std::size_t kMidGrayTexel = kLUTSize / 2 - 1;
+		const Float3          midGray = a_lut.Load(kMidGrayTexel, kMidGrayTexel, kMidGrayTexel) +
+		                       (a_lut.Load(kMidGrayTexel + 1, kMidGrayTexel + 1, kMidGrayTexel + 1) - a_lut.Load(kMidGrayTexel, kMidGrayTexel, kMidGrayTexel)) * 0.5f;
+		analysis.midGrayAverage = (midGray.x + midGray.y + midGray.z) / 3.f;
+		return analysis;
+	}
+
+	// "PatchLUTColor()" of the gamma space texel "a_originalGamma", for the neutral LUT texel "a_neutralGamma". Returns Oklab.
+	template <class T>
+	Vec3<T> PatchLUTColor(const Vec3<T>& a_originalGamma, const Vec3<T>& a_neutralGamma, const LUTAnalysis& a_analysis, const PluginConstants& a_constants)
+	{
+		using namespace Color;
+
+		const float   gammaCorrection = a_constants.GammaCorrectionStrength;
+		const Vec3<T> originalLab = BT709_To_Oklab(Apply(a_originalGamma, [&](T a_channel) { return Linearize(a_channel, gammaCorrection); }));
+		if (a_analysis.bInverted) {
+			return originalLab;
+		}
+
+		// The fog (black's color) is removed from the shadows and the highlights are lifted by how much white was lowered, both fading out towards mid gray
+		const T       zero = Splat<T>(0.f);
+		const float   midGrayAverage = a_analysis.midGrayAverage;
+		const float   shadowLength = 1.f - midGrayAverage;
+		const T       shadowStop = Max(a_neutralGamma.x, Max(a_neutralGamma.y, a_neutralGamma.z));
+		const T       highlightsStop = Min(a_neutralGamma.x, Min(a_neutralGamma.y, a_neutralGamma.z));
+		const T       removeFog = Max(zero, Sub(Splat<T>(shadowLength), shadowStop));
+		const T       liftHighlights = Div(Sub(Max(Splat<T>(midGrayAverage), highlightsStop), Splat<T>(midGrayAverage)), Splat<T>(midGrayAverage));
+		const Float3& addedGamma = a_analysis.blackGamma;
+		const Float3  removedGamma = 1.f - a_analysis.whiteGamma;
+		const auto    detint = [&](T a_original, float a_added, float a_removed) {
+			const T fog = Div(Mul(Splat<T>(a_added), removeFog), Splat<T>(shadowLength));
+			return MulAdd(Splat<T>(a_removed), liftHighlights, Sub(a_original, fog));
+		};
+
+		// Some texels have channels dipping below 0 (e.g. single channel colors), hence the mirrored curves
+		const Vec3<T> detintedGamma = { detint(a_originalGamma.x, addedGamma.x, removedGamma.x), detint(a_originalGamma.y, addedGamma.y, removedGamma.y),
+			detint(a_originalGamma.z, addedGamma.z, removedGamma.z) };
+		const Vec3<T> detintedLinear = Apply(detintedGamma, [&](T a_channel) { return LinearizeSafe(a_channel, gammaCorrection); });
+
+		// The lightness of the detinted color with the original hue and chroma
+		const T       saturation = Splat<T>(a_constants.Saturation);
+		const Vec3<T> targetLab = { Max(zero, BT709_To_Oklab(detintedLinear).x), Mul(originalLab.y, saturation), Mul(originalLab.z, saturation) };
+
+		const float strength = a_constants.LUTCorrectionStrength;
+		return { Lerp(originalLab.x, targetLab.x, strength), Lerp(originalLab.y, targetLab.y, strength), Lerp(originalLab.z, targetLab.z, strength) };
+	}
+
+	// Everything of a merge that doesn't change between texels
+	struct MergeSetup
+	{
+		std::array<const GameLUT*, kMaxLUTs> luts = {};  // only the LUTs with a share of the mix
+		std::array<LUTAnalysis, kMaxLUTs>    analyses = {};
+		std::array<float, kMaxLUTs>          percentages = {};
+		std::size_t                          lutCount = 0;
+		float                                neutralPercentage = 0.f;
+		PluginConstants                      constants;
+	};
+
+	inline MergeSetup MakeMergeSetup(const MergeInputs& a_inputs)
+	{
+		MergeSetup setup;
+		for (std::size_t i = 0; i < kMaxLUTs; ++i) {
+			const float percentage = a_inputs.pushConstants.LUTPercentages[i];
+			if (a_inputs.luts[i] && percentage != 0.f) {
+				setup.luts[setup.lutCount] = a_inputs.luts[i];
+				setup.analyses[setup.lutCount] = AnalyzeLUT(*a_inputs.luts[i], a_inputs.pluginConstants.GammaCorrectionStrength);
+				setup.percentages[setup.lutCount] = percentage;
+				++setup.lutCount;
+			}
+		}
+		// "AdditionalNeutralLUTPercentage" is 0, so the push constants are used as they are
+		setup.neutralPercentage = a_inputs.pushConstants.neutralLUTPercentage;
+		setup.constants = a_inputs.pluginConstants;
+		return setup;
+	}
+
+	// The mixed LUT texel of the neutral texel "a_neutralGamma", from the texels of the setup's LUTs at the same coordinates
+	template <class T>
+	Vec3<T> MergeTexel(const MergeSetup& a_setup, const Vec3<T> (&a_lutGammas)[kMaxLUTs], const Vec3<T>& a_neutralGamma)
+	{
+		using namespace Color;
+
+		const float   gammaCorrection = a_setup.constants.GammaCorrectionStrength;
+		const Vec3<T> neutralLinear = Apply(a_neutralGamma, [&](T a_channel) { return Linearize(a_channel, gammaCorrection); });
+		Vec3<T>       mixedLab = BT709_To_Oklab(neutralLinear) * Splat<T>(a_setup.neutralPercentage);
+		for (std::size_t i = 0; i < a_setup.lutCount; ++i) {
+			mixedLab += PatchLUTColor(a_lutGammas[i], a_neutralGamma, a_setup.analyses[i], a_setup.constants) * Splat<T>(a_setup.percentages[i]);
+		}
+
+		Vec3<T> mixed = Apply(Oklab_To_BT709(mixedLab), [&](T a_channel) { return CorrectGamma(a_channel, gammaCorrection); });
+
+		// "POST_CORRECT_GAMMA()": gamma is applied below zero ("ApplyGammaBelowZeroDefault"), which can leave colors with a negative luminance
+		const auto negative = Less(Luminance(mixed), Splat<T>(0.f));
+		mixed = Apply(mixed, [&](T a_channel) { return Select(negative, Splat<T>(0.f), a_channel); });
+		return mixed;
+	}
+
+	// Scalar reference of one texel of "Merge()"
+	inline Float3 MergeTexel(const MergeSetup& a_setup, std::size_t a_r, std::size_t a_g, std::size_t a_b)
+	{
+		Float3 lutGammas[kMaxLUTs] = {};
+		for (std::size_t i = 0; i < a_setup.lutCount; ++i) {
+			lutGammas[i] = a_setup.luts[i]->Load(a_r, a_g, a_b);
+		}
+		const Float3 neutralGamma = Float3{ static_cast<float>(a_r), static_cast<float>(a_g), static_cast<float>(a_b) } / static_cast<float>(kLUTSize - 1);
+		return MergeTexel(a_setup, lutGammas, neutralGamma);
+	}
+
+	// Fills the blue slice "a_b" of "a_outLUT"
+	inline void MergeSlice(const MergeSetup& a_setup, std::size_t a_b, MixedLUT& a_outLUT)
+	{
+		using Color::WideVec3;
+		constexpr std::size_t kSliceTexels = kLUTSize * kLUTSize;
+		static_assert(kSliceTexels % Color::kWideLanes == 0);
+
+		// The slice's channels as arrays, in the order of the mixed LUT (red first). The LUTs are followed by the neutral LUT and the output.
+		float channels[kMaxLUTs + 2][3][kSliceTexels];
+		constexpr std::size_t kNeutral = kMaxLUTs;
+		constexpr std::size_t kOutput = kMaxLUTs + 1;
+		const auto            store = [&](std::size_t a_array, std::size_t a_texel, const Float3& a_color) {
+			channels[a_array][0][a_texel] = a_color.x;
+			channels[a_array][1][a_texel] = a_color.y;
+			channels[a_array][2][a_texel] = a_color.z;
+		};
+		for (std::size_t g = 0; g < kLUTSize; ++g) {
+			for (std::size_t r = 0; r < kLUTSize; ++r) {
+				const std::size_t texel = g * kLUTSize + r;
+				store(kNeutral, texel, Float3{ static_cast<float>(r), static_cast<float>(g), static_cast<float>(a_b) } / static_cast<float>(kLUTSize - 1));
+				for (std::size_t i = 0; i < a_setup.lutCount; ++i) {
+					store(i, texel, a_setup.luts[i]->Load(r, g, a_b));
+				}
+			}
+		}
+
+		for (std::size_t texel = 0; texel < kSliceTexels; texel += Color::kWideLanes) {
+			const auto load = [&](std::size_t a_array) {
+				return WideVec3{ Color::LoadWide(&channels[a_array][0][texel]), Color::LoadWide(&channels[a_array][1][texel]), Color::LoadWide(&channels[a_array][2][texel]) };
+			};
+			WideVec3 lutGammas[kMaxLUTs] = {};
+			for (std::size_t i = 0; i < a_setup.lutCount; ++i) {
+				lutGammas[i] = load(i);
+			}
+			const WideVec3 mixed = MergeTexel(a_setup, lutGammas, load(kNeutral));
+			Color::Store(&channels[kOutput][0][texel], mixed.x);
+			Color::Store(&channels[kOutput][1][texel], mixed.y);
+			Color::Store(&channels[kOutput][2][texel], mixed.z);
+		}
+
+		Float3* slice = a_outLUT.texels.data() + a_b * kSliceTexels;
+		for (std::size_t texel = 0; texel < kSliceTexels; ++texel) {
+			slice[texel] = { channels[kOutput][0][texel], channels[kOutput][1][texel], channels[kOutput][2][texel] };
+		}
+	}
+
+	// Merges every one of the "a_count" inputs into the mixed LUT of the same index, on "a_threadCount" threads (0 is all cores).
+	// A merge is only 16 slices, so a batch spreads the slices of all its merges over the threads.
+	inline void Merge(const MergeInputs* a_inputs, MixedLUT* a_outLUTs, std::size_t a_count, std::size_t a_threadCount = 0)
+	{
+		std::vector<MergeSetup> setups(a_count);
+		for (std::size_t i = 0; i < a_count; ++i) {
+			setups[i] = MakeMergeSetup(a_inputs[i]);
+		}
+		ToneMapping::ParallelFor(a_count * kLUTSize, a_threadCount, [&](std::size_t a_slice) {
+			MergeSlice(setups[a_slice / kLUTSize], a_slice % kLUTSize, a_outLUTs[a_slice / kLUTSize]);
+		});
+	}
+
+	inline void Merge(const MergeInputs& a_inputs, MixedLUT& a_outLUT, std::size_t a_threadCount = 0)
+	{
+		Merge(&a_inputs, &a_outLUT, 1, a_threadCount);
+	}
+}
@@ -0,0 +1,364 @@
+#pragma once
+
+#include "Color.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <immintrin.h>
+
+// Lookup tables of the transfer functions of "Color.h", generated at compile time so the hot paths skip pow() entirely.
+// Every table is linearly interpolated. The max absolute errors below were measured against the double precision formulas on every float input in [0, 1]
+// by "tools/ColorSweep", which fails past about twice them (in brackets):
+// - "kLinearToPQTable": 4.6e-6 [1e-5] (~1/220 of a 10 bit code value), 3 times closer than the float pow() version. Inputs are normalized, 1 is 10000 nits.
+// - "kLinearToSRGBTable": 5.9e-6 [1.2e-5]. "kLinearToGammaTable": 2.2e-5 [4.5e-5].
+// - "kPQToLinearTable": 1.2e-5 [2.5e-5] (0.12 nits). "kSRGBToLinearTable": 4.1e-7 [1e-6]. "kGammaToLinearTable": 3.8e-7 [8e-7].
+// - "kPQ10BitToLinear" and "GetPQ16BitToLinear()" hold every code value rounded from double precision.
+// Tables are sized to stay below the default constexpr step limits of MSVC and Clang (~1M steps each).
+namespace Color
+{
+	// Double precision math that can run at compile time, accurate to a few ulps
+	namespace Exact
+	{
+		// Log2 of positive, finite values
+		constexpr double Log2(double a_value)
+		{
+			const std::uint64_t bits = std::bit_cast<std::uint64_t>(a_value);
+			if ((bits >> 52) == 0) {
+				return Log2(a_value * 0x1p64) - 64.0;  // denormal
+			}
+
+			int    exponent = static_cast<int>(bits >> 52) - 1023;
+			double mantissa = std::bit_cast<double>((bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull);
+			if (mantissa > std::numbers::sqrt2) {
+				mantissa *= 0.5;
+				++exponent;
+			}
+
+			// ln(m) = 2 * atanh(s), with |s| <= 0.1716 every term is 34 times smaller than the previous one
+			const double s = (mantissa - 1.0) / (mantissa + 1.0);
+			const double s2 = s * s;
+			double       term = s;
+			double       series = 0.0;
+			for (int i = 1; term != 0.0 && (term > 1e-17 || term < -1e-17); i += 2) {
+				series += term / i;
+				term *= s2;
+			}
+			return exponent + 2.0 * series * std::numbers::log2e;
+		}
+
+		// Exp2, results outside of the double range aren't handled
+		constexpr double Exp2(double a_value)
+		{
+			const std::int64_t integer = static_cast<std::int64_t>(a_value + (a_value >= 0.0 ? 0.5 : -0.5));
+			const double       fraction = (a_value - static_cast<double>(integer)) * std::numbers::ln2;
+
+			double term = 1.0;
+			double series = 1.0;
+			for (int i = 1; term > 1e-17 || term < -1e-17; ++i) {
+				term *= fraction / i;
+				series += term;
+			}
+			return series * std::bit_cast<double>(static_cast<std::uint64_t>(integer + 1023) << 52);
+		}
+
+		constexpr double Pow(double a_base, double a_exponent)
+		{
+			return a_base > 0.0 ? Exp2(Log2(a_base) * a_exponent) : 0.0;
+		}
+
+		constexpr double LinearToPQ(double a_value)
+		{
+			const double colorPow = Pow(a_value, kPQ_M1);
+			return Pow((kPQ_C1 + kPQ_C2 * colorPow) / (1.0 + kPQ_C3 * colorPow), kPQ_M2);
+		}
+
+		constexpr double PQToLinear(double a_value)
+		{
+			const double colorPow = Pow(a_value, 1.0 / kPQ_M2);
+			const double numerator = colorPow > kPQ_C1 ? colorPow - kPQ_C1 : 0.0;
+			return Pow(numerator / (kPQ_C2 - kPQ_C3 * colorPow), 1.0 / kPQ_M1);
+		}
+
+		constexpr double LinearToSRGB(double a_value)
+		{
+			return a_value <= 0.0031308 ? a_value * 12.92 : 1.055 * Pow(a_value, 1.0 / 2.4) - 0.055;
+		}
+
+		constexpr double SRGBToLinear(double a_value)
+		{
+			return a_value <= 0.04045 ? a_value / 12.92 : Pow((a_value + 0.055) / 1.055, 2.4);
+		}
+
+		constexpr double LinearToGamma(double a_value, double a_gamma = 2.2) { return Pow(a_value, 1.0 / a_gamma); }
+		constexpr double GammaToLinear(double a_value, double a_gamma = 2.2) { return Pow(a_value, a_gamma); }
+
+		// The cusp of the Oklab hue of "a_a" and "a_b" (normalized so a^2 + b^2 == 1), solved by bisection instead of "OklabFindCusp()"'s
+		// polynomial fit and Halley step. Uses the same float matrices as the rest of "Color.h".
+		constexpr OklabLC OklabCusp(double a_a, double a_b, bool a_bt2020)
+		{
+			const Matrix3x3& oklmsToRGB = a_bt2020 ? kOklabLMS_To_BT2020 : kOklabLMS_To_BT709;
+			double           kLMS[3];
+			for (int i = 0; i < 3; ++i) {
+				kLMS[i] = kOklab_To_OklabLMS[i][1] * a_a + kOklab_To_OklabLMS[i][2] * a_b;
+			}
+
+			// RGB of L = 1 and saturation (C/L) "S", all channels start at 1 and the first one to reach 0 limits the saturation
+			const auto rgbAt = [&](double a_saturation, double (&a_outRGB)[3]) {
+				double lms[3];
+				for (int i = 0; i < 3; ++i) {
+					const double lms_ = 1.0 + a_saturation * kLMS[i];
+					lms[i] = lms_ * lms_ * lms_;
+				}
+				for (int i = 0; i < 3; ++i) {
+					a_outRGB[i] = oklmsToRGB[i][0] * lms[0] + oklmsToRGB[i][1] * lms[1] + oklmsToRGB[i][2] * lms[2];
+				}
+			};
+			const auto minChannelAt = [&](double a_saturation) {
+				double rgb[3];
+				rgbAt(a_saturation, rgb);
+				return rgb[0] < rgb[1] ? (rgb[0] < rgb[2] ? rgb[0] : rgb[2]) : (rgb[1] < rgb[2] ? rgb[1] : rgb[2]);
+			};
+
+			// Steps are small enough not to skip over a channel dipping below 0 and coming back (saturations are within ~0.1-4)
+			double low = 0.0;
+			double high = 1.0 / 64.0;
+			while (minChannelAt(high) > 0.0 && high < 64.0) {
+				low = high;
+				high += 1.0 / 64.0;
+			}
+			for (int i = 0; i < 52; ++i) {
+				const double middle = (low + high) * 0.5;
+				(minChannelAt(middle) > 0.0 ? low : high) = middle;
+			}
+
+			double rgb[3];
+			rgbAt(low, rgb);
+			const double maxChannel = rgb[0] > rgb[1] ? (rgb[0] > rgb[2] ? rgb[0] : rgb[2]) : (rgb[1] > rgb[2] ? rgb[1] : rgb[2]);
+			const double L = Pow(1.0 / maxChannel, 1.0 / 3.0);
+			return { static_cast<float>(L), static_cast<float>(L * low) };
+		}
+	}
+
+	// Interpolates 4 table segments, "a_index" is the start of each segment and "a_fraction" the position within it
+	inline __m128 SampleSegments(const float* a_values, __m128i a_index, __m128 a_fraction)
+	{
+		alignas(16) std::int32_t indices[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(indices), a_index);
+		const __m128 begin = _mm_setr_ps(a_values[indices[0]], a_values[indices[1]], a_values[indices[2]], a_values[indices[3]]);
+		const __m128 end = _mm_setr_ps(a_values[indices[0] + 1], a_values[indices[1] + 1], a_values[indices[2] + 1], a_values[indices[3] + 1]);
+		return _mm_add_ps(begin, _mm_mul_ps(_mm_sub_ps(end, begin), a_fraction));
+	}
+
+	// A function of [0, 1] sampled in "N" uniform segments, for inputs that are already perceptual (decoding).
+	// "values" holds the N + 1 segment ends followed by a copy of the last one, so an input of 1 can interpolate without a branch.
+	// Uploaded as an R32_FLOAT Texture1D of the first N + 1 values, a linear sample at (x * N + 0.5) / (N + 1) matches "Sample()".
+	template <std::size_t N>
+	struct UniformTable
+	{
+		static constexpr std::size_t kSize = N + 2;
+
+		template <class F>
+		static constexpr UniformTable Make(F a_function)
+		{
+			UniformTable table = {};
+			for (std::size_t i = 0; i <= N; ++i) {
+				table.values[i] = static_cast<float>(a_function(static_cast<double>(i) / N));
+			}
+			table.values[N + 1] = table.values[N];
+			return table;
+		}
+
+		// Inputs are clamped to [0, 1], NaNs return the value of 0
+		float Sample(float a_value) const
+		{
+			const float       position = (a_value > 0.f ? (a_value < 1.f ? a_value : 1.f) : 0.f) * N;
+			const std::size_t index = static_cast<std::size_t>(position);
+			const float       fraction = position - static_cast<float>(index);
+			return values[index] + (values[index + 1] - values[index]) * fraction;
+		}
+
+		__m128 Sample(__m128 a_value) const
+		{
+			const __m128  position = _mm_mul_ps(_mm_min_ps(_mm_max_ps(a_value, _mm_setzero_ps()), _mm_set1_ps(1.f)), _mm_set1_ps(static_cast<float>(N)));
+			const __m128i index = _mm_cvttps_epi32(position);
+			const __m128  fraction = _mm_sub_ps(position, _mm_cvtepi32_ps(index));
+			return SampleSegments(values.data(), index, fraction);
+		}
+
+		std::array<float, kSize> values;
+	};
+
+	// A function of [0, 2^MaxExponent] (1 by default) for linear light inputs (encoding, tonemapping), where most of the curvature is near black.
+	// The table is indexed by the float's exponent and its top "MantissaBits" mantissa bits, so every octave from 2^MinExponent to 2^MaxExponent
+	// gets the same number of segments. Below 2^MinExponent it interpolates from the value of 0.
+	// "values" is the value of 0, then the start of every segment, then the value of the max twice (so an input of the max doesn't need a branch).
+	// A shader can sample it with the same index math on asuint() of its input.
+	template <int MinExponent, int MantissaBits, int MaxExponent = 0>
+	struct LogTable
+	{
+		static_assert(MinExponent < MaxExponent && MinExponent > -127 && MaxExponent < 128);
+
+		static constexpr std::size_t   kSegments = static_cast<std::size_t>(MaxExponent - MinExponent) << MantissaBits;
+		static constexpr std::size_t   kSize = kSegments + 3;
+		static constexpr int           kShift = 23 - MantissaBits;
+		static constexpr std::uint32_t kMinBits = static_cast<std::uint32_t>(127 + MinExponent) << 23;
+		static constexpr float         kMin = std::bit_cast<float>(kMinBits);
+		static constexpr float         kMax = std::bit_cast<float>(static_cast<std::uint32_t>(127 + MaxExponent) << 23);
+
+		template <class F>
+		static constexpr LogTable Make(F a_function)
+		{
+			LogTable table = {};
+			table.values[0] = static_cast<float>(a_function(0.0));
+			for (std::size_t i = 0; i <= kSegments; ++i) {
+				const float segmentStart = std::bit_cast<float>(kMinBits + (static_cast<std::uint32_t>(i) << kShift));
+				table.values[i + 1] = static_cast<float>(a_function(static_cast<double>(segmentStart)));
+			}
+			table.values[kSegments + 2] = table.values[kSegments + 1];
+			return table;
+		}
+
+		// Inputs are clamped to [0, kMax], NaNs return the value of 0
+		float Sample(float a_value) const
+		{
+			if (!(a_value > 0.f)) {
+				return values[0];
+			}
+			if (a_value < kMin) {
+				return values[0] + (values[1] - values[0]) * (a_value * (1.f / kMin));
+			}
+			const std::uint32_t offset = std::bit_cast<std::uint32_t>(a_value < kMax ? a_value : kMax) - kMinBits;
+			const std::size_t   index = 1 + (offset >> kShift);
+			const float         fraction = static_cast<float>(offset & ((1u << kShift) - 1)) * (1.f / (1u << kShift));
+			return values[index] + (values[index + 1] - values[index]) * fraction;
+		}
+
+		__m128 Sample(__m128 a_value) const
+		{
+			const __m128  clamped = _mm_min_ps(_mm_max_ps(a_value, _mm_setzero_ps()), _mm_set1_ps(kMax));
+			const __m128  below = _mm_cmplt_ps(clamped, _mm_set1_ps(kMin));
+			const __m128i offset = _mm_sub_epi32(_mm_castps_si128(clamped), _mm_set1_epi32(static_cast<int>(kMinBits)));
+
+			// Lanes below the first octave have a negative offset, they use the segment from 0 instead
+			const __m128i index = _mm_andnot_si128(_mm_castps_si128(below), _mm_add_epi32(_mm_srli_epi32(offset, kShift), _mm_set1_epi32(1)));
+			const __m128  segmentFraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(offset, _mm_set1_epi32((1 << kShift) - 1))), _mm_set1_ps(1.f / (1u << kShift)));
+			const __m128  fraction = _mm_or_ps(_mm_and_ps(below, _mm_mul_ps(clamped, _mm_set1_ps(1.f / kMin))), _mm_andnot_ps(below, segmentFraction));
+			return SampleSegments(values.data(), index, fraction);
+		}
+
+		std::array<float, kSize> values;
+	};
+
+	// Position of the Oklab hue of "a_a" and "a_b" around the a/b plane, from 0 to 4 (a full turn) counterclockwise from +a.
+	// It's monotonic with the hue angle but doesn't need any trigonometry ("diamond angle").
+	inline float OklabHueToDiamondAngle(float a_a, float a_b)
+	{
+		if (a_b >= 0.f) {
+			return a_a >= 0.f ? a_b / (a_a + a_b) : 1.f - a_a / (a_b - a_a);
+		}
+		return a_a < 0.f ? 2.f - a_b / (-a_a - a_b) : 3.f + a_a / (a_a - a_b);
+	}
+
+	// The normalized a/b of a diamond angle
+	constexpr std::array<double, 2> DiamondAngleToOklabHue(double a_angle)
+	{
+		const int    quadrant = static_cast<int>(a_angle) & 3;
+		const double t = a_angle - static_cast<int>(a_angle);
+		const double a = quadrant == 0 ? 1.0 - t : (quadrant == 1 ? -t : (quadrant == 2 ? t - 1.0 : t));
+		const double b = quadrant == 0 ? t : (quadrant == 1 ? 1.0 - t : (quadrant == 2 ? -t : t - 1.0));
+		const double length = Exact::Pow(a * a + b * b, 0.5);
+		return { a / length, b / length };
+	}
+
+	// The cusp of every Oklab hue within BT.709 or BT.2020, so gamut mapping can look it up instead of running "OklabFindCusp()" per pixel.
+	// Hues are indexed by their diamond angle, in "N" uniform segments over the full turn, and linearly interpolated.
+	// Values come from "Exact::OklabCusp()", which is also more accurate than "OklabFindCusp()" on BT.2020, as its polynomial was fit for BT.709.
+	// Max errors of the default table over every hue (measured by "tools/OklabCuspTable"): ~1e-5 mean and 0.02 max in L and C, the max is where the channel
+	// limiting the saturation switches, as the cusps have a corner there. The solver's are 4e-5 mean and 0.04 max on BT.709, and 0.02 mean and 2 max on BT.2020.
+	// "values" holds the start of every segment and a copy of the first one, so the wrap around doesn't need a branch.
+	// Uploaded as an R32G32_FLOAT Texture1D of the first N values with wrap addressing, a linear sample at angle / 4 + 0.5 / N matches "Sample()".
+	template <std::size_t N>
+	struct OklabCuspTable
+	{
+		static constexpr std::size_t kSegments = N;
+
+		static constexpr OklabCuspTable Make(bool a_bt2020)
+		{
+			OklabCuspTable table = {};
+			for (std::size_t i = 0; i < N; ++i) {
+				const auto hue = DiamondAngleToOklabHue(4.0 * static_cast<double>(i) / N);
+				table.values[i] = Exact::OklabCusp(hue[0], hue[1], a_bt2020);
+			}
+			table.values[N] = table.values[0];
+			return table;
+		}
+
+		// "a_a" and "a_b" don't need to be normalized, but can't both be 0
+		OklabLC Sample(float a_a, float a_b) const
+		{
+			const float       position = OklabHueToDiamondAngle(a_a, a_b) * (N / 4.f);
+			const std::size_t index = std::min(static_cast<std::size_t>(position), N - 1);
+			const float       fraction = position - static_cast<float>(index);
+			const OklabLC&    begin = values[index];
+			const OklabLC&    end = values[index + 1];
+			return { begin.L + (end.L - begin.L) * fraction, begin.C + (end.C - begin.C) * fraction };
+		}
+
+		std::array<OklabLC, N + 1> values;
+	};
+
+	// 1024 hues (8KB per gamut), built on first use as solving them at compile time would go beyond the constexpr step limits
+	inline constexpr std::size_t kOklabCuspTableSize = 1024;
+
+	inline const OklabCuspTable<kOklabCuspTableSize>& GetOklabCuspTable(bool a_bt2020)
+	{
+		static const auto tables = [] {
+			auto values = std::make_unique<std::array<OklabCuspTable<kOklabCuspTableSize>, 2>>();
+			(*values)[0] = OklabCuspTable<kOklabCuspTableSize>::Make(false);
+			(*values)[1] = OklabCuspTable<kOklabCuspTableSize>::Make(true);
+			return values;
+		}();
+		return (*tables)[a_bt2020 ? 1 : 0];
+	}
+
+	// "OklabFindCusp()" from the tables
+	inline OklabLC OklabFindCuspFromTable(float a_a, float a_b, bool a_bt2020) { return GetOklabCuspTable(a_bt2020).Sample(a_a, a_b); }
+
+	// Normalized linear (1 is 10000 nits) to PQ
+	inline constexpr auto kLinearToPQTable = LogTable<-40, 6>::Make([](double a_value) { return Exact::LinearToPQ(a_value); });
+	inline constexpr auto kLinearToSRGBTable = LogTable<-9, 6>::Make([](double a_value) { return Exact::LinearToSRGB(a_value); });
+	inline constexpr auto kLinearToGammaTable = LogTable<-32, 5>::Make([](double a_value) { return Exact::LinearToGamma(a_value); });
+
+	// PQ to normalized linear (1 is 10000 nits)
+	inline constexpr auto kPQToLinearTable = UniformTable<1024>::Make([](double a_value) { return Exact::PQToLinear(a_value); });
+	inline constexpr auto kSRGBToLinearTable = UniformTable<1024>::Make([](double a_value) { return Exact::SRGBToLinear(a_value); });
+	inline constexpr auto kGammaToLinearTable = UniformTable<1024>::Make([](double a_value) { return Exact::GammaToLinear(a_value); });
+
+	// Normalized linear value of every 10 bit PQ code
+	inline constexpr auto kPQ10BitToLinear = [] {
+		std::array<float, 1024> table = {};
+		for (std::size_t i = 0; i < table.size(); ++i) {
+			table[i] = static_cast<float>(Exact::PQToLinear(static_cast<double>(i) / 1023.0));
+		}
+		return table;
+	}();
+
+	// Normalized linear value of every 16 bit PQ code, built on first use as it's too big to generate at compile time.
+	// It's filled on the heap so compilers don't try to constant initialize it either.
+	inline const std::array<float, 65536>& GetPQ16BitToLinear()
+	{
+		static const auto table = [] {
+			auto values = std::make_unique<std::array<float, 65536>>();
+			for (std::size_t i = 0; i < values->size(); ++i) {
+				(*values)[i] = static_cast<float>(Exact::PQToLinear(static_cast<double>(i) / 65535.0));
+			}
+			return values;
+		}();
+		return *table;
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "ParallelFor.h"
+#include "ToneMapping.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+// Hable's curve and its inverse folded into constants, derived once per settings change instead of for every channel of every pixel.
+// Each of the toe, mid and shoulder segments of either direction is the same closed form:
+//   out = outScale * (exp2(power * log2(max(inScale * in + inBias, FLT_MIN)) + logBias) + outBias)
+// so evaluating a channel is picking its segment by comparing it to two ends, then one log2() and one exp2(), without rebuilding anything.
+// The block is 12 float4, ready for a constant buffer, though no shader reads it yet: HDRComposite gets Hable's scene settings from the game's
+// per scene constants, which the plugin doesn't see, and its shipped permutations never invert Hable ("SDRTonemapHDRStrength" is 1).
+// Against a double precision evaluation of the curve (measured by "tools/HableRoundTrip" over a few scene settings):
+// - the forward curve is within 0.3% in float (9% for a toe with a power of ~1e5), below the errors of "Hable()", where the shoulder's
+//   ~3000 power also amplifies the rounding of its large log bias.
+// - SDR values going through the inverse then the forward curve come back within 2e-7 in the toe and mid, and within 6e-4 in the shoulder, where
+//   "Hable_Inverse()" is off by up to 5e-2, as it picks segments by comparing outputs with the joints' values before they are scaled by "invScale".
+namespace ToneMapping
+{
+	struct HableSegmentConstants
+	{
+		float inScale;
+		float inBias;
+		float power;
+		float logBias;
+		float outScale;
+		float outBias;  // added before "outScale", so offsets close to the power's result cancel exactly like in the analytic curve
+		float end;  // inputs from this onwards belong to the next segment
+		float unused;
+	};
+
+	struct HableConstants
+	{
+		HableSegmentConstants forward[3];  // toe, mid and shoulder of "Hable()", from scene linear to 0-1
+		HableSegmentConstants inverse[3];  // toe, mid and shoulder of "Hable_Inverse()", from 0-1 to scene linear
+	};
+	static_assert(sizeof(HableConstants) == 12 * 4 * sizeof(float));
+
+	inline HableConstants MakeHableConstants(const HableCurve& a_curve)
+	{
+		const HableParams&     params = a_curve.params;
+		const HableEvalParams& evalParams = a_curve.evalParams;
+		const float            W = params.dstParams.W;
+		const float            invScale = params.invScale;
+		constexpr float        kInfinity = std::numeric_limits<float>::infinity();
+
+		HableConstants constants;
+
+		// "HableEval()" works on "x * invW", and its outputs are scaled by "invScale"
+		constants.forward[0] = { a_curve.invW, 0.f, evalParams.toeSegment_B, evalParams.toeSegment_optimised + (evalParams.toeSegment_lnA_optimised * kLog2E),
+			invScale, 0.f, evalParams.params_x0 / a_curve.invW, 0.f };
+		constants.forward[1] = { a_curve.invW, evalParams.midSegment_offsetX, 1.f, evalParams.midSegment_lnA_optimised,
+			invScale, 0.f, evalParams.params_x1 / a_curve.invW, 0.f };
+		constants.forward[2] = { -a_curve.invW, 1.f + evalParams.params_overshootX, evalParams.shoulderSegment_B_optimised * kLog2E, evalParams.shoulderSegment_lnA * kLog2E,
+			-invScale, -evalParams.params_overshootY, kInfinity, 0.f };
+
+		// "Hable_Inverse()" evaluates "((exp((log((value - offsetY) / scaleY) - lnA) / B) / scaleX) + offsetX) * W" with these per segment.
+		// It picks segments by comparing outputs with "y0" and "y1", which are before the "invScale" scaling, so it extrapolates the toe and mid
+		// beyond where the forward curve uses them (a few percents off in the round trip). Here the ends are scaled, so the inverse inverts the forward curve.
+		const auto makeInverse = [&](float a_offsetX, float a_offsetY, float a_scaleX, float a_scaleY, float a_lnA, float a_B, float a_end) {
+			// Without a toe (zero length) its B is 0, and the little range left below its end maps to 0
+			if (a_B == 0.f) {
+				return HableSegmentConstants{ 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, a_end, 0.f };
+			}
+			return HableSegmentConstants{ 1.f / a_scaleY, -a_offsetY / a_scaleY, 1.f / a_B, -(a_lnA * kLog2E) / a_B, W / a_scaleX, a_offsetX * a_scaleX, a_end, 0.f };
+		};
+		constants.inverse[0] = makeInverse(0.f, 0.f, 1.f, invScale, params.toeSegment.lnA, params.toeSegment.B, params.params.y0 * invScale);
+		constants.inverse[1] = makeInverse(-params.midSegment.offsetX, 0.f, 1.f, invScale, params.midSegment.lnA, 1.f, params.params.y1 * invScale);
+		constants.inverse[2] = makeInverse(params.shoulderSegment.offsetX, params.shoulderSegment.offsetY * invScale, -1.f, -invScale, params.shoulderSegment.lnA, params.shoulderSegment.B, kInfinity);
+
+		// Steep segments (the forward shoulder's power is usually ~3000) can have a log bias of thousands, which a power times log2() would need to cancel
+		// in float. As "2^(power * log2(y) + logBias)" is "2^(power * log2(y * 2^(logBias / power)))", the bias goes into the input scaling instead.
+		for (auto& segment : constants.forward) {
+			if (std::abs(segment.logBias) > 64.f) {
+				const float scale = std::exp2(segment.logBias / segment.power);
+				segment.inScale *= scale;
+				segment.inBias *= scale;
+				segment.logBias = 0.f;
+			}
+		}
+		return constants;
+	}
+
+	// "T" is a float or SIMD lanes (see "Color.h")
+	template <class T>
+	T EvalHableSegments(T a_value, const HableSegmentConstants (&a_segments)[3])
+	{
+		const auto inToe = Color::Less(a_value, Color::Splat<T>(a_segments[0].end));
+		const auto inMid = Color::Less(a_value, Color::Splat<T>(a_segments[1].end));
+		const auto select = [&](float HableSegmentConstants::*a_member) {
+			return Color::Select(inToe, Color::Splat<T>(a_segments[0].*a_member), Color::Select(inMid, Color::Splat<T>(a_segments[1].*a_member), Color::Splat<T>(a_segments[2].*a_member)));
+		};
+
+		// Clamped to the smallest normal float (GPUs flush denormals), so the log2() is never -INF, which a power of 0 would turn into NaN
+		const T y = Color::Max(Color::MulAdd(select(&HableSegmentConstants::inScale), a_value, select(&HableSegmentConstants::inBias)), Color::Splat<T>(FLT_MIN));
+		const T x = Color::Exp2(Color::MulAdd(select(&HableSegmentConstants::power), Color::Log2(y), select(&HableSegmentConstants::logBias)));
+		return Color::Mul(select(&HableSegmentConstants::outScale), Color::Add(x, select(&HableSegmentConstants::outBias)));
+	}
+
+	// Same as "Hable(const Float3&, const HableCurve&)", outputs are within 0-1
+	inline float Hable(float a_value, const HableConstants& a_constants)
+	{
+		return EvalHableSegments(a_value, a_constants.forward);
+	}
+
+	inline Float3 Hable(const Float3& a_color, const HableConstants& a_constants)
+	{
+		return Apply(a_color, [&](float a_channel) { return Hable(a_channel, a_constants); });
+	}
+
+	// Same as "Hable_Inverse(float, const HableParams&)"
+	inline float Hable_Inverse(float a_value, const HableConstants& a_constants)
+	{
+		// There's no inverse formula beyond the 0-1 range
+		return EvalHableSegments(Saturate(a_value), a_constants.inverse);
+	}
+
+	inline Float3 Hable_Inverse(const Float3& a_color, const HableConstants& a_constants)
+	{
+		return Apply(a_color, [&](float a_channel) { return Hable_Inverse(a_channel, a_constants); });
+	}
+
+	// Inverse tone maps SDR frames (linear, 0-1) in place, as three channel arrays of "a_count" values, on "a_threadCount" threads (0 is all cores).
+	// Channels go through SIMD lanes, whose log2() and exp2() are within a few ulps of the scalar ones.
+	inline void Hable_Inverse(float* a_r, float* a_g, float* a_b, std::size_t a_count, const HableConstants& a_constants, std::size_t a_threadCount = 0)
+	{
+		constexpr std::size_t kChunkSize = 16384;
+
+		ParallelFor((a_count + kChunkSize - 1) / kChunkSize, a_threadCount, [&](std::size_t a_chunk) {
+			const std::size_t begin = a_chunk * kChunkSize;
+			const std::size_t count = std::min(a_count - begin, kChunkSize);
+			for (float* channel : { a_r, a_g, a_b }) {
+				Color::ForEach(channel + begin, count, [&](Color::Wide a_value) { return EvalHableSegments(Color::Saturate(a_value), a_constants.inverse); });
+			}
+		});
+	}
+}
@@ -1,7 +1,9 @@
+#include <DirectXTex.h>
 #include <wincodec.h>
 
 #include "Hooks.h"
 #include "Offsets.h"
+#include "Screenshot.h"
 #include "Utils.h"
 
 namespace Hooks
@@ -137,7 +139,7 @@ namespace Hooks
 		// We don't expose "DevSetting*" or "EnforceUserDisplayMode" or "ForceSDROnHDR" or "kHDRScreenshots*" to the game settings, they'd just confuse users.
 		// Here we write down the number of settings we didn't add to the UI, to make sure "Settings::SettingID::kEND" has the right value.
 		// Note: this is pretty unnecessary, as the separator works anyway.
-		constexpr int unusedSettings = 4;
+		constexpr int unusedSettings = 7;
 
 		CreateStepperSetting(a_settingList, settings->DisplayMode, settings->IsHDRSupported() && !settings->IsSDRForcedOnHDR());
 		CreateStepperSetting(a_settingList, settings->PeakBrightness, settings->IsGameRenderingSetToHDR());
@@ -174,55 +176,246 @@ namespace Hooks
 
 	struct ScreenshotData
 	{
-		std::string                                                                                   FileName;
-		std::function<void(ID3D12CommandQueue*, ID3D12Resource*, D3D12_RESOURCE_STATES, std::string)> Callback;
-		ID3D12Resource*                                                                               TextureCopy;
-		uint64_t                                                                                      CaptureFrameIndex;
+		std::string                                             FileName;
+		std::function<void(const DirectX::Image&, std::string)> Callback;
+		Screenshot::ReadbackPool::Buffer*                       Readback;
 	};
 
-	static std::string                 screenshotName;
-	static std::vector<ScreenshotData> pendingScreenshots;
+	// Readback buffers for captures, created on the game's device the first time a resolution/format is used
+	class D3D12ReadbackDevice : public Screenshot::ReadbackDevice
+	{
+	public:
+		ID3D12Device* device = nullptr;
+
+		static D3D12_PLACED_SUBRESOURCE_FOOTPRINT GetFootprint(const Screenshot::ReadbackKey& a_key, ID3D12Device* a_device, uint64_t& a_outTotalBytes)
+		{
+			D3D12_RESOURCE_DESC textureDesc = {};
+			textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+			textureDesc.Width = a_key.width;
+			textureDesc.Height = a_key.height;
+			textureDesc.DepthOrArraySize = 1;
+			textureDesc.MipLevels = 1;
+			textureDesc.Format = static_cast<DXGI_FORMAT>(a_key.format);
+			textureDesc.SampleDesc.Count = 1;
+
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+			a_device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &footprint, nullptr, nullptr, &a_outTotalBytes);
+			return footprint;
+		}
+
+		std::size_t GetAllocationSize(const Screenshot::ReadbackKey& a_key) override
+		{
+			uint64_t totalBytes = 0;
+			if (device) {
+				GetFootprint(a_key, device, totalBytes);
+			}
+			return static_cast<std::size_t>(totalBytes);
+		}
+
+		bool Allocate(const Screenshot::ReadbackKey& a_key, Screenshot::ReadbackAllocation& a_outAllocation) override
+		{
+			if (!device) {
+				return false;
+			}
+
+			uint64_t   totalBytes = 0;
+			const auto footprint = GetFootprint(a_key, device, totalBytes);
+
+			const D3D12_HEAP_PROPERTIES heapProperties = {
+				.Type = D3D12_HEAP_TYPE_READBACK,
+				.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+				.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+			};
+
+			D3D12_RESOURCE_DESC bufferDesc = {};
+			bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+			bufferDesc.Width = totalBytes;
+			bufferDesc.Height = 1;
+			bufferDesc.DepthOrArraySize = 1;
+			bufferDesc.MipLevels = 1;
+			bufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+			bufferDesc.SampleDesc.Count = 1;
+			bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+			ID3D12Resource* buffer = nullptr;
+			if (FAILED(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&buffer)))) {
+				return false;
+			}
+
+			void* mapped = nullptr;
+			if (FAILED(buffer->Map(0, nullptr, &mapped))) {
+				buffer->Release();
+				return false;
+			}
+
+			a_outAllocation.resource = buffer;
+			a_outAllocation.mapped = static_cast<std::uint8_t*>(mapped);
+			a_outAllocation.rowPitch = footprint.Footprint.RowPitch;
+			a_outAllocation.size = totalBytes;
+			return true;
+		}
 
-	bool CheckForScreenshotRequest(ID3D12Device2* a_device, ID3D12CommandQueue* a_queue, ID3D12GraphicsCommandList* a_commandList, ID3D12Resource* a_sourceTexture)
+		void Free(const Screenshot::ReadbackAllocation& a_allocation) override
+		{
+			const auto buffer = static_cast<ID3D12Resource*>(a_allocation.resource);
+			buffer->Unmap(0, nullptr);
+			buffer->Release();
+		}
+	};
+
+	// Fence on the queue the game executes the frame's command lists on
+	class D3D12CompletionFence : public Screenshot::CompletionFence
+	{
+	public:
+		ID3D12Device*       device = nullptr;
+		ID3D12CommandQueue* queue = nullptr;
+
+		~D3D12CompletionFence() override
+		{
+			if (fence) {
+				fence->Release();
+			}
+		}
+
+		bool Signal(uint64_t a_value) override
+		{
+			if (!fence && (!device || FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence))))) {
+				return false;
+			}
+			return queue && SUCCEEDED(queue->Signal(fence, a_value));
+		}
+
+		uint64_t GetCompletedValue() override
+		{
+			return fence ? fence->GetCompletedValue() : 0;
+		}
+
+	private:
+		ID3D12Fence* fence = nullptr;
+	};
+
+	// Copy recorded in one of the game's command lists, which the game submits on its own
+	struct RecordedScreenshot
+	{
+		ID3D12CommandList*  commandList;
+		ID3D12CommandQueue* executedQueue;  // set by "Hook_ExecuteCommandLists" once the command list has been submitted
+		ScreenshotData      screenshot;
+	};
+
+	static std::string                       screenshotName;
+	static std::mutex                        recordedScreenshotsMutex;  // the game may submit its command lists from another thread
+	static std::vector<RecordedScreenshot>   recordedScreenshots;
+	static std::atomic<std::size_t>          unsubmittedScreenshots = 0;  // recorded screenshots without an "executedQueue", changed under the mutex
+	static std::vector<ScreenshotData>       readyScreenshots;  // copy done on the GPU, waiting for a free worker
+	static D3D12CompletionFence              screenshotFence;
+	static Screenshot::SteadyCompletionClock screenshotClock;
+	static Screenshot::CompletionTracker     screenshotTracker{ screenshotFence, screenshotClock };
+	static D3D12ReadbackDevice               screenshotReadbackDevice;
+	// Idle buffers are kept for about a minute of photo mode. A 4K FP16 one is 64MB of system memory,
+	// the budget fits ~16 of those, more than that and burst frames get dropped until the workers catch up.
+	// Never destroyed either: freeing the buffers unmaps and releases D3D12 resources, which mustn't happen under the loader lock.
+	static Screenshot::ReadbackPool&         screenshotReadbackPool = *new Screenshot::ReadbackPool{ screenshotReadbackDevice, 3600, 2, 1024ull << 20 };
+	// Stopped by "Shutdown()" on the plugin's exit path, which waits for queued screenshots to be written and their buffers released.
+	// Never destroyed: the destructor would run under the loader lock, after ExitProcess killed the workers (maybe holding the queue's lock).
+	static Screenshot::WorkerPool&           screenshotWorkers = *new Screenshot::WorkerPool{ 2, 8 };
+
+	void Hooks::Hook_ExecuteCommandLists(ID3D12CommandQueue* a_this, UINT a_numCommandLists, ID3D12CommandList* const* a_commandLists)
+	{
+		_ExecuteCommandLists(a_this, a_numCommandLists, a_commandLists);
+
+		// Nearly every submission happens without a screenshot waiting for it. The game hands a recorded list over to the thread that submits it,
+		// so that thread always sees the increment of the copy recorded in it, even with a relaxed load.
+		if (unsubmittedScreenshots.load(std::memory_order_relaxed) == 0) {
+			return;
+		}
+
+		// A command list can't be executed while it's being recorded, so the first submission of a list after the copy was recorded is the one holding it
+		std::scoped_lock lock(recordedScreenshotsMutex);
+		for (auto& recorded : recordedScreenshots) {
+			if (!recorded.executedQueue && std::find(a_commandLists, a_commandLists + a_numCommandLists, recorded.commandList) != a_commandLists + a_numCommandLists) {
+				recorded.executedQueue = a_this;
+				unsubmittedScreenshots.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool CheckForScreenshotRequest(ID3D12Device2* a_device, ID3D12GraphicsCommandList* a_commandList, ID3D12Resource* a_sourceTexture)
 	{
 		static uint64_t currentFrameCounter = 0;
 		currentFrameCounter++;
 
+		// HDR screenshots can be a burst of consecutive frames, the request is only done once the last one is captured
+		static uint32_t burstFrame = 0;
+		static uint32_t burstDroppedFrames = 0;
+
 		decltype(ScreenshotData::Callback) screenshotCallback;
 		bool                               screenshotEnqueued = false;
 		const auto                         settings = Settings::Main::GetSingleton();
 
+		screenshotReadbackDevice.device = a_device;
+		screenshotReadbackPool.Trim(currentFrameCounter);
+		screenshotFence.device = a_device;
+
+		// A signal is only queued once the command list holding the copies has gone through ExecuteCommandLists, on the queue that executed it,
+		// so it always lands after them whenever and wherever the game submits the list
+		{
+			std::scoped_lock lock(recordedScreenshotsMutex);
+			uint64_t         fenceValue = 0;
+			for (auto itr = recordedScreenshots.begin(); itr != recordedScreenshots.end();) {
+				// The fence follows one queue at a time, copies executed on another one wait until everything pending on the fence completed
+				const bool bSameQueue = itr->executedQueue == screenshotFence.queue;
+				if (!itr->executedQueue || (!bSameQueue && screenshotTracker.GetPendingCount() > 0)) {
+					++itr;
+					continue;
+				}
+				if (!bSameQueue || !fenceValue) {
+					screenshotFence.queue = itr->executedQueue;
+					if (fenceValue = screenshotTracker.Signal(); !fenceValue) {
+						break;
+					}
+				}
+				screenshotTracker.Add(fenceValue, [screenshot = std::move(itr->screenshot)] {
+					readyScreenshots.emplace_back(screenshot);
+				});
+				itr = recordedScreenshots.erase(itr);
+			}
+		}
+		screenshotTracker.Poll();
+
 		if (settings->bRequestedHDRScreenshot) {
 			screenshotCallback = &Utils::TakeHDRPhotoModeScreenshot;
 		} else if (settings->bRequestedSDRScreenshot) {
 			screenshotCallback = &Utils::TakeSDRPhotoModeScreenshot;
 		}
 
-		// Capture texture data on the GPU side initially
+		// Copy the texture straight into a CPU readable buffer, the copy is executed along with the rest of the frame
 		if (screenshotCallback) {
-			ID3D12Resource* texture = nullptr;
-			auto textureDesc = a_sourceTexture->GetDesc();
+			const auto     burstSetting = settings->HDRScreenshotsBurstFrames.value.get_data();
+			const uint32_t burstFrames = settings->bRequestedHDRScreenshot && burstSetting > 1 ? static_cast<uint32_t>(burstSetting) : 1;
+			const auto     textureDesc = a_sourceTexture->GetDesc();
+			DXGI_FORMAT format = textureDesc.Format;
 
-			if (textureDesc.Format == DXGI_FORMAT_R10G10B10A2_TYPELESS) {
-				textureDesc.Format = DXGI_FORMAT_R10G10B10A2_UNORM;
+			if (format == DXGI_FORMAT_R10G10B10A2_TYPELESS) {
+				format = DXGI_FORMAT_R10G10B10A2_UNORM;
 			}
-			else if (textureDesc.Format == DXGI_FORMAT_R16G16B16A16_TYPELESS) {
-				textureDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+			else if (format == DXGI_FORMAT_R16G16B16A16_TYPELESS) {
+				format = DXGI_FORMAT_R16G16B16A16_FLOAT;
 			}
 
-			const D3D12_HEAP_PROPERTIES heapProperties = {
-				.Type = D3D12_HEAP_TYPE_DEFAULT,
-				.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
-				.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
-			};
+			const Screenshot::ReadbackKey key{ static_cast<uint32_t>(textureDesc.Width), textureDesc.Height, static_cast<uint32_t>(format) };
+			if (const auto readback = screenshotReadbackPool.Acquire(key, currentFrameCounter)) {
+				uint64_t totalBytes = 0;
+
+				D3D12_TEXTURE_COPY_LOCATION destination = {};
+				destination.pResource = static_cast<ID3D12Resource*>(readback->allocation.resource);
+				destination.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+				destination.PlacedFootprint = D3D12ReadbackDevice::GetFootprint(key, a_device, totalBytes);
+
+				D3D12_TEXTURE_COPY_LOCATION source = {};
+				source.pResource = a_sourceTexture;
+				source.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+				source.SubresourceIndex = 0;
 
-			if (SUCCEEDED(a_device->CreateCommittedResource(
-					&heapProperties,
-					D3D12_HEAP_FLAG_NONE,
-					&textureDesc,
-					D3D12_RESOURCE_STATE_COPY_DEST,
-					nullptr,
-					IID_PPV_ARGS(&texture)))) {
 				// We're assuming the input is always a render target
 				D3D12_RESOURCE_BARRIER barrier = {};
 				barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -233,30 +426,59 @@ namespace Hooks
 				barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
 
 				a_commandList->ResourceBarrier(1, &barrier);
-				a_commandList->CopyResource(texture, a_sourceTexture);
+				a_commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
 				std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
 				a_commandList->ResourceBarrier(1, &barrier);
-			}
 
-			pendingScreenshots.emplace_back(ScreenshotData{
-				screenshotName,
-				screenshotCallback,
-				texture,
-				currentFrameCounter });
+				std::scoped_lock lock(recordedScreenshotsMutex);
+				recordedScreenshots.emplace_back(RecordedScreenshot{
+					a_commandList,
+					nullptr,
+					ScreenshotData{
+						burstFrames > 1 ? std::format("{}_{:03}", screenshotName, burstFrame) : screenshotName,
+						screenshotCallback,
+						readback } });
+				unsubmittedScreenshots.fetch_add(1, std::memory_order_relaxed);
+			} else {
+				// Out of readback memory (or the device failed), the frame is skipped rather than stalling for a buffer
+				++burstDroppedFrames;
+			}
 
-			screenshotEnqueued = true;
+			if (++burstFrame >= burstFrames) {
+				if (burstFrames > 1) {
+					INFO("HDR screenshot burst {}: captured {} of {} frames", screenshotName, burstFrames - burstDroppedFrames, burstFrames)
+				}
+				burstFrame = 0;
+				burstDroppedFrames = 0;
+				screenshotEnqueued = true;
+			}
 		}
 
-		// Allow eight frames to pass before attempting a CPU readback. Ideally a fence would be issued on the
-		// command queue, but that's not possible without a lot of reverse engineering work.
-		for (auto itr = pendingScreenshots.begin(); itr != pendingScreenshots.end();) {
-			if ((currentFrameCounter - itr->CaptureFrameIndex) >= 8) {
-				// Callback releases the texture
-				std::thread(itr->Callback, a_queue, itr->TextureCopy, D3D12_RESOURCE_STATE_COPY_DEST, itr->FileName).detach();
-
-				itr = pendingScreenshots.erase(itr);
+		for (auto itr = readyScreenshots.begin(); itr != readyScreenshots.end();) {
+			// The buffer goes back to the pool once the callback is done reading it
+			const bool bQueued = screenshotWorkers.TryEnqueue([callback = itr->Callback, readback = itr->Readback, fileName = itr->FileName] {
+				const auto& key = readback->key;
+				const auto& allocation = readback->allocation;
+				const DirectX::Image image{
+					key.width,
+					key.height,
+					static_cast<DXGI_FORMAT>(key.format),
+					allocation.rowPitch,
+					allocation.rowPitch * key.height,
+					allocation.mapped
+				};
+				callback(image, fileName);
+				screenshotReadbackPool.Release(readback);
+
+				const auto stats = screenshotWorkers.GetStats();
+				INFO("Saved screenshot {} ({} queued, average latency {:.0f}ms, max {:.0f}ms)", fileName, stats.queueDepth, stats.averageLatencyMs, stats.maxLatencyMs)
+			});
+
+			// When the workers are backed up, keep the capture around and try again next frame
+			if (bQueued) {
+				itr = readyScreenshots.erase(itr);
 			} else {
-				itr++;
+				break;
 			}
 		}
 
@@ -404,6 +626,15 @@ namespace Hooks
 			return *reinterpret_cast<ID3D12CommandQueue**>(queueArray[a_queueIndex] + 0x60);
 		};
 
+		// Screenshot copies are signalled once their command list is executed. Every queue of the device shares the vtable,
+		// so the hook sees the list whichever queue the game submits it to.
+		if (!_ExecuteCommandLists) {
+			constexpr uint16_t kExecuteCommandListsIndex = 10;  // after IUnknown (3), ID3D12Object (4), ID3D12DeviceChild (1), UpdateTileMappings and CopyTileMappings
+			auto               hookExecuteCommandLists = dku::Hook::AddVMTHook(getCommandQueue(0), kExecuteCommandListsIndex, FUNC_INFO(Hook_ExecuteCommandLists));
+			_ExecuteCommandLists = reinterpret_cast<decltype(&Hook_ExecuteCommandLists)>(hookExecuteCommandLists->OldAddress);
+			hookExecuteCommandLists->Enable();
+		}
+
 		auto getBoundShaderResource = [&]() {
 			const auto v1 = *reinterpret_cast<uintptr_t*>(reinterpret_cast<uintptr_t>(a_arg2) + 0x20);
 			const auto v2 = *reinterpret_cast<uint32_t*>(*reinterpret_cast<uintptr_t*>(v1) + 0x18) * 3;
@@ -414,7 +645,7 @@ namespace Hooks
 
 		// This seems to be the best place to shove our screenshot code in. It's not worth adding new hooks.
 		// This will end up missing the photo mode frames as they are drawn in later passes.
-		bool bScreenshotMade = CheckForScreenshotRequest(device, getCommandQueue(0), commandList, ScaleformCompositeRenderTarget->m_Resource);
+		bool bScreenshotMade = CheckForScreenshotRequest(device, commandList, ScaleformCompositeRenderTarget->m_Resource);
 
 		if (Hook_ApplyRenderPassRenderState(a_renderGraph, a_arg2)) {
 			// Remove all render targets; we're treating this pixel shader as a compute shader. All RT writes end
@@ -555,12 +786,32 @@ namespace Hooks
 		}
     }
 
+	static HWND                       gameWindow = nullptr;
+	static WNDPROC                    originalGameWindowProc = nullptr;
+	static std::add_pointer_t<void()> gameWindowDestroyedCallback = nullptr;
+
+	static LRESULT CALLBACK GameWindowProc(HWND a_hwnd, UINT a_message, WPARAM a_wParam, LPARAM a_lParam)
+	{
+		if (a_message == WM_DESTROY && a_hwnd == gameWindow) {
+			if (const auto callback = std::exchange(gameWindowDestroyedCallback, nullptr)) {
+				callback();
+			}
+		}
+		return CallWindowProcW(originalGameWindowProc, a_hwnd, a_message, a_wParam, a_lParam);
+	}
+
 	// Called more than once, every time some settings are changed by the user
     void Hooks::Hook_UnkFunc(uintptr_t a1, RE::BGSSwapChainObject* a_bgsSwapchainObject)
     {
 		const auto settings = Settings::Main::GetSingleton();
 		settings->InitCompatibility(a_bgsSwapchainObject);
 
+		// The game keeps the same window when switching between windowed and borderless, it's only subclassed once
+		if (!gameWindow && a_bgsSwapchainObject->hwnd) {
+			gameWindow = a_bgsSwapchainObject->hwnd;
+			originalGameWindowProc = reinterpret_cast<WNDPROC>(SetWindowLongPtrW(gameWindow, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(&GameWindowProc)));
+		}
+
 		a_bgsSwapchainObject->swapChainInterface->SetColorSpace1(settings->GetDisplayModeColorSpaceType());
 
 		settings->RegisterReshadeOverlay();
@@ -976,4 +1227,17 @@ namespace Hooks
 		Hooks::Hook();
 		Patches::Patch();
 	}
+
+	void SetGameWindowDestroyedCallback(std::add_pointer_t<void()> a_callback)
+	{
+		gameWindowDestroyedCallback = a_callback;
+	}
+
+	void Shutdown()
+	{
+		screenshotWorkers.Shutdown();
+
+		const auto stats = screenshotWorkers.GetStats();
+		INFO("Screenshot workers stopped after {} screenshots ({} retried while busy)", stats.completedJobs, stats.rejectedJobs)
+	}
 }
@@ -125,6 +125,9 @@ namespace Hooks
 		static inline std::add_pointer_t<decltype(HookedScaleformCompositeRenderPass)> _ScaleformCompositeRenderPass;
 		static void HookedScaleformCompositeRenderPassExecuteDraw(void* a_arg1, void* a_arg2, uint32_t a_vertexCount);
 
+		static void Hook_ExecuteCommandLists(ID3D12CommandQueue* a_this, UINT a_numCommandLists, ID3D12CommandList* const* a_commandLists);
+		static inline std::add_pointer_t<decltype(Hook_ExecuteCommandLists)> _ExecuteCommandLists;
+
 		static void Hook_UnkFunc(uintptr_t a1, RE::BGSSwapChainObject* a_bgsSwapchainObject);
 		static inline std::add_pointer_t<decltype(Hook_UnkFunc)> _UnkFunc;
 
@@ -167,4 +170,10 @@ namespace Hooks
 	};
 
 	void Install();
+
+	// "a_callback" runs once, on the game's thread, when the game's window is destroyed
+	void SetGameWindowDestroyedCallback(std::add_pointer_t<void()> a_callback);
+
+	// Waits for queued screenshots to be written and stops the threads writing them
+	void Shutdown();
 }
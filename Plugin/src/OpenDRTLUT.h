@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ShapedLUT.h"
+#include "ToneMapping.h"
+
+#include <cstddef>
+
+// "OpenDRT::TransformCustom()" baked into a 3D LUT, so a pixel does one trilinear sample instead of the whole transform.
+// Values are the transform's output (linear, 0-1 with 1 being the display peak), see "ShapedLUT.h" for the layout and shapers.
+// Delta E ITP against the analytic transform, on the display's output (measured by "tools/OpenDRTLUTBaker" on colors from 2^-12 to 2^6, 100 to 4000 nits):
+// - 65^3 PQ: 0.2-0.3 mean, 1.3-2 at the 99.9th percentile (4 with contrast 0.5). 33^3 PQ: ~0.9 mean, 4-6 at the 99.9th percentile.
+// - Log2 has the same means but ~1.5 times higher tails, except with low contrast where it's twice better than PQ.
+// The worst errors are bright saturated colors (purples and magentas several times above 1), where the chroma compression bends the fastest.
+namespace ToneMapping
+{
+	// Everything the LUT depends on, the arguments of "OpenDRT::TransformCustom()" (the defaults are the reference display's transform)
+	struct OpenDRTLUTInputs
+	{
+		float peakNits = Color::kReferenceWhiteNits_BT2408;
+		float midGrayAdjustment = 1.f;
+		float contrast = 1.f;
+		float highlights = 0.575f;
+		float shadows = 1.f;
+
+		bool operator==(const OpenDRTLUTInputs&) const = default;
+	};
+
+	inline Float3 EvaluateOpenDRT(const Float3& a_rgb, const OpenDRTLUTInputs& a_inputs)
+	{
+		return OpenDRT::TransformCustom(a_rgb, a_inputs.peakNits, a_inputs.midGrayAdjustment, a_inputs.contrast, a_inputs.highlights, a_inputs.shadows);
+	}
+
+	// Fills "a_outLUT" (which sets the size and shaper) with the transform of "a_inputs", on "a_threadCount" threads (0 is all cores)
+	inline void BakeOpenDRTLUT(const OpenDRTLUTInputs& a_inputs, ShapedLUT& a_outLUT, std::size_t a_threadCount = 0)
+	{
+		const OpenDRT::TonescaleParams tonescaleParams = OpenDRT::MakeCustomTonescaleParams(a_inputs.peakNits, a_inputs.contrast);
+		const auto                     tonescale = [&](float a_lum) { return OpenDRT::DisplayTonescale(a_lum, tonescaleParams); };
+		BakeShapedLUT([&](const Float3& a_rgb) { return OpenDRT::TransformCustom(a_rgb, tonescale, a_inputs.peakNits, a_inputs.midGrayAdjustment, a_inputs.highlights, a_inputs.shadows); },
+			a_outLUT, a_threadCount);
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace ToneMapping
+{
+	// Calls "a_function(i)" for every i below "a_count" on "a_threadCount" threads (0 is all cores), the calling thread included.
+	// Indices are handed out one at a time, so threads that got cheap ones take more of them.
+	template <class F>
+	void ParallelFor(std::size_t a_count, std::size_t a_threadCount, F&& a_function)
+	{
+		std::size_t threadCount = a_threadCount ? a_threadCount : std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+		threadCount = std::min(threadCount, std::max<std::size_t>(a_count, 1));
+
+		std::atomic<std::size_t> nextIndex = 0;
+		const auto               worker = [&]() {
+			for (std::size_t i = nextIndex++; i < a_count; i = nextIndex++) {
+				a_function(i);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		for (std::size_t i = 1; i < threadCount; ++i) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+}
@@ -0,0 +1,917 @@
+#include "Screenshot.h"
+
+#include "Color.h"
+#include "ColorLUT.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ranges>
+#include <tuple>
+
+#include <DirectXPackedVector.h>
+
+#include <stb_image_write_hdr_png.h>
+
+#include <immintrin.h>
+
+#ifdef _WIN32
+#	include <Windows.h>
+#	include <intrin.h>
+#else
+#	include <sys/resource.h>
+#endif
+
+// MSVC emits any intrinsic regardless of /arch, GCC and Clang need the target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#	define SCREENSHOT_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#else
+#	define SCREENSHOT_TARGET_AVX2
+#endif
+
+namespace Screenshot
+{
+	// Light level stats of a row, kept in registers until the row is done
+	struct LightLevelAccumulator
+	{
+		DirectX::XMVECTOR maxComponent = DirectX::g_XMZero;
+		DirectX::XMVECTOR sumMaxComponent = DirectX::g_XMZero;
+	};
+
+	// Converts 4 scRGB pixels to HDR10 (BT.2020 + PQ). They are transposed so each register holds one channel of all 4 pixels,
+	// which keeps every lane busy through the gamut conversion and PQ encode.
+	// The first "a_count" pixels are measured into "a_accumulator" and "a_stats" if there are stats to gather.
+	void XM_CALLCONV TransformColor_HDR10_x4(DirectX::XMVECTOR* a_outPixels, DirectX::FXMMATRIX a_inPixels, LightLevelStats* a_stats, LightLevelAccumulator& a_accumulator, std::size_t a_count)
+	{
+		using namespace DirectX;
+
+		const XMMATRIX channels = XMMatrixTranspose(a_inPixels);
+
+		const auto [r2020, g2020, b2020] = Color::BT709_To_BT2020(Color::Vec3{ channels.r[0], channels.r[1], channels.r[2] });
+
+		if (a_stats) {
+			// In nits, negative (out of gamut) components don't emit any light and PQ can't go past 10000 nits.
+			// XMVectorClamp() lets NaNs through, _mm_max_ps() returns its second operand if either one is NaN, so they count as black like they encode.
+			constexpr float nitsPerUnit = 80.f;
+			const XMVECTOR maxNits = XMVectorReplicate(10000.f);
+			const auto     toNits = [&](FXMVECTOR a_value) { return _mm_min_ps(_mm_max_ps(XMVectorScale(a_value, nitsPerUnit), g_XMZero), maxNits); };
+			const XMVECTOR rNits = toNits(r2020);
+			const XMVECTOR gNits = toNits(g2020);
+			const XMVECTOR bNits = toNits(b2020);
+
+			// Padding lanes of a partial group are zero, so they don't change the max and only need masking out of the sum and histogram
+			const XMVECTOR maxComponent = XMVectorMax(rNits, XMVectorMax(gNits, bNits));
+			a_accumulator.maxComponent = XMVectorMax(a_accumulator.maxComponent, maxComponent);
+			a_accumulator.sumMaxComponent = XMVectorAdd(a_accumulator.sumMaxComponent, maxComponent);
+
+			// BT.2020 luminance to a histogram bin
+			constexpr float binsPerStop = static_cast<float>(LightLevelStats::kHistogramBins) / (LightLevelStats::kHistogramMaxLog2 - LightLevelStats::kHistogramMinLog2);
+			const XMVECTOR luminance = XMVectorMultiplyAdd(bNits, XMVectorReplicate(0.0593f), XMVectorMultiplyAdd(gNits, XMVectorReplicate(0.6780f), XMVectorScale(rNits, 0.2627f)));
+			const XMVECTOR logLuminance = Color::Log2(luminance);
+			const XMVECTOR bin = XMVectorClamp(XMVectorScale(XMVectorSubtract(logLuminance, XMVectorReplicate(LightLevelStats::kHistogramMinLog2)), binsPerStop), g_XMZero, XMVectorReplicate(static_cast<float>(LightLevelStats::kHistogramBins - 1)));
+			alignas(16) std::int32_t bins[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(bins), _mm_cvttps_epi32(bin));
+			for (std::size_t i = 0; i < a_count; ++i) {
+				++a_stats->histogram[bins[i]];
+			}
+		}
+
+		// The PQ table clamps to [0, 10000] nits (NaNs encode to PQ(0)), its max absolute error is 4.6e-6 (~1/220 of a 10 bit code value)
+		const auto     encode = [](FXMVECTOR a_value) { return Color::kLinearToPQTable.Sample(XMVectorScale(a_value, 1.f / Color::kPQMaxWhitePoint)); };
+		const XMMATRIX pixels = XMMatrixTranspose(XMMATRIX(encode(r2020), encode(g2020), encode(b2020), g_XMOne));
+		a_outPixels[0] = pixels.r[0];
+		a_outPixels[1] = pixels.r[1];
+		a_outPixels[2] = pixels.r[2];
+		a_outPixels[3] = pixels.r[3];
+	}
+
+	void TransformColor_HDR10(DirectX::XMVECTOR* a_outPixels, const DirectX::XMVECTOR* a_inPixels, std::size_t a_width, LightLevelStats* a_stats)
+	{
+		LightLevelAccumulator accumulator;
+
+		std::size_t i = 0;
+		for (; i + 4 <= a_width; i += 4) {
+			TransformColor_HDR10_x4(a_outPixels + i, DirectX::XMMATRIX(a_inPixels[i], a_inPixels[i + 1], a_inPixels[i + 2], a_inPixels[i + 3]), a_stats, accumulator, 4);
+		}
+
+		if (i < a_width) {
+			DirectX::XMVECTOR tail[4] = { DirectX::g_XMZero, DirectX::g_XMZero, DirectX::g_XMZero, DirectX::g_XMZero };
+			std::copy(a_inPixels + i, a_inPixels + a_width, tail);
+			TransformColor_HDR10_x4(tail, DirectX::XMMATRIX(tail[0], tail[1], tail[2], tail[3]), a_stats, accumulator, a_width - i);
+			std::copy(tail, tail + (a_width - i), a_outPixels + i);
+		}
+
+		if (a_stats) {
+			alignas(16) float maxComponent[4];
+			alignas(16) float sumMaxComponent[4];
+			DirectX::XMStoreFloat4A(reinterpret_cast<DirectX::XMFLOAT4A*>(maxComponent), accumulator.maxComponent);
+			DirectX::XMStoreFloat4A(reinterpret_cast<DirectX::XMFLOAT4A*>(sumMaxComponent), accumulator.sumMaxComponent);
+			a_stats->maxCLL = std::max({ a_stats->maxCLL, maxComponent[0], maxComponent[1], maxComponent[2], maxComponent[3] });
+			a_stats->sumMaxComponent += static_cast<double>(sumMaxComponent[0]) + sumMaxComponent[1] + sumMaxComponent[2] + sumMaxComponent[3];
+			a_stats->pixelCount += a_width;
+		}
+	}
+
+	std::string FormatLightLevelStats(const LightLevelStats& a_stats)
+	{
+		// JSON has no NaN or infinity
+		const auto finite = [](float a_value) { return std::isfinite(a_value) ? a_value : 0.f; };
+
+		char header[256];
+		std::snprintf(header, sizeof(header),
+			"{\n"
+			"\t\"maxCLL\": %.4f,\n"
+			"\t\"maxFALL\": %.4f,\n"
+			"\t\"pixelCount\": %llu,\n"
+			"\t\"histogram\": {\n"
+			"\t\t\"log2MinNits\": %g,\n"
+			"\t\t\"log2MaxNits\": %g,\n"
+			"\t\t\"bins\": [",
+			finite(a_stats.maxCLL), finite(a_stats.GetMaxFALL()), static_cast<unsigned long long>(a_stats.pixelCount), LightLevelStats::kHistogramMinLog2, LightLevelStats::kHistogramMaxLog2);
+
+		std::string json = header;
+		for (std::size_t i = 0; i < a_stats.histogram.size(); ++i) {
+			json += (i ? ", " : "") + std::to_string(a_stats.histogram[i]);
+		}
+		json += "]\n\t}\n}\n";
+		return json;
+	}
+
+	bool HasAVX2()
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		constexpr int osxsave = 1 << 27, avx = 1 << 28, f16c = 1 << 29;
+		if ((info[2] & (osxsave | avx | f16c)) != (osxsave | avx | f16c) || (_xgetbv(0) & 0x6) != 0x6) {  // the OS must save YMM registers
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#endif
+	}
+
+	// 16 halfs (four pixels) per iteration, the count is always a multiple of 4 so the tail is converted one pixel at a time
+	SCREENSHOT_TARGET_AVX2 void ConvertHalfToFloat_AVX2(float* a_out, const std::uint16_t* a_in, std::size_t a_count)
+	{
+		std::size_t i = 0;
+		for (; i + 16 <= a_count; i += 16) {
+			const __m256i halfs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_in + i));
+			_mm256_storeu_ps(a_out + i, _mm256_cvtph_ps(_mm256_castsi256_si128(halfs)));
+			_mm256_storeu_ps(a_out + i + 8, _mm256_cvtph_ps(_mm256_extracti128_si256(halfs, 1)));
+		}
+		for (; i + 4 <= a_count; i += 4) {
+			_mm_storeu_ps(a_out + i, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a_in + i))));
+		}
+		if (i < a_count) {
+			DirectX::PackedVector::XMConvertHalfToFloatStream(a_out + i, sizeof(float), reinterpret_cast<const DirectX::PackedVector::HALF*>(a_in + i), sizeof(DirectX::PackedVector::HALF), a_count - i);
+		}
+	}
+
+	// Each pixel is broadcast to the four lanes of its half of a YMM register with a cross-lane shuffle,
+	// then every lane shifts its own channel down, masks it and scales it to [0, 1]. Four pixels per iteration.
+	SCREENSHOT_TARGET_AVX2 void UnpackR10G10B10A2_AVX2(DirectX::XMVECTOR* a_outPixels, const std::uint32_t* a_in, std::size_t a_count)
+	{
+		const __m256i broadcast01 = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+		const __m256i broadcast23 = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+		const __m256i shifts = _mm256_setr_epi32(0, 10, 20, 30, 0, 10, 20, 30);
+		const __m256i masks = _mm256_setr_epi32(0x3FF, 0x3FF, 0x3FF, 0x3, 0x3FF, 0x3FF, 0x3FF, 0x3);
+		const __m256 scales = _mm256_setr_ps(1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 3.0f, 1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 1023.0f, 1.0f / 3.0f);
+
+		auto out = reinterpret_cast<float*>(a_outPixels);
+		std::size_t x = 0;
+		for (; x + 4 <= a_count; x += 4) {
+			const __m256i pixels = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_in + x)));
+			const __m256i channels01 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_permutevar8x32_epi32(pixels, broadcast01), shifts), masks);
+			const __m256i channels23 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_permutevar8x32_epi32(pixels, broadcast23), shifts), masks);
+			_mm256_storeu_ps(out + x * 4, _mm256_mul_ps(_mm256_cvtepi32_ps(channels01), scales));
+			_mm256_storeu_ps(out + x * 4 + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(channels23), scales));
+		}
+		for (; x < a_count; ++x) {
+			a_outPixels[x] = DirectX::PackedVector::XMLoadUDecN4(reinterpret_cast<const DirectX::PackedVector::XMUDECN4*>(a_in + x));
+		}
+	}
+
+	void ConvertHalfToFloat(float* a_out, const std::uint16_t* a_in, std::size_t a_count)
+	{
+		static const bool hasAVX2 = HasAVX2();
+		if (hasAVX2) {
+			ConvertHalfToFloat_AVX2(a_out, a_in, a_count);
+		} else {
+			DirectX::PackedVector::XMConvertHalfToFloatStream(a_out, sizeof(float), reinterpret_cast<const DirectX::PackedVector::HALF*>(a_in), sizeof(DirectX::PackedVector::HALF), a_count);
+		}
+	}
+
+	void UnpackR10G10B10A2(DirectX::XMVECTOR* a_outPixels, const std::uint32_t* a_in, std::size_t a_count)
+	{
+		static const bool hasAVX2 = HasAVX2();
+		if (hasAVX2) {
+			UnpackR10G10B10A2_AVX2(a_outPixels, a_in, a_count);
+		} else {
+			for (std::size_t x = 0; x < a_count; ++x) {
+				a_outPixels[x] = DirectX::PackedVector::XMLoadUDecN4(reinterpret_cast<const DirectX::PackedVector::XMUDECN4*>(a_in + x));
+			}
+		}
+	}
+
+	void DecodeRow(DirectX::XMVECTOR* a_outPixels, const std::uint8_t* a_row, std::size_t a_width, PixelFormat a_format)
+	{
+		switch (a_format) {
+		case PixelFormat::kR16G16B16A16_FLOAT:
+			ConvertHalfToFloat(reinterpret_cast<float*>(a_outPixels), reinterpret_cast<const std::uint16_t*>(a_row), a_width * 4);
+			break;
+		case PixelFormat::kR32G32B32A32_FLOAT:
+			std::memcpy(a_outPixels, a_row, a_width * sizeof(DirectX::XMVECTOR));
+			break;
+		case PixelFormat::kR10G10B10A2_UNORM:
+			UnpackR10G10B10A2(a_outPixels, reinterpret_cast<const std::uint32_t*>(a_row), a_width);
+			break;
+		}
+	}
+
+	bool WriteHDR10PNG(const Image& a_image, Compression a_compression, stbi_write_func* a_func, PatchFunc* a_patch, void* a_context, LightLevelStats* a_outStats, int a_stripes)
+	{
+		const auto writer = stbi_write_hdr_png_begin(
+			a_func,
+			a_context,
+			static_cast<int>(a_image.width),
+			static_cast<int>(a_image.height),
+			3,
+			9,   // BT.2020 primaries
+			16,  // PQ transfer function
+			a_stripes);
+
+		stbi_write_hdr_png_patch(writer, a_patch);
+
+		switch (a_compression) {
+		case Compression::kFastest:
+			stbi_write_hdr_png_compression(writer, 0, 5);
+			break;
+		case Compression::kBalanced:
+			stbi_write_hdr_png_compression(writer, 1, 8);
+			break;
+		case Compression::kSmallest:
+			stbi_write_hdr_png_compression(writer, 2, 16);
+			break;
+		}
+
+		LightLevelStats stats;
+		PixelBuffer floatRow(a_image.width);
+		std::vector<std::uint16_t> row(a_image.width * 3);
+
+		for (std::size_t y = 0; y < a_image.height; ++y) {
+			DecodeRow(floatRow.data(), a_image.pixels + y * a_image.rowPitch, a_image.width, a_image.format);
+			TransformColor_HDR10(floatRow.data(), floatRow.data(), a_image.width, &stats);
+
+			// Same rounding as converting to R16G16B16A16_UNORM with DirectXTex, so the output matches the old multi pass version
+			for (std::size_t x = 0; x < a_image.width; ++x) {
+				DirectX::PackedVector::XMUSHORTN4 unorm;
+				DirectX::PackedVector::XMStoreUShortN4(&unorm, floatRow[x]);
+				row[x * 3 + 0] = QuantizeTo10Bit(unorm.x);
+				row[x * 3 + 1] = QuantizeTo10Bit(unorm.y);
+				row[x * 3 + 2] = QuantizeTo10Bit(unorm.z);
+			}
+
+			if (!stbi_write_hdr_png_row(writer, row.data())) {
+				break;
+			}
+		}
+
+		stbi_write_hdr_png_content_light_level(writer, stats.maxCLL, stats.GetMaxFALL());
+		if (a_outStats) {
+			*a_outStats = stats;
+		}
+
+		return stbi_write_hdr_png_end(writer) != 0;
+	}
+
+	Downsampler::Downsampler(std::size_t a_sourceWidth, std::size_t a_sourceHeight, std::size_t a_width, std::size_t a_height, Filter a_filter) :
+		width(a_width),
+		height(a_height),
+		sourceHeight(a_sourceHeight),
+		filteredRow(a_width),
+		pixels(a_width * a_height)
+	{
+		// Keep the central part of the source that has the output aspect ratio
+		std::size_t cropWidth = a_sourceWidth;
+		std::size_t cropHeight = a_sourceHeight;
+		if (a_sourceWidth * a_height > a_sourceHeight * a_width) {
+			cropWidth = std::max<std::size_t>((a_sourceHeight * a_width + a_height / 2) / std::max<std::size_t>(a_height, 1), 1);
+		} else {
+			cropHeight = std::max<std::size_t>((a_sourceWidth * a_height + a_width / 2) / std::max<std::size_t>(a_width, 1), 1);
+		}
+		// An empty source can't be cropped, neither axis gets any taps so no row is ever read
+		if (cropWidth == 0 || cropHeight == 0) {
+			cropWidth = 0;
+			cropHeight = 0;
+		}
+
+		ComputeTaps(cropWidth, width, a_filter, columnTaps, columnWeights);
+		ComputeTaps(cropHeight, height, a_filter, rowTaps, rowWeights);
+
+		const std::size_t cropX = (a_sourceWidth - cropWidth) / 2;
+		const std::size_t cropY = (a_sourceHeight - cropHeight) / 2;
+		for (auto& taps : columnTaps) {
+			taps.first += cropX;
+		}
+		for (auto& taps : rowTaps) {
+			taps.first += cropY;
+		}
+	}
+
+	void Downsampler::ComputeTaps(std::size_t a_sourceSize, std::size_t a_size, Filter a_filter, std::vector<Taps>& a_outTaps, std::vector<float>& a_outWeights)
+	{
+		a_outTaps.resize(a_size);
+		a_outWeights.clear();
+
+		if (a_sourceSize == 0) {
+			std::ranges::fill(a_outTaps, Taps{ 0, 0, 0 });
+			return;
+		}
+
+		// Footprint of an output pixel in source pixels, when upscaling it's still one source pixel wide so it ends up as a linear filter
+		const double scale = static_cast<double>(a_sourceSize) / static_cast<double>(std::max<std::size_t>(a_size, 1));
+		const double radius = a_filter == Filter::kBox ? std::max(scale, 1.0) * 0.5 : std::max(scale, 1.0);
+
+		for (std::size_t i = 0; i < a_size; ++i) {
+			const double center = (static_cast<double>(i) + 0.5) * scale;
+			const auto   first = static_cast<std::size_t>(std::clamp(std::floor(center - radius), 0.0, static_cast<double>(a_sourceSize - 1)));
+			const auto   last = static_cast<std::size_t>(std::clamp(std::ceil(center + radius), 1.0, static_cast<double>(a_sourceSize)));
+
+			auto& taps = a_outTaps[i];
+			taps.first = first;
+			taps.count = 0;
+			taps.weightOffset = a_outWeights.size();
+
+			double totalWeight = 0.0;
+			for (std::size_t p = first; p < last; ++p) {
+				double weight;
+				if (a_filter == Filter::kBox) {
+					// Overlap of the source pixel [p, p + 1] with the footprint
+					weight = std::max(std::min(static_cast<double>(p + 1), center + radius) - std::max(static_cast<double>(p), center - radius), 0.0);
+				} else {
+					weight = std::max(1.0 - std::abs(static_cast<double>(p) + 0.5 - center) / radius, 0.0);
+				}
+				a_outWeights.push_back(static_cast<float>(weight));
+				totalWeight += weight;
+				++taps.count;
+			}
+
+			// Trim zero weights at the ends, so rows are only waited on and read when they matter
+			while (taps.count > 1 && a_outWeights[taps.weightOffset + taps.count - 1] == 0.f) {
+				a_outWeights.pop_back();
+				--taps.count;
+			}
+			while (taps.count > 1 && a_outWeights[taps.weightOffset] == 0.f) {
+				a_outWeights.erase(a_outWeights.begin() + static_cast<std::ptrdiff_t>(taps.weightOffset));
+				++taps.first;
+				--taps.count;
+			}
+
+			const float normalization = totalWeight > 0.0 ? static_cast<float>(1.0 / totalWeight) : 1.f;
+			for (std::size_t k = 0; k < taps.count; ++k) {
+				a_outWeights[taps.weightOffset + k] *= normalization;
+			}
+		}
+	}
+
+	// Horizontal pass of "Downsampler": one output pixel per iteration, its taps two at a time in the halves of a YMM register
+	SCREENSHOT_TARGET_AVX2 void FilterRow_AVX2(DirectX::XMVECTOR* a_outPixels, const DirectX::XMVECTOR* a_row, const Downsampler::Taps* a_taps, const float* a_weights, std::size_t a_width)
+	{
+		for (std::size_t x = 0; x < a_width; ++x) {
+			const auto&              taps = a_taps[x];
+			const float*             weights = a_weights + taps.weightOffset;
+			const DirectX::XMVECTOR* source = a_row + taps.first;
+			__m256                   sum = _mm256_setzero_ps();
+			std::size_t              k = 0;
+			for (; k + 2 <= taps.count; k += 2) {
+				const __m256 weight = _mm256_set_m128(_mm_set1_ps(weights[k + 1]), _mm_set1_ps(weights[k]));
+				sum = _mm256_add_ps(_mm256_mul_ps(weight, _mm256_loadu_ps(reinterpret_cast<const float*>(source + k))), sum);
+			}
+			__m128 result = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+			if (k < taps.count) {
+				result = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(weights[k]), source[k]), result);
+			}
+			a_outPixels[x] = result;
+		}
+	}
+
+	// Vertical pass of "Downsampler", two pixels per iteration
+	SCREENSHOT_TARGET_AVX2 void AccumulateRow_AVX2(DirectX::XMVECTOR* a_outPixels, const DirectX::XMVECTOR* a_row, float a_weight, std::size_t a_width)
+	{
+		const __m256 weight = _mm256_set1_ps(a_weight);
+		auto         out = reinterpret_cast<float*>(a_outPixels);
+		auto         in = reinterpret_cast<const float*>(a_row);
+		std::size_t  x = 0;
+		for (; x + 2 <= a_width; x += 2) {
+			_mm256_storeu_ps(out + x * 4, _mm256_add_ps(_mm256_mul_ps(weight, _mm256_loadu_ps(in + x * 4)), _mm256_loadu_ps(out + x * 4)));
+		}
+		if (x < a_width) {
+			a_outPixels[x] = _mm_add_ps(_mm_mul_ps(_mm256_castps256_ps128(weight), a_row[x]), a_outPixels[x]);
+		}
+	}
+
+	void Downsampler::AddRow(const DirectX::XMVECTOR* a_row)
+	{
+		if (sourceY >= sourceHeight) {
+			return;
+		}
+
+		while (firstOpenRow < height && rowTaps[firstOpenRow].first + rowTaps[firstOpenRow].count <= sourceY) {
+			++firstOpenRow;
+		}
+
+		static const bool hasAVX2 = HasAVX2();
+
+		bool bFiltered = false;
+		for (std::size_t y = firstOpenRow; y < height && rowTaps[y].first <= sourceY; ++y) {
+			// Horizontal pass, only done for rows inside the crop
+			if (!bFiltered) {
+				if (hasAVX2) {
+					FilterRow_AVX2(filteredRow.data(), a_row, columnTaps.data(), columnWeights.data(), width);
+				} else {
+					for (std::size_t x = 0; x < width; ++x) {
+						const auto&              taps = columnTaps[x];
+						const float*             weights = columnWeights.data() + taps.weightOffset;
+						const DirectX::XMVECTOR* source = a_row + taps.first;
+						DirectX::XMVECTOR        sum = DirectX::g_XMZero;
+						for (std::size_t k = 0; k < taps.count; ++k) {
+							sum = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorReplicate(weights[k]), source[k], sum);
+						}
+						filteredRow[x] = sum;
+					}
+				}
+				bFiltered = true;
+			}
+
+			// Vertical pass, accumulated into every output row this source row contributes to
+			const float        weight = rowWeights[rowTaps[y].weightOffset + (sourceY - rowTaps[y].first)];
+			DirectX::XMVECTOR* output = pixels.data() + y * width;
+			if (hasAVX2) {
+				AccumulateRow_AVX2(output, filteredRow.data(), weight, width);
+			} else {
+				const DirectX::XMVECTOR weights = DirectX::XMVectorReplicate(weight);
+				for (std::size_t x = 0; x < width; ++x) {
+					output[x] = DirectX::XMVectorMultiplyAdd(weights, filteredRow[x], output[x]);
+				}
+			}
+		}
+
+		++sourceY;
+	}
+
+	void StoreRowBGRA8(std::uint8_t* a_outRow, const DirectX::XMVECTOR* a_pixels, std::size_t a_width)
+	{
+		auto output = reinterpret_cast<DirectX::PackedVector::XMCOLOR*>(a_outRow);
+		for (std::size_t x = 0; x < a_width; ++x) {
+			DirectX::PackedVector::XMStoreColor(&output[x], a_pixels[x]);
+		}
+	}
+
+	void ConvertToBGRA8(const Image& a_image, std::uint8_t* a_outPixels, std::size_t a_outRowPitch, Downsampler* a_thumbnail)
+	{
+		PixelBuffer row(a_image.width);
+
+		for (std::size_t y = 0; y < a_image.height; ++y) {
+			DecodeRow(row.data(), a_image.pixels + y * a_image.rowPitch, a_image.width, a_image.format);
+			StoreRowBGRA8(a_outPixels + y * a_outRowPitch, row.data(), a_image.width);
+			if (a_thumbnail) {
+				a_thumbnail->AddRow(row.data());
+			}
+		}
+	}
+
+	bool WriteRaw(const Image& a_image, const RawMetadata& a_metadata, stbi_write_func* a_func, void* a_context)
+	{
+		const std::size_t bytesPerPixel = GetBytesPerPixel(a_image.format);
+		if (!bytesPerPixel || !a_image.pixels) {
+			return false;
+		}
+
+		RawHeader header = {};
+		std::memcpy(header.magic, RawHeader::kMagic, sizeof(header.magic));
+		header.version = RawHeader::kVersion;
+		header.headerSize = sizeof(RawHeader);
+		header.width = static_cast<std::uint32_t>(a_image.width);
+		header.height = static_cast<std::uint32_t>(a_image.height);
+		header.format = a_image.format;
+		header.bytesPerPixel = static_cast<std::uint32_t>(bytesPerPixel);
+		header.timestamp = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+		header.peakBrightness = a_metadata.peakBrightness;
+		header.gamePaperWhite = a_metadata.gamePaperWhite;
+		header.uiPaperWhite = a_metadata.uiPaperWhite;
+
+		a_func(a_context, &header, sizeof(header));
+
+		// Rows are written one by one to drop the GPU's row pitch padding
+		const int rowSize = static_cast<int>(a_image.width * bytesPerPixel);
+		for (std::size_t y = 0; y < a_image.height; ++y) {
+			a_func(a_context, const_cast<std::uint8_t*>(a_image.pixels + y * a_image.rowPitch), rowSize);
+		}
+
+		return true;
+	}
+
+	bool ParseRaw(const std::uint8_t* a_data, std::size_t a_size, RawHeader& a_outHeader, Image& a_outImage)
+	{
+		if (a_size < sizeof(RawHeader)) {
+			return false;
+		}
+
+		std::memcpy(&a_outHeader, a_data, sizeof(RawHeader));
+		if (std::memcmp(a_outHeader.magic, RawHeader::kMagic, sizeof(RawHeader::kMagic)) != 0 || a_outHeader.version < 1 || a_outHeader.headerSize < sizeof(RawHeader)) {
+			return false;
+		}
+
+		const std::size_t bytesPerPixel = GetBytesPerPixel(a_outHeader.format);
+		if (!bytesPerPixel || bytesPerPixel != a_outHeader.bytesPerPixel) {
+			return false;
+		}
+
+		const std::size_t rowPitch = static_cast<std::size_t>(a_outHeader.width) * bytesPerPixel;
+		if (a_size < a_outHeader.headerSize || (a_size - a_outHeader.headerSize) / std::max<std::size_t>(rowPitch, 1) < a_outHeader.height) {
+			return false;
+		}
+
+		a_outImage.pixels = a_data + a_outHeader.headerSize;
+		a_outImage.width = a_outHeader.width;
+		a_outImage.height = a_outHeader.height;
+		a_outImage.rowPitch = rowPitch;
+		a_outImage.format = a_outHeader.format;
+		return true;
+	}
+
+	bool WriteLinearEXR(const Image& a_image, stbi_write_func* a_func, void* a_context)
+	{
+		if (!GetBytesPerPixel(a_image.format) || !a_image.pixels || !a_image.width || !a_image.height) {
+			return false;
+		}
+
+		// Everything in an EXR is little endian, like the platforms we run on
+		const bool         bFloat = a_image.format == PixelFormat::kR32G32B32A32_FLOAT;
+		const std::int32_t pixelType = bFloat ? 2 : 1;  // FLOAT or HALF
+		const std::size_t  channelSize = bFloat ? sizeof(float) : sizeof(std::uint16_t);
+		const std::int32_t maxX = static_cast<std::int32_t>(a_image.width - 1);
+		const std::int32_t maxY = static_cast<std::int32_t>(a_image.height - 1);
+
+		std::vector<std::uint8_t> header;
+		const auto put = [&](const void* a_data, std::size_t a_size) {
+			const auto bytes = static_cast<const std::uint8_t*>(a_data);
+			header.insert(header.end(), bytes, bytes + a_size);
+		};
+		const auto putAttribute = [&](const char* a_name, const char* a_type, const void* a_value, std::int32_t a_size) {
+			put(a_name, std::strlen(a_name) + 1);
+			put(a_type, std::strlen(a_type) + 1);
+			put(&a_size, sizeof(a_size));
+			put(a_value, a_size);
+		};
+
+		constexpr std::uint8_t magicAndVersion[8] = { 0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0 };  // single part scanline image
+		put(magicAndVersion, sizeof(magicAndVersion));
+
+		// Channels have to be sorted by name
+		std::vector<std::uint8_t> channels;
+		for (const char* name : { "B", "G", "R" }) {
+			const std::int32_t sampling[2] = { 1, 1 };
+			const std::uint8_t linearAndReserved[4] = {};
+			channels.push_back(static_cast<std::uint8_t>(name[0]));
+			channels.push_back(0);
+			channels.insert(channels.end(), reinterpret_cast<const std::uint8_t*>(&pixelType), reinterpret_cast<const std::uint8_t*>(&pixelType) + sizeof(pixelType));
+			channels.insert(channels.end(), linearAndReserved, linearAndReserved + sizeof(linearAndReserved));
+			channels.insert(channels.end(), reinterpret_cast<const std::uint8_t*>(sampling), reinterpret_cast<const std::uint8_t*>(sampling) + sizeof(sampling));
+		}
+		channels.push_back(0);
+
+		const std::uint8_t compression = 0;  // none
+		const std::uint8_t lineOrder = 0;    // increasing Y
+		const std::int32_t window[4] = { 0, 0, maxX, maxY };
+		const float        chromaticities[8] = { 0.64f, 0.33f, 0.30f, 0.60f, 0.15f, 0.06f, 0.3127f, 0.3290f };  // BT.709 primaries and D65
+		const float        pixelAspectRatio = 1.f;
+		const float        screenWindowCenter[2] = { 0.f, 0.f };
+		const float        screenWindowWidth = 1.f;
+		putAttribute("channels", "chlist", channels.data(), static_cast<std::int32_t>(channels.size()));
+		putAttribute("chromaticities", "chromaticities", chromaticities, sizeof(chromaticities));
+		putAttribute("compression", "compression", &compression, sizeof(compression));
+		putAttribute("dataWindow", "box2i", window, sizeof(window));
+		putAttribute("displayWindow", "box2i", window, sizeof(window));
+		putAttribute("lineOrder", "lineOrder", &lineOrder, sizeof(lineOrder));
+		putAttribute("pixelAspectRatio", "float", &pixelAspectRatio, sizeof(pixelAspectRatio));
+		putAttribute("screenWindowCenter", "v2f", screenWindowCenter, sizeof(screenWindowCenter));
+		putAttribute("screenWindowWidth", "float", &screenWindowWidth, sizeof(screenWindowWidth));
+		header.push_back(0);
+
+		// Each line is its y and data size followed by all the B values of the row, then G, then R
+		const std::size_t planeSize = a_image.width * channelSize;
+		const std::size_t lineSize = 2 * sizeof(std::int32_t) + 3 * planeSize;
+		std::vector<std::uint64_t> offsets(a_image.height);
+		for (std::size_t y = 0; y < a_image.height; ++y) {
+			offsets[y] = header.size() + offsets.size() * sizeof(std::uint64_t) + y * lineSize;
+		}
+		a_func(a_context, header.data(), static_cast<int>(header.size()));
+		a_func(a_context, offsets.data(), static_cast<int>(offsets.size() * sizeof(std::uint64_t)));
+
+		std::vector<std::uint8_t>       line(lineSize);
+		PixelBuffer decodedRow(a_image.format == PixelFormat::kR10G10B10A2_UNORM ? a_image.width : 0);
+		const std::int32_t              dataSize = static_cast<std::int32_t>(3 * planeSize);
+		std::memcpy(line.data() + sizeof(std::int32_t), &dataSize, sizeof(dataSize));
+
+		// Splits the RGBA pixels of a float row into the line's planes, bits untouched
+		const auto deinterleave = [&]<typename T>(const T* a_pixels) {
+			for (std::size_t plane = 0; plane < 3; ++plane) {
+				const auto        out = reinterpret_cast<T*>(line.data() + 2 * sizeof(std::int32_t) + plane * planeSize);
+				const std::size_t channel = 2 - plane;
+				for (std::size_t x = 0; x < a_image.width; ++x) {
+					out[x] = a_pixels[x * 4 + channel];
+				}
+			}
+		};
+
+		for (std::size_t y = 0; y < a_image.height; ++y) {
+			const std::int32_t lineY = static_cast<std::int32_t>(y);
+			std::memcpy(line.data(), &lineY, sizeof(lineY));
+
+			const std::uint8_t* row = a_image.pixels + y * a_image.rowPitch;
+			switch (a_image.format) {
+			case PixelFormat::kR16G16B16A16_FLOAT:
+				deinterleave(reinterpret_cast<const std::uint16_t*>(row));
+				break;
+			case PixelFormat::kR32G32B32A32_FLOAT:
+				deinterleave(reinterpret_cast<const std::uint32_t*>(row));
+				break;
+			case PixelFormat::kR10G10B10A2_UNORM:
+				{
+					DecodeRow(decodedRow.data(), row, a_image.width, a_image.format);
+					const auto values = reinterpret_cast<const float*>(decodedRow.data());
+					for (std::size_t plane = 0; plane < 3; ++plane) {
+						const auto out = reinterpret_cast<DirectX::PackedVector::HALF*>(line.data() + 2 * sizeof(std::int32_t) + plane * planeSize);
+						DirectX::PackedVector::XMConvertFloatToHalfStream(out, sizeof(DirectX::PackedVector::HALF), values + (2 - plane), sizeof(DirectX::XMVECTOR), a_image.width);
+					}
+					break;
+				}
+			}
+
+			a_func(a_context, line.data(), static_cast<int>(line.size()));
+		}
+
+		return true;
+	}
+
+	WorkerPool::WorkerPool(std::size_t a_threadCount, std::size_t a_queueCapacity) :
+		queueCapacity(std::max<std::size_t>(a_queueCapacity, 1))
+	{
+		a_threadCount = std::max<std::size_t>(a_threadCount, 1);
+		workers.reserve(a_threadCount);
+		for (std::size_t i = 0; i < a_threadCount; ++i) {
+			workers.emplace_back(&WorkerPool::WorkerMain, this);
+		}
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		Shutdown();
+	}
+
+	bool WorkerPool::TryEnqueue(Job a_job)
+	{
+		{
+			std::scoped_lock lock(mutex);
+			if (bShuttingDown || queue.size() >= queueCapacity) {
+				++rejectedJobs;
+				return false;
+			}
+			queue.push_back({ std::move(a_job), std::chrono::steady_clock::now() });
+			peakQueueDepth = std::max(peakQueueDepth, queue.size());
+		}
+		condition.notify_one();
+		return true;
+	}
+
+	void WorkerPool::Shutdown()
+	{
+		{
+			std::scoped_lock lock(mutex);
+			bShuttingDown = true;
+		}
+		condition.notify_all();
+
+		for (auto& worker : workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+	}
+
+	WorkerPool::Stats WorkerPool::GetStats() const
+	{
+		std::scoped_lock lock(mutex);
+		return Stats{
+			queue.size(),
+			peakQueueDepth,
+			runningJobs,
+			completedJobs,
+			rejectedJobs,
+			lastLatencyMs,
+			completedJobs ? totalLatencyMs / static_cast<double>(completedJobs) : 0.0,
+			maxLatencyMs
+		};
+	}
+
+	void WorkerPool::WorkerMain()
+	{
+		// Encoding is heavy but never urgent, the game's render and job threads must always win
+#ifdef _WIN32
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+		std::ignore = setpriority(PRIO_PROCESS, 0, 10);  // per thread on Linux
+#endif
+
+		std::unique_lock lock(mutex);
+		while (true) {
+			condition.wait(lock, [this] { return bShuttingDown || !queue.empty(); });
+			// Queued jobs are drained before exiting, each of them owns a GPU resource that only the job releases
+			if (queue.empty()) {
+				return;
+			}
+
+			QueuedJob queuedJob = std::move(queue.front());
+			queue.pop_front();
+			++runningJobs;
+			lock.unlock();
+
+			queuedJob.job();
+			const double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queuedJob.enqueueTime).count();
+
+			lock.lock();
+			--runningJobs;
+			++completedJobs;
+			lastLatencyMs = latencyMs;
+			totalLatencyMs += latencyMs;
+			maxLatencyMs = std::max(maxLatencyMs, latencyMs);
+		}
+	}
+
+	ReadbackPool::ReadbackPool(ReadbackDevice& a_device, std::uint64_t a_maxIdleFrames, std::size_t a_maxIdleBuffers, std::size_t a_budgetBytes) :
+		device(a_device),
+		maxIdleFrames(a_maxIdleFrames),
+		maxIdleBuffers(a_maxIdleBuffers),
+		budgetBytes(a_budgetBytes)
+	{}
+
+	ReadbackPool::~ReadbackPool()
+	{
+		std::scoped_lock lock(mutex);
+		while (!buffers.empty()) {
+			FreeBuffer(buffers.size() - 1);
+		}
+	}
+
+	ReadbackPool::Buffer* ReadbackPool::Acquire(const ReadbackKey& a_key, std::uint64_t a_frameIndex)
+	{
+		std::scoped_lock lock(mutex);
+		currentFrame = a_frameIndex;
+
+		for (const auto& buffer : buffers) {
+			if (!buffer->bInUse && buffer->key == a_key) {
+				buffer->bInUse = true;
+				buffer->lastUsedFrame = a_frameIndex;
+				return buffer.get();
+			}
+		}
+
+		const std::size_t size = device.GetAllocationSize(a_key);
+		for (std::size_t i = 0; i < buffers.size() && allocatedBytes + size > budgetBytes;) {
+			if (!buffers[i]->bInUse) {
+				FreeBuffer(i);
+			} else {
+				++i;
+			}
+		}
+		if (allocatedBytes + size > budgetBytes) {
+			return nullptr;
+		}
+
+		auto buffer = std::make_unique<Buffer>();
+		if (!device.Allocate(a_key, buffer->allocation)) {
+			return nullptr;
+		}
+		allocatedBytes += buffer->allocation.size;
+		buffer->key = a_key;
+		buffer->lastUsedFrame = a_frameIndex;
+		buffer->bInUse = true;
+		return buffers.emplace_back(std::move(buffer)).get();
+	}
+
+	void ReadbackPool::Release(Buffer* a_buffer)
+	{
+		if (!a_buffer) {
+			return;
+		}
+
+		std::scoped_lock lock(mutex);
+		a_buffer->bInUse = false;
+		// The idle time starts now, not when the capture was made
+		a_buffer->lastUsedFrame = currentFrame;
+	}
+
+	void ReadbackPool::Trim(std::uint64_t a_frameIndex)
+	{
+		std::scoped_lock lock(mutex);
+		currentFrame = a_frameIndex;
+
+		// Newest buffers are at the back, walking backwards keeps the most recently allocated idle ones when over the limit
+		std::size_t idleBuffers = 0;
+		for (std::size_t i = buffers.size(); i-- > 0;) {
+			const auto& buffer = buffers[i];
+			if (buffer->bInUse) {
+				continue;
+			}
+			if (a_frameIndex - buffer->lastUsedFrame > maxIdleFrames || idleBuffers >= maxIdleBuffers) {
+				FreeBuffer(i);
+			} else {
+				++idleBuffers;
+			}
+		}
+	}
+
+	std::size_t ReadbackPool::GetBufferCount() const
+	{
+		std::scoped_lock lock(mutex);
+		return buffers.size();
+	}
+
+	std::size_t ReadbackPool::GetIdleBufferCount() const
+	{
+		std::scoped_lock lock(mutex);
+		return static_cast<std::size_t>(std::ranges::count_if(buffers, [](const auto& a_buffer) { return !a_buffer->bInUse; }));
+	}
+
+	std::size_t ReadbackPool::GetAllocatedBytes() const
+	{
+		std::scoped_lock lock(mutex);
+		return allocatedBytes;
+	}
+
+	void ReadbackPool::FreeBuffer(std::size_t a_index)
+	{
+		allocatedBytes -= buffers[a_index]->allocation.size;
+		device.Free(buffers[a_index]->allocation);
+		buffers.erase(buffers.begin() + static_cast<std::ptrdiff_t>(a_index));
+	}
+
+	double SteadyCompletionClock::NowMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	CompletionTracker::CompletionTracker(CompletionFence& a_fence, CompletionClock& a_clock) :
+		fence(a_fence),
+		clock(a_clock)
+	{}
+
+	std::uint64_t CompletionTracker::Signal()
+	{
+		if (!fence.Signal(lastSignalledValue + 1)) {
+			return 0;
+		}
+
+		lastSignalTimeMs = clock.NowMs();
+		return ++lastSignalledValue;
+	}
+
+	void CompletionTracker::Add(std::uint64_t a_fenceValue, Callback a_callback)
+	{
+		// Only the latest signal time is kept, which is the one that matters as callbacks are added right after signalling
+		pending.push(Entry{ a_fenceValue, addedCount++, a_fenceValue == lastSignalledValue ? lastSignalTimeMs : clock.NowMs(), std::move(a_callback) });
+	}
+
+	std::size_t CompletionTracker::Poll()
+	{
+		if (pending.empty()) {
+			return 0;
+		}
+
+		const std::uint64_t completedValue = fence.GetCompletedValue();
+		const double        nowMs = clock.NowMs();
+		std::size_t         completed = 0;
+
+		while (!pending.empty() && pending.top().fenceValue <= completedValue) {
+			// The heap only gives const access to the top, the entry is moved out right before it's popped
+			Entry entry = std::move(const_cast<Entry&>(pending.top()));
+			pending.pop();
+
+			lastCompletionMs = nowMs - entry.signalTimeMs;
+			entry.callback();
+			++completed;
+		}
+
+		return completed;
+	}
+}
@@ -0,0 +1,420 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include <stb_image_write.h>
+
+// Screenshot encoding and scheduling, independent of D3D12 and the game so it can be fed synthetic frames and mock jobs
+namespace Screenshot
+{
+	// Stored in raw captures, don't reorder
+	enum class PixelFormat : std::uint32_t
+	{
+		kR16G16B16A16_FLOAT = 0,
+		kR32G32B32A32_FLOAT = 1,
+		kR10G10B10A2_UNORM = 2
+	};
+
+	constexpr std::size_t GetBytesPerPixel(PixelFormat a_format)
+	{
+		switch (a_format) {
+		case PixelFormat::kR16G16B16A16_FLOAT:
+			return 8;
+		case PixelFormat::kR32G32B32A32_FLOAT:
+			return 16;
+		case PixelFormat::kR10G10B10A2_UNORM:
+			return 4;
+		}
+		return 0;
+	}
+
+	// A mapped, CPU readable frame. Rows are "rowPitch" bytes apart.
+	struct Image
+	{
+		const std::uint8_t* pixels = nullptr;
+		std::size_t width = 0;
+		std::size_t height = 0;
+		std::size_t rowPitch = 0;
+		PixelFormat format = PixelFormat::kR16G16B16A16_FLOAT;
+	};
+
+	// Heap array of pixels for the row functions below. It stores "XMFLOAT4A" (the same size and alignment) because
+	// "std::vector<DirectX::XMVECTOR>" drops the attributes of the vector type from the template argument, which GCC warns about.
+	class PixelBuffer
+	{
+	public:
+		PixelBuffer() = default;
+		explicit PixelBuffer(std::size_t a_size) : values(a_size, DirectX::XMFLOAT4A(0.f, 0.f, 0.f, 0.f)) {}
+
+		DirectX::XMVECTOR*       data() { return reinterpret_cast<DirectX::XMVECTOR*>(values.data()); }
+		const DirectX::XMVECTOR* data() const { return reinterpret_cast<const DirectX::XMVECTOR*>(values.data()); }
+		std::size_t              size() const { return values.size(); }
+
+		DirectX::XMVECTOR&       operator[](std::size_t a_index) { return data()[a_index]; }
+		const DirectX::XMVECTOR& operator[](std::size_t a_index) const { return data()[a_index]; }
+
+	private:
+		std::vector<DirectX::XMFLOAT4A> values;
+	};
+
+	// Batch unpacks behind DecodeRow. They use AVX2/F16C kernels when the CPU supports them and DirectXMath's per-element conversions otherwise.
+	bool HasAVX2();
+	void ConvertHalfToFloat(float* a_out, const std::uint16_t* a_in, std::size_t a_count);
+	void UnpackR10G10B10A2(DirectX::XMVECTOR* a_outPixels, const std::uint32_t* a_in, std::size_t a_count);
+
+	// Unpacks one row of "a_width" pixels to floats
+	void DecodeRow(DirectX::XMVECTOR* a_outPixels, const std::uint8_t* a_row, std::size_t a_width, PixelFormat a_format);
+
+	// Content light level of a frame in nits, as defined by CTA-861.3 for HDR10 metadata, and a histogram of its luminance.
+	// Every encode fills its own, so threads encoding different frames never share one.
+	struct LightLevelStats
+	{
+		// Bins are spread evenly in log2(nits) over [2^-10, 2^14), darker and brighter pixels are counted in the first and last one
+		static constexpr std::size_t kHistogramBins = 96;
+		static constexpr float       kHistogramMinLog2 = -10.f;
+		static constexpr float       kHistogramMaxLog2 = 14.f;
+
+		float                                     maxCLL = 0.f;           // brightest color component of any pixel
+		double                                    sumMaxComponent = 0.0;  // of every pixel, for MaxFALL
+		std::uint64_t                             pixelCount = 0;
+		std::array<std::uint64_t, kHistogramBins> histogram = {};         // of BT.2020 luminance
+
+		float GetMaxFALL() const { return pixelCount ? static_cast<float>(sumMaxComponent / static_cast<double>(pixelCount)) : 0.f; }
+	};
+
+	// JSON summary of the stats, saved next to HDR screenshots
+	std::string FormatLightLevelStats(const LightLevelStats& a_stats);
+
+	// scRGB (BT.709, 1 = 80 nits) to BT.2020 + PQ, can be done in place. The light level of the pixels is added to "a_stats" (optional) on the way.
+	void TransformColor_HDR10(DirectX::XMVECTOR* a_outPixels, const DirectX::XMVECTOR* a_inPixels, std::size_t a_width, LightLevelStats* a_stats);
+
+	// Rounds a 16 bit value to the nearest 10 bit one and expands it back to 16 bits by replicating the top bits,
+	// so PNG readers that ignore sBIT still get the full range
+	constexpr std::uint16_t QuantizeTo10Bit(std::uint16_t a_value)
+	{
+		const std::uint32_t value10Bit = (static_cast<std::uint32_t>(a_value) * 1023u + 32767u) / 65535u;
+		return static_cast<std::uint16_t>((value10Bit << 6u) | (value10Bit >> 4u));
+	}
+
+	// Speed/size tradeoff of HDR PNGs. Stored in the settings, don't reorder.
+	enum class Compression : std::uint32_t
+	{
+		kFastest = 0,   // "Up" filter on every row, lowest deflate effort
+		kBalanced = 1,  // filter of each row estimated from a sample of it
+		kSmallest = 2   // every filter tried on every row, higher deflate effort
+	};
+
+	// Encodes a scRGB frame to a 10 bit HDR10 PNG in a single pass: every row is decoded, converted, quantized and handed to
+	// the PNG writer before the next one is touched, so only a couple of rows and the compressed stream are ever held in memory.
+	// The content light level is measured along the way and stored in the PNG, and in "a_outStats" if there's one.
+	// The PNG needs it before the image data, which is streamed out as it's compressed, so without "a_patch" it's left out of big images.
+	// "a_patch" overwrites bytes already written at an offset, like "stbi_write_hdr_png_patch_func" (the stb header can't be included here).
+	// "a_stripes" is how many stripes are deflated concurrently, as in "stbi_write_hdr_png_begin" (0 is one per hardware thread).
+	using PatchFunc = void(void* a_context, long long a_offset, const void* a_data, int a_size);
+	bool WriteHDR10PNG(const Image& a_image, Compression a_compression, stbi_write_func* a_func, PatchFunc* a_patch, void* a_context, LightLevelStats* a_outStats = nullptr, int a_stripes = 0);
+
+	// Separable box or tent filter that shrinks a frame fed to it one row at a time, top to bottom, so a thumbnail can be built
+	// from the rows already decoded for the full size image instead of going over the frame a second time.
+	// Sources with a different aspect ratio than the output are center-cropped rather than stretched. An empty source leaves the output black.
+	// Both passes use AVX2 kernels when the CPU supports them, see "HasAVX2()".
+	class Downsampler
+	{
+	public:
+		enum class Filter
+		{
+			kBox,   // area average of the footprint of each output pixel
+			kTent   // triangle over twice the footprint, a little softer but with less aliasing
+		};
+
+		Downsampler(std::size_t a_sourceWidth, std::size_t a_sourceHeight, std::size_t a_width, std::size_t a_height, Filter a_filter);
+
+		// "a_row" is "a_sourceWidth" pixels wide. Extra rows past the source height are ignored.
+		void AddRow(const DirectX::XMVECTOR* a_row);
+
+		// Complete once every source row has been added
+		const DirectX::XMVECTOR* GetPixels() const { return pixels.data(); }
+		std::size_t              GetWidth() const { return width; }
+		std::size_t              GetHeight() const { return height; }
+
+		// The source pixels [first, first + count) contributing to one output pixel, their weights start at "weights[weightOffset]"
+		struct Taps
+		{
+			std::size_t first;
+			std::size_t count;
+			std::size_t weightOffset;
+		};
+
+	private:
+		static void ComputeTaps(std::size_t a_sourceSize, std::size_t a_size, Filter a_filter, std::vector<Taps>& a_outTaps, std::vector<float>& a_outWeights);
+
+		const std::size_t  width;
+		const std::size_t  height;
+		const std::size_t  sourceHeight;
+		std::size_t        sourceY = 0;
+		std::size_t        firstOpenRow = 0;  // output rows before this one have all their source rows
+		std::vector<Taps>  columnTaps;
+		std::vector<float> columnWeights;
+		std::vector<Taps>  rowTaps;
+		std::vector<float> rowWeights;
+		PixelBuffer        filteredRow;
+		PixelBuffer        pixels;
+	};
+
+	// Stores "a_width" pixels as 8 bit BGRA (rounded and saturated, no color conversion)
+	void StoreRowBGRA8(std::uint8_t* a_outRow, const DirectX::XMVECTOR* a_pixels, std::size_t a_width);
+
+	// Converts an SDR frame to 8 bit BGRA for encoding, feeding every decoded row to "a_thumbnail" (optional) along the way
+	void ConvertToBGRA8(const Image& a_image, std::uint8_t* a_outPixels, std::size_t a_outRowPitch, Downsampler* a_thumbnail);
+
+	// Lossless capture container (".lumaraw"): this header followed by "height" rows of "width * bytesPerPixel" bytes, top to bottom,
+	// exactly as the GPU wrote them. Everything is little endian. Writing one costs little more than a memcpy of the frame,
+	// converting it to something viewable is left to Plugin/tools/RawConverter.
+	struct RawHeader
+	{
+		static constexpr char          kMagic[8] = { 'L', 'U', 'M', 'A', 'R', 'A', 'W', '\0' };
+		static constexpr std::uint32_t kVersion = 1;
+
+		char          magic[8];
+		std::uint32_t version;
+		std::uint32_t headerSize;  // the pixels start here, later versions may append fields
+		std::uint32_t width;
+		std::uint32_t height;
+		PixelFormat   format;
+		std::uint32_t bytesPerPixel;
+		std::uint64_t timestamp;  // seconds since the Unix epoch
+		// Luma's HDR settings when the capture was made, in nits
+		float         peakBrightness;
+		float         gamePaperWhite;
+		float         uiPaperWhite;
+		std::uint8_t  reserved[12];
+	};
+	static_assert(sizeof(RawHeader) == 64);
+
+	struct RawMetadata
+	{
+		float peakBrightness = 0.f;
+		float gamePaperWhite = 0.f;
+		float uiPaperWhite = 0.f;
+	};
+
+	bool WriteRaw(const Image& a_image, const RawMetadata& a_metadata, stbi_write_func* a_func, void* a_context);
+
+	// Validates a raw capture loaded in memory, "a_outImage" points into "a_data"
+	bool ParseRaw(const std::uint8_t* a_data, std::size_t a_size, RawHeader& a_outHeader, Image& a_outImage);
+
+	// Writes the frame's values, untouched, as an uncompressed scanline OpenEXR with B, G and R channels and BT.709 chromaticities (scRGB).
+	// Half float frames keep their exact bits and 32 bit float frames are written as FLOAT channels, 10 bit frames are written as halfs of their normalized values.
+	// Uncompressed EXRs have a fixed size per row, so the whole line offset table is known upfront and rows are streamed through a single row buffer.
+	bool WriteLinearEXR(const Image& a_image, stbi_write_func* a_func, void* a_context);
+
+	// Fixed set of low priority threads that run screenshot jobs off the render thread.
+	// The queue is bounded so a burst of photos can't pile up unbounded memory, callers are expected to retry later when it's full.
+	class WorkerPool
+	{
+	public:
+		using Job = std::function<void()>;
+
+		struct Stats
+		{
+			std::size_t   queueDepth;       // jobs waiting for a worker
+			std::size_t   peakQueueDepth;
+			std::size_t   runningJobs;
+			std::uint64_t completedJobs;
+			std::uint64_t rejectedJobs;     // TryEnqueue() calls that found the queue full or the pool shut down
+			double        lastLatencyMs;    // from TryEnqueue() to the job returning
+			double        averageLatencyMs;
+			double        maxLatencyMs;
+		};
+
+		WorkerPool(std::size_t a_threadCount, std::size_t a_queueCapacity);
+		~WorkerPool();
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		// Returns false without taking the job if the queue is full or the pool is shutting down
+		bool TryEnqueue(Job a_job);
+
+		// Stops accepting jobs, waits for everything already queued to finish and joins the workers. Safe to call more than once.
+		void Shutdown();
+
+		Stats GetStats() const;
+
+	private:
+		struct QueuedJob
+		{
+			Job                                   job;
+			std::chrono::steady_clock::time_point enqueueTime;
+		};
+
+		void WorkerMain();
+
+		const std::size_t        queueCapacity;
+		std::vector<std::thread> workers;
+		std::deque<QueuedJob>    queue;
+		mutable std::mutex       mutex;
+		std::condition_variable  condition;
+		bool                     bShuttingDown = false;
+
+		std::size_t   peakQueueDepth = 0;
+		std::size_t   runningJobs = 0;
+		std::uint64_t completedJobs = 0;
+		std::uint64_t rejectedJobs = 0;
+		double        lastLatencyMs = 0.0;
+		double        totalLatencyMs = 0.0;
+		double        maxLatencyMs = 0.0;
+	};
+
+	// Identifies interchangeable readback buffers. "format" is a DXGI_FORMAT, kept as an integer so this compiles without D3D headers.
+	struct ReadbackKey
+	{
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+		std::uint32_t format = 0;
+
+		bool operator==(const ReadbackKey&) const = default;
+	};
+
+	// CPU visible memory a frame can be copied into. "resource" is owned by the device that made it.
+	struct ReadbackAllocation
+	{
+		void*         resource = nullptr;
+		std::uint8_t* mapped = nullptr;  // stays mapped for the whole lifetime of the allocation
+		std::size_t   rowPitch = 0;
+		std::size_t   size = 0;
+	};
+
+	// What the pool needs from the graphics API, so it can be driven by a fake device
+	class ReadbackDevice
+	{
+	public:
+		virtual ~ReadbackDevice() = default;
+
+		virtual std::size_t GetAllocationSize(const ReadbackKey& a_key) = 0;
+		virtual bool        Allocate(const ReadbackKey& a_key, ReadbackAllocation& a_outAllocation) = 0;
+		virtual void        Free(const ReadbackAllocation& a_allocation) = 0;
+	};
+
+	// Recycles readback buffers between captures, so repeated photos at the same resolution don't allocate anything.
+	// Acquire() and Trim() are called from the render thread with its frame index, Release() may come from any thread.
+	// A released buffer is freed once it's been idle for "a_maxIdleFrames", or right away if there are already "a_maxIdleBuffers" idle ones.
+	// All buffers together never take more than "a_budgetBytes", idle ones are freed to make room and past that Acquire() fails,
+	// so captures get dropped under memory pressure instead of piling up.
+	class ReadbackPool
+	{
+	public:
+		struct Buffer
+		{
+			ReadbackKey        key;
+			ReadbackAllocation allocation;
+			std::uint64_t      lastUsedFrame = 0;
+			bool               bInUse = false;
+		};
+
+		ReadbackPool(ReadbackDevice& a_device, std::uint64_t a_maxIdleFrames, std::size_t a_maxIdleBuffers, std::size_t a_budgetBytes);
+		~ReadbackPool();
+
+		ReadbackPool(const ReadbackPool&) = delete;
+		ReadbackPool& operator=(const ReadbackPool&) = delete;
+
+		// Returns nullptr if a new buffer was needed and it didn't fit in the budget or the device failed to allocate it
+		Buffer* Acquire(const ReadbackKey& a_key, std::uint64_t a_frameIndex);
+		void    Release(Buffer* a_buffer);
+		void    Trim(std::uint64_t a_frameIndex);
+
+		std::size_t GetBufferCount() const;
+		std::size_t GetIdleBufferCount() const;
+		std::size_t GetAllocatedBytes() const;
+
+	private:
+		void FreeBuffer(std::size_t a_index);
+
+		ReadbackDevice&                      device;
+		const std::uint64_t                  maxIdleFrames;
+		const std::size_t                    maxIdleBuffers;
+		const std::size_t                    budgetBytes;
+		std::size_t                          allocatedBytes = 0;
+		std::vector<std::unique_ptr<Buffer>> buffers;
+		std::uint64_t                        currentFrame = 0;
+		mutable std::mutex                   mutex;
+	};
+
+	// GPU timeline the tracker waits on. On D3D12 it's a fence signalled on the queue that executes the copies.
+	class CompletionFence
+	{
+	public:
+		virtual ~CompletionFence() = default;
+
+		// Queues a signal to "a_value" behind all the work submitted so far
+		virtual bool          Signal(std::uint64_t a_value) = 0;
+		virtual std::uint64_t GetCompletedValue() = 0;
+	};
+
+	class CompletionClock
+	{
+	public:
+		virtual ~CompletionClock() = default;
+
+		virtual double NowMs() = 0;
+	};
+
+	class SteadyCompletionClock : public CompletionClock
+	{
+	public:
+		double NowMs() override;
+	};
+
+	// Runs callbacks once the GPU has passed the point where they were registered, instead of waiting a fixed number of frames.
+	// Not thread safe, everything is expected to happen on the render thread.
+	class CompletionTracker
+	{
+	public:
+		using Callback = std::function<void()>;
+
+		CompletionTracker(CompletionFence& a_fence, CompletionClock& a_clock);
+
+		// Signals the next fence value and returns it, or 0 if the signal couldn't be queued
+		std::uint64_t Signal();
+
+		// "a_callback" runs from Poll() once the fence reaches "a_fenceValue"
+		void Add(std::uint64_t a_fenceValue, Callback a_callback);
+
+		// Runs the callbacks of everything the GPU has finished, in fence order. Returns how many ran.
+		std::size_t Poll();
+
+		std::size_t GetPendingCount() const { return pending.size(); }
+		double      GetLastCompletionMs() const { return lastCompletionMs; }  // from Signal() to the Poll() that saw it complete
+
+	private:
+		struct Entry
+		{
+			std::uint64_t fenceValue;
+			std::uint64_t order;  // keeps callbacks on the same fence value in the order they were added
+			double        signalTimeMs;
+			Callback      callback;
+
+			bool operator>(const Entry& a_other) const { return fenceValue != a_other.fenceValue ? fenceValue > a_other.fenceValue : order > a_other.order; }
+		};
+
+		CompletionFence&                                                   fence;
+		CompletionClock&                                                   clock;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pending;  // min-heap by fence value
+		std::uint64_t                                                      lastSignalledValue = 0;
+		double                                                             lastSignalTimeMs = 0.0;
+		std::uint64_t                                                      addedCount = 0;
+		double                                                             lastCompletionMs = 0.0;
+	};
+}
@@ -331,6 +331,10 @@ namespace Settings
 			config->Bind(FilmGrainFPSLimit.value, FilmGrainFPSLimit.defaultValue);
 			config->Bind(PostSharpen.value, PostSharpen.defaultValue);
 			config->Bind(HDRScreenshots.value, HDRScreenshots.defaultValue);
+			config->Bind(HDRScreenshotsLossless.value, HDRScreenshotsLossless.defaultValue);
+			config->Bind(HDRScreenshotsBurstFrames.value, HDRScreenshotsBurstFrames.defaultValue);
+			config->Bind(HDRScreenshotsCompression.value, HDRScreenshotsCompression.defaultValue);
+			config->Bind(HDRScreenshotsLinearEXR.value, HDRScreenshotsLinearEXR.defaultValue);
 			config->Bind(DLSSFGToFSRFGMod.value, DLSSFGToFSRFGMod.defaultValue);
 			config->Bind(DevSetting01.value, DevSetting01.defaultValue);
 			config->Bind(DevSetting02.value, DevSetting02.defaultValue);
@@ -563,6 +567,14 @@ namespace Settings
 		DrawReshadeCheckbox(PostSharpen);
 		ImGui::Spacing();
 		DrawReshadeCheckbox(HDRScreenshots);
+		if (*HDRScreenshots.value) {
+			DrawReshadeCheckbox(HDRScreenshotsLossless);
+			DrawReshadeValueStepper(HDRScreenshotsBurstFrames);
+			if (!*HDRScreenshotsLossless.value) {
+				DrawReshadeEnumStepper(HDRScreenshotsCompression);
+			}
+			DrawReshadeCheckbox(HDRScreenshotsLinearEXR);
+		}
 
 #if DEVELOPMENT
 		DrawReshadeSlider(DevSetting01);
@@ -57,6 +57,9 @@ namespace Settings
 		kPostSharpen,
 		kHDRScreenshots,
 		kHDRScreenshotsLossless,
+		kHDRScreenshotsBurstFrames,
+		kHDRScreenshotsCompression,
+		kHDRScreenshotsLinearEXR,
 		kDLSSFGToFSRFGMod,
 
 		kEND,
@@ -462,6 +465,43 @@ namespace Settings
 			"HDRScreenshots", "HDR",
 			true
 		};
+		Checkbox HDRScreenshotsLossless{
+			SettingID::kHDRScreenshotsLossless,
+			"Lossless HDR Screenshots",
+			"Saves HDR screenshots as uncompressed raw captures (.lumaraw) instead of 10 bit PNGs."
+				"\nThey are written almost instantly and keep the full precision of the game's output, but are several times bigger."
+				"\nUse the RawConverter tool to turn them into HDR PNGs.",
+			"HDRScreenshotsLossless", "HDR",
+			false
+		};
+		ValueStepper HDRScreenshotsBurstFrames{
+			SettingID::kHDRScreenshotsBurstFrames,
+			"HDR Screenshot Burst",
+			"Number of consecutive frames captured for each HDR screenshot, useful for comparisons."
+				"\nFrames are numbered in the file name. Frames that don't fit in memory while previous ones are still being saved are skipped.",
+			"HDRScreenshotsBurstFrames", "HDR",
+			1,
+			1,
+			120,
+			1
+		};
+		EnumStepper HDRScreenshotsCompression{
+			SettingID::kHDRScreenshotsCompression,
+			"HDR Screenshot Compression",
+			"Trades HDR screenshot PNG size for encoding speed."
+				"\nFastest writes the biggest files, Smallest takes about twice as long as Fastest for files roughly 10% smaller.",
+			"HDRScreenshotsCompression", "HDR",
+			1,
+			{ "Fastest", "Balanced", "Smallest" }
+		};
+		Checkbox HDRScreenshotsLinearEXR{
+			SettingID::kHDRScreenshotsLinearEXR,
+			"Linear EXR Screenshots",
+			"Also saves every HDR screenshot as an OpenEXR (.exr) with the game's linear scRGB output, before any display encoding."
+				"\nMeant for grading and comparisons in external tools, the files are uncompressed and about as big as lossless captures.",
+			"HDRScreenshotsLinearEXR", "HDR",
+			false
+		};
 		Checkbox DLSSFGToFSRFGMod{
 			SettingID::kDLSSFGToFSRFGMod,
 			"DLSS FG to FSR FG Mod",
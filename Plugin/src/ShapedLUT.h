@@ -0,0 +1,112 @@
+#pragma once
+
+#include "ColorLUT.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 3D LUTs of color transforms of scene linear inputs, and the helpers to bake them on all cores.
+// Texels are spaced by a shaper of each scene linear input channel, either PQ (1 is 100 nits, up to 100) or log2 (2^-12 to 2^7, with an offset so 0 is the first texel),
+// both spread texels roughly perceptually. Inputs beyond the shaper's range get the value of its edge.
+// Values are stored red first, then green, then blue, like a .cube file (whose input would be the shaper's encoding),
+// so a shader can sample the same values uploaded as an R16G16B16A16_FLOAT or R32G32B32A32_FLOAT Texture3D.
+namespace ToneMapping
+{
+	using Color::Float3;
+
+	enum class LUTShaper : std::uint32_t
+	{
+		kPQ,
+		kLog2
+	};
+
+	class ShapedLUT
+	{
+	public:
+		static constexpr float kPQScale = 100.f / Color::kPQMaxNits;  // 1 is 100 nits
+		static constexpr float kLog2Offset = 1.f / 4096.f;
+		static constexpr float kLog2Max = 128.f;
+
+		ShapedLUT() = default;
+		ShapedLUT(std::size_t a_size, LUTShaper a_shaper) :
+			size(a_size),
+			shaper(a_shaper),
+			values(a_size * a_size * a_size)
+		{}
+
+		// Scene linear to 0-1 along an axis of the LUT. PQ goes through "Color::kLinearToPQTable", sampling is ~3 pow() cheaper that way.
+		float Shape(float a_value) const
+		{
+			a_value = std::fmax(a_value, 0.f);
+			if (shaper == LUTShaper::kPQ) {
+				return Color::kLinearToPQTable.Sample(std::fmin(a_value * kPQScale, 1.f));
+			}
+			static const float log2Min = std::log2(kLog2Offset);
+			static const float log2Range = std::log2(kLog2Max + kLog2Offset) - log2Min;
+			return std::fmin((std::log2(a_value + kLog2Offset) - log2Min) / log2Range, 1.f);
+		}
+
+		float Unshape(float a_coordinate) const
+		{
+			if (shaper == LUTShaper::kPQ) {
+				return Color::PQToLinear(a_coordinate) / kPQScale;
+			}
+			static const float log2Min = std::log2(kLog2Offset);
+			static const float log2Range = std::log2(kLog2Max + kLog2Offset) - log2Min;
+			return std::fmax(std::exp2(a_coordinate * log2Range + log2Min) - kLog2Offset, 0.f);
+		}
+
+		// Trilinear, the input is scene linear
+		Float3 Sample(const Float3& a_rgb) const
+		{
+			const float maxIndex = static_cast<float>(size - 1);
+			const float coordinates[3] = { Shape(a_rgb.x) * maxIndex, Shape(a_rgb.y) * maxIndex, Shape(a_rgb.z) * maxIndex };
+			std::size_t begin[3];
+			std::size_t end[3];
+			float       fraction[3];
+			for (int i = 0; i < 3; ++i) {
+				begin[i] = std::min(static_cast<std::size_t>(coordinates[i]), size - 2);
+				end[i] = begin[i] + 1;
+				fraction[i] = coordinates[i] - static_cast<float>(begin[i]);
+			}
+
+			const auto load = [&](std::size_t a_x, std::size_t a_y, std::size_t a_z) { return values[(a_z * size + a_y) * size + a_x]; };
+			const auto lerp = [](const Float3& a_a, const Float3& a_b, float a_alpha) { return a_a + (a_b - a_a) * a_alpha; };
+			const auto sampleSlice = [&](std::size_t a_z) {
+				const Float3 top = lerp(load(begin[0], begin[1], a_z), load(end[0], begin[1], a_z), fraction[0]);
+				const Float3 bottom = lerp(load(begin[0], end[1], a_z), load(end[0], end[1], a_z), fraction[0]);
+				return lerp(top, bottom, fraction[1]);
+			};
+			return lerp(sampleSlice(begin[2]), sampleSlice(end[2]), fraction[2]);
+		}
+
+		std::size_t         size = 0;
+		LUTShaper           shaper = LUTShaper::kPQ;
+		std::vector<Float3> values;  // x (red) first, then y (green), then z (blue)
+	};
+
+	// Fills "a_outLUT" (which sets the size and shaper) with "a_transform(Float3)" of every texel, blue slices are spread over "a_threadCount" threads (0 is all cores).
+	// "a_transform" is called concurrently. A 33^3 LUT is ~36K calls, a 65^3 one ~275K.
+	template <class F>
+	void BakeShapedLUT(F&& a_transform, ShapedLUT& a_outLUT, std::size_t a_threadCount = 0)
+	{
+		const std::size_t  size = a_outLUT.size;
+		std::vector<float> axis(size);
+		for (std::size_t i = 0; i < size; ++i) {
+			axis[i] = a_outLUT.Unshape(static_cast<float>(i) / static_cast<float>(size - 1));
+		}
+
+		ParallelFor(size, a_threadCount, [&](std::size_t a_z) {
+			Float3* slice = a_outLUT.values.data() + a_z * size * size;
+			for (std::size_t y = 0; y < size; ++y) {
+				for (std::size_t x = 0; x < size; ++x) {
+					slice[y * size + x] = a_transform(Float3{ axis[x], axis[y], axis[a_z] });
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ColorLUT.h"
+#include "ToneMapping.h"
+
+#include <cstdint>
+
+// The per pixel tone curves of HDRComposite baked into 1D tables, so a pixel does a table lookup instead of evaluating
+// Hable's segments, the ACES fit or OpenDRT's tonescale and flare.
+// Tables cover scene linear inputs from 2^-20 to 2^12 with 128 segments per octave (4096 segments, 16KB each), see "Color::LogTable" for the layout
+// (a shader can sample the same values uploaded as an R32_FLOAT buffer). Inputs beyond 2^12 get the value of 2^12, the curves are flat by then.
+// Max errors against the analytic curves, in 10 bit code values of the encoded output (measured by "tools/ToneCurveBaker"):
+// - ACES: 0.02 (gamma 2.2). OpenDRT: 0.007 (gamma 2.2), 0.02 (PQ), 0.1 with the lowest contrast.
+// - Hable: 0.8 (gamma 2.2), but that's the analytic curve's own error: in float its shoulder is a staircase of ~4.5e-4 steps,
+//   as "(1 + overshootX) - x" cancels most of x. The table interpolates between the steps, so more segments don't lower it.
+// OpenDRT's tonescale of negative norms is NaN analytically, the tables return 0 for them.
+namespace ToneMapping
+{
+	using ToneCurveTable = Color::LogTable<-20, 7, 12>;
+
+	// Everything the baked curves depend on, with the same meaning as the HDRComposite constants of the same name
+	struct ToneCurveInputs
+	{
+		std::uint32_t    Tmo = 3;  // 1 ACES fitted, 2 ACES parametric, 3 Hable, anything else is no tonemapper
+		std::uint32_t    ToneMapperType = 0;
+		std::int32_t     DisplayMode = 1;
+		float            PeakBrightness = 1000.f;
+		float            Contrast = 1.f;
+		float            Shadows = 0.5f;
+		float            AcesParam0 = 11.2f;
+		float            AcesParam1 = 0.022f;
+		HableSceneParams hable;
+
+		bool operator==(const ToneCurveInputs&) const = default;
+	};
+
+	struct ToneCurves
+	{
+		// By channel for Hable and ACES (on the absolute value, the sign is restored after), or OpenDRT's tonescale of the reference display
+		ToneCurveTable sdr;
+		// OpenDRT's tonescale of the user's display, it's the same as "sdr" with the other tonemappers
+		ToneCurveTable hdr;
+	};
+
+	// The analytic version of the "sdr" curve, "a_hableCurve" and "a_acesParams" are the ones made from the same inputs
+	inline float EvaluateSDRToneCurve(float a_value, const ToneCurveInputs& a_inputs, const HableCurve& a_hableCurve, const ACESParametricParams& a_acesParams)
+	{
+		if (a_inputs.ToneMapperType == 1) {
+			return OpenDRT::DisplayTonescale(a_value, OpenDRT::MakeCustomTonescaleParams());
+		}
+		switch (a_inputs.Tmo) {
+		case 1:
+			return ACES(a_value, false, ACESParametricParams{});
+		case 2:
+			return ACES(a_value, false, a_acesParams);
+		case 3:
+			return HableEval(a_value * a_hableCurve.invW, a_hableCurve.evalParams) * a_hableCurve.params.invScale;
+		default:
+			return a_value;
+		}
+	}
+
+	// The analytic version of the "hdr" curve
+	inline float EvaluateHDRToneCurve(float a_value, const ToneCurveInputs& a_inputs, const HableCurve& a_hableCurve, const ACESParametricParams& a_acesParams)
+	{
+		if (a_inputs.ToneMapperType != 1) {
+			return EvaluateSDRToneCurve(a_value, a_inputs, a_hableCurve, a_acesParams);
+		}
+		const bool bHDR = a_inputs.DisplayMode > 0;
+		return OpenDRT::DisplayTonescale(a_value, OpenDRT::MakeCustomTonescaleParams(bHDR ? a_inputs.PeakBrightness : Color::kReferenceWhiteNits_BT2408, a_inputs.Contrast));
+	}
+
+	// Both tables take ~10K curve evaluations
+	inline void BakeToneCurves(const ToneCurveInputs& a_inputs, ToneCurves& a_outCurves)
+	{
+		const HableCurve           hableCurve = MakeHableCurve(a_inputs.hable, a_inputs.Shadows);
+		const ACESParametricParams acesParams = MakeACESParametricParams(a_inputs.AcesParam0, a_inputs.AcesParam1);
+
+		a_outCurves.sdr = ToneCurveTable::Make([&](double a_value) { return EvaluateSDRToneCurve(static_cast<float>(a_value), a_inputs, hableCurve, acesParams); });
+		a_outCurves.hdr = ToneCurveTable::Make([&](double a_value) { return EvaluateHDRToneCurve(static_cast<float>(a_value), a_inputs, hableCurve, acesParams); });
+	}
+}
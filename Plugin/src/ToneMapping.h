@@ -0,0 +1,619 @@
+#pragma once
+
+#include "Color.h"
+
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+
+// C++ port of the tone mappers of "shaders/HDRComposite" (ACES fitted/parametric, Hable's piecewise power curves, DICE and OpenDRT),
+// and of the "math.hlsl" helpers they use. Scalar only: formulas and operation order follow the shaders, so CPU results can be compared
+// against the GPU and changes can be tested on any machine.
+// The shader rebuilds the ACES and Hable curve parameters for every pixel even though they only depend on constants,
+// here they are set up once by "Make*()" functions and passed to the evaluation.
+// min()/max() use fmin()/fmax(), which like GPUs return the other operand when one of them is NaN.
+namespace ToneMapping
+{
+	using Color::Apply;
+	using Color::Float3;
+
+	// 1.1920928955078125e-07
+	inline constexpr float kEpsilon = std::bit_cast<float>(0x34000000u);
+	// Second largest float below 1
+	inline constexpr float kLFLT1 = std::bit_cast<float>(0x3F7FFFFEu);
+	inline constexpr float kBTHCNST = std::bit_cast<float>(0x3F7FFF58u);
+	inline constexpr float kLog2E = std::bit_cast<float>(0x3FB8AA3Bu);
+	inline constexpr float kRcpLog2E = std::bit_cast<float>(0x3F317218u);
+	inline constexpr float kDenormMin = std::bit_cast<float>(0x00000001u);
+
+	// Start of the highlights shoulder and end of the shadows in SDR tonemapped colors (empirical)
+	inline const float kMinHighlightsColor = std::pow(2.f / 3.f, 2.2f);
+	inline const float kMaxShadowsColor = std::pow(1.f / 3.f, 2.2f);
+
+	// HLSL intrinsics on colors
+	inline float Saturate(float a_value) { return std::fmin(std::fmax(a_value, 0.f), 1.f); }
+	inline float Lerp(float a_a, float a_b, float a_alpha) { return a_a + (a_b - a_a) * a_alpha; }
+	inline float Sign(float a_value) { return a_value > 0.f ? 1.f : (a_value < 0.f ? -1.f : 0.f); }
+	inline float MaxChannel(const Float3& a_color) { return std::fmax(a_color.x, std::fmax(a_color.y, a_color.z)); }
+	inline float MinChannel(const Float3& a_color) { return std::fmin(a_color.x, std::fmin(a_color.y, a_color.z)); }
+	inline float Length(const Float3& a_color) { return std::sqrt(Color::Dot(a_color, a_color)); }
+
+	inline Float3 Max(const Float3& a_color, float a_value) { return Apply(a_color, [&](float a_channel) { return std::fmax(a_channel, a_value); }); }
+	inline Float3 Min(const Float3& a_color, float a_value) { return Apply(a_color, [&](float a_channel) { return std::fmin(a_channel, a_value); }); }
+	inline Float3 Clamp(const Float3& a_color, float a_min, float a_max) { return Min(Max(a_color, a_min), a_max); }
+	inline Float3 Saturate(const Float3& a_color) { return Apply(a_color, [](float a_channel) { return Saturate(a_channel); }); }
+	inline Float3 Abs(const Float3& a_color) { return Apply(a_color, [](float a_channel) { return std::abs(a_channel); }); }
+	inline Float3 Sign(const Float3& a_color) { return Apply(a_color, [](float a_channel) { return Sign(a_channel); }); }
+	inline Float3 Pow(const Float3& a_color, float a_exponent) { return Apply(a_color, [&](float a_channel) { return std::pow(a_channel, a_exponent); }); }
+	inline Float3 Lerp(const Float3& a_a, const Float3& a_b, float a_alpha) { return a_a + (a_b - a_a) * a_alpha; }
+	inline Float3 Lerp(const Float3& a_a, const Float3& a_b, const Float3& a_alpha) { return a_a + (a_b - a_a) * a_alpha; }
+	inline Float3 Normalize(const Float3& a_color) { return a_color / Length(a_color); }
+
+	// From old to new range (just a remap function)
+	inline float LinearNormalization(float a_input, float a_min, float a_max, float a_newMin, float a_newMax)
+	{
+		return ((a_input - a_min) * ((a_newMax - a_newMin) / (a_max - a_min))) + a_newMin;
+	}
+
+	inline float Average(const Float3& a_color) { return (a_color.x + a_color.y + a_color.z) / 3.f; }
+
+	// Returns 1 if "a_divisor" is 0
+	inline float SafeDivision(float a_dividend, float a_divisor) { return a_divisor == 0.f ? 1.f : a_dividend / a_divisor; }
+	inline Float3 SafeDivision(const Float3& a_dividend, const Float3& a_divisor)
+	{
+		return { SafeDivision(a_dividend.x, a_divisor.x), SafeDivision(a_dividend.y, a_divisor.y), SafeDivision(a_dividend.z, a_divisor.z) };
+	}
+
+	// Exponential ("Photographic") compression, "a_pow" modulates the curve without changing the values around the edges
+	inline float RangeCompress(float a_value, float a_max = FLT_MAX, float a_pow = 1.f)
+	{
+		if (a_pow == 1.f && a_max == FLT_MAX) {
+			return 1.f - std::exp(-a_value);
+		}
+		if (a_pow == 1.f) {
+			return (1.f - std::exp(-a_value)) * (1.f / (1.f - std::exp(-a_max)));
+		}
+		if (a_max == FLT_MAX) {
+			return 1.f - std::pow(std::exp(-a_value), a_pow);
+		}
+		return (1.f - std::pow(std::exp(-a_value), a_pow)) * (1.f / (1.f - std::pow(std::exp(-a_max), a_pow)));
+	}
+
+	// Refurbished DICE HDR tonemapper (of a single channel or luminance)
+	inline float LuminanceCompress(float a_value, float a_outMaxValue, float a_shoulderStart = 0.f, bool a_considerMaxValue = false, float a_inMaxValue = FLT_MAX, float a_modulationPow = 1.f)
+	{
+		const float compressableValue = a_value - a_shoulderStart;
+		const float compressableRange = a_inMaxValue - a_shoulderStart;
+		const float compressedRange = std::fmax(a_outMaxValue - a_shoulderStart, FLT_MIN);
+		const float possibleOutValue = a_shoulderStart + compressedRange * RangeCompress(compressableValue / compressedRange, a_considerMaxValue ? (compressableRange / compressedRange) : FLT_MAX, a_modulationPow);
+		return a_value <= a_shoulderStart ? a_value : possibleOutValue;
+	}
+
+	// ACES filmic fit by Krzysztof Narkowicz: (x * (a * x + b)) / (x * (c * x + d) + e), "a" and "e" vary by scene in the parametric version
+	inline constexpr float kACES_a = 2.51f;
+	inline constexpr float kACES_b = 0.03f;
+	inline constexpr float kACES_c = 2.43f;
+	inline constexpr float kACES_d = 0.59f;
+	inline constexpr float kACES_e = 0.14f;
+
+	struct ACESParametricParams
+	{
+		float modE = kACES_e;
+		float modA = kACES_a;
+	};
+
+	// "a_param0" is usually 11.2 and "a_param1" 0.022 (the scene's "AcesParam0" and "AcesParam1")
+	inline ACESParametricParams MakeACESParametricParams(float a_param0, float a_param1)
+	{
+		return { a_param1, ((0.56f / a_param0) + kACES_b) + (a_param1 / (a_param0 * a_param0)) };
+	}
+
+	inline float ACES(float a_value, bool a_clamp, const ACESParametricParams& a_params)
+	{
+		const float value = (a_value * (a_params.modA * a_value + kACES_b)) / ((a_value * (kACES_c * a_value + kACES_d)) + a_params.modE);
+		return a_clamp ? Saturate(value) : value;
+	}
+
+	inline Float3 ACES(const Float3& a_color, bool a_clamp, const ACESParametricParams& a_params)
+	{
+		return Apply(a_color, [&](float a_channel) { return ACES(a_channel, a_clamp, a_params); });
+	}
+
+	// Only defined for 0-1, which already represents the whole 0-INF range
+	inline float ACES_Inverse(float a_value, const ACESParametricParams& a_params)
+	{
+		const float value = Saturate(a_value);
+
+		const float fixed0 = (-kACES_d * value) + kACES_b;
+		const float fixed1 = (kACES_c * value) - a_params.modA;
+
+		const float variableNumeratorPart0 = -fixed0;
+		const float variableNumerator = std::sqrt((variableNumeratorPart0 * variableNumeratorPart0) - (4.f * a_params.modE * value * fixed1));
+
+		const float denominator = 2.f * fixed1;
+
+		const float result0 = (fixed0 + variableNumerator) / denominator;
+		const float result1 = (fixed0 - variableNumerator) / denominator;
+		return std::fmax(result0, result1);
+	}
+
+	inline Float3 ACES_Inverse(const Float3& a_color, const ACESParametricParams& a_params)
+	{
+		return Apply(a_color, [&](float a_channel) { return ACES_Inverse(a_channel, a_params); });
+	}
+
+	// Hable's piecewise power curves (http://filmicworlds.com/blog/filmic-tonemapping-with-piecewise-power-curves/), not the Uncharted 2 tonemapper.
+	// The game's setup was optimized by the compiler, the "_optimised" values are what's left of it (https://github.com/johnhable/fw-public).
+	struct HableSceneParams
+	{
+		float toeStrength = 0.5f;       // usually 0.5
+		float toeLength = 0.3f;         // usually 0.3, but can also be ~0
+		float shoulderStrength = 9.9f;  // usually 9.9
+		float shoulderLength = 0.8f;    // usually 0.8
+		float shoulderAngle = 0.3f;     // usually 0.3
+
+		bool operator==(const HableSceneParams&) const = default;
+	};
+
+	struct HableParams
+	{
+		struct
+		{
+			float y0;
+			float y1;
+		} params;
+
+		struct
+		{
+			float W;
+		} dstParams;
+
+		struct
+		{
+			float lnA;
+			float B;
+		} toeSegment;
+
+		struct
+		{
+			float offsetX;
+			float lnA;
+		} midSegment;
+
+		struct
+		{
+			float offsetX;
+			float offsetY;
+			float lnA;
+			float B;
+		} shoulderSegment;
+
+		float invScale;
+		float toeEnd;
+		float shoulderStart;
+	};
+
+	struct HableEvalParams
+	{
+		float params_x0;
+		float params_x1;
+		float params_overshootX;
+		float params_overshootY;
+		float toeSegment_lnA_optimised;
+		float toeSegment_optimised;
+		float toeSegment_B;
+		float midSegment_offsetX;
+		float midSegment_lnA_optimised;
+		float shoulderSegment_lnA;
+		float shoulderSegment_B_optimised;
+	};
+
+	struct HableCurve
+	{
+		HableParams     params;
+		HableEvalParams evalParams;
+		float           invW;
+	};
+
+	// "a_shadows" is the user shadows setting (0-1, 0.5 is neutral)
+	inline HableCurve MakeHableCurve(const HableSceneParams& a_sceneParams, float a_shadows)
+	{
+		HableCurve   curve;
+		HableParams& hableParams = curve.params;
+
+		// The 2.2 pow is so you don't have to input very small numbers, it's not related to gamma
+		const float toeLength = std::pow(Saturate(a_sceneParams.toeLength), 2.2f);
+		const float toeStrength = Saturate(a_sceneParams.toeStrength);
+		const float shoulderLength = std::fmin(std::fmax(Saturate(a_sceneParams.shoulderLength), kEpsilon), kBTHCNST);
+		const float shoulderStrength = std::fmax(a_sceneParams.shoulderStrength, 0.f);
+		const float shoulderAngle = Saturate(a_sceneParams.shoulderAngle);
+
+		constexpr float kShadowModulationMax = 10.f;
+		constexpr float kShadowModulationMin = 0.f;
+		const float     shadowModulation = a_shadows + 0.5f;
+		const float     shadowModulationPow = shadowModulation >= 1.f ? LinearNormalization(shadowModulation, 1.f, 1.5f, 1.f, kShadowModulationMax) : LinearNormalization(shadowModulation, 0.5f, 1.f, kShadowModulationMin, 1.f);
+
+		const float dstParams_x0 = toeLength * 0.5f;
+		const float dstParams_y0 = (1.f - std::pow(toeStrength, shadowModulationPow)) * dstParams_x0;
+
+		const float remainingY = 1.f - dstParams_y0;
+
+		const float y1_offset = (1.f - shoulderLength) * remainingY;
+		const float dstParams_x1 = dstParams_x0 + y1_offset;
+		const float dstParams_y1 = dstParams_y0 + y1_offset;
+
+		const float extraW = std::exp2(shoulderStrength) - kLFLT1;
+		const float initialW = dstParams_x0 + remainingY;
+		hableParams.dstParams.W = initialW + extraW;
+
+		// "W *" was optimised away as down the line there was a "/ W"
+		const float shoulderAngleXshoulderStrength = shoulderAngle * shoulderStrength;
+		const float dstParams_overshootX = 2.f * shoulderAngleXshoulderStrength;
+		const float dstParams_overshootY = 0.5f * shoulderAngleXshoulderStrength;
+
+		curve.invW = 1.f / hableParams.dstParams.W;
+
+		const float params_x0 = dstParams_x0 / hableParams.dstParams.W;
+		const float params_x1 = dstParams_x1 / hableParams.dstParams.W;
+		const float dx = y1_offset / hableParams.dstParams.W;
+		const float params_overshootX = dstParams_overshootX;
+
+		// Mid (linear) segment
+		float m = (std::abs(dx) < kEpsilon) ? 1.f : (y1_offset / dx);
+		m += kEpsilon;
+		const float b = dstParams_y0 - (m * params_x0);
+
+		hableParams.midSegment.offsetX = b / m;
+		const float midSegment_lnA_optimised = std::log2(m);
+		hableParams.midSegment.lnA = kRcpLog2E * midSegment_lnA_optimised;
+
+		// The toe and shoulder derivatives at the joints are both "m", as the curve has a gamma of 1
+		const float toeM = m;
+		const float shoulderM = m;
+
+		hableParams.params.y0 = std::fmax(kEpsilon, dstParams_y0);
+		hableParams.params.y1 = std::fmax(kEpsilon, dstParams_y1);
+
+		// -1 was optimised away as "shoulderSegment.offsetY" is "params_overshootY + 1"
+		const float params_overshootY = 1.f + dstParams_overshootY;
+
+		// Toe segment
+		hableParams.toeSegment.B = (toeM * params_x0) / (hableParams.params.y0 + kEpsilon);
+		const float toeSegment_optimised = std::log2(hableParams.params.y0);
+		const float toeSegment_lnA_optimised = -hableParams.toeSegment.B * std::log(params_x0);
+		hableParams.toeSegment.lnA = toeSegment_optimised * kRcpLog2E + toeSegment_lnA_optimised;
+
+		// Shoulder segment
+		const float shoulderSection_x0 = 1.f + params_overshootX - params_x1;
+		const float shoulderSection_y0 = params_overshootY - hableParams.params.y1;
+		hableParams.shoulderSegment.offsetX = 1.f + params_overshootX;
+		hableParams.shoulderSegment.offsetY = params_overshootY;
+		hableParams.shoulderSegment.B = (shoulderM * shoulderSection_x0) / (shoulderSection_y0 + kEpsilon);
+		const float shoulderSegment_B_optimised = hableParams.shoulderSegment.B * kRcpLog2E;
+		hableParams.shoulderSegment.lnA = (std::log2(shoulderSection_y0) * kRcpLog2E) - (shoulderSegment_B_optimised * std::log2(shoulderSection_x0));
+
+		// "params_overshootX" can occasionally be 0, log2(0) is -INF and exp2(-INF) is 0
+		float evalY0 = params_overshootY;
+		if (params_overshootX > 0.f) {
+			evalY0 -= std::exp2(((shoulderSegment_B_optimised * std::log2(params_overshootX)) + hableParams.shoulderSegment.lnA) * kLog2E);
+		}
+		hableParams.invScale = 1.f / evalY0;
+
+		hableParams.toeEnd = (std::fmin(params_x0, params_x1) / curve.invW) / hableParams.invScale;
+		hableParams.shoulderStart = (std::fmax(params_x0, params_x1) / curve.invW) / hableParams.invScale;
+
+		curve.evalParams = {
+			params_x0,
+			params_x1,
+			params_overshootX,
+			params_overshootY,
+			toeSegment_lnA_optimised,
+			toeSegment_optimised,
+			hableParams.toeSegment.B,
+			hableParams.midSegment.offsetX,
+			midSegment_lnA_optimised,
+			hableParams.shoulderSegment.lnA,
+			shoulderSegment_B_optimised
+		};
+		return curve;
+	}
+
+	inline float HableEval(float a_normX, const HableEvalParams& a_params)
+	{
+		// Toe
+		if (a_normX < a_params.params_x0) {
+			if (a_normX > 0.f) {
+				return std::exp2(((((std::log2(a_normX) * a_params.toeSegment_B) + a_params.toeSegment_optimised) * kRcpLog2E) + a_params.toeSegment_lnA_optimised) * kLog2E);
+			}
+			return 0.f;
+		}
+		// Mid
+		if (a_normX < a_params.params_x1) {
+			const float evalMidSegment_y0 = a_normX + a_params.midSegment_offsetX;
+			return evalMidSegment_y0 > 0.f ? std::exp2(std::log2(evalMidSegment_y0) + a_params.midSegment_lnA_optimised) : 0.f;
+		}
+		// Shoulder, it "clips" to 1 way before +INF
+		const float evalShoulderSegment_y0 = (1.f + a_params.params_overshootX) - a_normX;
+		float       evalShoulderReturn = 0.f;
+		if (evalShoulderSegment_y0 > 0.f) {
+			evalShoulderReturn = std::exp2(((a_params.shoulderSegment_B_optimised * std::log2(evalShoulderSegment_y0)) + a_params.shoulderSegment_lnA) * kLog2E);
+		}
+		return a_params.params_overshootY - evalShoulderReturn;
+	}
+
+	// Outputs are already within 0-1
+	inline Float3 Hable(const Float3& a_color, const HableCurve& a_curve)
+	{
+		return Apply(a_color * a_curve.invW, [&](float a_normX) { return HableEval(a_normX, a_curve.evalParams); }) * a_curve.params.invScale;
+	}
+
+	// Precision is within 0.0005 on most values, highlights are harder to recover.
+	// This mirrors the shader, "HableConstants.h" has a precomputed inverse that is also closer near the joints.
+	inline float Hable_Inverse(float a_value, const HableParams& a_params)
+	{
+		// There's no inverse formula beyond the 0-1 range
+		const float value = Saturate(a_value);
+
+		float offsetX, offsetY, scaleX, scaleY, lnA, B;
+		if (value < a_params.params.y0) {  // toe
+			offsetX = 0.f;
+			offsetY = 0.f;
+			scaleX = 1.f;
+			scaleY = a_params.invScale;
+			lnA = a_params.toeSegment.lnA;
+			B = a_params.toeSegment.B;
+		} else if (value < a_params.params.y1) {  // mid (linear segment)
+			offsetX = -a_params.midSegment.offsetX;
+			offsetY = 0.f;
+			scaleX = 1.f;
+			scaleY = a_params.invScale;
+			lnA = a_params.midSegment.lnA;
+			B = 1.f;
+		} else {  // shoulder
+			offsetX = a_params.shoulderSegment.offsetX;
+			offsetY = a_params.shoulderSegment.offsetY * a_params.invScale;
+			scaleX = -1.f;
+			scaleY = -a_params.invScale;
+			lnA = a_params.shoulderSegment.lnA;
+			B = a_params.shoulderSegment.B;
+		}
+
+		// Clamped to the smallest float
+		const float y0 = std::fmax((value - offsetY) / scaleY, kDenormMin);
+		const float x0 = std::exp((std::log(y0) - lnA) / B);
+		return (x0 / scaleX + offsetX) * a_params.dstParams.W;
+	}
+
+	inline Float3 Hable_Inverse(const Float3& a_color, const HableParams& a_params)
+	{
+		return Apply(a_color, [&](float a_channel) { return Hable_Inverse(a_channel, a_params); });
+	}
+
+	// DICE inspired tonemapper, working on the intensity (I) of ICtCp so hues are kept, with highlights desaturated as they get compressed.
+	// "a_shoulderStart" (in the same unit as the color) is where the compression starts, colors below it are returned untouched.
+	inline Float3 DICETonemap(const Float3& a_color, float a_maxOutputLuminance, float a_shoulderStart = 0.f, float a_modulationPow = 1.f)
+	{
+		const float targetCLLInPQ = Color::LinearToPQ(a_maxOutputLuminance, Color::kPQMaxWhitePoint);
+		const float shoulderStartInPQ = Color::LinearToPQ(a_shoulderStart, Color::kPQMaxWhitePoint);
+
+		// To L'M'S', normalized so 1 is 10000 nits
+		Float3 pqLMS = Color::Mul(Color::kBT709_To_LMS, a_color / Color::kPQMaxWhitePoint);
+		pqLMS = Apply(pqLMS, [](float a_channel) { return Color::LinearToPQ(a_channel); });
+
+		const float i1 = 0.5f * pqLMS.x + 0.5f * pqLMS.y;
+		if (i1 <= shoulderStartInPQ) {
+			return a_color;
+		}
+
+		const float i2 = LuminanceCompress(i1, targetCLLInPQ, shoulderStartInPQ, false, FLT_MAX, a_modulationPow);
+
+		// Desaturate to blow out highlights
+		const float minI = std::fmin(i1 / i2, i2 / i1);
+
+		const auto& toICtCp = Color::kPQLMS_To_ICtCp;
+		pqLMS = Color::Mul(Color::kICtCp_To_PQLMS, Float3{ i2, Color::Dot(pqLMS, Float3{ toICtCp[1][0], toICtCp[1][1], toICtCp[1][2] }) * minI, Color::Dot(pqLMS, Float3{ toICtCp[2][0], toICtCp[2][1], toICtCp[2][2] }) * minI });
+
+		const Float3 lms = Apply(pqLMS, [](float a_channel) { return Color::PQToLinear(a_channel); });
+		return Color::Mul(Color::kLMS_To_BT709, lms) * Color::kPQMaxWhitePoint;
+	}
+
+	// OpenDRT v0.2.8 by Jed Smith (https://github.com/jedypod/open-display-transform), GPL v3, as adapted in "Open_DRT.hlsl"
+	namespace OpenDRT
+	{
+		inline constexpr float kLogOf2 = 0.6931471805599453f;
+		inline constexpr float kLogOf100 = 4.605170185988092f;
+
+		// [0-2]
+		inline Float3 NarrowHueAngles(const Float3& a_value)
+		{
+			return Clamp(a_value - Float3{ a_value.y + a_value.z, a_value.x + a_value.z, a_value.x + a_value.y }, 0.f, 2.f);
+		}
+
+		inline float Tonescale(float a_x, float a_m, float a_s, float a_c) { return std::pow(a_m * a_x / (a_x + a_s), a_c); }
+		inline float Flare(float a_x, float a_fl) { return (a_x * a_x) / (a_x + a_fl); }
+		inline float FlareInvert(float a_x, float a_fl) { return (a_x + std::sqrt(a_x * ((4.f * a_fl) + a_x))) / 2.f; }
+
+		inline constexpr float kFlare = 0.01f;  // flare/glare compensation
+
+		// The parameters of the tonescale of "Transform()", they only depend on the display and the user settings
+		struct TonescaleParams
+		{
+			float m;
+			float s;
+			float c;
+			float peak;
+		};
+
+		// "a_peak" is the display peak luminance (100 is SDR), "a_greyBoost" how many stops to boost mid grey per stop of peak luminance increase
+		inline TonescaleParams MakeTonescaleParams(float a_peak = 100.f, float a_greyBoost = 0.12f, float a_contrast = 1.f)
+		{
+			const float c = 1.21f * a_contrast;
+
+			// Tonescale constraints: the scene linear peak (px) maps to the display peak (py), and mid grey (gx) to (gy)
+			const float px = 256.f * std::log(a_peak) / kLogOf100 - 128.f;
+			const float py = a_peak / 100.f;
+			const float gx = 0.18f;
+			const float gy = 11.696f / 100.f * (1.f + a_greyBoost * std::log(py) / kLogOf2);
+			const float s0 = FlareInvert(gy, kFlare);
+			const float m0 = FlareInvert(py, kFlare);
+			const float ip = 1.f / c;
+			const float m0_ip = std::pow(m0, ip);
+			const float s0_ip = std::pow(s0, ip);
+			const float s = (px * gx * (m0_ip - s0_ip)) / (px * s0_ip - gx * m0_ip);
+			const float m = m0_ip * (s + px) / px;
+			return { m, s, c, a_peak };
+		}
+
+		// Maps the norm of a scene linear color to 0-1 (1 being the peak). This is the only part of "Transform()" that can be baked in a 1D table.
+		inline float DisplayTonescale(float a_lum, const TonescaleParams& a_params)
+		{
+			float ts = Tonescale(a_lum, a_params.m, a_params.s, a_params.c);
+			ts = Flare(ts, kFlare);
+			// Normalize so peak luminance is at 1, and clamp to it (required with low contrast)
+			ts *= 100.f / a_params.peak;
+			return std::fmin(1.f, ts);
+		}
+
+		// Invertible cubic shadow exposure function (https://www.desmos.com/calculator/ubgteikoke)
+		inline Float3 ShadowContrast(const Float3& a_rgb, float a_exposure, float a_strength)
+		{
+			const float m = std::exp2(a_exposure);
+			const float w = a_strength * a_strength * a_strength;
+
+			const float n = MaxChannel(a_rgb);
+			const float n2 = n * n;
+			const float dividend = n2 + w;
+			const float s = dividend != 0.f ? (n2 + m * w) / dividend : 1.f;  // implicit divide by n
+			return a_rgb * s;
+		}
+
+		// Invertible quadratic highlight contrast function (https://www.desmos.com/calculator/p7j4udnwkm)
+		inline Float3 HighlightContrast(const Float3& a_rgb, float a_exposure, float a_threshold)
+		{
+			const float p = std::exp2(-a_exposure);
+			const float t0 = 0.18f * std::exp2(a_threshold);
+			const float a = std::pow(t0, 1.f - p) / p;
+			const float b = t0 * (1.f - 1.f / p);
+
+			const float n = MaxChannel(a_rgb);
+			if (n == 0.f || n < t0) {
+				return a_rgb;
+			}
+			return a_rgb * (std::pow((n - b) / a, 1.f / p) / n);
+		}
+
+		inline Float3 ApplyUserShadows(const Float3& a_rgb, float a_shadows = 1.f)
+		{
+			Float3 rgb = ShadowContrast(a_rgb, -1.8f, std::pow(2.f - a_shadows, 4.f) * 0.025f);  // 0.04 at 1
+			return ShadowContrast(rgb, -0.5f * a_shadows * (1.f - a_shadows), 0.25f);            // 0 at 1
+		}
+
+		inline Float3 ApplyUserHighlights(const Float3& a_rgb, float a_highlights = 1.f)
+		{
+			return HighlightContrast(a_rgb, a_highlights, 2.f);
+		}
+
+		// "a_tonescale" maps the norm of the color to 0-1 (see "DisplayTonescale()"), either analytically or from a baked table.
+		// Output is within 0-1 (1 being the peak), but still scene linear.
+		template <std::invocable<float> F>
+		inline Float3 Transform(const Float3& a_rgb, F&& a_tonescale)
+		{
+			constexpr float dch = 0.1f;  // dechroma
+			constexpr float chc_p = 1.1f;  // chroma contrast amount
+			constexpr float chc_m = 0.6f;  // chroma contrast pivot
+
+			// Controls the "vibrancy" of each channel, their sum is used later to correct the luminance
+			constexpr Float3 weights = { 0.21f, 0.71f, 0.07f };
+			const float      weightSum = weights.x + weights.y + weights.z;
+
+			// Hue shift of RGB (disabled)
+			constexpr Float3 hs = { 0.f, 0.f, 0.f };
+
+			// Weighted sum of RGB, used as the norm to separate color and intensity
+			float lum = Color::Dot(a_rgb, weights);
+			lum *= 1.f / weightSum;
+
+			// RGB ratios, 1:1:1 for black
+			Float3 rats = lum != 0.f ? a_rgb / lum : Color::Broadcast(1.f);
+
+			const float ts = a_tonescale(lum);
+
+			// RGB and CMY hue angles
+			const float mx = MaxChannel(rats);
+			const float mn = MinChannel(rats);
+			Float3      rats_h = (rats - mn) / mx;
+			rats_h = NarrowHueAngles(rats_h);
+
+			// Normalized distance from achromatic
+			const float rats_ch = 1.f - (mn / mx);
+
+			// Chroma value compression: normalize bright saturated ratios so max(r,g,b) doesn't exceed 1
+			const Float3 rats_h2 = rats_h * rats_h;
+			float        chf = ts * MaxChannel(rats_h2);
+
+			constexpr float chf_m = 0.25f;
+			constexpr float chf_p = 0.65f;
+			chf = 1.f - std::pow(std::pow(chf / chf_m, 1.f / chf_p) + 1.f, -chf_p);
+
+			const Float3 rats_n = rats / mx;
+			rats = rats_n * chf + rats * (1.f - chf);
+
+			// Chroma compression towards the display peak (disabled by "overallDechroma")
+			constexpr float overallDechroma = 0.f;
+			constexpr float dechromaDelay = 3.f;
+			constexpr float dechromaStrength = 0.15f;
+			constexpr float dechromaBias = 0.1f;
+			const float     ccf = 1.f - overallDechroma * (std::pow(ts, dechromaDelay / dch) * (1.f - ts * dechromaStrength) + ts * ts * dechromaBias);
+			rats = rats * ccf + 1.f - ccf;
+
+			// Chroma compression hue shift, mixed in by the tonescale
+			const Float3 hsf = rats_h * ccf;
+			const Float3 rats_hs = {
+				rats.x + hsf.z * hs.z - hsf.y * hs.y,
+				rats.y + hsf.x * hs.x - hsf.z * hs.z,
+				rats.z + hsf.y * hs.y - hsf.x * hs.x
+			};
+			rats = rats_hs * ts + rats * (1.f - ts);
+
+			// Chroma contrast: boost mid-range chroma in shadows and midtones
+			const float chc_f = 4.f * rats_ch * (1.f - rats_ch);
+			const float chc_sa = std::fmin(2.f, lum / (chc_m * std::pow(lum / chc_m, chc_p) * chc_f + lum * (1.f - chc_f)));
+			const float chc_L = Color::Dot(rats, Float3{ 0.21f, 0.71f, 0.072f });  // roughly P3 weights
+			rats = (1.f - chc_sa) * chc_L + rats * chc_sa;
+
+			// Negative colors aren't supported yet
+			return Saturate(rats * ts);
+		}
+
+		// "a_peak" is the display peak luminance (100 is SDR), "a_greyBoost" how many stops to boost mid grey per stop of peak luminance increase
+		inline Float3 Transform(const Float3& a_rgb, float a_peak = 100.f, float a_greyBoost = 0.12f, float a_contrast = 1.f)
+		{
+			const TonescaleParams params = MakeTonescaleParams(a_peak, a_greyBoost, a_contrast);
+			return Transform(a_rgb, [&](float a_lum) { return DisplayTonescale(a_lum, params); });
+		}
+
+		// The tonescale parameters of "TransformCustom()"
+		inline TonescaleParams MakeCustomTonescaleParams(float a_peakNits = Color::kReferenceWhiteNits_BT2408, float a_contrast = 1.f)
+		{
+			return MakeTonescaleParams(a_peakNits, 0.12f * Color::kReferenceWhiteNits_BT2408 / a_peakNits, a_contrast);
+		}
+
+		// "TransformCustom()" with its tonescale passed in, the contrast setting is part of it
+		template <std::invocable<float> F>
+		inline Float3 TransformCustom(const Float3& a_rgb, F&& a_tonescale, float a_peakNits, float a_midGrayAdjustment = 1.f, float a_highlights = 0.575f, float a_shadows = 1.f)
+		{
+			Float3 rgb = ApplyUserShadows(a_rgb, a_shadows);
+			rgb = ApplyUserHighlights(rgb, (2.f * a_highlights - 1.15f) * Color::kReferenceWhiteNits_BT2408 / a_peakNits);
+			return Transform(rgb * a_midGrayAdjustment, a_tonescale);
+		}
+
+		// Luma's parameters on top of the transform. "a_highlights" 0.575 and "a_shadows" 1 are neutral.
+		inline Float3 TransformCustom(const Float3& a_rgb, float a_peakNits = Color::kReferenceWhiteNits_BT2408, float a_midGrayAdjustment = 1.f, float a_contrast = 1.f, float a_highlights = 0.575f, float a_shadows = 1.f)
+		{
+			const TonescaleParams params = MakeCustomTonescaleParams(a_peakNits, a_contrast);
+			return TransformCustom(a_rgb, [&](float a_lum) { return DisplayTonescale(a_lum, params); }, a_peakNits, a_midGrayAdjustment, a_highlights, a_shadows);
+		}
+	}
+}
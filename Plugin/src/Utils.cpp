@@ -1,6 +1,7 @@
 #include "Utils.h"
 
 #include "Offsets.h"
+#include "Screenshot.h"
 #include "Settings.h"
 
 #include <DirectXTex.h>
@@ -368,45 +369,41 @@ namespace Utils
 		return std::format("Photo_{}-{:02d}-{:02d}-{:02d}{:02d}{:02d}", systemTime.wYear, systemTime.wMonth, systemTime.wDay, systemTime.wHour, systemTime.wMinute, systemTime.wSecond);
     }
 
-	void TransformColor_HDR10(DirectX::XMVECTOR* a_outPixels, const DirectX::XMVECTOR* a_inPixels, size_t a_width, size_t)
+	// Wraps a screenshot for the encoders in "Screenshot.h". The swapchain formats are decoded while encoding,
+	// anything else is converted to half floats first, into "a_convertedImage", which has to outlive "a_outImage".
+	static bool GetScreenshotImage(const DirectX::Image& a_image, DirectX::ScratchImage& a_convertedImage, Screenshot::Image& a_outImage)
 	{
-		const DirectX::XMMATRIX fromBT709ToBT2020 = {
-			0.6274039149284363f, 0.06909728795289993f, 0.0163914393633604f, 0.f,
-			0.3292830288410187f, 0.9195404052734375f, 0.08801330626010895f, 0.f,
-			0.04331306740641594f, 0.01136231515556574f, 0.8955952525138855f, 0.f,
-			0.f, 0.f, 0.f, 1.f
-		};
-
-		const auto linearToPQ = [](float value) {
-			constexpr float pqMaxWhitePoint = 10000.f / 80.f;
-			constexpr float m1 = 0.1593017578125f;
-			constexpr float m2 = 78.84375f;
-			constexpr float c1 = 0.8359375f;
-			constexpr float c2 = 18.8515625f;
-			constexpr float c3 = 18.6875f;
-
-			const float colorPow = std::pow(std::max(value, 0.f) / pqMaxWhitePoint, m1);
-			return std::pow((c1 + c2 * colorPow) / (1.f + c3 * colorPow), m2);
-		};
-
-		for (size_t i = 0; i < a_width; ++i) {
-			DirectX::XMFLOAT4 color;
-			DirectX::XMStoreFloat4(&color, DirectX::XMVector4Transform(a_inPixels[i], fromBT709ToBT2020));
-			a_outPixels[i] = DirectX::XMVectorSet(
-				linearToPQ(color.x),
-				linearToPQ(color.y),
-				linearToPQ(color.z),
-				1.f);
+		const DirectX::Image* image = &a_image;
+		Screenshot::PixelFormat format;
+		switch (image->format) {
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			format = Screenshot::PixelFormat::kR16G16B16A16_FLOAT;
+			break;
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			format = Screenshot::PixelFormat::kR32G32B32A32_FLOAT;
+			break;
+		case DXGI_FORMAT_R10G10B10A2_UNORM:
+			format = Screenshot::PixelFormat::kR10G10B10A2_UNORM;
+			break;
+		default:
+			{
+				// sRGB formats are read as plain UNORM, the encoders expect the values as they're stored
+				DirectX::Image storedImage = *image;
+				storedImage.format = DirectX::MakeLinear(storedImage.format);
+				if (FAILED(DirectX::Convert(storedImage, DXGI_FORMAT_R16G16B16A16_FLOAT, DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, a_convertedImage))) {
+					return false;
+				}
+			}
+			image = a_convertedImage.GetImage(0, 0, 0);
+			format = Screenshot::PixelFormat::kR16G16B16A16_FLOAT;
+			break;
 		}
-	}
 
-	constexpr std::uint16_t QuantizeTo10Bit(std::uint16_t a_value)
-	{
-		const std::uint32_t value10Bit = (static_cast<std::uint32_t>(a_value) * 1023u + 32767u) / 65535u;
-		return static_cast<std::uint16_t>((value10Bit << 6u) | (value10Bit >> 4u));
+		a_outImage = { image->pixels, image->width, image->height, image->rowPitch, format };
+		return true;
 	}
 
-	void TakeSDRPhotoModeScreenshot(ID3D12CommandQueue* a_queue, ID3D12Resource* a_resource, D3D12_RESOURCE_STATES a_state, std::string a_name)
+	void TakeSDRPhotoModeScreenshot(const DirectX::Image& a_image, std::string a_name)
 	{
 		const auto fullPath = GetPhotoModeScreenshotDirectory() / std::format("{}.png", a_name);
 		const auto thumbnailPath = GetPhotoModeScreenshotDirectory() / std::format("{}-thumbnail.png", a_name);
@@ -414,87 +411,109 @@ namespace Utils
 		std::filesystem::create_directories(fullPath.parent_path());
 		std::filesystem::create_directories(thumbnailPath.parent_path());
 
-		DirectX::ScratchImage scratchImage;
-		DirectX::CaptureTexture(a_queue, a_resource, false, scratchImage, a_state, a_state);
+		DirectX::ScratchImage convertedImage;
+		Screenshot::Image source;
+		if (!GetScreenshotImage(a_image, convertedImage, source)) {
+			return;
+		}
+
+		// The frame is decoded once: each row is stored for the full photo and fed to the thumbnail downsampler,
+		// which center-crops non 16:9 frames so the thumbnail isn't stretched
+		constexpr std::size_t thumbnailWidth = 640;
+		constexpr std::size_t thumbnailHeight = 360;
+		DirectX::ScratchImage fullImage;
+		DirectX::ScratchImage thumbnailImage;
+		if (FAILED(fullImage.Initialize2D(DXGI_FORMAT_B8G8R8A8_UNORM, source.width, source.height, 1, 1)) ||
+			FAILED(thumbnailImage.Initialize2D(DXGI_FORMAT_B8G8R8A8_UNORM, thumbnailWidth, thumbnailHeight, 1, 1))) {
+			return;
+		}
+
+		Screenshot::Downsampler thumbnail(source.width, source.height, thumbnailWidth, thumbnailHeight, Screenshot::Downsampler::Filter::kTent);
+		const auto full = fullImage.GetImage(0, 0, 0);
+		Screenshot::ConvertToBGRA8(source, full->pixels, full->rowPitch, &thumbnail);
+
+		const auto thumbnailPixels = thumbnailImage.GetImage(0, 0, 0);
+		for (std::size_t y = 0; y < thumbnailHeight; ++y) {
+			Screenshot::StoreRowBGRA8(thumbnailPixels->pixels + y * thumbnailPixels->rowPitch, thumbnail.GetPixels() + y * thumbnailWidth, thumbnailWidth);
+		}
 
 		// full photo.
 		// We save it with the sRGB gamma as that's what PNG and other formats would expect on PC.
 		// LUMA might interpret any UI buffer as gamma 2.2 though, so this isn't entirely correct, but it's good enough.
-		DirectX::SaveToWICFile(scratchImage.GetImages(), scratchImage.GetImageCount(), DirectX::WIC_FLAGS_FORCE_SRGB, GUID_ContainerFormatPng, fullPath.c_str(), &GUID_WICPixelFormat32bppBGRA, nullptr);
+		// Both images are already in the container's pixel format, so WIC encodes them without any conversion.
+		DirectX::SaveToWICFile(*full, DirectX::WIC_FLAGS_FORCE_SRGB, GUID_ContainerFormatPng, fullPath.c_str(), &GUID_WICPixelFormat32bppBGRA, nullptr);
 
 		// thumbnail
-		DirectX::ScratchImage resizedImage;
-		// TODO: for ideal results, we could crop out the non 16:9 central part, so the screenshot isn't stretched
-		DirectX::Resize(scratchImage.GetImages(), scratchImage.GetImageCount(), scratchImage.GetMetadata(), 640, 360, DirectX::TEX_FILTER_DEFAULT, resizedImage);
-		DirectX::SaveToWICFile(resizedImage.GetImages(), resizedImage.GetImageCount(), DirectX::WIC_FLAGS_FORCE_SRGB, GUID_ContainerFormatPng, thumbnailPath.c_str(), &GUID_WICPixelFormat32bppBGRA, nullptr);
-
-		a_resource->Release();
+		DirectX::SaveToWICFile(*thumbnailPixels, DirectX::WIC_FLAGS_FORCE_SRGB, GUID_ContainerFormatPng, thumbnailPath.c_str(), &GUID_WICPixelFormat32bppBGRA, nullptr);
 	}
 
-	void TakeHDRPhotoModeScreenshot(ID3D12CommandQueue* a_queue, ID3D12Resource* a_resource, D3D12_RESOURCE_STATES a_state, std::string a_name)
+	void TakeHDRPhotoModeScreenshot(const DirectX::Image& a_image, std::string a_name)
 	{
-		const auto fullPath = GetPhotoModeScreenshotDirectory() / "HDR" / std::format("{}.png", a_name);
-		std::filesystem::create_directories(fullPath.parent_path());
+		const auto settings = Settings::Main::GetSingleton();
+		const bool bLossless = *settings->HDRScreenshotsLossless.value;
 
-		DirectX::ScratchImage scratchImage;
-		DirectX::CaptureTexture(a_queue, a_resource, false, scratchImage, a_state, a_state);
-
-		DirectX::ScratchImage transformedImage;
-		if (FAILED(DirectX::TransformImage(
-				scratchImage.GetImages(),
-				scratchImage.GetImageCount(),
-				scratchImage.GetMetadata(),
-				&TransformColor_HDR10,
-				transformedImage))) {
-			a_resource->Release();
-			return;
-		}
+		const auto fullPath = GetPhotoModeScreenshotDirectory() / "HDR" / std::format("{}.{}", a_name, bLossless ? "lumaraw" : "png");
+		std::filesystem::create_directories(fullPath.parent_path());
 
 		DirectX::ScratchImage convertedImage;
-		if (FAILED(DirectX::Convert(
-				transformedImage.GetImages(),
-				transformedImage.GetImageCount(),
-				transformedImage.GetMetadata(),
-				DXGI_FORMAT_R16G16B16A16_UNORM,
-				DirectX::TEX_FILTER_DEFAULT,
-				DirectX::TEX_THRESHOLD_DEFAULT,
-				convertedImage))) {
-			a_resource->Release();
+		Screenshot::Image source;
+		if (!GetScreenshotImage(a_image, convertedImage, source)) {
 			return;
 		}
 
-		const auto image = convertedImage.GetImage(0, 0, 0);
-		std::vector<std::uint16_t> pixels(image->width * image->height * 3);
+		Screenshot::LightLevelStats stats;
+		bool                        bHasStats = false;
+
+		const auto writeCallback = [](void* context, void* data, int size) {
+			std::ignore = std::fwrite(data, 1, size, static_cast<FILE*>(context));
+		};
 
-		for (size_t y = 0; y < image->height; ++y) {
-			const auto row = reinterpret_cast<const std::uint16_t*>(image->pixels + y * image->rowPitch);
-			for (size_t x = 0; x < image->width; ++x) {
-				const auto pixelIndex = (y * image->width + x) * 3;
-				pixels[pixelIndex + 0] = QuantizeTo10Bit(row[x * 4 + 0]);
-				pixels[pixelIndex + 1] = QuantizeTo10Bit(row[x * 4 + 1]);
-				pixels[pixelIndex + 2] = QuantizeTo10Bit(row[x * 4 + 2]);
+		bool bWritten = false;
+		if (FILE* file = nullptr; _wfopen_s(&file, fullPath.c_str(), L"wb") == 0) {
+			if (bLossless) {
+				const Screenshot::RawMetadata metadata{
+					static_cast<float>(settings->PeakBrightness.value.get_data()),
+					static_cast<float>(settings->GamePaperWhite.value.get_data()),
+					static_cast<float>(settings->UIPaperWhite.value.get_data())
+				};
+				bWritten = Screenshot::WriteRaw(source, metadata, writeCallback, file);
+			} else {
+				const auto compression = static_cast<Screenshot::Compression>(std::clamp(static_cast<int32_t>(settings->HDRScreenshotsCompression.value.get_data()), 0, 2));
+				const auto patchCallback = [](void* context, long long offset, const void* data, int size) {
+					const auto file = static_cast<FILE*>(context);
+					if (_fseeki64(file, offset, SEEK_SET) == 0) {
+						std::ignore = std::fwrite(data, 1, size, file);
+						_fseeki64(file, 0, SEEK_END);
+					}
+				};
+				bHasStats = bWritten = Screenshot::WriteHDR10PNG(source, compression, writeCallback, patchCallback, file, &stats);
 			}
+			// The write callback can't fail the encoder, a full disk only shows on the stream
+			bWritten &= !std::ferror(file);
+			bWritten &= std::fclose(file) == 0;
+		}
+		if (!bWritten) {
+			WARN("Failed to write HDR screenshot {}.{}", a_name, bLossless ? "lumaraw" : "png")
 		}
 
-		if (FILE* file = nullptr; _wfopen_s(&file, fullPath.c_str(), L"wb") == 0) {
-			const auto writeCallback = [](void* context, void* data, int size) {
-				std::ignore = std::fwrite(data, 1, size, static_cast<FILE*>(context));
-			};
-			std::ignore = stbi_write_hdr_png_to_func(
-				writeCallback,
-				file,
-				static_cast<int>(image->width),
-				static_cast<int>(image->height),
-				3,
-				pixels.data(),
-				0,
-				9,  // BT.2020 primaries
-				16  // PQ transfer function
-			);
-			std::fclose(file);
+		// The PNG carries MaxCLL/MaxFALL in its cLLi chunk, the sidecar has them along with the luminance histogram
+		if (bHasStats) {
+			std::ofstream sidecar(fullPath.parent_path() / std::format("{}.json", a_name));
+			sidecar << Screenshot::FormatLightLevelStats(stats);
 		}
 
-		a_resource->Release();
+		// Linear copy for grading tools, straight from the captured values
+		if (*settings->HDRScreenshotsLinearEXR.value) {
+			const auto exrPath = fullPath.parent_path() / std::format("{}.exr", a_name);
+			bool       bWrittenEXR = false;
+			if (FILE* file = nullptr; _wfopen_s(&file, exrPath.c_str(), L"wb") == 0) {
+				bWrittenEXR = Screenshot::WriteLinearEXR(source, writeCallback, file) && !std::ferror(file);
+				bWrittenEXR &= std::fclose(file) == 0;
+			}
+			if (!bWrittenEXR) {
+				WARN("Failed to write HDR screenshot {}.exr", a_name)
+			}
+		}
 	}
 
 	float linearNormalization(float input, float min, float max, float newMin, float newMax)
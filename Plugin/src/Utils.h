@@ -1,6 +1,11 @@
 #pragma once
 #include "RE/Buffers.h"
 
+namespace DirectX
+{
+	struct Image;
+}
+
 namespace Utils
 {
 	std::unordered_map<DXGI_FORMAT, std::string> GetDXGIFormatNameMap();
@@ -26,8 +31,8 @@ namespace Utils
 
 	std::filesystem::path GetPhotoModeScreenshotDirectory();
 	std::string GetPhotoModeScreenshotName();
-	void TakeSDRPhotoModeScreenshot(ID3D12CommandQueue* a_queue, ID3D12Resource* a_resource, D3D12_RESOURCE_STATES a_state, std::string a_name);
-	void TakeHDRPhotoModeScreenshot(ID3D12CommandQueue* a_queue, ID3D12Resource* a_resource, D3D12_RESOURCE_STATES a_state, std::string a_name);
+	void TakeSDRPhotoModeScreenshot(const DirectX::Image& a_image, std::string a_name);
+	void TakeHDRPhotoModeScreenshot(const DirectX::Image& a_image, std::string a_name);
 	float linearNormalization(float input, float min, float max, float newMin, float newMax);
 
 }
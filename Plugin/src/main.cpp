@@ -26,6 +26,14 @@ void SFSEPlugin_Preload(SFSE::LoadInterface* a_sfse);
 
 static inline bool bIsLoaded = false;
 
+// The plugin's exit path, run when the game's window is destroyed, before the process exits.
+// Threads must be stopped here rather than in static destructors: those run under the loader lock, once ExitProcess has already killed them.
+void UnloadPlugin()
+{
+	Hooks::Shutdown();
+	INFO("{} unloaded", Plugin::NAME)
+}
+
 void LoadPlugin(bool a_bIsSFSE)
 {
 #if 0
@@ -52,6 +60,7 @@ void LoadPlugin(bool a_bIsSFSE)
 	
 	Offsets::Initialize();
 	Hooks::Install();
+	Hooks::SetGameWindowDestroyedCallback(UnloadPlugin);
 	
 	bIsLoaded = true;
 }
@@ -0,0 +1,181 @@
+// Bakes the ACES RRT+ODT of "ACES.h" into 3D LUTs for a set of display peaks, and writes them as .cube files and DDS volume textures.
+// Usage: ACESLUTExporter [--peak <nits>]... [--min <nits>] [--size <texels>] [--shaper pq|log2] [--threads <count>] [--output <directory>]
+// Every "--peak" (400, 600, 1000, 1500, 2000 and 4000 nits by default) gets "ACES_<peak>nits_<size>_<shaper>.cube" and ".dds" in "--output" (the current directory by default).
+// Inputs are the shaper's encoding of scene linear BT.709 (see "ShapedLUT.h"), outputs are display linear BT.709 with 1 being the peak.
+// The DDS files are R32G32B32A32_FLOAT Texture3Ds with the same layout, so they can be sampled like "ShapedLUT::Sample()" after shaping the coordinates.
+// Also reports how far every LUT is from the analytic transform (Delta E ITP on random colors from 2^-12 to 2^6), and the throughput of the batch evaluation.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ACES.h"
+#include "Metrics.h"
+
+namespace
+{
+	using namespace ToneMapping;
+	using Color::Float3;
+
+	bool WriteCube(const std::filesystem::path& a_path, const ShapedLUT& a_lut, float a_minNits, float a_peakNits)
+	{
+		FILE* file = std::fopen(a_path.string().c_str(), "w");
+		if (!file) {
+			return false;
+		}
+
+		const char* shaper = a_lut.shaper == LUTShaper::kPQ ? "PQ (ST 2084) of scene linear BT.709, 1 being 100 nits" : "log2 shaper of scene linear BT.709 (ShapedLUT.h)";
+		std::fprintf(file, "# ACES RRT+ODT for a %g-%g nits display\n", a_minNits, a_peakNits);
+		std::fprintf(file, "# Input: %s\n", shaper);
+		std::fprintf(file, "# Output: display linear BT.709, 1 being %g nits\n", a_peakNits);
+		std::fprintf(file, "TITLE \"ACES %g nits\"\n", a_peakNits);
+		std::fprintf(file, "LUT_3D_SIZE %zu\n", a_lut.size);
+		std::fprintf(file, "DOMAIN_MIN 0.0 0.0 0.0\n");
+		std::fprintf(file, "DOMAIN_MAX 1.0 1.0 1.0\n");
+		for (const auto& value : a_lut.values) {
+			std::fprintf(file, "%.7f %.7f %.7f\n", value.x, value.y, value.z);
+		}
+		return std::fclose(file) == 0;
+	}
+
+	bool WriteDDS(const std::filesystem::path& a_path, const ShapedLUT& a_lut)
+	{
+		constexpr std::uint32_t kDDSMagic = 0x20534444;                                 // "DDS "
+		constexpr std::uint32_t kFlags = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x800000;     // caps, height, width, pitch, pixel format, depth
+		constexpr std::uint32_t kFourCCFlag = 0x4;
+		constexpr std::uint32_t kDX10 = 0x30315844;                                     // "DX10"
+		constexpr std::uint32_t kCapsTexture = 0x1000;
+		constexpr std::uint32_t kCaps2Volume = 0x200000;
+		constexpr std::uint32_t kFormatR32G32B32A32Float = 2;
+		constexpr std::uint32_t kDimensionTexture3D = 4;
+
+		const std::uint32_t size = static_cast<std::uint32_t>(a_lut.size);
+		std::uint32_t       header[1 + 31 + 5] = {};
+		header[0] = kDDSMagic;
+		header[1] = 124;  // header size
+		header[2] = kFlags;
+		header[3] = size;  // height
+		header[4] = size;  // width
+		header[5] = size * 16;  // pitch
+		header[6] = size;  // depth
+		header[19] = 32;  // pixel format size
+		header[20] = kFourCCFlag;
+		header[21] = kDX10;
+		header[27] = kCapsTexture;
+		header[28] = kCaps2Volume;
+		header[32] = kFormatR32G32B32A32Float;
+		header[33] = kDimensionTexture3D;
+		header[35] = 1;  // array size
+
+		std::vector<float> texels;
+		texels.reserve(a_lut.values.size() * 4);
+		for (const auto& value : a_lut.values) {
+			texels.insert(texels.end(), { value.x, value.y, value.z, 1.f });
+		}
+
+		FILE* file = std::fopen(a_path.string().c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		const bool bWritten = std::fwrite(header, sizeof(header), 1, file) == 1 && std::fwrite(texels.data(), sizeof(float), texels.size(), file) == texels.size();
+		return std::fclose(file) == 0 && bWritten;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<float>    peaks;
+	float                 minNits = 0.0001f;
+	std::size_t           size = 65;
+	LUTShaper             shaper = LUTShaper::kPQ;
+	std::size_t           threadCount = 0;
+	std::filesystem::path outputDirectory = ".";
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--peak" && i + 1 < argc) {
+			peaks.push_back(static_cast<float>(std::atof(argv[++i])));
+		} else if (argument == "--min" && i + 1 < argc) {
+			minNits = static_cast<float>(std::atof(argv[++i]));
+		} else if (argument == "--size" && i + 1 < argc) {
+			size = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 2));
+		} else if (argument == "--shaper" && i + 1 < argc && (std::string_view(argv[i + 1]) == "pq" || std::string_view(argv[i + 1]) == "log2")) {
+			shaper = std::string_view(argv[++i]) == "pq" ? LUTShaper::kPQ : LUTShaper::kLog2;
+		} else if (argument == "--threads" && i + 1 < argc) {
+			threadCount = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 0));
+		} else if (argument == "--output" && i + 1 < argc) {
+			outputDirectory = argv[++i];
+		} else {
+			std::fprintf(stderr, "Usage: %s [--peak <nits>]... [--min <nits>] [--size <texels>] [--shaper pq|log2] [--threads <count>] [--output <directory>]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (peaks.empty()) {
+		peaks = { 400.f, 600.f, 1000.f, 1500.f, 2000.f, 4000.f };
+	}
+	if (minNits <= 0.f || std::any_of(peaks.begin(), peaks.end(), [&](float a_peak) { return a_peak <= minNits; })) {
+		std::fprintf(stderr, "Peaks must be above the min luminance, which must be above 0\n");
+		return 1;
+	}
+	std::filesystem::create_directories(outputDirectory);
+
+	constexpr std::size_t     kSamples = 1 << 18;
+	const std::vector<Float3> samples = Metrics::MakeSamples(kSamples);
+	std::vector<float>        sampleR(kSamples), sampleG(kSamples), sampleB(kSamples);
+	for (std::size_t i = 0; i < kSamples; ++i) {
+		sampleR[i] = samples[i].x;
+		sampleG[i] = samples[i].y;
+		sampleB[i] = samples[i].z;
+	}
+
+	const char* shaperName = shaper == LUTShaper::kPQ ? "pq" : "log2";
+	for (const float peak : peaks) {
+		ShapedLUT  lut(size, shaper);
+		const auto start = std::chrono::steady_clock::now();
+		ACESTransform::BakeLUT(minNits, peak, lut, threadCount);
+		const double bakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		// Errors of what the display shows, the outputs being relative to its peak
+		const ACESTransform::Params params = ACESTransform::MakeParams(minNits, peak);
+		const float                 scale = peak / Color::kWhiteNits_sRGB;
+		std::vector<double>         errors(kSamples);
+		for (std::size_t i = 0; i < kSamples; ++i) {
+			errors[i] = Metrics::DeltaEITP(lut.Sample(samples[i]) * scale, ACESTransform::RRTODT(samples[i], params, minNits, peak) * scale);
+		}
+		const Metrics::ErrorStats error = Metrics::GetErrorStats(errors);
+
+		// The 9 significant digits that round trip a float, so different peaks never share a file.
+		// The extension is appended rather than replaced, as a fractional peak already has a dot in the name.
+		char name[64];
+		std::snprintf(name, sizeof(name), "ACES_%.9gnits_%zu_%s", peak, size, shaperName);
+		const std::string basePath = (outputDirectory / name).string();
+		if (!WriteCube(basePath + ".cube", lut, minNits, peak) || !WriteDDS(basePath + ".dds", lut)) {
+			std::fprintf(stderr, "Failed to write %s\n", basePath.c_str());
+			return 1;
+		}
+		std::printf("%s: baked in %.1f ms, Delta E ITP mean %.3f, 99.9%% %.3f, max %.3f\n", name, bakeMs, error.mean, error.percentile999, error.max);
+	}
+
+	// The batch evaluation on one thread and on all of them, in place on copies of the samples
+	for (const std::size_t threads : { std::size_t(1), threadCount }) {
+		std::vector<float> r = sampleR;
+		std::vector<float> g = sampleG;
+		std::vector<float> b = sampleB;
+
+		const ACESTransform::Params params = ACESTransform::MakeParams(minNits, peaks.front());
+		const auto                  start = std::chrono::steady_clock::now();
+		ACESTransform::RRTODT(r.data(), g.data(), b.data(), kSamples, params, minNits, peaks.front(), threads);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::printf("Batch RRT+ODT on %s: %.1f M colors/s\n", threads == 1 ? "one thread" : "all threads", static_cast<double>(kSamples) / seconds * 1e-6);
+		if (threadCount == 1) {
+			break;
+		}
+	}
+	return 0;
+}
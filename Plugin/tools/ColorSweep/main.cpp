@@ -0,0 +1,305 @@
+// Checks the SIMD lanes of "Color.h" against double precision references on every float of each function's domain, next to the scalar float versions.
+// Usage: ColorSweep [--stride <count>] [--threads <count>]
+// "--stride" only takes every nth float of each domain, for a quicker run.
+// Inputs go through "Color::ForEach()" (so the widest lanes of the build and the padded tail), and through "__m128" too in AVX2 builds,
+// as the header promises both return the same bits within a build. Builds with FMA contraction return different bits than SSE2 builds, so the bounds
+// need to hold for both (e.g. "-march=haswell" with GCC, which contracts by default).
+// "Atan2()" is swept along the edges of the unit square (every float of y with x = 1, every float of x with y = 1), which goes through every
+// ratio the polynomial sees, on both sides of the octant fold and on both signs of either argument.
+// The lookup tables of "ColorLUT.h" are swept on every float of [0, 1] through their float and "__m128" "Sample()", and the code value tables
+// on every code.
+// The exit code is 1 if any max error goes past the bounds listed at the top of "Color.h" and "ColorLUT.h" (in brackets), or if the lanes disagree.
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <numbers>
+#include <string_view>
+#include <vector>
+
+#include "ColorLUT.h"
+#include "ParallelFor.h"
+
+namespace
+{
+	using namespace Color;
+
+	constexpr std::size_t kBlockSize = 1 << 16;
+
+	// Errors are relative to the reference wherever it's above "floor", absolute otherwise
+	struct Bound
+	{
+		double maxError;
+		bool   bRelative = false;
+		double floor = 0.0;
+	};
+
+	struct Result
+	{
+		double        maxError = 0.0;
+		double        maxScalarError = 0.0;
+		float         worstInput = 0.f;
+		std::uint64_t count = 0;
+		std::uint64_t laneMismatches = 0;  // inputs where "__m128" and the widest lanes differ
+
+		void Merge(const Result& a_other)
+		{
+			if (a_other.maxError > maxError) {
+				maxError = a_other.maxError;
+				worstInput = a_other.worstInput;
+			}
+			maxScalarError = std::max(maxScalarError, a_other.maxScalarError);
+			count += a_other.count;
+			laneMismatches += a_other.laneMismatches;
+		}
+	};
+
+	double GetError(double a_value, double a_reference, const Bound& a_bound)
+	{
+		const double error = std::abs(a_value - a_reference);
+		if (a_bound.bRelative) {
+			return std::abs(a_reference) > a_bound.floor ? error / std::abs(a_reference) : 0.0;
+		}
+		return error;
+	}
+
+	// Every float of [a_from, a_to] as runs of bit patterns (first and last included), one per sign
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> GetFloatRuns(float a_from, float a_to)
+	{
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> runs;
+		if (a_from < 0.f) {
+			runs.emplace_back(std::bit_cast<std::uint32_t>(std::min(a_to, -0.f)), std::bit_cast<std::uint32_t>(a_from));
+		}
+		if (a_to >= 0.f) {
+			runs.emplace_back(std::bit_cast<std::uint32_t>(std::max(a_from, 0.f)), std::bit_cast<std::uint32_t>(a_to));
+		}
+		return runs;
+	}
+
+	// "a_function" is a generic lambda of one lane argument, "a_reference" takes and returns doubles
+	template <class F, class R>
+	bool Sweep(const char* a_name, float a_from, float a_to, const Bound& a_bound, F a_function, R a_reference, std::uint32_t a_stride, std::size_t a_threadCount)
+	{
+		Result     result;
+		std::mutex mutex;
+		for (const auto& [first, last] : GetFloatRuns(a_from, a_to)) {
+			const std::uint64_t count = (static_cast<std::uint64_t>(last) - first) / a_stride + 1;
+			const std::uint32_t runFirst = first;
+			ToneMapping::ParallelFor((count + kBlockSize - 1) / kBlockSize, a_threadCount, [&](std::size_t a_block) {
+				const std::uint64_t begin = a_block * kBlockSize;
+				const std::size_t   size = static_cast<std::size_t>(std::min<std::uint64_t>(kBlockSize, count - begin));
+
+				std::vector<float> inputs(size);
+				for (std::size_t i = 0; i < size; ++i) {
+					inputs[i] = std::bit_cast<float>(static_cast<std::uint32_t>(runFirst + (begin + i) * a_stride));
+				}
+				std::vector<float> outputs = inputs;
+				ForEach(outputs.data(), size, a_function);
+
+				Result blockResult;
+				blockResult.count = size;
+#ifdef __AVX2__
+				std::vector<float> sseOutputs = inputs;
+				for (std::size_t i = 0; i + 4 <= size; i += 4) {
+					Store(sseOutputs.data() + i, a_function(_mm_loadu_ps(inputs.data() + i)));
+				}
+				for (std::size_t i = 0; i < (size & ~std::size_t(3)); ++i) {
+					blockResult.laneMismatches += std::bit_cast<std::uint32_t>(sseOutputs[i]) != std::bit_cast<std::uint32_t>(outputs[i]);
+				}
+#endif
+				for (std::size_t i = 0; i < size; ++i) {
+					const double reference = a_reference(static_cast<double>(inputs[i]));
+					const double error = GetError(outputs[i], reference, a_bound);
+					if (!(error <= blockResult.maxError)) {
+						blockResult.maxError = error;
+						blockResult.worstInput = inputs[i];
+					}
+					blockResult.maxScalarError = std::max(blockResult.maxScalarError, GetError(a_function(inputs[i]), reference, a_bound));
+				}
+
+				const std::lock_guard lock(mutex);
+				result.Merge(blockResult);
+			});
+		}
+
+		const bool bPassed = result.maxError <= a_bound.maxError && result.laneMismatches == 0;
+		std::printf("%-28s %s: %s %.2e at %.9g (max %.1e), scalar %.2e, %llu floats", a_name, bPassed ? "passed" : "FAILED", a_bound.bRelative ? "relative" : "absolute",
+			result.maxError, result.worstInput, a_bound.maxError, result.maxScalarError, static_cast<unsigned long long>(result.count));
+		if (result.laneMismatches) {
+			std::printf(", %llu differ between SSE2 and AVX2", static_cast<unsigned long long>(result.laneMismatches));
+		}
+		std::printf("\n");
+		return bPassed;
+	}
+
+	// A table of "ColorLUT.h" on every float of [a_from, a_to], through "Sample(float)" and "Sample(__m128)", which must return the same bits
+	template <class T, class R>
+	bool SweepTable(const char* a_name, float a_from, float a_to, const Bound& a_bound, const T& a_table, R a_reference, std::uint32_t a_stride, std::size_t a_threadCount)
+	{
+		Result     result;
+		std::mutex mutex;
+		for (const auto& [first, last] : GetFloatRuns(a_from, a_to)) {
+			const std::uint64_t count = (static_cast<std::uint64_t>(last) - first) / a_stride + 1;
+			const std::uint32_t runFirst = first;
+			ToneMapping::ParallelFor((count + kBlockSize - 1) / kBlockSize, a_threadCount, [&](std::size_t a_block) {
+				const std::uint64_t begin = a_block * kBlockSize;
+				const std::size_t   size = static_cast<std::size_t>(std::min<std::uint64_t>(kBlockSize, count - begin));
+
+				std::vector<float> inputs(size);
+				for (std::size_t i = 0; i < size; ++i) {
+					inputs[i] = std::bit_cast<float>(static_cast<std::uint32_t>(runFirst + (begin + i) * a_stride));
+				}
+				std::vector<float> sseOutputs = inputs;
+				for (std::size_t i = 0; i + 4 <= size; i += 4) {
+					_mm_storeu_ps(sseOutputs.data() + i, a_table.Sample(_mm_loadu_ps(inputs.data() + i)));
+				}
+
+				Result blockResult;
+				blockResult.count = size;
+				for (std::size_t i = 0; i < size; ++i) {
+					const float  output = a_table.Sample(inputs[i]);
+					const double error = GetError(output, a_reference(static_cast<double>(inputs[i])), a_bound);
+					if (!(error <= blockResult.maxError)) {
+						blockResult.maxError = error;
+						blockResult.worstInput = inputs[i];
+					}
+					if (i < (size & ~std::size_t(3))) {
+						blockResult.laneMismatches += std::bit_cast<std::uint32_t>(sseOutputs[i]) != std::bit_cast<std::uint32_t>(output);
+					}
+				}
+
+				const std::lock_guard lock(mutex);
+				result.Merge(blockResult);
+			});
+		}
+
+		const bool bPassed = result.maxError <= a_bound.maxError && result.laneMismatches == 0;
+		std::printf("%-28s %s: %s %.2e at %.9g (max %.1e), %llu floats", a_name, bPassed ? "passed" : "FAILED", a_bound.bRelative ? "relative" : "absolute",
+			result.maxError, result.worstInput, a_bound.maxError, static_cast<unsigned long long>(result.count));
+		if (result.laneMismatches) {
+			std::printf(", %llu differ between float and SSE", static_cast<unsigned long long>(result.laneMismatches));
+		}
+		std::printf("\n");
+		return bPassed;
+	}
+
+	// A table of every code value, each must be its reference rounded to float (half an ulp, plus what the table's compile time
+	// pow() is off by, a few 1e-14, for the references that land next to a tie)
+	template <std::size_t N, class R>
+	bool CheckCodes(const char* a_name, const std::array<float, N>& a_table, R a_reference)
+	{
+		constexpr double kMaxUlps = 0.5 + 1e-6;
+
+		double      maxUlps = 0.0;
+		std::size_t worstCode = 0;
+		for (std::size_t code = 0; code < N; ++code) {
+			const double reference = a_reference(static_cast<double>(code) / (N - 1));
+			const float  value = a_table[code];
+			const double ulps = std::abs(value - reference) / (std::nextafter(value, FLT_MAX) - value);
+			if (!(ulps <= maxUlps)) {
+				maxUlps = ulps;
+				worstCode = code;
+			}
+		}
+
+		const bool bPassed = maxUlps <= kMaxUlps;
+		std::printf("%-28s %s: %.3f ulps at code %zu (max %.6f), %zu codes\n", a_name, bPassed ? "passed" : "FAILED", maxUlps, worstCode, kMaxUlps, N);
+		return bPassed;
+	}
+
+	double LinearToPQReference(double a_value)
+	{
+		const double colorPow = std::pow(a_value, static_cast<double>(kPQ_M1));
+		return std::pow((kPQ_C1 + kPQ_C2 * colorPow) / (1.0 + kPQ_C3 * colorPow), static_cast<double>(kPQ_M2));
+	}
+
+	double PQToLinearReference(double a_value)
+	{
+		const double colorPow = std::pow(a_value, 1.0 / kPQ_M2);
+		return std::pow(std::max(colorPow - kPQ_C1, 0.0) / (kPQ_C2 - kPQ_C3 * colorPow), 1.0 / kPQ_M1);
+	}
+
+	double LinearToSRGBReference(double a_value) { return a_value <= 0.0031308 ? a_value * 12.92 : 1.055 * std::pow(a_value, 1.0 / 2.4) - 0.055; }
+	double SRGBToLinearReference(double a_value) { return a_value <= 0.04045 ? a_value / 12.92 : std::pow((a_value + 0.055) / 1.055, 2.4); }
+}
+
+int main(int argc, char** argv)
+{
+	std::uint32_t stride = 1;
+	std::size_t   threadCount = 0;
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--stride" && i + 1 < argc) {
+			stride = static_cast<std::uint32_t>(std::max(std::atoi(argv[++i]), 1));
+		} else if (argument == "--threads" && i + 1 < argc) {
+			threadCount = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 0));
+		} else {
+			std::fprintf(stderr, "Usage: %s [--stride <count>] [--threads <count>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::printf("%zu lanes, every %u float(s) of each domain\n", kWideLanes, stride);
+
+	// The bounds listed in brackets in "Color.h", about twice the measured errors
+	constexpr Bound kLog2 = { 1.6e-5 };
+	constexpr Bound kExp2 = { 2.5e-7, true, FLT_MIN };
+	constexpr Bound kTransferUnit = { 5e-7 };
+	constexpr Bound kTransferBeyondOne = { 1.8e-6, true };
+	constexpr Bound kPQEncode = { 3e-5 };
+	constexpr Bound kPQDecode = { 1.2e-4 };
+	constexpr Bound kTrigonometry = { 6e-7 };
+	constexpr Bound kAtan2 = { 4e-6 };
+	constexpr float kTwoPi = 2.f * std::numbers::pi_v<float>;
+
+	const auto sweep = [&](const char* a_name, float a_from, float a_to, const Bound& a_bound, auto a_function, auto a_reference) {
+		return Sweep(a_name, a_from, a_to, a_bound, a_function, a_reference, stride, threadCount);
+	};
+
+	bool bPassed = true;
+	bPassed &= sweep("Log2", FLT_TRUE_MIN, FLT_MAX, kLog2, [](auto a_value) { return Log2(a_value); }, [](double a_value) { return std::log2(a_value); });
+	bPassed &= sweep("Exp2", -150.f, 127.f, kExp2, [](auto a_value) { return Exp2(a_value); }, [](double a_value) { return std::exp2(a_value); });
+	bPassed &= sweep("LinearToSRGB", 0.f, 1.f, kTransferUnit, [](auto a_value) { return LinearToSRGB(a_value); }, LinearToSRGBReference);
+	bPassed &= sweep("LinearToSRGB beyond 1", 1.f, kPQMaxWhitePoint, kTransferBeyondOne, [](auto a_value) { return LinearToSRGB(a_value); }, LinearToSRGBReference);
+	bPassed &= sweep("SRGBToLinear", 0.f, 1.f, kTransferUnit, [](auto a_value) { return SRGBToLinear(a_value); }, SRGBToLinearReference);
+	bPassed &= sweep("SRGBToLinear beyond 1", 1.f, 8.f, kTransferBeyondOne, [](auto a_value) { return SRGBToLinear(a_value); }, SRGBToLinearReference);
+	bPassed &= sweep("LinearToGamma", 0.f, 1.f, kTransferUnit, [](auto a_value) { return LinearToGamma(a_value); }, [](double a_value) { return std::pow(a_value, 1.0 / 2.2); });
+	bPassed &= sweep("LinearToGamma beyond 1", 1.f, kPQMaxWhitePoint, kTransferBeyondOne, [](auto a_value) { return LinearToGamma(a_value); }, [](double a_value) { return std::pow(a_value, 1.0 / 2.2); });
+	bPassed &= sweep("GammaToLinear", 0.f, 1.f, kTransferUnit, [](auto a_value) { return GammaToLinear(a_value); }, [](double a_value) { return std::pow(a_value, 2.2); });
+	bPassed &= sweep("GammaToLinear beyond 1", 1.f, 8.f, kTransferBeyondOne, [](auto a_value) { return GammaToLinear(a_value); }, [](double a_value) { return std::pow(a_value, 2.2); });
+	bPassed &= sweep("LinearToPQ (scRGB)", 0.f, kPQMaxWhitePoint, kPQEncode, [](auto a_value) { return LinearToPQ(a_value, kPQMaxWhitePoint); }, [](double a_value) { return LinearToPQReference(a_value / kPQMaxWhitePoint); });
+	bPassed &= sweep("PQToLinear", 0.f, 1.f, kPQDecode, [](auto a_value) { return PQToLinear(a_value); }, PQToLinearReference);
+	bPassed &= sweep("Sin", -kTwoPi, kTwoPi, kTrigonometry, [](auto a_value) { return Sin(a_value); }, [](double a_value) { return std::sin(a_value); });
+	bPassed &= sweep("Cos", -kTwoPi, kTwoPi, kTrigonometry, [](auto a_value) { return Cos(a_value); }, [](double a_value) { return std::cos(a_value); });
+	bPassed &= sweep("Atan2(y, 1)", -1.f, 1.f, kAtan2, [](auto a_value) { return Atan2(a_value, Splat<decltype(a_value)>(1.f)); }, [](double a_value) { return std::atan2(a_value, 1.0); });
+	bPassed &= sweep("Atan2(1, x)", -1.f, 1.f, kAtan2, [](auto a_value) { return Atan2(Splat<decltype(a_value)>(1.f), a_value); }, [](double a_value) { return std::atan2(1.0, a_value); });
+
+	// The tables of "ColorLUT.h", with the bounds listed in brackets at its top
+	constexpr Bound kPQEncodeTable = { 1e-5 };
+	constexpr Bound kSRGBEncodeTable = { 1.2e-5 };
+	constexpr Bound kGammaEncodeTable = { 4.5e-5 };
+	constexpr Bound kPQDecodeTable = { 2.5e-5 };
+	constexpr Bound kSRGBDecodeTable = { 1e-6 };
+	constexpr Bound kGammaDecodeTable = { 8e-7 };
+
+	const auto sweepTable = [&](const char* a_name, const Bound& a_bound, const auto& a_table, auto a_reference) {
+		return SweepTable(a_name, 0.f, 1.f, a_bound, a_table, a_reference, stride, threadCount);
+	};
+
+	bPassed &= sweepTable("kLinearToPQTable", kPQEncodeTable, kLinearToPQTable, LinearToPQReference);
+	bPassed &= sweepTable("kLinearToSRGBTable", kSRGBEncodeTable, kLinearToSRGBTable, LinearToSRGBReference);
+	bPassed &= sweepTable("kLinearToGammaTable", kGammaEncodeTable, kLinearToGammaTable, [](double a_value) { return std::pow(a_value, 1.0 / 2.2); });
+	bPassed &= sweepTable("kPQToLinearTable", kPQDecodeTable, kPQToLinearTable, PQToLinearReference);
+	bPassed &= sweepTable("kSRGBToLinearTable", kSRGBDecodeTable, kSRGBToLinearTable, SRGBToLinearReference);
+	bPassed &= sweepTable("kGammaToLinearTable", kGammaDecodeTable, kGammaToLinearTable, [](double a_value) { return std::pow(a_value, 2.2); });
+	bPassed &= CheckCodes("kPQ10BitToLinear", kPQ10BitToLinear, PQToLinearReference);
+	bPassed &= CheckCodes("GetPQ16BitToLinear()", GetPQ16BitToLinear(), PQToLinearReference);
+
+	return bPassed ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "Color.h"
+
+// Error measurements shared by the tools: BT.2124 Delta E ITP, the random colors LUTs are compared on, and error statistics.
+namespace Metrics
+{
+	using Color::Float3;
+
+	// ICtCp of linear BT.709 (1 is 80 nits), in double precision. In float, the PQ encode's exponent of ~79 amplifies the rounding
+	// of its base to ~1e-5, which is already ~0.01 Delta E ITP between two colors that only differ in their last bits.
+	inline std::array<double, 3> BT709_To_ICtCp(const Float3& a_color)
+	{
+		const double rgb[3] = { a_color.x, a_color.y, a_color.z };
+		double       pqLMS[3];
+		for (int i = 0; i < 3; ++i) {
+			double lms = 0.0;
+			for (int j = 0; j < 3; ++j) {
+				lms += static_cast<double>(Color::kBT709_To_LMS[i][j]) * rgb[j];
+			}
+			const double colorPow = std::pow(std::max(lms / Color::kPQMaxWhitePoint, 0.0), static_cast<double>(Color::kPQ_M1));
+			pqLMS[i] = std::pow((Color::kPQ_C1 + Color::kPQ_C2 * colorPow) / (1.0 + Color::kPQ_C3 * colorPow), static_cast<double>(Color::kPQ_M2));
+		}
+
+		std::array<double, 3> ictcp = {};
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				ictcp[i] += static_cast<double>(Color::kPQLMS_To_ICtCp[i][j]) * pqLMS[j];
+			}
+		}
+		return ictcp;
+	}
+
+	// Squared ITP distance of two linear BT.709 colors (1 is 80 nits), T being half of Ct
+	inline double SquaredITPError(const Float3& a_a, const Float3& a_b)
+	{
+		const auto   a = BT709_To_ICtCp(a_a);
+		const auto   b = BT709_To_ICtCp(a_b);
+		const double i = a[0] - b[0];
+		const double t = 0.5 * (a[1] - b[1]);
+		const double p = a[2] - b[2];
+		return i * i + t * t + p * p;
+	}
+
+	// BT.2124 Delta E ITP of two linear BT.709 colors (1 is 80 nits), 720 scales a just noticeable difference to ~1
+	inline double DeltaEITP(const Float3& a_a, const Float3& a_b)
+	{
+		return 720.0 * std::sqrt(SquaredITPError(a_a, a_b));
+	}
+
+	// Random scene linear colors: a max channel from 2^-12 to 2^6 (log uniform) and random ratios for the other channels, so every hue and saturation.
+	// The same on every run.
+	inline std::vector<Float3> MakeSamples(std::size_t a_count)
+	{
+		std::mt19937                          random(1234);
+		std::uniform_real_distribution<float> exponent(-12.f, 6.f);
+		std::uniform_real_distribution<float> ratio(0.f, 1.f);
+
+		std::vector<Float3> samples(a_count);
+		for (auto& sample : samples) {
+			const Float3 ratios = { ratio(random), ratio(random), ratio(random) };
+			const float  maxRatio = std::max({ ratios.x, ratios.y, ratios.z, FLT_MIN });
+			sample = ratios * (std::exp2(exponent(random)) / maxRatio);
+		}
+		return samples;
+	}
+
+	struct ErrorStats
+	{
+		double mean = 0.0;
+		double percentile999 = 0.0;
+		double max = 0.0;
+	};
+
+	// Mean, 99.9th percentile and max of "a_errors", which get reordered
+	inline ErrorStats GetErrorStats(std::vector<double>& a_errors)
+	{
+		ErrorStats stats;
+		if (a_errors.empty()) {
+			return stats;
+		}
+		for (const double error : a_errors) {
+			stats.mean += error;
+		}
+		stats.mean /= static_cast<double>(a_errors.size());
+		const auto percentile = a_errors.begin() + static_cast<std::ptrdiff_t>(static_cast<double>(a_errors.size() - 1) * 0.999);
+		std::nth_element(a_errors.begin(), percentile, a_errors.end());
+		stats.percentile999 = *percentile;
+		stats.max = *std::max_element(percentile, a_errors.end());
+		return stats;
+	}
+}
@@ -0,0 +1,841 @@
+#include "HDRComposite.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <type_traits>
+#include <variant>
+
+#include "ParallelFor.h"
+
+namespace HDRComposite
+{
+	namespace
+	{
+		using namespace ToneMapping;
+
+		constexpr float kPostProcessStrength = 1.f;
+		constexpr float kHDRHighlightsModulation = 1.f;
+		constexpr float kOklabGamma = 3.f;
+		constexpr float kLUTMax = static_cast<float>(kLUTSize - 1);
+		constexpr int   kLUTExtrapolationColorSpace = 5;  // "DEFAULT_LUT_EXTRAPOLATION_COLOR_SPACE", OkLCh keeping the LUT edge hue
+
+		float Luminance(const Float3& a_color) { return Color::Luminance(a_color); }
+
+		Float3 Floor(const Float3& a_color) { return Apply(a_color, [](float a_channel) { return std::floor(a_channel); }); }
+		Float3 Ceil(const Float3& a_color) { return Apply(a_color, [](float a_channel) { return std::ceil(a_channel); }); }
+
+		Float3 LinearToSRGBMirrored(const Float3& a_color) { return Apply(a_color, [](float a_channel) { return Color::LinearToSRGBMirrored(a_channel); }); }
+		Float3 SRGBToLinearMirrored(const Float3& a_color) { return Apply(a_color, [](float a_channel) { return Color::SRGBToLinearMirrored(a_channel); }); }
+		Float3 LinearToGammaMirrored(const Float3& a_color, float a_gamma) { return Apply(a_color, [&](float a_channel) { return Color::LinearToGammaMirrored(a_channel, a_gamma); }); }
+
+		// "cubeCoordinatesIntersection" of "math.hlsl", "a_sideNormal" faces the origin
+		bool CubeCoordinatesIntersection(Float3& a_outIntersection, const Float3& a_coordinates, const Float3& a_sideNormal)
+		{
+			const float dot = Color::Dot(a_sideNormal, a_coordinates);
+			if (dot >= -1.f) {
+				return false;
+			}
+			a_outIntersection = a_coordinates * (-1.f / dot);
+			return true;
+		}
+
+		// "clampCubeCoordinates" of "math.hlsl" (without "clampFromCenter"): brings coordinates beyond 1 back onto the unit cube along their direction
+		Float3 ClampCubeCoordinates(const Float3& a_coordinates)
+		{
+			if (Length(a_coordinates - Saturate(a_coordinates)) <= FLT_MIN) {
+				return a_coordinates;
+			}
+
+			Float3 bestIntersection = a_coordinates;
+			Float3 currentIntersection;
+			float  intersection1Length = FLT_MAX;
+			float  intersection2Length = FLT_MAX;
+			if (CubeCoordinatesIntersection(currentIntersection, a_coordinates, { -1.f, 0.f, 0.f })) {
+				intersection1Length = Length(currentIntersection);
+				bestIntersection = currentIntersection;
+			}
+			if (CubeCoordinatesIntersection(currentIntersection, a_coordinates, { 0.f, -1.f, 0.f })) {
+				intersection2Length = Length(currentIntersection);
+				if (intersection2Length < intersection1Length) {
+					bestIntersection = currentIntersection;
+				}
+			}
+			if (CubeCoordinatesIntersection(currentIntersection, a_coordinates, { 0.f, 0.f, -1.f })) {
+				const float intersection3Length = Length(currentIntersection);
+				if (intersection3Length < intersection1Length && intersection3Length < intersection2Length) {
+					bestIntersection = currentIntersection;
+				}
+			}
+			return bestIntersection;
+		}
+
+		// Takes LUT coordinates, returns the LUT color (linear)
+		Float3 TetrahedralInterpolation(const Texture3D& a_lut, const Float3& a_coordinates)
+		{
+			const Float3 coords = Saturate(a_coordinates) * kLUTMax;
+
+			const std::ptrdiff_t baseX = static_cast<std::ptrdiff_t>(coords.x);
+			const std::ptrdiff_t baseY = static_cast<std::ptrdiff_t>(coords.y);
+			const std::ptrdiff_t baseZ = static_cast<std::ptrdiff_t>(coords.z);
+			const Float3         fract = coords - Floor(coords);
+
+			const Float3 v1 = a_lut.Load(baseX, baseY, baseZ);
+			const Float3 v4 = a_lut.Load(baseX + 1, baseY + 1, baseZ + 1);
+
+			int   v2[3], v3[3];
+			float f1, f2, f3, f4;
+			const auto setup = [&](std::initializer_list<int> a_v2, std::initializer_list<int> a_v3, float a_f1, float a_f2, float a_f3, float a_f4) {
+				std::copy(a_v2.begin(), a_v2.end(), v2);
+				std::copy(a_v3.begin(), a_v3.end(), v3);
+				f1 = a_f1;
+				f2 = a_f2;
+				f3 = a_f3;
+				f4 = a_f4;
+			};
+
+			if (fract.x >= fract.y) {
+				if (fract.y >= fract.z) {  // R > G > B
+					setup({ 1, 0, 0 }, { 1, 1, 0 }, 1.f - fract.x, fract.x - fract.y, fract.y - fract.z, fract.z);
+				} else if (fract.x >= fract.z) {  // R > B > G
+					setup({ 1, 0, 0 }, { 1, 0, 1 }, 1.f - fract.x, fract.x - fract.z, fract.z - fract.y, fract.y);
+				} else {  // B > R > G
+					setup({ 0, 0, 1 }, { 1, 0, 1 }, 1.f - fract.z, fract.z - fract.x, fract.x - fract.y, fract.y);
+				}
+			} else {
+				if (fract.y <= fract.z) {  // B > G > R
+					setup({ 0, 0, 1 }, { 0, 1, 1 }, 1.f - fract.z, fract.z - fract.y, fract.y - fract.x, fract.x);
+				} else if (fract.x >= fract.z) {  // G > R > B
+					setup({ 0, 1, 0 }, { 1, 1, 0 }, 1.f - fract.y, fract.y - fract.x, fract.x - fract.z, fract.z);
+				} else {  // G > B > R
+					setup({ 0, 1, 0 }, { 0, 1, 1 }, 1.f - fract.y, fract.y - fract.z, fract.z - fract.x, fract.x);
+				}
+			}
+
+			const Float3 v2Color = a_lut.Load(baseX + v2[0], baseY + v2[1], baseZ + v2[2]);
+			const Float3 v3Color = a_lut.Load(baseX + v3[0], baseY + v3[1], baseZ + v3[2]);
+			return (f1 * v1) + (f2 * v2Color) + (f3 * v3Color) + (f4 * v4);
+		}
+
+		// Re-applies the change post processing made from "a_sourceColor" to "a_postProcessedColor" on a similar color,
+		// by offset near black and by ratio elsewhere ("ForceKeepHue" is off with "HDR_POST_PROCESS_TYPE" 5)
+		Float3 RestorePostProcess(const Float3& a_colorToPostProcess, const Float3& a_sourceColor, const Float3& a_postProcessedColor)
+		{
+			const Float3 postProcessColorRatio = SafeDivision(a_postProcessedColor, a_sourceColor);
+			const Float3 postProcessColorOffset = a_postProcessedColor - a_sourceColor;
+			const Float3 postProcessedRatioColor = a_colorToPostProcess * postProcessColorRatio;
+			const Float3 postProcessedOffsetColor = a_colorToPostProcess + postProcessColorOffset;
+			const Float3 alpha = Apply(a_colorToPostProcess, [](float a_channel) { return Saturate(std::abs(a_channel / kMaxShadowsColor)); });
+			const Float3 sourceAlpha = Apply(a_sourceColor, [](float a_channel) { return Saturate(std::abs(a_channel / kMaxShadowsColor)); });
+			return Lerp(postProcessedOffsetColor, postProcessedRatioColor, Float3{ std::fmax(alpha.x, sourceAlpha.x), std::fmax(alpha.y, sourceAlpha.y), std::fmax(alpha.z, sourceAlpha.z) });
+		}
+
+		// Restores the linear color of highlights the SDR tonemapper compressed, keeping the tonemapped color below them (scaled to connect the curves)
+		void PostInverseTonemapByChannel(float a_inputChannel, float a_tonemappedChannel, float& a_inverseTonemappedChannel, float a_minHighlightsColorIn, float a_minHighlightsColorOut)
+		{
+			constexpr float kHighlightAlphaBlendMultiplier = 2.5f;
+
+			const bool  bIsHighlight = a_inputChannel >= a_minHighlightsColorOut;
+			const float highlightAlpha = Saturate(((a_inputChannel - a_minHighlightsColorOut) / a_minHighlightsColorOut) * kHighlightAlphaBlendMultiplier);
+
+			const float sourceHighlightInverseTonemappedChannel = a_tonemappedChannel * (a_minHighlightsColorOut / a_minHighlightsColorIn);
+			if (!bIsHighlight) {
+				a_inverseTonemappedChannel = sourceHighlightInverseTonemappedChannel;
+			} else {
+				a_inverseTonemappedChannel = Lerp(sourceHighlightInverseTonemappedChannel, a_inputChannel, highlightAlpha);
+			}
+		}
+	}
+
+	ToneMapping::ToneCurveInputs GetToneCurveInputs(const Constants& a_constants)
+	{
+		ToneMapping::ToneCurveInputs inputs;
+		inputs.Tmo = a_constants.push.Tmo;
+		inputs.ToneMapperType = a_constants.plugin.ToneMapperType;
+		inputs.DisplayMode = a_constants.plugin.DisplayMode;
+		inputs.PeakBrightness = a_constants.plugin.PeakBrightness;
+		inputs.Contrast = a_constants.plugin.Contrast;
+		inputs.Shadows = a_constants.plugin.Shadows;
+		inputs.AcesParam0 = a_constants.scene.AcesParam0;
+		inputs.AcesParam1 = a_constants.scene.AcesParam1;
+		inputs.hable = a_constants.scene.hable;
+		return inputs;
+	}
+
+	bool SetConstant(Constants& a_constants, std::string_view a_name, double a_value)
+	{
+		struct Field
+		{
+			std::string_view                                    name;
+			std::variant<float*, std::int32_t*, std::uint32_t*> value;
+		};
+
+		auto&       plugin = a_constants.plugin;
+		auto&       data = a_constants.data;
+		auto&       scene = a_constants.scene;
+		const Field fields[] = {
+			{ "DisplayMode", &plugin.DisplayMode },
+			{ "PeakBrightness", &plugin.PeakBrightness },
+			{ "GamePaperWhite", &plugin.GamePaperWhite },
+			{ "UIPaperWhite", &plugin.UIPaperWhite },
+			{ "ExtendGamut", &plugin.ExtendGamut },
+			{ "SDRSecondaryBrightness", &plugin.SDRSecondaryBrightness },
+			{ "ToneMapperType", &plugin.ToneMapperType },
+			{ "Saturation", &plugin.Saturation },
+			{ "Contrast", &plugin.Contrast },
+			{ "Highlights", &plugin.Highlights },
+			{ "Shadows", &plugin.Shadows },
+			{ "Bloom", &plugin.Bloom },
+			{ "ColorGradingStrength", &plugin.ColorGradingStrength },
+			{ "LUTCorrectionStrength", &plugin.LUTCorrectionStrength },
+			{ "StrictLUTApplication", &plugin.StrictLUTApplication },
+			{ "GammaCorrectionStrength", &plugin.GammaCorrectionStrength },
+			{ "bIsAtEndOfFrame", &plugin.bIsAtEndOfFrame },
+			{ "DevSetting01", &plugin.DevSetting01 },
+			{ "DevSetting02", &plugin.DevSetting02 },
+			{ "DevSetting03", &plugin.DevSetting03 },
+			{ "DevSetting04", &plugin.DevSetting04 },
+			{ "DevSetting05", &plugin.DevSetting05 },
+			{ "HighlightsColorFilter.r", &data.HighlightsColorFilter.rgb.x },
+			{ "HighlightsColorFilter.g", &data.HighlightsColorFilter.rgb.y },
+			{ "HighlightsColorFilter.b", &data.HighlightsColorFilter.rgb.z },
+			{ "HighlightsColorFilter.a", &data.HighlightsColorFilter.a },
+			{ "ColorFilter.r", &data.ColorFilter.rgb.x },
+			{ "ColorFilter.g", &data.ColorFilter.rgb.y },
+			{ "ColorFilter.b", &data.ColorFilter.rgb.z },
+			{ "ColorFilter.a", &data.ColorFilter.a },
+			{ "HableSaturation", &data.HableSaturation },
+			{ "BrightnessMultiplier", &data.BrightnessMultiplier },
+			{ "ContrastIntensity", &data.ContrastIntensity },
+			{ "Tmo", &a_constants.push.Tmo },
+			{ "BloomMultiplier", &a_constants.push.BloomMultiplier },
+			{ "AcesParam0", &scene.AcesParam0 },
+			{ "AcesParam1", &scene.AcesParam1 },
+			{ "toeStrength", &scene.hable.toeStrength },
+			{ "toeLength", &scene.hable.toeLength },
+			{ "shoulderStrength", &scene.hable.shoulderStrength },
+			{ "shoulderLength", &scene.hable.shoulderLength },
+			{ "shoulderAngle", &scene.hable.shoulderAngle },
+			{ "contrastMidPoint", &scene.contrastMidPoint },
+			{ "SDRTonemapHDRStrength", &a_constants.statics.SDRTonemapHDRStrength },
+		};
+
+		for (const auto& field : fields) {
+			if (field.name == a_name) {
+				std::visit([&](auto* a_field) { *a_field = static_cast<std::remove_pointer_t<decltype(a_field)>>(a_value); }, field.value);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool GetPermutation(std::uint32_t a_techniqueId, Permutation& a_outPermutation)
+	{
+		for (const auto& technique : kTechniques) {
+			if (technique.id == a_techniqueId) {
+				a_outPermutation = technique.permutation;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool SetDefine(Permutation& a_permutation, std::string_view a_define)
+	{
+		if (a_define == "APPLY_BLOOM") {
+			a_permutation.bBloom = true;
+		} else if (a_define == "APPLY_TONEMAPPING") {
+			a_permutation.bTonemapping = true;
+		} else if (a_define == "APPLY_CINEMATICS") {
+			a_permutation.bCinematics = true;
+		} else if (a_define == "APPLY_MERGED_COLOR_GRADING_LUT") {
+			a_permutation.bMergedLUT = true;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	Texture2D::Texture2D(std::size_t a_width, std::size_t a_height, const Float3& a_value) :
+		width(a_width),
+		height(a_height),
+		texels(a_width * a_height, a_value)
+	{}
+
+	Float3 Texture2D::Load(std::ptrdiff_t a_x, std::ptrdiff_t a_y) const
+	{
+		if (a_x < 0 || a_y < 0 || static_cast<std::size_t>(a_x) >= width || static_cast<std::size_t>(a_y) >= height) {
+			return { 0.f, 0.f, 0.f };
+		}
+		return texels[static_cast<std::size_t>(a_y) * width + static_cast<std::size_t>(a_x)];
+	}
+
+	Float3 Texture2D::SampleBilinear(float a_u, float a_v) const
+	{
+		if (texels.empty()) {
+			return { 0.f, 0.f, 0.f };
+		}
+
+		const float          x = a_u * static_cast<float>(width) - 0.5f;
+		const float          y = a_v * static_cast<float>(height) - 0.5f;
+		const float          floorX = std::floor(x);
+		const float          floorY = std::floor(y);
+		const float          fractX = x - floorX;
+		const float          fractY = y - floorY;
+		const std::ptrdiff_t maxX = static_cast<std::ptrdiff_t>(width) - 1;
+		const std::ptrdiff_t maxY = static_cast<std::ptrdiff_t>(height) - 1;
+		const std::ptrdiff_t x0 = std::clamp(static_cast<std::ptrdiff_t>(floorX), std::ptrdiff_t(0), maxX);
+		const std::ptrdiff_t x1 = std::clamp(static_cast<std::ptrdiff_t>(floorX) + 1, std::ptrdiff_t(0), maxX);
+		const std::ptrdiff_t y0 = std::clamp(static_cast<std::ptrdiff_t>(floorY), std::ptrdiff_t(0), maxY);
+		const std::ptrdiff_t y1 = std::clamp(static_cast<std::ptrdiff_t>(floorY) + 1, std::ptrdiff_t(0), maxY);
+
+		const Float3 top = Lerp(Load(x0, y0), Load(x1, y0), fractX);
+		const Float3 bottom = Lerp(Load(x0, y1), Load(x1, y1), fractX);
+		return Lerp(top, bottom, fractY);
+	}
+
+	Texture3D::Texture3D(std::size_t a_size) :
+		size(a_size),
+		texels(a_size * a_size * a_size)
+	{}
+
+	Float3 Texture3D::Load(std::ptrdiff_t a_x, std::ptrdiff_t a_y, std::ptrdiff_t a_z) const
+	{
+		const auto outside = [&](std::ptrdiff_t a_coordinate) { return a_coordinate < 0 || static_cast<std::size_t>(a_coordinate) >= size; };
+		if (outside(a_x) || outside(a_y) || outside(a_z)) {
+			return { 0.f, 0.f, 0.f };
+		}
+		return texels[(static_cast<std::size_t>(a_z) * size + static_cast<std::size_t>(a_y)) * size + static_cast<std::size_t>(a_x)];
+	}
+
+	Float3 Texture3D::SampleTrilinear(float a_u, float a_v, float a_w) const
+	{
+		if (texels.empty()) {
+			return { 0.f, 0.f, 0.f };
+		}
+
+		const std::ptrdiff_t maxCoordinate = static_cast<std::ptrdiff_t>(size) - 1;
+		std::ptrdiff_t       begin[3], end[3];
+		float                fract[3];
+		const float          uvw[3] = { a_u, a_v, a_w };
+		for (int i = 0; i < 3; ++i) {
+			const float coordinate = uvw[i] * static_cast<float>(size) - 0.5f;
+			const float floorCoordinate = std::floor(coordinate);
+			fract[i] = coordinate - floorCoordinate;
+			begin[i] = std::clamp(static_cast<std::ptrdiff_t>(floorCoordinate), std::ptrdiff_t(0), maxCoordinate);
+			end[i] = std::clamp(static_cast<std::ptrdiff_t>(floorCoordinate) + 1, std::ptrdiff_t(0), maxCoordinate);
+		}
+
+		const auto sampleSlice = [&](std::ptrdiff_t a_z) {
+			const Float3 top = Lerp(Load(begin[0], begin[1], a_z), Load(end[0], begin[1], a_z), fract[0]);
+			const Float3 bottom = Lerp(Load(begin[0], end[1], a_z), Load(end[0], end[1], a_z), fract[0]);
+			return Lerp(top, bottom, fract[1]);
+		};
+		return Lerp(sampleSlice(begin[2]), sampleSlice(end[2]), fract[2]);
+	}
+
+	Texture3D MakeNeutralLUT()
+	{
+		Texture3D lut(kLUTSize);
+		for (std::size_t z = 0; z < kLUTSize; ++z) {
+			for (std::size_t y = 0; y < kLUTSize; ++y) {
+				for (std::size_t x = 0; x < kLUTSize; ++x) {
+					const Float3 coordinates = Float3{ static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) } / kLUTMax;
+					lut.texels[(z * kLUTSize + y) * kLUTSize + x] = SRGBToLinearMirrored(coordinates);
+				}
+			}
+		}
+		return lut;
+	}
+
+	bool LoadLUTFromSlices(const Texture2D& a_slices, Texture3D& a_outLUT)
+	{
+		if (a_slices.width != kLUTSize * kLUTSize || a_slices.height != kLUTSize) {
+			return false;
+		}
+
+		a_outLUT = Texture3D(kLUTSize);
+		for (std::size_t z = 0; z < kLUTSize; ++z) {
+			for (std::size_t y = 0; y < kLUTSize; ++y) {
+				for (std::size_t x = 0; x < kLUTSize; ++x) {
+					a_outLUT.texels[(z * kLUTSize + y) * kLUTSize + x] = a_slices.texels[y * a_slices.width + z * kLUTSize + x];
+				}
+			}
+		}
+		return true;
+	}
+
+	Renderer::Renderer(const Constants& a_constants, const Permutation& a_permutation, bool a_bBakedToneCurves) :
+		constants(a_constants),
+		permutation(a_permutation),
+		neutralLUT(MakeNeutralLUT()),
+		acesParametricParams(MakeACESParametricParams(a_constants.scene.AcesParam0, a_constants.scene.AcesParam1)),
+		hableCurve(MakeHableCurve(a_constants.scene.hable, a_constants.plugin.Shadows))
+	{
+		if (a_bBakedToneCurves) {
+			toneCurves = std::make_unique<ToneCurves>();
+			BakeToneCurves(GetToneCurveInputs(a_constants), *toneCurves);
+		}
+	}
+
+	// "POST_PROCESS_CONTRAST_TYPE" 2
+	Float3 Renderer::PostProcess(const Float3& a_color) const
+	{
+		const HDRCompositeData& data = constants.data;
+		const float             contrastMidPoint = constants.scene.contrastMidPoint;
+
+		const float colorLuminance = Luminance(a_color);
+
+		// Saturation adjustment a la Hable, can cause negative colors
+		Float3 color = ((a_color - colorLuminance) * data.HableSaturation) + colorLuminance;
+
+		color += Lerp(Float3{ 0.f, 0.f, 0.f }, colorLuminance * data.HighlightsColorFilter.rgb, data.HighlightsColorFilter.a);
+		color *= data.BrightnessMultiplier;
+
+		const float adjustedContrastIntensity = std::pow(data.ContrastIntensity, 2.f);
+		color = Pow(Abs(color) / contrastMidPoint, adjustedContrastIntensity) * contrastMidPoint * Sign(color);
+
+		return Lerp(color, data.ColorFilter.rgb, data.ColorFilter.a);
+	}
+
+	void Renderer::ApplyCinematics(CompositeParams& a_params) const
+	{
+		if (permutation.bCinematics) {
+			a_params.outputColor = Lerp(a_params.outputColor, PostProcess(a_params.outputColor), kPostProcessStrength);
+		}
+	}
+
+	// "LUT_MAPPING_TYPE" 4 with tetrahedral interpolation, "LUT_EXTRAPOLATION_TYPE" 1.
+	// "a_coordinates" are the unclamped sRGB coordinates of "a_originalColor".
+	Float3 Renderer::SampleGradingLUT(const Texture3D& a_lut, const Float3& a_coordinates, const Float3& a_originalColor) const
+	{
+		const Float3& unclampedNeutralLUTColor = a_originalColor;
+		const Float3& unclampedLUTCoordinates = a_coordinates;
+		Float3        lutCoordinates = Saturate(a_coordinates);
+		const bool    bLUTCoordinatesClamped = Length(unclampedLUTCoordinates - lutCoordinates) > FLT_MIN;
+		const Float3  neutralLUTColor = Saturate(a_originalColor);
+
+		// Remap the coordinates so the LUT is interpolated in linear space between its sRGB spaced texels
+		const Float3 previousLUTCoordinatesGammaSpace = Floor(lutCoordinates * kLUTMax) / kLUTMax;
+		const Float3 nextLUTCoordinatesGammaSpace = Ceil(lutCoordinates * kLUTMax) / kLUTMax;
+		const Float3 previousLUTCoordinatesLinearSpace = SRGBToLinearMirrored(previousLUTCoordinatesGammaSpace);
+		const Float3 nextLUTCoordinatesLinearSpace = SRGBToLinearMirrored(nextLUTCoordinatesGammaSpace);
+		const Float3 stepSize = nextLUTCoordinatesLinearSpace - previousLUTCoordinatesLinearSpace;
+		const Float3 blendAlpha = SafeDivision(unclampedNeutralLUTColor - previousLUTCoordinatesLinearSpace, stepSize);
+		lutCoordinates = Lerp(previousLUTCoordinatesGammaSpace, nextLUTCoordinatesGammaSpace, blendAlpha);
+
+		constexpr float kLUTCoordinatesScale = kLUTMax / kLUTSize;
+		constexpr float kLUTCoordinatesOffset = 1.f / (2.f * kLUTSize);
+		Float3          lutColor = TetrahedralInterpolation(a_lut, lutCoordinates);
+
+		if (bLUTCoordinatesClamped) {
+			// Step back a texel from the cube edge, towards the inside, and extrapolate the color change between the two
+			const bool   bAccurateLUTCentering = constants.plugin.DevSetting04 <= 0.5f;
+			const float  lutCenteringMultiplier = bAccurateLUTCentering ? 1.f : (kLUTSize / 2.f);
+			const Float3 lutCenteredCoordinates = lutCoordinates - (Normalize(unclampedLUTCoordinates - lutCoordinates) * (lutCenteringMultiplier / kLUTMax));
+			const Float3 sampleCoordinates = (lutCenteredCoordinates * kLUTCoordinatesScale) + kLUTCoordinatesOffset;
+			const Float3 lutCenteredColor = a_lut.SampleTrilinear(sampleCoordinates.x, sampleCoordinates.y, sampleCoordinates.z);
+
+			// The color change in Oklab's perceptual space (pow 3)
+			const float extrapolationRatio = Length(LinearToGammaMirrored(unclampedNeutralLUTColor, kOklabGamma) - LinearToGammaMirrored(neutralLUTColor, kOklabGamma)) /
+			                                 Length(LinearToGammaMirrored(neutralLUTColor, kOklabGamma) - LinearToGammaMirrored(SRGBToLinearMirrored(lutCenteredCoordinates), kOklabGamma));
+
+			static_assert(kLUTExtrapolationColorSpace == 5);
+			const Float3 derivedLUTColor = Color::BT709_To_OkLCh(lutColor);
+			const Float3 derivedLUTCenteredColor = Color::BT709_To_OkLCh(lutCenteredColor);
+			Float3       extrapolatedDerivedLUTColor = derivedLUTColor + (derivedLUTColor - derivedLUTCenteredColor) * extrapolationRatio;
+			// Negative lightness or chroma would flip the hue
+			extrapolatedDerivedLUTColor.x = std::fmax(extrapolatedDerivedLUTColor.x, 0.f);
+			extrapolatedDerivedLUTColor.y = std::fmax(extrapolatedDerivedLUTColor.y, 0.f);
+			// Keep the hue of the LUT edge
+			lutColor = Color::OkLCh_To_BT709(Float3{ extrapolatedDerivedLUTColor.x, extrapolatedDerivedLUTColor.y, derivedLUTColor.z });
+
+			if (Luminance(lutColor) < 0.f) {
+				lutColor = { 0.f, 0.f, 0.f };
+			}
+		}
+		return lutColor;
+	}
+
+	// In and out linear, "MAINTAIN_CORRECTED_LUTS_TINT_AROUND_BLACK" on
+	Float3 Renderer::GradingLUT(const Inputs& a_inputs, const Float3& a_color, float a_u, float a_v) const
+	{
+		const ShaderConstants& plugin = constants.plugin;
+		const Texture3D&       lut = a_inputs.lut ? *a_inputs.lut : neutralLUT;
+
+		const Float3 lutCoordinates = LinearToSRGBMirrored(a_color);
+		Float3       lutColor = SampleGradingLUT(lut, lutCoordinates, a_color);
+
+		// Doubles the saturation within the first LUT sub cube of LUTs that are tinted there, as corrected LUTs always map black to black.
+		// "CLAMP_INPUT_OUTPUT_TYPE" is 1 so this runs in SDR too.
+		if (plugin.LUTCorrectionStrength != 0.f) {
+			const Float3& neutralLUTColor = a_color;
+
+			const Float3 subCubeCoordinates = Abs(lutCoordinates) * static_cast<float>(kLUTSize);
+			const float  subCubeCoordinatesLength = Length(subCubeCoordinates);
+			const Float3 clampedSubCubeCoordinates = ClampCubeCoordinates(Normalize(subCubeCoordinates) * 3.f);
+			const float  distanceFromZero = (subCubeCoordinatesLength <= FLT_MIN) ? 0.f : Saturate(subCubeCoordinatesLength / Length(clampedSubCubeCoordinates));
+			const float  closenessToZero = 1.f - distanceFromZero;
+
+			const float luminanceDeviationFromNeutralLUT = std::abs(Luminance(lutColor) - Luminance(neutralLUTColor)) > 0.5f ? 0.f : 1.f;
+
+			const Float3 normalizedDeviationFromNeutralLUT = (lutColor / neutralLUTColor) / distanceFromZero;
+			const float  maxNormalizedDeviationFromNeutralLUT = MaxChannel(normalizedDeviationFromNeutralLUT);
+			const float  minNormalizedDeviationFromNeutralLUT = MinChannel(normalizedDeviationFromNeutralLUT);
+
+			constexpr float kNormalizationDeviationThreshold = 0.0001f;
+			constexpr float kDeviationFromNeutralLUTThreshold = 5.f;
+			constexpr float kSaturationMultiplier = 2.f;
+			const float     minNormalizedDeviationFromNeutralLUTChroma = std::fmax(maxNormalizedDeviationFromNeutralLUT - minNormalizedDeviationFromNeutralLUT - kNormalizationDeviationThreshold, 0.f);
+			const float     chromaDeviationFromNeutralLUT = minNormalizedDeviationFromNeutralLUTChroma != 0.f ? Saturate(std::pow(minNormalizedDeviationFromNeutralLUTChroma, kDeviationFromNeutralLUTThreshold)) : 0.f;
+
+			lutColor = Color::Saturation(lutColor, Lerp(1.f, kSaturationMultiplier, closenessToZero * luminanceDeviationFromNeutralLUT * chromaDeviationFromNeutralLUT * plugin.LUTCorrectionStrength));
+		}
+
+		const float maskAlpha = (1.f - (a_inputs.lutMask ? a_inputs.lutMask->SampleBilinear(a_u, a_v).x : 0.f)) * plugin.ColorGradingStrength;
+		return Lerp(a_color, lutColor, maskAlpha);
+	}
+
+	// "SDR_USE_GAMMA_2_2" correction, by channel, only within 0-1 and mirrored below 0
+	Float3 Renderer::PostGradingGammaCorrect(const Float3& a_color) const
+	{
+		const Float3 corrected = Apply(a_color, [](float a_channel) { return Color::GammaToLinearCustom(Color::LinearToSRGBCustom(a_channel)); });
+		const Float3 color = Lerp(a_color, corrected, constants.plugin.GammaCorrectionStrength);
+
+		// Modulating colors around zero can create invalid luminances if there's negative scRGB colors
+		if (Luminance(color) < 0.f) {
+			return { 0.f, 0.f, 0.f };
+		}
+		return color;
+	}
+
+	void Renderer::ApplyColorGrading(const Inputs& a_inputs, Float3& a_color, Float3& a_outNonGammaCorrectedColor, float a_u, float a_v) const
+	{
+		if (permutation.bMergedLUT) {
+			a_color = GradingLUT(a_inputs, a_color, a_u, a_v);
+		}
+		a_outNonGammaCorrectedColor = a_color;
+		a_color = PostGradingGammaCorrect(a_color);
+	}
+
+	void Renderer::ApplyUserSettingExtendGamut(Float3& a_color) const
+	{
+		if (constants.plugin.ExtendGamut != 0.f) {
+			a_color = Color::ExtendGamut(a_color, std::pow(constants.plugin.ExtendGamut, 2.f));
+		}
+	}
+
+	void Renderer::ApplyUserSettingSaturation(Float3& a_color) const
+	{
+		const ShaderConstants& plugin = constants.plugin;
+
+		float saturation = plugin.Saturation;
+		if (permutation.bMergedLUT) {
+			saturation = Lerp(saturation, 1.f, plugin.ColorGradingStrength * plugin.LUTCorrectionStrength);
+		}
+		a_color = Color::Saturation(a_color, saturation);
+	}
+
+	void Renderer::ApplyUserSettingContrast(Float3& a_color) const
+	{
+		a_color = Pow(Abs(a_color) / Color::kMidGray, constants.plugin.Contrast) * Color::kMidGray * Sign(a_color);
+	}
+
+	void Renderer::ApplySDRBrightness(Float3& a_color) const
+	{
+		const float brightness = constants.plugin.SDRSecondaryBrightness;
+		if (brightness != 1.f) {
+			Float3 oklabColor = Color::BT709_To_Oklab(a_color);
+			oklabColor.x = std::pow(std::abs(oklabColor.x), LinearNormalization(brightness, 0.f, 2.f, 1.25f, 0.75f)) * Sign(oklabColor.x);
+			a_color = Color::Oklab_To_BT709(oklabColor);
+		}
+	}
+
+	// The game's tonemappers, by channel. abs() * sign() keeps negative scRGB values.
+	void Renderer::ApplySDRToneMap(CompositeParams& a_params, ToneMapperParams& a_tmParams) const
+	{
+		constexpr bool kClampBethesdaACES = false;
+
+		const Float3& inputColor = a_tmParams.inputColor;
+		if (toneCurves && constants.push.Tmo >= 1 && constants.push.Tmo <= 3) {
+			a_tmParams.outputSDRColor = Apply(Abs(inputColor), [&](float a_channel) { return toneCurves->sdr.Sample(a_channel); }) * Sign(inputColor);
+			a_params.outputColor = a_tmParams.outputSDRColor;
+			return;
+		}
+
+		switch (constants.push.Tmo) {
+		case 1:
+			a_tmParams.outputSDRColor = ACES(Abs(inputColor), kClampBethesdaACES, ACESParametricParams{}) * Sign(inputColor);
+			break;
+		case 2:
+			a_tmParams.outputSDRColor = ACES(Abs(inputColor), kClampBethesdaACES, acesParametricParams) * Sign(inputColor);
+			break;
+		case 3:
+			a_tmParams.outputSDRColor = Hable(Abs(inputColor), hableCurve) * Sign(inputColor);
+			break;
+		default:
+			return;
+		}
+		a_params.outputColor = a_tmParams.outputSDRColor;
+	}
+
+	// "INVERT_TONEMAP_TYPE" 2 (SDR tonemapped shadows and midtones, linear highlights) and "HDR_TONEMAP_TYPE" 2 (DICE in ICtCp)
+	void Renderer::ApplySDRToneMapperHDRUpgrade(const Inputs& a_inputs, CompositeParams& a_params, const ToneMapperParams& a_tmParams) const
+	{
+		const ShaderConstants& plugin = constants.plugin;
+		const Float3&          tonemappedColor = a_tmParams.outputSDRColor;
+		const float            paperWhite = plugin.GamePaperWhite / Color::kWhiteNits_sRGB;
+		const float            sdrTonemapHDRStrength = constants.statics.SDRTonemapHDRStrength;
+
+		const float midGrayIn = Color::kMidGray;
+		float       midGrayOut = midGrayIn;
+		float       minHighlightsColorIn = kMinHighlightsColor;
+		float       minHighlightsColorOut = minHighlightsColorIn;
+
+		// Only blending towards the untonemapped color needs the inverse of the SDR tonemapper
+		const bool bNeedsInverseTonemap = sdrTonemapHDRStrength != 1.f;
+		Float3     inverseTonemappedColor = bNeedsInverseTonemap ? tonemappedColor : a_tmParams.inputColor;
+
+		switch (constants.push.Tmo) {
+		case 1:
+		case 2:
+			{
+				const ACESParametricParams& params = constants.push.Tmo == 1 ? ACESParametricParams{} : acesParametricParams;
+				if (bNeedsInverseTonemap) {
+					inverseTonemappedColor = ACES_Inverse(inverseTonemappedColor, params);
+					midGrayOut = ACES_Inverse(midGrayIn, params);
+				}
+				minHighlightsColorOut = ACES_Inverse(minHighlightsColorIn, params);
+				break;
+			}
+		case 3:
+			// Switch where the Hable curve's shoulder starts
+			minHighlightsColorIn = std::fmax(hableCurve.params.params.y0, hableCurve.params.params.y1);
+			if (bNeedsInverseTonemap) {
+				inverseTonemappedColor = Hable_Inverse(inverseTonemappedColor, hableCurve.params);
+				midGrayOut = Hable_Inverse(midGrayIn, hableCurve.params);
+			}
+			minHighlightsColorOut = hableCurve.params.shoulderStart;
+			break;
+		default:
+			break;
+		}
+
+		PostInverseTonemapByChannel(a_tmParams.inputColor.x, tonemappedColor.x, inverseTonemappedColor.x, minHighlightsColorIn, minHighlightsColorOut);
+		PostInverseTonemapByChannel(a_tmParams.inputColor.y, tonemappedColor.y, inverseTonemappedColor.y, minHighlightsColorIn, minHighlightsColorOut);
+		PostInverseTonemapByChannel(a_tmParams.inputColor.z, tonemappedColor.z, inverseTonemappedColor.z, minHighlightsColorIn, minHighlightsColorOut);
+
+		// Mid gray follows the same scale as the highlights, so the curves connect
+		const float highlightsMidGrayOut = midGrayIn * (minHighlightsColorOut / minHighlightsColorIn);
+		// Shift back towards the untonemapped color to ignore the SDR tonemapper (the shader's lerps by a strength of 1 fold away at compile time)
+		if (!bNeedsInverseTonemap) {
+			midGrayOut = highlightsMidGrayOut;
+		} else {
+			midGrayOut = Lerp(midGrayOut, highlightsMidGrayOut, sdrTonemapHDRStrength);
+			inverseTonemappedColor = Lerp(a_tmParams.inputColor, inverseTonemappedColor, sdrTonemapHDRStrength);
+			minHighlightsColorOut = Lerp(minHighlightsColorIn, minHighlightsColorOut, sdrTonemapHDRStrength);
+		}
+		const float midGrayScale = midGrayOut / midGrayIn;
+
+		inverseTonemappedColor /= midGrayScale;
+		minHighlightsColorOut /= midGrayScale;
+
+		// "HDR_POST_PROCESS_TYPE" 5: post process the HDR color directly, then either apply the LUT to it too (strict) or restore the SDR LUT change
+		Float3 inverseTonemappedPostProcessedColor = inverseTonemappedColor;
+		if (permutation.bCinematics) {
+			inverseTonemappedPostProcessedColor = Lerp(inverseTonemappedColor, PostProcess(inverseTonemappedColor), kPostProcessStrength);
+		}
+
+		if (permutation.bMergedLUT && plugin.StrictLUTApplication) {
+			Float3 unusedNonGammaCorrectedColor;
+			ApplyColorGrading(a_inputs, inverseTonemappedPostProcessedColor, unusedNonGammaCorrectedColor, a_params.u, a_params.v);
+		} else {
+			inverseTonemappedPostProcessedColor = RestorePostProcess(inverseTonemappedPostProcessedColor, a_params.preLUTColor, a_params.finalSDRColor);
+		}
+
+		a_params.outputColor = inverseTonemappedPostProcessedColor;
+		ApplyUserSettingExtendGamut(a_params.outputColor);
+		ApplyUserSettingSaturation(a_params.outputColor);
+		ApplyUserSettingContrast(a_params.outputColor);
+
+		a_params.outputColor *= paperWhite;
+		minHighlightsColorOut *= paperWhite;
+
+		// Never compress highlights before the top part of the range (based on the user setting), even if it means having two separate mid tones sections
+		const float maxOutputLuminance = plugin.PeakBrightness / Color::kWhiteNits_sRGB;
+		const float highlightsModulationPow = plugin.Highlights >= 0.5f ? LinearNormalization(plugin.Highlights, 0.5f, 1.f, 1.f / 3.f, 1.f) : LinearNormalization(plugin.Highlights, 0.f, 0.5f, 0.f, 1.f / 3.f);
+		const float highlightsShoulderStart = Lerp(0.f, std::fmax(maxOutputLuminance * highlightsModulationPow, minHighlightsColorOut), sdrTonemapHDRStrength);
+
+		a_params.outputColor = DICETonemap(a_params.outputColor, maxOutputLuminance, highlightsShoulderStart, kHDRHighlightsModulation);
+	}
+
+	void Renderer::ApplyHDRToneMapperScaling(CompositeParams& a_params, ToneMapperParams& a_tmParams) const
+	{
+		// Replicate per channel colors by clamping
+		a_tmParams.inputColor = Clamp(a_tmParams.inputColor, 0.f, 4.f);
+		const float postClampedY = Luminance(a_tmParams.inputColor);
+		a_tmParams.inputColor *= postClampedY != 0.f ? a_tmParams.inputLuminance / postClampedY : 0.f;
+		a_tmParams.inputLuminance = postClampedY;
+
+		float scale = 1.f;
+		if (constants.push.Tmo != 3) {  // ACES fitted/parametric
+			scale = 3.5f;
+		} else if (constants.scene.hable.toeLength == 0.f || constants.scene.hable.toeStrength == 0.f) {  // Hable without a toe
+			scale = 2.8f;
+		}
+		if (scale != 1.f) {
+			a_params.outputColor *= scale;
+			a_tmParams.inputColor *= scale;
+			a_tmParams.inputLuminance *= scale;
+		}
+	}
+
+	void Renderer::ApplyOpenDRTToneMap(CompositeParams& a_params, ToneMapperParams& a_tmParams) const
+	{
+		const ShaderConstants& plugin = constants.plugin;
+		const bool             bHDR = plugin.DisplayMode > 0;
+
+		ApplyHDRToneMapperScaling(a_params, a_tmParams);
+
+		const float peakNits = bHDR ? plugin.PeakBrightness : Color::kReferenceWhiteNits_BT2408;
+		const float midGrayAdjustment = bHDR ? plugin.GamePaperWhite / Color::kReferenceWhiteNits_BT2408 : 1.f;
+		if (toneCurves) {
+			const auto tonescale = [&](float a_lum) { return toneCurves->hdr.Sample(a_lum); };
+			a_tmParams.outputHDRColor = OpenDRT::TransformCustom(a_tmParams.inputColor, tonescale, peakNits, midGrayAdjustment, plugin.Highlights * 2.f, plugin.Shadows * 2.f);
+		} else {
+			a_tmParams.outputHDRColor = OpenDRT::TransformCustom(a_tmParams.inputColor, peakNits, midGrayAdjustment, plugin.Contrast, plugin.Highlights * 2.f, plugin.Shadows * 2.f);
+		}
+		a_tmParams.outputHDRColor *= bHDR ? plugin.PeakBrightness / Color::kReferenceWhiteNits_BT2408 : 1.f;
+		a_tmParams.outputHDRLuminance = Luminance(a_tmParams.outputHDRColor);
+
+		// Strict LUT application isn't supported by OpenDRT yet, so SDR always uses the display toned color and HDR the vanilla one,
+		// unless the settings make them identical
+		const bool bReferenceDisplay = !bHDR || (plugin.GamePaperWhite == Color::kReferenceWhiteNits_BT2408 && plugin.PeakBrightness == Color::kReferenceWhiteNits_BT2408);
+		if (plugin.ColorGradingStrength == 0.f || !bHDR || (bReferenceDisplay && plugin.Contrast == 1.f && plugin.Highlights == 1.f && plugin.Shadows == 1.f)) {
+			a_tmParams.outputSDRColor = a_tmParams.outputHDRColor;
+			a_tmParams.outputSDRLuminance = a_tmParams.outputHDRLuminance;
+		} else {
+			if (toneCurves) {
+				const auto tonescale = [&](float a_lum) { return toneCurves->sdr.Sample(a_lum); };
+				a_tmParams.outputSDRColor = OpenDRT::TransformCustom(a_tmParams.inputColor, tonescale, Color::kReferenceWhiteNits_BT2408);
+			} else {
+				a_tmParams.outputSDRColor = OpenDRT::TransformCustom(a_tmParams.inputColor);
+			}
+			a_tmParams.outputSDRLuminance = Luminance(a_tmParams.outputSDRColor);
+		}
+
+		a_params.outputColor = a_tmParams.outputSDRColor;
+	}
+
+	void Renderer::ApplyOpenDRTHDRUpgrade(CompositeParams& a_params, const ToneMapperParams& a_tmParams) const
+	{
+		// Add the HDR/SDR luminance difference instead of multiplying by their ratio,
+		// so LUTs with heavy luminance shifts aren't raised to extreme values
+		float       scaledRatio = 1.f;
+		const float outputY = Luminance(a_params.postLUTColor);  // before gamma correction
+		if (a_tmParams.outputHDRLuminance < a_tmParams.outputSDRLuminance) {
+			scaledRatio = a_tmParams.outputHDRLuminance / a_tmParams.outputSDRLuminance;
+		} else {
+			const float deltaY = a_tmParams.outputHDRLuminance - a_tmParams.outputSDRLuminance;
+			const float newY = outputY + std::fmax(0.f, deltaY);
+			scaledRatio = outputY > 0.f ? (newY / outputY) : 0.f;
+		}
+
+		a_params.outputColor *= scaledRatio;
+
+		ApplyUserSettingExtendGamut(a_params.outputColor);
+		ApplyUserSettingSaturation(a_params.outputColor);
+
+		a_params.outputColor *= Color::kReferenceWhiteNits_BT2408 / Color::kWhiteNits_sRGB;
+	}
+
+	Float3 Renderer::Shade(const Inputs& a_inputs, std::size_t a_x, std::size_t a_y) const
+	{
+		const ShaderConstants& plugin = constants.plugin;
+		const Texture2D&       scene = *a_inputs.scene;
+		const Float3           renderedColor = scene.Load(static_cast<std::ptrdiff_t>(a_x), static_cast<std::ptrdiff_t>(a_y));
+
+		CompositeParams params = {
+			(static_cast<float>(a_x) + 0.5f) / static_cast<float>(scene.width),
+			(static_cast<float>(a_y) + 0.5f) / static_cast<float>(scene.height),
+			renderedColor,
+			renderedColor,
+			renderedColor,
+			renderedColor
+		};
+
+		if (permutation.bBloom && a_inputs.bloom) {
+			const Float3 bloom = a_inputs.bloom->SampleBilinear(params.u, params.v);
+			params.outputColor += constants.push.BloomMultiplier * bloom * (2.f * plugin.Bloom);
+		}
+
+		const float      inputLuminance = Luminance(params.outputColor);
+		ToneMapperParams tmParams = {
+			params.outputColor, inputLuminance,
+			params.outputColor, inputLuminance,
+			params.outputColor, inputLuminance
+		};
+
+		if (plugin.ToneMapperType == 1) {
+			ApplyOpenDRTToneMap(params, tmParams);
+		} else {
+			ApplySDRToneMap(params, tmParams);
+		}
+
+		const bool bStrictLUTApplication = plugin.StrictLUTApplication != 0;
+		const bool bNeedsSDRPostProcess = !bStrictLUTApplication || plugin.DisplayMode <= 0 || plugin.ToneMapperType > 0;
+		if (bNeedsSDRPostProcess) {
+			ApplyCinematics(params);
+			params.preLUTColor = params.outputColor;
+
+			ApplyColorGrading(a_inputs, params.outputColor, params.postLUTColor, params.u, params.v);
+			params.finalSDRColor = params.outputColor;
+		} else {
+			params.preLUTColor = params.outputColor;
+			params.postLUTColor = params.outputColor;
+			params.finalSDRColor = params.outputColor;
+		}
+
+		if (plugin.DisplayMode > 0) {
+			if (plugin.ToneMapperType == 1) {
+				ApplyOpenDRTHDRUpgrade(params, tmParams);
+			} else {
+				ApplySDRToneMapperHDRUpgrade(a_inputs, params, tmParams);
+			}
+			// "CLAMP_INPUT_OUTPUT_TYPE" 1 leaves gamut mapping to the final output, in another pass
+		} else {
+			ApplySDRBrightness(params.outputColor);
+			ApplyUserSettingSaturation(params.outputColor);
+			// User contrast is already baked in OpenDRT
+			if (plugin.ToneMapperType == 0) {
+				ApplyUserSettingContrast(params.outputColor);
+			}
+			// "SDR_LINEAR_INTERMEDIARY" keeps SDR linear, gamma is applied on output
+		}
+
+		return params.outputColor;
+	}
+
+	void Renderer::Render(const Inputs& a_inputs, Float3* a_outPixels, std::size_t a_threadCount) const
+	{
+		constexpr std::size_t kTileSize = 64;
+
+		const std::size_t width = a_inputs.scene->width;
+		const std::size_t height = a_inputs.scene->height;
+		const std::size_t tilesX = (width + kTileSize - 1) / kTileSize;
+		const std::size_t tileCount = tilesX * ((height + kTileSize - 1) / kTileSize);
+
+		// Tiles are handed out one at a time, so threads that got cheap tiles (e.g. dark ones that skip DICE) take more of them
+		ToneMapping::ParallelFor(tileCount, a_threadCount, [&](std::size_t a_tile) {
+			const std::size_t beginX = (a_tile % tilesX) * kTileSize;
+			const std::size_t beginY = (a_tile / tilesX) * kTileSize;
+			const std::size_t endX = std::min(beginX + kTileSize, width);
+			const std::size_t endY = std::min(beginY + kTileSize, height);
+			for (std::size_t y = beginY; y < endY; ++y) {
+				for (std::size_t x = beginX; x < endX; ++x) {
+					a_outPixels[y * width + x] = Shade(a_inputs, x, y);
+				}
+			}
+		});
+	}
+}
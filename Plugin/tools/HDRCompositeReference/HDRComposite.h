@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "Color.h"
+#include "ToneCurve.h"
+#include "ToneMapping.h"
+
+// CPU reference of the "PS" entry point of "shaders/HDRComposite/HDRComposite_ps.hlsl", with the defines the shader ships with
+// (tetrahedral LUT sampling with OkLCh extrapolation, highlights only inverse tonemapping, DICE in ICtCp, "HDR_POST_PROCESS_TYPE" 5,
+// gamut mapped output). Every pixel goes through the same steps as on the GPU, only the debug draws are left out.
+// It's meant to be slow and readable, not fast: the shader stays the source of truth and changes to it should be mirrored here.
+namespace HDRComposite
+{
+	using Color::Float3;
+
+	// Mirror of "Settings::ShaderConstants" ("StructHdrDllPluginConstants" in shaders), which can't be included without the plugin's dependencies.
+	// Defaults are the neutral values of each setting, for HDR on a 1000 nits display.
+	struct ShaderConstants
+	{
+		std::int32_t  DisplayMode = 1;
+		float         PeakBrightness = 1000.f;
+		float         GamePaperWhite = Color::kReferenceWhiteNits_BT2408;
+		float         UIPaperWhite = Color::kReferenceWhiteNits_BT2408;
+		float         ExtendGamut = 0.f;
+		std::uint32_t bAutoHDRVideos = 0;
+
+		float SDRSecondaryBrightness = 1.f;
+
+		std::uint32_t ToneMapperType = 0;
+		float         Saturation = 1.f;
+		float         Contrast = 1.f;
+		float         Highlights = 0.5f;
+		float         Shadows = 0.5f;
+		float         Bloom = 0.5f;
+
+		float         ColorGradingStrength = 1.f;
+		float         LUTCorrectionStrength = 1.f;
+		std::uint32_t StrictLUTApplication = 0;
+
+		float         GammaCorrectionStrength = 1.f;
+		std::uint32_t FilmGrainType = 1;
+		float         FilmGrainFPSLimit = 0.f;
+		std::uint32_t PostSharpen = 1;
+		std::uint32_t bIsAtEndOfFrame = 0;
+		std::uint32_t RuntimeMS = 0;
+		float         DevSetting01 = 0.f;
+		float         DevSetting02 = 0.f;
+		float         DevSetting03 = 0.f;
+		float         DevSetting04 = 0.5f;
+		float         DevSetting05 = 0.5f;
+	};
+	static_assert(sizeof(ShaderConstants) == 27 * sizeof(std::uint32_t), "must match HDR_PLUGIN_CONSTANTS_SIZE");
+
+	struct Float4
+	{
+		Float3 rgb;
+		float  a;
+	};
+
+	// The game's per frame post process settings (structured buffer "HdrCmpDat"), neutral by default
+	struct HDRCompositeData
+	{
+		Float4       HighlightsColorFilter = { { 0.f, 0.f, 0.f }, 0.f };
+		Float4       ColorFilter = { { 0.f, 0.f, 0.f }, 0.f };
+		float        HableSaturation = 1.f;
+		float        BrightnessMultiplier = 1.f;
+		float        ContrastIntensity = 1.f;
+		std::int32_t i_0 = 0;
+	};
+
+	// "PushConstantWrapper_HDRComposite", the buffer index isn't needed as there's a single "HDRCompositeData"
+	struct PushConstants
+	{
+		std::uint32_t Tmo = 3;  // 1 ACES fitted, 2 ACES parametric, 3 Hable, anything else is no tonemapper
+		float         BloomMultiplier = 1.f;
+	};
+
+	// What the shader reads from "PerSceneConstants"
+	struct SceneConstants
+	{
+		float                         AcesParam0 = 11.2f;   // [3255].x
+		float                         AcesParam1 = 0.022f;  // [3255].y
+		ToneMapping::HableSceneParams hable;                // [3255].zw and [3256].xyz
+		float                         contrastMidPoint = Color::kMidGray;  // [311].z
+	};
+
+	// The shader's "static const" settings, which the shipped shader never changes. Tests can still change them to reach the branches they switch off.
+	struct StaticConstants
+	{
+		float SDRTonemapHDRStrength = 1.f;  // below 1 blends towards the untonemapped color, which needs the inverse of the SDR tonemapper
+	};
+
+	struct Constants
+	{
+		ShaderConstants  plugin;
+		HDRCompositeData data;
+		PushConstants    push;
+		SceneConstants   scene;
+		StaticConstants  statics;
+	};
+
+	// The inputs of the baked tone curves of these constants
+	ToneMapping::ToneCurveInputs GetToneCurveInputs(const Constants& a_constants);
+
+	// Sets a constant by its member name, plus "Tmo", "BloomMultiplier", "AcesParam0", "AcesParam1", the Hable scene params, "contrastMidPoint" and "SDRTonemapHDRStrength".
+	// Color filters are set by channel, e.g. "ColorFilter.r". Returns false for unknown names.
+	bool SetConstant(Constants& a_constants, std::string_view a_name, double a_value);
+
+	// Shader permutation defines. "APPLY_TONEMAPPING" is set by the game but the shader never reads it.
+	struct Permutation
+	{
+		bool bBloom = false;
+		bool bTonemapping = false;
+		bool bCinematics = false;
+		bool bMergedLUT = false;
+	};
+
+	// The permutations built by "compile_all_shaders.ps1"
+	struct Technique
+	{
+		std::uint32_t id;
+		Permutation   permutation;
+	};
+
+	inline constexpr Technique kTechniques[] = {
+		{ 0x1FE1A, { false, false, false, false } },
+		{ 0xC01FE1A, { false, true, true, false } },
+		{ 0xE01FE1A, { true, true, true, false } },
+		{ 0x1001FE1A, { false, false, false, true } },
+		{ 0x1C01FE1A, { false, true, true, true } },
+		{ 0x1E01FE1A, { true, true, true, true } },
+	};
+
+	// Returns false for unknown ids
+	bool GetPermutation(std::uint32_t a_techniqueId, Permutation& a_outPermutation);
+
+	// Turns on the permutation flag of a define ("APPLY_BLOOM", ...), returns false for defines the shader doesn't have
+	bool SetDefine(Permutation& a_permutation, std::string_view a_define);
+
+	// Linear RGB texels, addressed like D3D: out of bounds loads return 0 and samples clamp to the edges
+	class Texture2D
+	{
+	public:
+		Texture2D() = default;
+		Texture2D(std::size_t a_width, std::size_t a_height, const Float3& a_value = { 0.f, 0.f, 0.f });
+
+		Float3 Load(std::ptrdiff_t a_x, std::ptrdiff_t a_y) const;
+		Float3 SampleBilinear(float a_u, float a_v) const;
+
+		std::size_t         width = 0;
+		std::size_t         height = 0;
+		std::vector<Float3> texels;  // row major, top to bottom
+	};
+
+	class Texture3D
+	{
+	public:
+		Texture3D() = default;
+		explicit Texture3D(std::size_t a_size);
+
+		Float3 Load(std::ptrdiff_t a_x, std::ptrdiff_t a_y, std::ptrdiff_t a_z) const;
+		Float3 SampleTrilinear(float a_u, float a_v, float a_w) const;
+
+		std::size_t         size = 0;
+		std::vector<Float3> texels;  // x (red) first, then y (green), then z (blue)
+	};
+
+	inline constexpr std::size_t kLUTSize = 16;
+
+	// The merged LUT as the ColorGradingMerge shader would write it for a neutral LUT ("LUT_MAPPING_TYPE" 4: sRGB coordinates, linear colors)
+	Texture3D MakeNeutralLUT();
+
+	// A 256x16 strip of 16 LUT slices side by side (red along x within a slice, green along y, one slice per blue step), as LUTs are stored by the game
+	bool LoadLUTFromSlices(const Texture2D& a_slices, Texture3D& a_outLUT);
+
+	// Unbound textures of the permutation are ignored, a missing bloom or mask reads as black and a missing LUT as a neutral one
+	struct Inputs
+	{
+		const Texture2D* scene = nullptr;
+		const Texture2D* bloom = nullptr;
+		const Texture3D* lut = nullptr;
+		const Texture2D* lutMask = nullptr;
+	};
+
+	class Renderer
+	{
+	public:
+		// "a_bBakedToneCurves" evaluates the tone curves from tables baked by "ToneMapping::BakeToneCurves()" instead of analytically
+		Renderer(const Constants& a_constants, const Permutation& a_permutation, bool a_bBakedToneCurves = false);
+
+		// Runs the pixel shader of one pixel of the scene
+		Float3 Shade(const Inputs& a_inputs, std::size_t a_x, std::size_t a_y) const;
+
+		// Shades the whole scene into "a_outPixels" (scene sized), in tiles spread across "a_threadCount" threads (0 is one per core)
+		void Render(const Inputs& a_inputs, Float3* a_outPixels, std::size_t a_threadCount = 0) const;
+
+	private:
+		// Colors of "CompositeParams" in the shader
+		struct CompositeParams
+		{
+			float  u;
+			float  v;
+			Float3 outputColor;
+			Float3 preLUTColor;
+			Float3 postLUTColor;
+			Float3 finalSDRColor;
+		};
+
+		struct ToneMapperParams
+		{
+			Float3 inputColor;
+			float  inputLuminance;
+			Float3 outputSDRColor;
+			float  outputSDRLuminance;
+			Float3 outputHDRColor;
+			float  outputHDRLuminance;
+		};
+
+		Float3 PostProcess(const Float3& a_color) const;
+		void   ApplyCinematics(CompositeParams& a_params) const;
+
+		Float3 SampleGradingLUT(const Texture3D& a_lut, const Float3& a_coordinates, const Float3& a_originalColor) const;
+		Float3 GradingLUT(const Inputs& a_inputs, const Float3& a_color, float a_u, float a_v) const;
+		Float3 PostGradingGammaCorrect(const Float3& a_color) const;
+		void   ApplyColorGrading(const Inputs& a_inputs, Float3& a_color, Float3& a_outNonGammaCorrectedColor, float a_u, float a_v) const;
+
+		void ApplyUserSettingExtendGamut(Float3& a_color) const;
+		void ApplyUserSettingSaturation(Float3& a_color) const;
+		void ApplyUserSettingContrast(Float3& a_color) const;
+		void ApplySDRBrightness(Float3& a_color) const;
+
+		void ApplySDRToneMap(CompositeParams& a_params, ToneMapperParams& a_tmParams) const;
+		void ApplySDRToneMapperHDRUpgrade(const Inputs& a_inputs, CompositeParams& a_params, const ToneMapperParams& a_tmParams) const;
+
+		void ApplyHDRToneMapperScaling(CompositeParams& a_params, ToneMapperParams& a_tmParams) const;
+		void ApplyOpenDRTToneMap(CompositeParams& a_params, ToneMapperParams& a_tmParams) const;
+		void ApplyOpenDRTHDRUpgrade(CompositeParams& a_params, const ToneMapperParams& a_tmParams) const;
+
+		const Constants                          constants;
+		const Permutation                        permutation;
+		const Texture3D                          neutralLUT;
+		const ToneMapping::ACESParametricParams  acesParametricParams;
+		const ToneMapping::HableCurve            hableCurve;
+		std::unique_ptr<ToneMapping::ToneCurves> toneCurves;  // null for the analytic curves
+	};
+}
@@ -0,0 +1,263 @@
+// Renders a captured scene through the CPU reference of the HDRComposite pixel shader and writes the result as a linear scRGB OpenEXR.
+// Usage: HDRCompositeReference <scene.lumaraw> [--technique <id>] [--bloom <bloom.lumaraw>] [--lut <lut.lumaraw>] [--mask <mask.lumaraw>]
+//                              [--constants <constants.txt>] [--baked-tone-curves] [--threads <count>] [--repeat <count>] [--output <output.exr>]
+// Inputs are raw captures of the game's textures, with their values read as is (linear). The LUT is the 256x16 strip of slices the game stores.
+// The technique id is hexadecimal and selects the shader permutation (defaults to 1E01FE1A, everything on).
+// The constants file has one "name = value" per line ('#' starts a comment), names are the ones of the structs in "HDRComposite.h"
+// plus "Tmo", "BloomMultiplier", "AcesParam0", "AcesParam1", the Hable scene params and "contrastMidPoint".
+// Peak brightness and paper white default to the ones stored in the scene capture. --repeat renders the scene multiple times and reports the best time.
+// --baked-tone-curves evaluates the tone curves from 1D tables ("ToneCurve.h") instead of analytically.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <stb_image_write_hdr_png.h>
+
+#include "HDRComposite.h"
+#include "Screenshot.h"
+
+namespace
+{
+	std::string_view Trim(std::string_view a_string)
+	{
+		const auto begin = a_string.find_first_not_of(" \t\r");
+		if (begin == std::string_view::npos) {
+			return {};
+		}
+		return a_string.substr(begin, a_string.find_last_not_of(" \t\r") - begin + 1);
+	}
+
+	bool LoadConstants(const std::filesystem::path& a_path, HDRComposite::Constants& a_constants)
+	{
+		std::ifstream input(a_path);
+		if (!input) {
+			std::fprintf(stderr, "%s: can't open\n", a_path.string().c_str());
+			return false;
+		}
+
+		std::string line;
+		for (int lineNumber = 1; std::getline(input, line); ++lineNumber) {
+			std::string_view content = line;
+			content = Trim(content.substr(0, content.find('#')));
+			if (content.empty()) {
+				continue;
+			}
+
+			const auto        separator = content.find('=');
+			const std::string value(separator != std::string_view::npos ? Trim(content.substr(separator + 1)) : std::string_view{});
+			char*             end = nullptr;
+			const double      number = std::strtod(value.c_str(), &end);
+			if (value.empty() || *end != '\0') {
+				std::fprintf(stderr, "%s(%d): invalid value\n", a_path.string().c_str(), lineNumber);
+				return false;
+			}
+			if (!HDRComposite::SetConstant(a_constants, Trim(content.substr(0, separator)), number)) {
+				std::fprintf(stderr, "%s(%d): unknown constant\n", a_path.string().c_str(), lineNumber);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool LoadTexture(const std::filesystem::path& a_path, HDRComposite::Texture2D& a_outTexture, Screenshot::RawHeader* a_outHeader = nullptr)
+	{
+		std::ifstream input(a_path, std::ios::binary);
+		if (!input) {
+			std::fprintf(stderr, "%s: can't open\n", a_path.string().c_str());
+			return false;
+		}
+		const std::vector<std::uint8_t> data{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+
+		Screenshot::RawHeader header;
+		Screenshot::Image     image;
+		if (!Screenshot::ParseRaw(data.data(), data.size(), header, image)) {
+			std::fprintf(stderr, "%s: not a valid raw capture\n", a_path.string().c_str());
+			return false;
+		}
+
+		a_outTexture = HDRComposite::Texture2D(image.width, image.height);
+		Screenshot::PixelBuffer row(image.width);
+		for (std::size_t y = 0; y < image.height; ++y) {
+			Screenshot::DecodeRow(row.data(), image.pixels + y * image.rowPitch, image.width, image.format);
+			for (std::size_t x = 0; x < image.width; ++x) {
+				DirectX::XMFLOAT4A pixel;
+				DirectX::XMStoreFloat4A(&pixel, row[x]);
+				a_outTexture.texels[y * image.width + x] = { pixel.x, pixel.y, pixel.z };
+			}
+		}
+
+		if (a_outHeader) {
+			*a_outHeader = header;
+		}
+		return true;
+	}
+
+	bool WriteEXR(const std::filesystem::path& a_outputPath, const std::vector<HDRComposite::Float3>& a_pixels, std::size_t a_width, std::size_t a_height)
+	{
+		std::vector<float> rgba(a_pixels.size() * 4);
+		for (std::size_t i = 0; i < a_pixels.size(); ++i) {
+			rgba[i * 4 + 0] = a_pixels[i].x;
+			rgba[i * 4 + 1] = a_pixels[i].y;
+			rgba[i * 4 + 2] = a_pixels[i].z;
+			rgba[i * 4 + 3] = 1.f;
+		}
+
+		Screenshot::Image image;
+		image.pixels = reinterpret_cast<const std::uint8_t*>(rgba.data());
+		image.width = a_width;
+		image.height = a_height;
+		image.rowPitch = a_width * 4 * sizeof(float);
+		image.format = Screenshot::PixelFormat::kR32G32B32A32_FLOAT;
+
+		FILE* file = std::fopen(a_outputPath.string().c_str(), "wb");
+		if (!file) {
+			std::fprintf(stderr, "%s: can't create\n", a_outputPath.string().c_str());
+			return false;
+		}
+
+		const auto writeCallback = [](void* context, void* data, int size) {
+			std::fwrite(data, 1, size, static_cast<FILE*>(context));
+		};
+		const bool bWritten = Screenshot::WriteLinearEXR(image, writeCallback, file);
+		std::fclose(file);
+
+		if (!bWritten) {
+			std::fprintf(stderr, "%s: encoding failed\n", a_outputPath.string().c_str());
+		}
+		return bWritten;
+	}
+
+	int PrintUsage(const char* a_executable)
+	{
+		std::fprintf(stderr,
+			"Usage: %s <scene.lumaraw> [--technique <id>] [--bloom <bloom.lumaraw>] [--lut <lut.lumaraw>] [--mask <mask.lumaraw>]\n"
+			"       [--constants <constants.txt>] [--baked-tone-curves] [--threads <count>] [--repeat <count>] [--output <output.exr>]\n",
+			a_executable);
+		return 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path scenePath;
+	std::filesystem::path bloomPath;
+	std::filesystem::path lutPath;
+	std::filesystem::path maskPath;
+	std::filesystem::path constantsPath;
+	std::filesystem::path outputPath;
+	std::uint32_t         techniqueId = 0x1E01FE1A;
+	std::size_t           threadCount = 0;
+	int                   repeat = 1;
+	bool                  bBakedToneCurves = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--technique" && i + 1 < argc) {
+			techniqueId = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 16));
+		} else if (argument == "--bloom" && i + 1 < argc) {
+			bloomPath = argv[++i];
+		} else if (argument == "--lut" && i + 1 < argc) {
+			lutPath = argv[++i];
+		} else if (argument == "--mask" && i + 1 < argc) {
+			maskPath = argv[++i];
+		} else if (argument == "--constants" && i + 1 < argc) {
+			constantsPath = argv[++i];
+		} else if (argument == "--baked-tone-curves") {
+			bBakedToneCurves = true;
+		} else if (argument == "--threads" && i + 1 < argc) {
+			threadCount = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 0));
+		} else if (argument == "--repeat" && i + 1 < argc) {
+			repeat = std::max(std::atoi(argv[++i]), 1);
+		} else if (argument == "--output" && i + 1 < argc) {
+			outputPath = argv[++i];
+		} else if (scenePath.empty() && !argument.starts_with("--")) {
+			scenePath = argument;
+		} else {
+			return PrintUsage(argv[0]);
+		}
+	}
+	if (scenePath.empty()) {
+		return PrintUsage(argv[0]);
+	}
+	if (outputPath.empty()) {
+		outputPath = scenePath;
+		outputPath.replace_extension(".reference.exr");
+	}
+
+	HDRComposite::Permutation permutation;
+	if (!HDRComposite::GetPermutation(techniqueId, permutation)) {
+		std::fprintf(stderr, "unknown technique %X\n", techniqueId);
+		return 1;
+	}
+
+	HDRComposite::Texture2D scene;
+	Screenshot::RawHeader   sceneHeader;
+	if (!LoadTexture(scenePath, scene, &sceneHeader)) {
+		return 1;
+	}
+
+	HDRComposite::Constants constants;
+	if (sceneHeader.peakBrightness > 0.f) {
+		constants.plugin.PeakBrightness = sceneHeader.peakBrightness;
+	}
+	if (sceneHeader.gamePaperWhite > 0.f) {
+		constants.plugin.GamePaperWhite = sceneHeader.gamePaperWhite;
+	}
+	if (sceneHeader.uiPaperWhite > 0.f) {
+		constants.plugin.UIPaperWhite = sceneHeader.uiPaperWhite;
+	}
+	if (!constantsPath.empty() && !LoadConstants(constantsPath, constants)) {
+		return 1;
+	}
+
+	HDRComposite::Texture2D bloom;
+	HDRComposite::Texture2D lutSlices;
+	HDRComposite::Texture3D lut;
+	HDRComposite::Texture2D mask;
+	HDRComposite::Inputs    inputs;
+	inputs.scene = &scene;
+	if (!bloomPath.empty()) {
+		if (!LoadTexture(bloomPath, bloom)) {
+			return 1;
+		}
+		inputs.bloom = &bloom;
+	}
+	if (!lutPath.empty()) {
+		if (!LoadTexture(lutPath, lutSlices)) {
+			return 1;
+		}
+		if (!HDRComposite::LoadLUTFromSlices(lutSlices, lut)) {
+			std::fprintf(stderr, "%s: LUTs must be %zux%zu\n", lutPath.string().c_str(), HDRComposite::kLUTSize * HDRComposite::kLUTSize, HDRComposite::kLUTSize);
+			return 1;
+		}
+		inputs.lut = &lut;
+	}
+	if (!maskPath.empty()) {
+		if (!LoadTexture(maskPath, mask)) {
+			return 1;
+		}
+		inputs.lutMask = &mask;
+	}
+
+	const HDRComposite::Renderer renderer(constants, permutation, bBakedToneCurves);
+	std::vector<HDRComposite::Float3> output(scene.width * scene.height);
+	double                            bestMs = std::numeric_limits<double>::max();
+	for (int i = 0; i < repeat; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		renderer.Render(inputs, output.data(), threadCount);
+		bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::printf("%s: %zux%zu, technique %X, rendered in %.2f ms\n", scenePath.string().c_str(), scene.width, scene.height, techniqueId, bestMs);
+
+	return WriteEXR(outputPath, output, scene.width, scene.height) ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+// Checks the precomputed Hable constants of "HableConstants.h" against a double precision evaluation of the curve, next to the analytic float
+// version of "ToneMapping.h", and times the batch inverse.
+// Usage: HableRoundTrip [--samples <count>] [--threads <count>]
+// For every configuration (scene curve settings and user shadows):
+// - the forward curve is evaluated on scene linear values from 2^-14 to 2^8 (log uniform), as relative errors.
+// - the inverse is evaluated on SDR values from 0 to 1 (evenly spaced), then its outputs go through the double precision forward curve
+//   and need to give the SDR values back, as absolute errors in the toe and mid, and in the shoulder.
+// Float evaluations of the shoulder are a staircase (see "ToneCurve.h"), so errors are checked against the analytic version's own errors.
+// The exit code is 1 if the constants are noticeably less accurate than the analytic curve anywhere.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numbers>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "HableConstants.h"
+
+namespace
+{
+	using namespace ToneMapping;
+
+	// The constants may be this much worse than the analytic curve, or within the absolute minimums below
+	constexpr double kMaxErrorRatio = 1.5;
+	constexpr double kMinRelativeError = 1e-5;
+	constexpr double kMinRoundTripError = 1e-5;
+
+	struct Configuration
+	{
+		const char*      name;
+		HableSceneParams sceneParams;
+		float            shadows;
+	};
+
+	std::vector<Configuration> GetConfigurations()
+	{
+		return {
+			{ "Default", {}, 0.5f },
+			{ "Shadows 0", {}, 0.f },
+			{ "Shadows 1", {}, 1.f },
+			{ "No toe", { 0.5f, 0.f, 9.9f, 0.8f, 0.3f }, 0.5f },
+			{ "Strong toe", { 0.9f, 0.6f, 9.9f, 0.8f, 0.3f }, 0.5f },
+			{ "Short shoulder", { 0.5f, 0.3f, 4.f, 0.3f, 0.3f }, 0.5f },
+			{ "No shoulder angle", { 0.5f, 0.3f, 9.9f, 0.8f, 0.f }, 0.5f },
+			{ "Steep shoulder", { 0.5f, 0.3f, 2.f, 0.95f, 1.f }, 0.5f }
+		};
+	}
+
+	double RelativeError(float a_value, double a_reference)
+	{
+		return std::abs(a_value - a_reference) / std::max(std::abs(a_reference), 1e-12);
+	}
+
+	// "HableEval()" in double, from the same (float) curve parameters
+	double HableReference(double a_value, const HableCurve& a_curve)
+	{
+		const HableEvalParams& params = a_curve.evalParams;
+		const double           normX = a_value * a_curve.invW;
+		double                 y;
+		if (normX < params.params_x0) {
+			y = normX > 0.0 ? std::exp2(std::log2(normX) * params.toeSegment_B + params.toeSegment_optimised + params.toeSegment_lnA_optimised * std::numbers::log2e) : 0.0;
+		} else if (normX < params.params_x1) {
+			y = std::max(normX + params.midSegment_offsetX, 0.0) * std::exp2(static_cast<double>(params.midSegment_lnA_optimised));
+		} else {
+			const double shoulderX = (1.0 + params.params_overshootX) - normX;
+			y = params.params_overshootY - (shoulderX > 0.0 ? std::exp2((params.shoulderSegment_B_optimised * std::log2(shoulderX) + params.shoulderSegment_lnA) * std::numbers::log2e) : 0.0);
+		}
+		return y * a_curve.params.invScale;
+	}
+
+	template <class Forward>
+	double MeasureForwardError(const HableCurve& a_curve, const std::vector<float>& a_sceneValues, Forward a_forward)
+	{
+		double error = 0.0;
+		for (const float value : a_sceneValues) {
+			error = std::max(error, RelativeError(a_forward(value), HableReference(value, a_curve)));
+		}
+		return error;
+	}
+
+	struct RoundTripErrors
+	{
+		double toeMid = 0.0;
+		double shoulder = 0.0;
+	};
+
+	// "a_inverses" are the inverse of every SDR value
+	RoundTripErrors MeasureRoundTripErrors(const HableCurve& a_curve, const std::vector<float>& a_sdrValues, const std::vector<float>& a_inverses)
+	{
+		// Where the forward curve switches to the shoulder
+		const double    shoulderStart = std::max(a_curve.params.params.y0, a_curve.params.params.y1) * static_cast<double>(a_curve.params.invScale);
+		RoundTripErrors errors;
+		for (std::size_t i = 0; i < a_sdrValues.size(); ++i) {
+			const double error = std::abs(HableReference(a_inverses[i], a_curve) - a_sdrValues[i]);
+			double&      maxError = a_sdrValues[i] < shoulderStart ? errors.toeMid : errors.shoulder;
+			maxError = std::max(maxError, error);
+		}
+		return errors;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t samples = 1 << 20;
+	std::size_t threadCount = 0;
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--samples" && i + 1 < argc) {
+			samples = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 2));
+		} else if (argument == "--threads" && i + 1 < argc) {
+			threadCount = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 0));
+		} else {
+			std::fprintf(stderr, "Usage: %s [--samples <count>] [--threads <count>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<float>                    sceneValues(samples);
+	std::mt19937                          random(1234);
+	std::uniform_real_distribution<float> exponent(-14.f, 8.f);
+	for (auto& value : sceneValues) {
+		value = std::exp2(exponent(random));
+	}
+	std::vector<float> sdrValues(samples);
+	for (std::size_t i = 0; i < samples; ++i) {
+		sdrValues[i] = static_cast<float>(i) / static_cast<float>(samples - 1);
+	}
+
+	bool bFailed = false;
+	for (const auto& configuration : GetConfigurations()) {
+		const HableCurve     curve = MakeHableCurve(configuration.sceneParams, configuration.shadows);
+		const HableConstants constants = MakeHableConstants(curve);
+
+		const double analyticForward = MeasureForwardError(curve, sceneValues, [&](float a_value) { return Hable(Color::Broadcast(a_value), curve).x; });
+		const double forward = MeasureForwardError(curve, sceneValues, [&](float a_value) { return Hable(a_value, constants); });
+
+		std::vector<float> analyticInverses(samples), inverses(samples);
+		for (std::size_t i = 0; i < samples; ++i) {
+			analyticInverses[i] = Hable_Inverse(sdrValues[i], curve.params);
+			inverses[i] = Hable_Inverse(sdrValues[i], constants);
+		}
+		// The batch inverse takes the SIMD path, whose log2() and exp2() differ from the scalar ones
+		std::vector<float> batchInverses = sdrValues, g = sdrValues, b = sdrValues;
+		Hable_Inverse(batchInverses.data(), g.data(), b.data(), samples, constants, threadCount);
+
+		const RoundTripErrors analyticRoundTrip = MeasureRoundTripErrors(curve, sdrValues, analyticInverses);
+		const RoundTripErrors roundTrip = MeasureRoundTripErrors(curve, sdrValues, inverses);
+		const RoundTripErrors batchRoundTrip = MeasureRoundTripErrors(curve, sdrValues, batchInverses);
+
+		const auto within = [](double a_error, double a_analyticError, double a_minError) { return a_error <= std::max(a_analyticError * kMaxErrorRatio, a_minError); };
+		const bool bPassed = within(forward, analyticForward, kMinRelativeError) &&
+		                     within(roundTrip.toeMid, analyticRoundTrip.toeMid, kMinRoundTripError) && within(roundTrip.shoulder, analyticRoundTrip.shoulder, kMinRoundTripError) &&
+		                     within(batchRoundTrip.toeMid, analyticRoundTrip.toeMid, kMinRoundTripError) && within(batchRoundTrip.shoulder, analyticRoundTrip.shoulder, kMinRoundTripError);
+		bFailed |= !bPassed;
+		std::printf("%-18s %s\n", configuration.name, bPassed ? "passed" : "FAILED");
+		std::printf("  forward relative error:  constants %.2e, analytic %.2e\n", forward, analyticForward);
+		std::printf("  round trip toe and mid:  constants %.2e (batch %.2e), analytic %.2e\n", roundTrip.toeMid, batchRoundTrip.toeMid, analyticRoundTrip.toeMid);
+		std::printf("  round trip shoulder:     constants %.2e (batch %.2e), analytic %.2e\n", roundTrip.shoulder, batchRoundTrip.shoulder, analyticRoundTrip.shoulder);
+	}
+
+	// Inverse tone mapping of a 4K frame, with the analytic inverse on one thread as a baseline
+	constexpr std::size_t kPixels = 3840 * 2160;
+	const HableCurve      curve = MakeHableCurve({}, 0.5f);
+	const HableConstants  constants = MakeHableConstants(curve);
+	std::vector<float>    r(kPixels), g(kPixels), b(kPixels);
+	const auto            fill = [&]() {
+		for (std::size_t i = 0; i < kPixels; ++i) {
+			r[i] = sdrValues[i % samples];
+			g[i] = sdrValues[(i * 7) % samples];
+			b[i] = sdrValues[(i * 13) % samples];
+		}
+	};
+
+	fill();
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < kPixels; ++i) {
+		const Float3 color = Hable_Inverse(Float3{ r[i], g[i], b[i] }, curve.params);
+		r[i] = color.x;
+		g[i] = color.y;
+		b[i] = color.z;
+	}
+	const double analyticMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::printf("\n4K frame inverse: analytic on one thread %.1f ms", analyticMs);
+
+	for (const std::size_t threads : { std::size_t(1), threadCount }) {
+		fill();
+		start = std::chrono::steady_clock::now();
+		Hable_Inverse(r.data(), g.data(), b.data(), kPixels, constants, threads);
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::printf(", batch on %s %.1f ms", threads == 1 ? "one thread" : "all threads", ms);
+		if (threadCount == 1) {
+			break;
+		}
+	}
+	std::printf("\n");
+	return bFailed ? 1 : 0;
+}
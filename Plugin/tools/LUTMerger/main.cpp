@@ -0,0 +1,375 @@
+// Corrects and blends the game's LUTs with the CPU port of the ColorGradingMerge shader ("ColorGradingMerge.h"), or checks the port when given no LUTs.
+// Usage: LUTMerger [<lut.lumaraw>...] [--mix <LUT1>,<LUT2>,<LUT3>,<LUT4>[,<neutral>]] [--saturation <value>] [--lut-correction <0-1>]
+//                  [--gamma-correction <0-1>] [--threads <count>] [--output <directory>]
+// LUTs are raw captures of the game's 256x16 LUT textures, with their values read as is (gamma space). Settings are the shader constants
+// ("Saturation" is 0.5-1.5, the others 0-1), all 1 by default.
+// Every LUT is corrected on its own (as 100% of the mix) into "<name>_merged.lumaraw" in "--output" (the current directory by default), on all cores.
+// With "--mix", the (up to four) LUTs are blended with those percentages into "merged.lumaraw" instead.
+// Outputs are the mixed LUT as a 256x16 strip of linear R32G32B32A32_FLOAT texels, what "HDRCompositeReference --lut" takes, so "StrictLUTApplication"
+// and the gamma correction of HDRComposite can be tested on them.
+// Without LUTs, synthetic LUTs go through checks of the correction (see "RunChecks()") and batch merges are timed. The exit code is 1 if a check fails.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <stb_image_write_hdr_png.h>
+
+#include "ColorGradingMerge.h"
+#include "Metrics.h"
+#include "Screenshot.h"
+
+namespace
+{
+	using namespace ColorGradingMerge;
+
+	bool LoadLUT(const std::filesystem::path& a_path, GameLUT& a_outLUT)
+	{
+		std::ifstream input(a_path, std::ios::binary);
+		if (!input) {
+			std::fprintf(stderr, "%s: can't open\n", a_path.string().c_str());
+			return false;
+		}
+		const std::vector<std::uint8_t> data{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+
+		Screenshot::RawHeader header;
+		Screenshot::Image     image;
+		if (!Screenshot::ParseRaw(data.data(), data.size(), header, image)) {
+			std::fprintf(stderr, "%s: not a valid raw capture\n", a_path.string().c_str());
+			return false;
+		}
+		if (image.width != kLUTSize * kLUTSize || image.height != kLUTSize) {
+			std::fprintf(stderr, "%s: %zux%zu, LUTs are %zux%zu\n", a_path.string().c_str(), image.width, image.height, kLUTSize * kLUTSize, kLUTSize);
+			return false;
+		}
+
+		Screenshot::PixelBuffer row(image.width);
+		for (std::size_t y = 0; y < image.height; ++y) {
+			Screenshot::DecodeRow(row.data(), image.pixels + y * image.rowPitch, image.width, image.format);
+			for (std::size_t x = 0; x < image.width; ++x) {
+				DirectX::XMFLOAT4A pixel;
+				DirectX::XMStoreFloat4A(&pixel, row[x]);
+				a_outLUT.texels[y * image.width + x] = { pixel.x, pixel.y, pixel.z };
+			}
+		}
+		return true;
+	}
+
+	// The same 256x16 layout as the game's LUTs
+	bool WriteLUT(const std::filesystem::path& a_path, const MixedLUT& a_lut)
+	{
+		constexpr std::size_t kWidth = kLUTSize * kLUTSize;
+		std::vector<float>    rgba(kLUTTexels * 4);
+		for (std::size_t b = 0; b < kLUTSize; ++b) {
+			for (std::size_t g = 0; g < kLUTSize; ++g) {
+				for (std::size_t r = 0; r < kLUTSize; ++r) {
+					const Float3& texel = a_lut.texels[(b * kLUTSize + g) * kLUTSize + r];
+					float*        pixel = &rgba[(g * kWidth + b * kLUTSize + r) * 4];
+					pixel[0] = texel.x;
+					pixel[1] = texel.y;
+					pixel[2] = texel.z;
+					pixel[3] = 1.f;
+				}
+			}
+		}
+
+		Screenshot::Image image;
+		image.pixels = reinterpret_cast<const std::uint8_t*>(rgba.data());
+		image.width = kWidth;
+		image.height = kLUTSize;
+		image.rowPitch = kWidth * 4 * sizeof(float);
+		image.format = Screenshot::PixelFormat::kR32G32B32A32_FLOAT;
+
+		FILE* file = std::fopen(a_path.string().c_str(), "wb");
+		if (!file) {
+			std::fprintf(stderr, "%s: can't create\n", a_path.string().c_str());
+			return false;
+		}
+		const auto writeCallback = [](void* context, void* data, int size) {
+			std::fwrite(data, 1, size, static_cast<FILE*>(context));
+		};
+		const bool bWritten = Screenshot::WriteRaw(image, {}, writeCallback, file);
+		return std::fclose(file) == 0 && bWritten;
+	}
+
+	// A game LUT from a function of the neutral gamma space coordinates
+	template <class F>
+	std::unique_ptr<GameLUT> MakeLUT(F a_function)
+	{
+		auto lut = std::make_unique<GameLUT>();
+		for (std::size_t b = 0; b < kLUTSize; ++b) {
+			for (std::size_t g = 0; g < kLUTSize; ++g) {
+				for (std::size_t r = 0; r < kLUTSize; ++r) {
+					const Float3 neutral = Float3{ static_cast<float>(r), static_cast<float>(g), static_cast<float>(b) } / static_cast<float>(kLUTSize - 1);
+					lut->texels[g * kLUTSize * kLUTSize + b * kLUTSize + r] = a_function(neutral);
+				}
+			}
+		}
+		return lut;
+	}
+
+	// Max Delta E ITP between the mixed LUT and "a_expected(r, g, b)", as SDR (1 is 80 nits)
+	template <class F>
+	double MaxDeltaEITP(const MixedLUT& a_lut, F a_expected)
+	{
+		double error = 0.0;
+		for (std::size_t b = 0; b < kLUTSize; ++b) {
+			for (std::size_t g = 0; g < kLUTSize; ++g) {
+				for (std::size_t r = 0; r < kLUTSize; ++r) {
+					error = std::max(error, Metrics::DeltaEITP(a_lut.texels[(b * kLUTSize + g) * kLUTSize + r], a_expected(r, g, b)));
+				}
+			}
+		}
+		return error;
+	}
+
+	float LinearY(const Float3& a_gamma, float a_gammaCorrection)
+	{
+		return Color::Luminance(Color::Apply(a_gamma, [&](float a_channel) { return Linearize(a_channel, a_gammaCorrection); }));
+	}
+
+	struct Check
+	{
+		const char* name;
+		bool        bPassed;
+		double      value;
+		double      limit;
+	};
+
+	// Checks on synthetic LUTs (Delta E ITP of 1 is about a just noticeable difference):
+	// - the SIMD merge matches the scalar reference of the shader's math, within 0.001 (measured 2e-4, in SSE2 and FMA contracted builds).
+	// - a neutral LUT comes out as the neutral (sRGB) LUT HDRComposite uses when there's no color grading, at no and full gamma correction
+	//   (0.25, gamma 2.2 amplifies what the Oklab round trip leaves in the channels that should be 0).
+	// - without LUT correction, a LUT comes out as it was, linearized and with its gamma corrected like the shader does (0.05).
+	// - with full LUT correction, the black of a LUT with raised (foggy) blacks goes to black (within 2% of its luminance, what's left is the fog's
+	//   chroma, which the correction keeps), its white gets brighter, and inverted LUTs (white darker than black) are left as they were.
+	std::vector<Check> RunChecks(std::size_t a_threadCount)
+	{
+		const auto neutralLUT = MakeLUT([](const Float3& a_neutral) { return a_neutral; });
+		// Warm raised blacks and lowered whites
+		const auto foggyLUT = MakeLUT([](const Float3& a_neutral) {
+			const Float3 black = { 0.12f, 0.1f, 0.08f };
+			const Float3 white = { 0.92f, 0.9f, 0.86f };
+			return black + a_neutral * (white - black);
+		});
+		// A stronger grade, with saturated and clipped colors
+		const auto tealOrangeLUT = MakeLUT([](const Float3& a_neutral) {
+			const Float3 graded = Color::Saturation(a_neutral * Float3{ 1.1f, 0.98f, 0.85f } + Float3{ 0.02f, 0.04f, 0.06f }, 1.4f);
+			return Float3{ std::clamp(graded.x, 0.f, 1.f), std::clamp(graded.y, 0.f, 1.f), std::clamp(graded.z, 0.f, 1.f) };
+		});
+		const auto invertedLUT = MakeLUT([](const Float3& a_neutral) { return 1.f - a_neutral; });
+
+		std::vector<Check> checks;
+		const auto         check = [&](const char* a_name, double a_value, double a_limit) { checks.push_back({ a_name, a_value <= a_limit, a_value, a_limit }); };
+		const auto         merge = [&](const MergeInputs& a_inputs) {
+			auto lut = std::make_unique<MixedLUT>();
+			Merge(a_inputs, *lut, a_threadCount);
+			return lut;
+		};
+
+		MergeInputs mixInputs;
+		mixInputs.luts = { foggyLUT.get(), tealOrangeLUT.get(), invertedLUT.get(), neutralLUT.get() };
+		mixInputs.pushConstants.LUTPercentages = { 0.4f, 0.3f, 0.1f, 0.1f };
+		mixInputs.pushConstants.neutralLUTPercentage = 0.1f;
+		mixInputs.pluginConstants = { 1.2f, 0.8f, 0.5f };
+		const MergeSetup mixSetup = MakeMergeSetup(mixInputs);
+		check("SIMD against scalar (Delta E ITP)", MaxDeltaEITP(*merge(mixInputs), [&](std::size_t a_r, std::size_t a_g, std::size_t a_b) {
+			return MergeTexel(mixSetup, a_r, a_g, a_b);
+		}), 0.001);
+
+		const auto sRGBNeutral = [](std::size_t a_r, std::size_t a_g, std::size_t a_b) {
+			return Color::Apply(Float3{ static_cast<float>(a_r), static_cast<float>(a_g), static_cast<float>(a_b) } / static_cast<float>(kLUTSize - 1),
+				[](float a_channel) { return Color::SRGBToLinearMirrored(a_channel); });
+		};
+		for (const float gammaCorrection : { 0.f, 1.f }) {
+			MergeInputs inputs;
+			inputs.luts[0] = neutralLUT.get();
+			inputs.pluginConstants.GammaCorrectionStrength = gammaCorrection;
+			check(gammaCorrection == 0.f ? "Neutral LUT, no gamma correction" : "Neutral LUT, full gamma correction", MaxDeltaEITP(*merge(inputs), sRGBNeutral), 0.25);
+		}
+
+		for (const GameLUT* lut : { foggyLUT.get(), tealOrangeLUT.get() }) {
+			MergeInputs inputs;
+			inputs.luts[0] = lut;
+			inputs.pluginConstants = { 1.f, 0.f, 0.5f };
+			check(lut == foggyLUT.get() ? "Foggy LUT without correction" : "Teal and orange LUT without correction", MaxDeltaEITP(*merge(inputs), [&](std::size_t a_r, std::size_t a_g, std::size_t a_b) {
+				return Color::Apply(lut->Load(a_r, a_g, a_b), [](float a_channel) { return CorrectGamma(Linearize(a_channel, 0.5f), 0.5f); });
+			}), 0.05);
+		}
+
+		MergeInputs foggyInputs;
+		foggyInputs.luts[0] = foggyLUT.get();
+		const auto  corrected = merge(foggyInputs);
+		const float originalBlackY = LinearY(foggyLUT->Load(0, 0, 0), 1.f);
+		const float originalWhiteY = LinearY(foggyLUT->Load(kLUTSize - 1, kLUTSize - 1, kLUTSize - 1), 1.f);
+		check("Foggy LUT black luminance (of the original's)", Color::Luminance(corrected->At(0, 0, 0)) / originalBlackY, 0.02);
+		check("Foggy LUT white luminance (of the original's, inverted)", originalWhiteY / Color::Luminance(corrected->At(kLUTSize - 1, kLUTSize - 1, kLUTSize - 1)), 1.0);
+
+		MergeInputs invertedInputs;
+		invertedInputs.luts[0] = invertedLUT.get();
+		const auto fullyCorrected = merge(invertedInputs);
+		invertedInputs.pluginConstants.LUTCorrectionStrength = 0.f;
+		const auto uncorrected = merge(invertedInputs);
+		check("Inverted LUT, full against no correction", MaxDeltaEITP(*fullyCorrected, [&](std::size_t a_r, std::size_t a_g, std::size_t a_b) { return uncorrected->At(a_r, a_g, a_b); }), 0.0);
+		return checks;
+	}
+
+	// Merges of all four LUTs, as a batch on one thread and on all of them, and with the scalar reference
+	void Benchmark(std::size_t a_threadCount)
+	{
+		constexpr std::size_t kMerges = 256;
+		const auto            lut = MakeLUT([](const Float3& a_neutral) { return 0.05f + a_neutral * 0.9f; });
+
+		std::vector<MergeInputs> inputs(kMerges);
+		for (std::size_t i = 0; i < kMerges; ++i) {
+			inputs[i].luts = { lut.get(), lut.get(), lut.get(), lut.get() };
+			inputs[i].pushConstants.LUTPercentages = { 0.25f, 0.25f, 0.25f, 0.25f };
+			inputs[i].pluginConstants.LUTCorrectionStrength = static_cast<float>(i) / static_cast<float>(kMerges - 1);
+		}
+		std::vector<MixedLUT> outputs(kMerges);
+
+		const MergeSetup setup = MakeMergeSetup(inputs.front());
+		auto             start = std::chrono::steady_clock::now();
+		for (std::size_t b = 0; b < kLUTSize; ++b) {
+			for (std::size_t g = 0; g < kLUTSize; ++g) {
+				for (std::size_t r = 0; r < kLUTSize; ++r) {
+					outputs.front().At(r, g, b) = MergeTexel(setup, r, g, b);
+				}
+			}
+		}
+		const double scalarMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::printf("\nMerge of four LUTs: scalar %.2f ms", scalarMs);
+
+		for (const std::size_t threads : { std::size_t(1), a_threadCount }) {
+			start = std::chrono::steady_clock::now();
+			Merge(inputs.data(), outputs.data(), kMerges, threads);
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / kMerges;
+			std::printf(", batch of %zu on %s %.3f ms", kMerges, threads == 1 ? "one thread" : "all threads", ms);
+			if (a_threadCount == 1) {
+				break;
+			}
+		}
+		std::printf("\n");
+	}
+
+	bool ParsePercentages(std::string_view a_list, PushConstants& a_outPushConstants)
+	{
+		std::vector<float> values;
+		while (!a_list.empty()) {
+			const auto        separator = a_list.find(',');
+			const std::string value(a_list.substr(0, separator));
+			char*             end = nullptr;
+			values.push_back(static_cast<float>(std::strtod(value.c_str(), &end)));
+			if (value.empty() || *end != '\0') {
+				return false;
+			}
+			a_list = separator == std::string_view::npos ? std::string_view{} : a_list.substr(separator + 1);
+		}
+		if (values.size() < kMaxLUTs || values.size() > kMaxLUTs + 1) {
+			return false;
+		}
+		std::copy_n(values.begin(), kMaxLUTs, a_outPushConstants.LUTPercentages.begin());
+		a_outPushConstants.neutralLUTPercentage = values.size() > kMaxLUTs ? values.back() : 0.f;
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::filesystem::path> lutPaths;
+	PushConstants                      pushConstants;
+	PluginConstants                    pluginConstants;
+	bool                               bMix = false;
+	std::size_t                        threadCount = 0;
+	std::filesystem::path              outputDirectory = ".";
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--mix" && i + 1 < argc && ParsePercentages(argv[i + 1], pushConstants)) {
+			bMix = true;
+			++i;
+		} else if (argument == "--saturation" && i + 1 < argc) {
+			pluginConstants.Saturation = static_cast<float>(std::atof(argv[++i]));
+		} else if (argument == "--lut-correction" && i + 1 < argc) {
+			pluginConstants.LUTCorrectionStrength = static_cast<float>(std::atof(argv[++i]));
+		} else if (argument == "--gamma-correction" && i + 1 < argc) {
+			pluginConstants.GammaCorrectionStrength = static_cast<float>(std::atof(argv[++i]));
+		} else if (argument == "--threads" && i + 1 < argc) {
+			threadCount = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 0));
+		} else if (argument == "--output" && i + 1 < argc) {
+			outputDirectory = argv[++i];
+		} else if (!argument.starts_with("--")) {
+			lutPaths.emplace_back(argument);
+		} else {
+			std::fprintf(stderr,
+				"Usage: %s [<lut.lumaraw>...] [--mix <LUT1>,<LUT2>,<LUT3>,<LUT4>[,<neutral>]] [--saturation <value>] [--lut-correction <0-1>]\n"
+				"       [--gamma-correction <0-1>] [--threads <count>] [--output <directory>]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (bMix && lutPaths.size() > kMaxLUTs) {
+		std::fprintf(stderr, "At most %zu LUTs can be mixed\n", kMaxLUTs);
+		return 1;
+	}
+
+	if (lutPaths.empty()) {
+		bool bFailed = false;
+		for (const auto& check : RunChecks(threadCount)) {
+			bFailed |= !check.bPassed;
+			std::printf("%-56s %s: %.4f (max %.4f)\n", check.name, check.bPassed ? "passed" : "FAILED", check.value, check.limit);
+		}
+		Benchmark(threadCount);
+		return bFailed ? 1 : 0;
+	}
+
+	std::vector<GameLUT> luts(lutPaths.size());
+	for (std::size_t i = 0; i < lutPaths.size(); ++i) {
+		if (!LoadLUT(lutPaths[i], luts[i])) {
+			return 1;
+		}
+	}
+	std::filesystem::create_directories(outputDirectory);
+
+	std::vector<MergeInputs>           inputs;
+	std::vector<std::filesystem::path> outputPaths;
+	if (bMix) {
+		MergeInputs& mix = inputs.emplace_back();
+		for (std::size_t i = 0; i < luts.size(); ++i) {
+			mix.luts[i] = &luts[i];
+		}
+		mix.pushConstants = pushConstants;
+		outputPaths.push_back(outputDirectory / "merged.lumaraw");
+	} else {
+		for (std::size_t i = 0; i < luts.size(); ++i) {
+			MergeInputs& single = inputs.emplace_back();
+			single.luts[0] = &luts[i];
+			outputPaths.push_back(outputDirectory / (lutPaths[i].stem().string() + "_merged.lumaraw"));
+		}
+	}
+	for (auto& input : inputs) {
+		input.pluginConstants = pluginConstants;
+	}
+
+	std::vector<MixedLUT> outputs(inputs.size());
+	const auto            start = std::chrono::steady_clock::now();
+	Merge(inputs.data(), outputs.data(), inputs.size(), threadCount);
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	for (std::size_t i = 0; i < outputs.size(); ++i) {
+		if (!WriteLUT(outputPaths[i], outputs[i])) {
+			return 1;
+		}
+	}
+	std::printf("Merged %zu LUT%s in %.1f ms\n", outputs.size(), outputs.size() == 1 ? "" : "s", ms);
+	return 0;
+}
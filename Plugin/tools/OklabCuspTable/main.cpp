@@ -0,0 +1,190 @@
+// Measures how far the Oklab cusp tables of "ColorLUT.h" are from the exact cusps, next to the per pixel solver they replace ("Color::OklabFindCusp()").
+// Usage: OklabCuspTable [--samples <count>]
+// "--samples" hues are spread uniformly over the full turn (by hue angle, so between the table's entries too), for BT.709 and BT.2020.
+// Errors are reported in Oklab L and C, then as how far gamut clipping ("Color::GamutClipProjectToLCusp()") of out of gamut colors
+// ends up from clipping with the exact cusps. Exits with 1 if the table's errors on either gamut are above the limits below.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <numbers>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "ColorLUT.h"
+
+namespace
+{
+	// Limits of the default table's errors, for both gamuts. The max in L and C is at the corners of the cusps, where the channel limiting
+	// the saturation switches (measured 0.020 in L and 0.015 in C, the same from 2^18 to 2^22 hues), the mean is what the rest of the hues
+	// get (measured 8e-6 to 1.1e-5 in L and C). Gamut clipping is only limited in its mean (measured 7e-6), its max grows with the number of
+	// colors that land next to a corner.
+	constexpr double kMaxTableError = 2.5e-2;
+	constexpr double kMaxTableMeanError = 2e-5;
+	constexpr double kMaxGamutClipMeanError = 2e-5;
+
+	struct Error
+	{
+		double maxL = 0.0;
+		double maxC = 0.0;
+		double meanL = 0.0;
+		double meanC = 0.0;
+		double worstHue = 0.0;  // degrees, of the max C error
+
+		void Add(const Color::OklabLC& a_value, const Color::OklabLC& a_reference, double a_hue)
+		{
+			const double errorL = std::abs(static_cast<double>(a_value.L) - a_reference.L);
+			const double errorC = std::abs(static_cast<double>(a_value.C) - a_reference.C);
+			if (errorC > maxC) {
+				worstHue = a_hue;
+			}
+			maxL = std::max(maxL, errorL);
+			maxC = std::max(maxC, errorC);
+			meanL += errorL;
+			meanC += errorC;
+		}
+	};
+
+	void PrintError(const char* a_label, Error a_error, std::size_t a_samples)
+	{
+		std::printf("  %-22s L max %.2e mean %.2e, C max %.2e mean %.2e (worst at %.2f degrees)\n", a_label, a_error.maxL, a_error.meanL / static_cast<double>(a_samples),
+			a_error.maxC, a_error.meanC / static_cast<double>(a_samples), a_error.worstHue);
+	}
+
+	template <class F>
+	Error MeasureError(F a_findCusp, bool a_bt2020, const std::vector<Color::OklabLC>& a_exact, std::size_t a_samples)
+	{
+		Error error;
+		for (std::size_t i = 0; i < a_samples; ++i) {
+			const double hue = 2.0 * std::numbers::pi * (static_cast<double>(i) + 0.5) / static_cast<double>(a_samples);
+			error.Add(a_findCusp(static_cast<float>(std::cos(hue)), static_cast<float>(std::sin(hue)), a_bt2020), a_exact[i], hue * 180.0 / std::numbers::pi);
+		}
+		return error;
+	}
+
+	// Tables of other sizes, to show what the default one buys
+	template <std::size_t N>
+	void PrintTableSize(bool a_bt2020, const std::vector<Color::OklabLC>& a_exact, std::size_t a_samples)
+	{
+		const auto table = std::make_unique<Color::OklabCuspTable<N>>(Color::OklabCuspTable<N>::Make(a_bt2020));
+		char       label[64];
+		std::snprintf(label, sizeof(label), "table of %zu", N);
+		PrintError(label, MeasureError([&](float a_a, float a_b, bool) { return table->Sample(a_a, a_b); }, a_bt2020, a_exact, a_samples), a_samples);
+	}
+
+	struct GamutClipError
+	{
+		double      max = 0.0;   // linear RGB, max channel
+		double      mean = 0.0;  // linear RGB, max channel
+		std::size_t notFinite = 0;
+	};
+
+	// Gamut clips random colors (mostly out of gamut, up to 4 times the gamut's white) with "a_findCusp", against clipping them with the exact cusps
+	template <class F>
+	GamutClipError MeasureGamutClipError(const char* a_label, F a_findCusp, bool a_bt2020, std::size_t a_samples)
+	{
+		std::mt19937                          random(1234);
+		std::uniform_real_distribution<float> channel(-0.5f, 4.f);
+		const auto                            exactCusp = [](float a_a, float a_b, bool a_bt2020) { return Color::Exact::OklabCusp(a_a, a_b, a_bt2020); };
+
+		double      maxError = 0.0;
+		double      meanError = 0.0;
+		std::size_t notFinite = 0;
+		for (std::size_t i = 0; i < a_samples; ++i) {
+			const Color::Float3 color = { channel(random), channel(random), channel(random) };
+			const Color::Float3 reference = Color::GamutClipProjectToLCusp(color, a_bt2020, a_bt2020, a_bt2020, exactCusp);
+			const Color::Float3 clipped = Color::GamutClipProjectToLCusp(color, a_bt2020, a_bt2020, a_bt2020, a_findCusp);
+			if (!std::isfinite(clipped.x) || !std::isfinite(clipped.y) || !std::isfinite(clipped.z)) {
+				++notFinite;
+				continue;
+			}
+			const double error = std::max({ std::abs(clipped.x - reference.x), std::abs(clipped.y - reference.y), std::abs(clipped.z - reference.z) });
+			maxError = std::max(maxError, error);
+			meanError += error;
+		}
+		const GamutClipError error{ maxError, meanError / static_cast<double>(a_samples), notFinite };
+		std::printf("  %-22s max %.2e, mean %.2e (linear RGB, max channel), %zu not finite\n", a_label, error.max, error.mean, error.notFinite);
+		return error;
+	}
+
+	template <class F>
+	double TimeNsPerCusp(F a_findCusp, bool a_bt2020)
+	{
+		constexpr std::size_t kCount = 1 << 20;
+		float                 sum = 0.f;
+		const auto            start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < kCount; ++i) {
+			const float hue = 6.2831853f * static_cast<float>(i) / kCount;
+			const auto  cusp = a_findCusp(std::cos(hue), std::sin(hue), a_bt2020);
+			sum += cusp.L + cusp.C;
+		}
+		const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / kCount;
+		// Keeps the loop from being optimized away
+		if (sum == 0.f) {
+			std::printf(" ");
+		}
+		return ns;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t samples = 1 << 18;
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--samples" && i + 1 < argc) {
+			samples = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 1));
+		} else {
+			std::fprintf(stderr, "Usage: %s [--samples <count>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const auto   buildStart = std::chrono::steady_clock::now();
+	const auto&  bt709Table = Color::GetOklabCuspTable(false);
+	const auto&  bt2020Table = Color::GetOklabCuspTable(true);
+	const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+	std::printf("Tables of %zu hues (%zu bytes each) built in %.2f ms, %zu hues sampled\n\n", Color::kOklabCuspTableSize, sizeof(bt709Table), buildMs, samples);
+	if (bt709Table.values[0].C == bt2020Table.values[0].C) {
+		std::fprintf(stderr, "The BT.709 and BT.2020 tables are the same\n");
+		return 1;
+	}
+
+	bool bFailed = false;
+	for (const bool bBT2020 : { false, true }) {
+		std::vector<Color::OklabLC> exact(samples);
+		for (std::size_t i = 0; i < samples; ++i) {
+			const double hue = 2.0 * std::numbers::pi * (static_cast<double>(i) + 0.5) / static_cast<double>(samples);
+			exact[i] = Color::Exact::OklabCusp(std::cos(hue), std::sin(hue), bBT2020);
+		}
+
+		const Error solverError = MeasureError(Color::OklabFindCusp, bBT2020, exact, samples);
+		const Error tableError = MeasureError(Color::OklabFindCuspFromTable, bBT2020, exact, samples);
+
+		std::printf("%s, against the exact cusps\n", bBT2020 ? "BT.2020" : "BT.709");
+		PrintError("solver", solverError, samples);
+		PrintError("table", tableError, samples);
+		PrintTableSize<256>(bBT2020, exact, samples);
+		PrintTableSize<512>(bBT2020, exact, samples);
+		PrintTableSize<2048>(bBT2020, exact, samples);
+		MeasureGamutClipError("gamut clip, solver", Color::OklabFindCusp, bBT2020, samples);
+		const GamutClipError clipError = MeasureGamutClipError("gamut clip, table", Color::OklabFindCuspFromTable, bBT2020, samples);
+		std::printf("  %-22s solver %.1f ns, table %.1f ns (including the sin/cos of the hue)\n\n", "time per cusp", TimeNsPerCusp(Color::OklabFindCusp, bBT2020),
+			TimeNsPerCusp(Color::OklabFindCuspFromTable, bBT2020));
+
+		const double meanL = tableError.meanL / static_cast<double>(samples), meanC = tableError.meanC / static_cast<double>(samples);
+		if (!(tableError.maxL <= kMaxTableError && tableError.maxC <= kMaxTableError && meanL <= kMaxTableMeanError && meanC <= kMaxTableMeanError)) {
+			std::fprintf(stderr, "%s: table errors above the limits (max %.2e, mean %.2e)\n", bBT2020 ? "BT.2020" : "BT.709", kMaxTableError, kMaxTableMeanError);
+			bFailed = true;
+		}
+		if (!(clipError.mean <= kMaxGamutClipMeanError) || clipError.notFinite) {
+			std::fprintf(stderr, "%s: gamut clip with the table above the limit (mean %.2e) or not finite\n", bBT2020 ? "BT.2020" : "BT.709", kMaxGamutClipMeanError);
+			bFailed = true;
+		}
+	}
+	return bFailed ? 1 : 0;
+}
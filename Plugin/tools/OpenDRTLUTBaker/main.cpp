@@ -0,0 +1,145 @@
+// Measures how far the baked OpenDRT LUTs of "OpenDRTLUT.h" are from the analytic transform, and how long baking takes.
+// Usage: OpenDRTLUTBaker [--samples <count>] [--threads <count>]
+// Every configuration (display and user settings) is baked at 33^3 and 65^3 with both shapers, then compared against the analytic transform
+// on "--samples" random colors: a max channel from 2^-12 to 2^6 (log uniform) and random ratios for the other channels, so every hue and saturation.
+// Errors are BT.2124 Delta E ITP of what the display shows (the output scaled to the display's nits), 1 being about a just noticeable difference.
+// Time per color of the CPU transform and of a LUT sample is also reported, as a rough idea of the ALU a LUT saves per pixel (~8.3M per frame at 4K).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "Metrics.h"
+#include "OpenDRTLUT.h"
+
+namespace
+{
+	using namespace ToneMapping;
+
+	struct Configuration
+	{
+		const char*      name;
+		OpenDRTLUTInputs inputs;
+	};
+
+	std::vector<Configuration> GetConfigurations()
+	{
+		std::vector<Configuration> configurations;
+		const auto                 add = [&](const char* a_name, auto a_setup) {
+			OpenDRTLUTInputs inputs;
+			a_setup(inputs);
+			configurations.push_back({ a_name, inputs });
+		};
+
+		add("Reference (203 nits)", [](OpenDRTLUTInputs&) {});
+		add("400 nits", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 400.f; });
+		add("1000 nits", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 1000.f; });
+		add("4000 nits", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 4000.f; });
+		add("1000 nits, paper white 300", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 1000.f; a_inputs.midGrayAdjustment = 300.f / Color::kReferenceWhiteNits_BT2408; });
+		add("1000 nits, contrast 0.5", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 1000.f; a_inputs.contrast = 0.5f; });
+		add("1000 nits, contrast 1.5", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 1000.f; a_inputs.contrast = 1.5f; });
+		add("1000 nits, highlights 0", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 1000.f; a_inputs.highlights = 0.f; });
+		add("1000 nits, highlights 2", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 1000.f; a_inputs.highlights = 2.f; });
+		add("1000 nits, shadows 0", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 1000.f; a_inputs.shadows = 0.f; });
+		add("1000 nits, shadows 2", [](OpenDRTLUTInputs& a_inputs) { a_inputs.peakNits = 1000.f; a_inputs.shadows = 2.f; });
+		return configurations;
+	}
+
+	// Errors of what the display shows, the outputs being relative to its peak
+	Metrics::ErrorStats MeasureError(const ShapedLUT& a_lut, const OpenDRTLUTInputs& a_inputs, const std::vector<Float3>& a_samples, const std::vector<Float3>& a_analytic)
+	{
+		const float         scale = a_inputs.peakNits / Color::kWhiteNits_sRGB;
+		std::vector<double> errors(a_samples.size());
+		for (std::size_t i = 0; i < a_samples.size(); ++i) {
+			errors[i] = Metrics::DeltaEITP(a_lut.Sample(a_samples[i]) * scale, a_analytic[i] * scale);
+		}
+		return Metrics::GetErrorStats(errors);
+	}
+
+	template <class F>
+	double TimeNsPerColor(const std::vector<Float3>& a_samples, F a_function)
+	{
+		float      sum = 0.f;
+		const auto start = std::chrono::steady_clock::now();
+		for (const auto& sample : a_samples) {
+			const Float3 color = a_function(sample);
+			sum += color.x + color.y + color.z;
+		}
+		const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(a_samples.size());
+		// Keeps the loop from being optimized away
+		if (sum == 0.f) {
+			std::printf(" ");
+		}
+		return ns;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t samples = 1 << 18;
+	std::size_t threadCount = 0;
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--samples" && i + 1 < argc) {
+			samples = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 1));
+		} else if (argument == "--threads" && i + 1 < argc) {
+			threadCount = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 0));
+		} else {
+			std::fprintf(stderr, "Usage: %s [--samples <count>] [--threads <count>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	struct LUTType
+	{
+		const char* name;
+		std::size_t size;
+		LUTShaper   shaper;
+	};
+	constexpr LUTType kLUTTypes[] = {
+		{ "33^3 PQ", 33, LUTShaper::kPQ },
+		{ "33^3 log2", 33, LUTShaper::kLog2 },
+		{ "65^3 PQ", 65, LUTShaper::kPQ },
+		{ "65^3 log2", 65, LUTShaper::kLog2 }
+	};
+
+	const std::vector<Float3> colors = Metrics::MakeSamples(samples);
+	std::printf("%zu colors, %zu threads\n\n", samples, threadCount ? threadCount : std::max<std::size_t>(std::thread::hardware_concurrency(), 1));
+
+	for (const auto& configuration : GetConfigurations()) {
+		const OpenDRTLUTInputs& inputs = configuration.inputs;
+
+		std::vector<Float3> analytic(colors.size());
+		for (std::size_t i = 0; i < colors.size(); ++i) {
+			analytic[i] = EvaluateOpenDRT(colors[i], inputs);
+		}
+
+		std::printf("%s\n", configuration.name);
+		for (const auto& type : kLUTTypes) {
+			constexpr int kBakes = 8;
+			ShapedLUT     lut(type.size, type.shaper);
+			const auto    start = std::chrono::steady_clock::now();
+			for (int i = 0; i < kBakes; ++i) {
+				BakeOpenDRTLUT(inputs, lut, threadCount);
+			}
+			const double bakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / kBakes;
+
+			const Metrics::ErrorStats error = MeasureError(lut, inputs, colors, analytic);
+			std::printf("  %-10s baked in %6.2f ms, Delta E ITP mean %.3f, 99.9%% %.3f, max %.3f\n", type.name, bakeMs, error.mean, error.percentile999, error.max);
+		}
+	}
+
+	const OpenDRTLUTInputs inputs = GetConfigurations()[2].inputs;
+	ShapedLUT              lut(65, LUTShaper::kPQ);
+	BakeOpenDRTLUT(inputs, lut, threadCount);
+	const double analyticNs = TimeNsPerColor(colors, [&](const Float3& a_color) { return EvaluateOpenDRT(a_color, inputs); });
+	const double lutNs = TimeNsPerColor(colors, [&](const Float3& a_color) { return lut.Sample(a_color); });
+	std::printf("\nOne thread, per color: transform %.1f ns, 65^3 LUT sample %.1f ns (%.0f ms and %.0f ms of one core for a 4K frame)\n", analyticNs, lutNs,
+		analyticNs * 3840.0 * 2160.0 * 1e-6, lutNs * 3840.0 * 2160.0 * 1e-6);
+	std::printf("Texture sizes as R16G16B16A16_FLOAT: 33^3 %d KB, 65^3 %d KB\n", 33 * 33 * 33 * 8 / 1024, 65 * 65 * 65 * 8 / 1024);
+	return 0;
+}
@@ -0,0 +1,154 @@
+// Converts Luma's lossless HDR screenshots (.lumaraw) to the same HDR10 PNGs the game would have written.
+// Usage: RawConverter [--exr] <capture.lumaraw>... (each output goes next to its input, with a .png extension, plus a .json with its light level)
+// --exr also writes the capture's linear values to an uncompressed OpenEXR (.exr) for grading tools.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <stb_image_write_hdr_png.h>
+
+#include "Screenshot.h"
+
+namespace
+{
+	const char* GetFormatName(Screenshot::PixelFormat a_format)
+	{
+		switch (a_format) {
+		case Screenshot::PixelFormat::kR16G16B16A16_FLOAT:
+			return "R16G16B16A16_FLOAT";
+		case Screenshot::PixelFormat::kR32G32B32A32_FLOAT:
+			return "R32G32B32A32_FLOAT";
+		case Screenshot::PixelFormat::kR10G10B10A2_UNORM:
+			return "R10G10B10A2_UNORM";
+		}
+		return "unknown";
+	}
+
+	// 64 bit offsets, a long is 32 bits on Windows and the PNG of a big capture can be past 2 GB
+	int Seek(FILE* a_file, long long a_offset, int a_origin)
+	{
+#ifdef _WIN32
+		return _fseeki64(a_file, a_offset, a_origin);
+#else
+		return fseeko(a_file, static_cast<off_t>(a_offset), a_origin);
+#endif
+	}
+
+	bool WriteEXR(const std::filesystem::path& a_outputPath, const Screenshot::Image& a_image)
+	{
+		FILE* file = std::fopen(a_outputPath.string().c_str(), "wb");
+		if (!file) {
+			std::fprintf(stderr, "%s: can't create\n", a_outputPath.string().c_str());
+			return false;
+		}
+
+		const auto writeCallback = [](void* context, void* data, int size) {
+			std::fwrite(data, 1, size, static_cast<FILE*>(context));
+		};
+		const bool bEncoded = Screenshot::WriteLinearEXR(a_image, writeCallback, file);
+		// The write callback can't fail the encoder, a full disk only shows on the stream
+		bool bWritten = !std::ferror(file);
+		bWritten &= std::fclose(file) == 0;
+
+		if (!bEncoded) {
+			std::fprintf(stderr, "%s: encoding failed\n", a_outputPath.string().c_str());
+			return false;
+		}
+		if (!bWritten) {
+			std::fprintf(stderr, "%s: write failed\n", a_outputPath.string().c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool Convert(const std::filesystem::path& a_inputPath, bool a_exr)
+	{
+		std::ifstream input(a_inputPath, std::ios::binary);
+		if (!input) {
+			std::fprintf(stderr, "%s: can't open\n", a_inputPath.string().c_str());
+			return false;
+		}
+		const std::vector<std::uint8_t> data{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+
+		Screenshot::RawHeader header;
+		Screenshot::Image     image;
+		if (!Screenshot::ParseRaw(data.data(), data.size(), header, image)) {
+			std::fprintf(stderr, "%s: not a valid raw capture\n", a_inputPath.string().c_str());
+			return false;
+		}
+
+		std::printf("%s: %ux%u %s, peak brightness %g nits, game paper white %g nits, UI paper white %g nits\n",
+			a_inputPath.string().c_str(), header.width, header.height, GetFormatName(header.format),
+			header.peakBrightness, header.gamePaperWhite, header.uiPaperWhite);
+
+		auto outputPath = a_inputPath;
+		if (a_exr && !WriteEXR(outputPath.replace_extension(".exr"), image)) {
+			return false;
+		}
+		outputPath.replace_extension(".png");
+
+		FILE* file = std::fopen(outputPath.string().c_str(), "wb");
+		if (!file) {
+			std::fprintf(stderr, "%s: can't create\n", outputPath.string().c_str());
+			return false;
+		}
+
+		const auto writeCallback = [](void* context, void* data, int size) {
+			std::fwrite(data, 1, size, static_cast<FILE*>(context));
+		};
+		const auto patchCallback = [](void* context, long long offset, const void* data, int size) {
+			const auto file = static_cast<FILE*>(context);
+			if (Seek(file, offset, SEEK_SET) == 0) {
+				std::fwrite(data, 1, size, file);
+				Seek(file, 0, SEEK_END);
+			}
+		};
+		Screenshot::LightLevelStats stats;
+		const bool                  bEncoded = Screenshot::WriteHDR10PNG(image, Screenshot::Compression::kSmallest, writeCallback, patchCallback, file, &stats);
+		bool                        bWritten = !std::ferror(file);
+		bWritten &= std::fclose(file) == 0;
+
+		if (!bEncoded) {
+			std::fprintf(stderr, "%s: encoding failed\n", outputPath.string().c_str());
+			return false;
+		}
+		if (!bWritten) {
+			std::fprintf(stderr, "%s: write failed\n", outputPath.string().c_str());
+			return false;
+		}
+
+		std::printf("%s: MaxCLL %.1f nits, MaxFALL %.1f nits\n", outputPath.string().c_str(), stats.maxCLL, stats.GetMaxFALL());
+		outputPath.replace_extension(".json");
+		std::ofstream json(outputPath);
+		json << Screenshot::FormatLightLevelStats(stats);
+		json.close();
+		if (!json) {
+			std::fprintf(stderr, "%s: write failed\n", outputPath.string().c_str());
+			return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const bool bExr = argc > 1 && std::string_view(argv[1]) == "--exr";
+	const int  firstInput = bExr ? 2 : 1;
+	if (argc <= firstInput) {
+		std::fprintf(stderr, "Usage: %s [--exr] <capture.lumaraw>...\n", argv[0]);
+		return 1;
+	}
+
+	int result = 0;
+	for (int i = firstInput; i < argc; ++i) {
+		if (!Convert(argv[i], bExr)) {
+			result = 1;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,574 @@
+// Times the portable parts of the SDR and HDR screenshot pipelines on deterministic synthetic frames and writes a JSON report.
+// Usage: ScreenshotBenchmark [--quick] [--stripes] [--iterations <count>] [--output <report.json>]
+// --quick only runs 1080p. Every stage reports the best time out of all iterations, and MB/s of the data it consumes:
+// the source frame for most stages, the filtered PNG rows for "deflate". "deflate" runs on a single thread,
+// the "png_*" stages are the complete multithreaded HDR10 PNG encoder.
+// --stripes measures how the HDR10 PNG encoder scales instead: the FP16 frames are encoded (balanced) with 1, 2, 4... stripes
+// compressed at once, up to one per hardware thread, and each count reports its MB/s of source frame and speedup over a single stripe.
+// Cases also report the peak resident memory of the process while they ran, their frame included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <stb_image_write_hdr_png.h>
+
+#include <DirectXPackedVector.h>
+
+#include "Screenshot.h"
+
+#include <malloc.h>
+#ifdef _WIN32
+#	include <Windows.h>
+#	include <psapi.h>
+#else
+#	include <unistd.h>
+#endif
+
+namespace
+{
+	enum class Pattern
+	{
+		kGradient,
+		kNoise,
+		kHighlights
+	};
+
+	struct Resolution
+	{
+		const char* name;
+		std::size_t width;
+		std::size_t height;
+	};
+
+	struct Stage
+	{
+		const char* name;
+		double      bytes = 0.0;  // consumed per run
+		double      bestMs = std::numeric_limits<double>::max();
+		std::size_t outputBytes = 0;
+	};
+
+	// xorshift64, so frames are identical on every platform and standard library
+	class Random
+	{
+	public:
+		explicit Random(std::uint64_t a_seed) :
+			state(a_seed)
+		{}
+
+		// In [0, 1)
+		float Next()
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return static_cast<float>(state >> 40) * (1.f / 16777216.f);
+		}
+
+	private:
+		std::uint64_t state;
+	};
+
+	const char* GetPatternName(Pattern a_pattern)
+	{
+		switch (a_pattern) {
+		case Pattern::kGradient:
+			return "gradient";
+		case Pattern::kNoise:
+			return "noise";
+		case Pattern::kHighlights:
+			return "highlights";
+		}
+		return "unknown";
+	}
+
+	const char* GetFormatName(Screenshot::PixelFormat a_format)
+	{
+		switch (a_format) {
+		case Screenshot::PixelFormat::kR16G16B16A16_FLOAT:
+			return "R16G16B16A16_FLOAT";
+		case Screenshot::PixelFormat::kR32G32B32A32_FLOAT:
+			return "R32G32B32A32_FLOAT";
+		case Screenshot::PixelFormat::kR10G10B10A2_UNORM:
+			return "R10G10B10A2_UNORM";
+		}
+		return "unknown";
+	}
+
+	// Resident memory of the process
+	double GetRSSMegabytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters = {};
+		if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return 0.0;
+		}
+		return static_cast<double>(counters.WorkingSetSize) / (1024.0 * 1024.0);
+#else
+		long  pages = 0, residentPages = 0;
+		FILE* file = std::fopen("/proc/self/statm", "r");
+		if (!file) {
+			return 0.0;
+		}
+		const bool bRead = std::fscanf(file, "%ld %ld", &pages, &residentPages) == 2;
+		std::fclose(file);
+		return bRead ? static_cast<double>(residentPages) * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0) : 0.0;
+#endif
+	}
+
+	// Peak resident memory of the process while one case runs. The process peak only ever grows, so every case would report the
+	// biggest one before it: on Linux it's reset when the meter starts (clear_refs), elsewhere, or if that fails, the resident
+	// memory is sampled every millisecond on another thread instead.
+	class PeakRSSMeter
+	{
+	public:
+		PeakRSSMeter()
+		{
+			// What earlier cases freed can stay resident in the heap, it's given back first so it doesn't count as this case's
+#ifdef _WIN32
+			_heapmin();
+#elif defined(__GLIBC__)
+			malloc_trim(0);
+#endif
+#ifndef _WIN32
+			if (FILE* file = std::fopen("/proc/self/clear_refs", "w")) {
+				bReset = std::fputs("5", file) >= 0;
+				bReset &= std::fclose(file) == 0;
+			}
+#endif
+			if (!bReset) {
+				peakMegabytes = GetRSSMegabytes();
+				sampler = std::jthread([this](std::stop_token a_stop) {
+					while (!a_stop.stop_requested()) {
+						peakMegabytes = std::max(peakMegabytes, GetRSSMegabytes());
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}
+				});
+			}
+		}
+
+		double Stop()
+		{
+			if (sampler.joinable()) {
+				sampler.request_stop();
+				sampler.join();
+				return std::max(peakMegabytes, GetRSSMegabytes());
+			}
+#ifndef _WIN32
+			// VmHWM, the peak that was reset
+			if (FILE* file = std::fopen("/proc/self/status", "r")) {
+				char line[256];
+				long kilobytes = 0;
+				while (std::fgets(line, sizeof(line), file) && std::sscanf(line, "VmHWM: %ld kB", &kilobytes) != 1) {}
+				std::fclose(file);
+				return static_cast<double>(kilobytes) / 1024.0;
+			}
+#endif
+			return 0.0;
+		}
+
+	private:
+		bool         bReset = false;
+		double       peakMegabytes = 0.0;  // sampled, only written by the sampler while it runs
+		std::jthread sampler;
+	};
+
+	// scRGB color of a pixel, 1 is 80 nits
+	DirectX::XMFLOAT3 GetPatternColor(Pattern a_pattern, std::size_t a_x, std::size_t a_y, std::size_t a_width, std::size_t a_height, Random& a_random)
+	{
+		const float u = static_cast<float>(a_x) / static_cast<float>(a_width);
+		const float v = static_cast<float>(a_y) / static_cast<float>(a_height);
+		switch (a_pattern) {
+		case Pattern::kGradient:
+			// Smooth ramps up to 1000 nits, the best case for the PNG filters
+			return { 12.5f * u, 12.5f * v, 12.5f * (1.f - u) * (1.f - v) };
+		case Pattern::kNoise:
+			// Uncorrelated channels up to 200 nits, the worst case for compression
+			return { 2.5f * a_random.Next(), 2.5f * a_random.Next(), 2.5f * a_random.Next() };
+		case Pattern::kHighlights:
+			{
+				// Dim noisy scene with a grid of 10000 nits primaries, slightly out of gamut
+				constexpr std::size_t cellSize = 256;
+				constexpr float       radius = 40.f;
+				const float           dx = static_cast<float>(a_x % cellSize) - cellSize / 2;
+				const float           dy = static_cast<float>(a_y % cellSize) - cellSize / 2;
+				const float           base = 0.25f + 0.1f * a_random.Next();
+				if (dx * dx + dy * dy < radius * radius) {
+					switch ((a_x / cellSize + a_y / cellSize) % 3) {
+					case 0:
+						return { 125.f, -0.05f, -0.05f };
+					case 1:
+						return { -0.05f, 125.f, -0.05f };
+					default:
+						return { -0.05f, -0.05f, 125.f };
+					}
+				}
+				return { base, base * 0.9f, base * 0.8f };
+			}
+		}
+		return { 0.f, 0.f, 0.f };
+	}
+
+	std::vector<std::uint8_t> MakeFrame(Pattern a_pattern, Screenshot::PixelFormat a_format, std::size_t a_width, std::size_t a_height)
+	{
+		const std::size_t         bytesPerPixel = Screenshot::GetBytesPerPixel(a_format);
+		std::vector<std::uint8_t> pixels(a_width * a_height * bytesPerPixel);
+		Random                    random(0x9E3779B97F4A7C15ull + static_cast<std::uint64_t>(a_pattern));
+
+		for (std::size_t y = 0; y < a_height; ++y) {
+			for (std::size_t x = 0; x < a_width; ++x) {
+				const DirectX::XMFLOAT3 color = GetPatternColor(a_pattern, x, y, a_width, a_height, random);
+				std::uint8_t* const     pixel = pixels.data() + (y * a_width + x) * bytesPerPixel;
+				switch (a_format) {
+				case Screenshot::PixelFormat::kR16G16B16A16_FLOAT:
+					{
+						const DirectX::PackedVector::HALF halfs[4] = {
+							DirectX::PackedVector::XMConvertFloatToHalf(color.x),
+							DirectX::PackedVector::XMConvertFloatToHalf(color.y),
+							DirectX::PackedVector::XMConvertFloatToHalf(color.z),
+							DirectX::PackedVector::XMConvertFloatToHalf(1.f)
+						};
+						std::memcpy(pixel, halfs, sizeof(halfs));
+						break;
+					}
+				case Screenshot::PixelFormat::kR32G32B32A32_FLOAT:
+					{
+						const float floats[4] = { color.x, color.y, color.z, 1.f };
+						std::memcpy(pixel, floats, sizeof(floats));
+						break;
+					}
+				case Screenshot::PixelFormat::kR10G10B10A2_UNORM:
+					{
+						// 10000 nits is 1
+						const auto quantize = [](float a_value) {
+							return static_cast<std::uint32_t>(std::clamp(a_value / 125.f, 0.f, 1.f) * 1023.f + 0.5f);
+						};
+						const std::uint32_t packed = quantize(color.x) | (quantize(color.y) << 10) | (quantize(color.z) << 20) | (3u << 30);
+						std::memcpy(pixel, &packed, sizeof(packed));
+						break;
+					}
+				}
+			}
+		}
+		return pixels;
+	}
+
+	double NowMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void CountingWrite(void* a_context, void*, int a_size)
+	{
+		*static_cast<std::size_t*>(a_context) += static_cast<std::size_t>(a_size);
+	}
+
+	void IgnorePatch(void*, long long, const void*, int)
+	{}
+
+	// Runs every stage "a_iterations" times on one frame
+	std::vector<Stage> Measure(const Screenshot::Image& a_image, int a_iterations)
+	{
+		const std::size_t width = a_image.width;
+		const std::size_t height = a_image.height;
+		const double      frameBytes = static_cast<double>(width * height * Screenshot::GetBytesPerPixel(a_image.format));
+		const int         rowBytes = static_cast<int>(width * 3 * sizeof(std::uint16_t));
+
+		std::vector<Stage> stages = {
+			{ "decode" }, { "thumbnail" }, { "transform" }, { "quantize" }, { "filter" }, { "deflate" },
+			{ "png_fastest" }, { "png_balanced" }, { "png_smallest" }, { "sdr_bgra8" }, { "raw" }, { "exr" }
+		};
+		for (auto& stage : stages) {
+			stage.bytes = frameBytes;
+		}
+		const auto find = [&](std::string_view a_name) -> Stage& {
+			return *std::ranges::find_if(stages, [&](const Stage& a_stage) { return a_name == a_stage.name; });
+		};
+		const auto record = [&](Stage& a_stage, double a_ms) {
+			a_stage.bestMs = std::min(a_stage.bestMs, a_ms);
+		};
+
+		Screenshot::PixelBuffer    floatRow(width);
+		std::vector<std::uint16_t> row(width * 3);
+		std::vector<std::uint8_t>  rows(2 * rowBytes);  // big endian current and prior rows, like the PNG writer keeps them
+		std::vector<signed char>   scratch(rowBytes);
+		std::vector<std::uint8_t>  filtered(height * (rowBytes + 1));
+		std::vector<std::uint8_t>  bgra(width * height * 4);
+
+		// Balanced filter selection, on a writer that only exists to hold the settings
+		stbi_hdr_png_writer filterSettings = {};
+		filterSettings.comp = 3;
+		filterSettings.row_bytes = rowBytes;
+		filterSettings.filter_mode = 1;
+		filterSettings.filtered = scratch.data();
+
+		for (int iteration = 0; iteration < a_iterations; ++iteration) {
+			// The row pipeline of WriteHDR10PNG, one stage at a time
+			double                      decodeMs = 0.0, thumbnailMs = 0.0, transformMs = 0.0, quantizeMs = 0.0, filterMs = 0.0;
+			Screenshot::LightLevelStats stats;
+			Screenshot::Downsampler     thumbnail(width, height, 640, 360, Screenshot::Downsampler::Filter::kTent);
+			std::fill(rows.begin(), rows.end(), std::uint8_t(0));
+
+			for (std::size_t y = 0; y < height; ++y) {
+				double start = NowMs();
+				Screenshot::DecodeRow(floatRow.data(), a_image.pixels + y * a_image.rowPitch, width, a_image.format);
+				double end = NowMs();
+				decodeMs += end - start;
+
+				start = end;
+				thumbnail.AddRow(floatRow.data());
+				end = NowMs();
+				thumbnailMs += end - start;
+
+				start = end;
+				Screenshot::TransformColor_HDR10(floatRow.data(), floatRow.data(), width, &stats);
+				end = NowMs();
+				transformMs += end - start;
+
+				start = end;
+				for (std::size_t x = 0; x < width; ++x) {
+					DirectX::PackedVector::XMUSHORTN4 unorm;
+					DirectX::PackedVector::XMStoreUShortN4(&unorm, floatRow[x]);
+					row[x * 3 + 0] = Screenshot::QuantizeTo10Bit(unorm.x);
+					row[x * 3 + 1] = Screenshot::QuantizeTo10Bit(unorm.y);
+					row[x * 3 + 2] = Screenshot::QuantizeTo10Bit(unorm.z);
+				}
+				end = NowMs();
+				quantizeMs += end - start;
+
+				start = end;
+				std::uint8_t* const cur = rows.data() + (y & 1) * rowBytes;
+				std::uint8_t* const prior = rows.data() + ((y + 1) & 1) * rowBytes;
+				for (int i = 0; i < rowBytes / 2; ++i) {
+					cur[i * 2] = static_cast<std::uint8_t>(row[i] >> 8);
+					cur[i * 2 + 1] = static_cast<std::uint8_t>(row[i]);
+				}
+				std::uint8_t* const out = filtered.data() + y * (rowBytes + 1);
+				const int           filter = stbiw__hdr_png_choose_filter(&filterSettings, cur, prior);
+				out[0] = static_cast<std::uint8_t>(filter);
+				stbiw__hdr_png_filter(filter, cur, prior, 6, 0, rowBytes, reinterpret_cast<signed char*>(out + 1));
+				filterMs += NowMs() - start;
+			}
+			record(find("decode"), decodeMs);
+			record(find("thumbnail"), thumbnailMs);
+			record(find("transform"), transformMs);
+			record(find("quantize"), quantizeMs);
+			record(find("filter"), filterMs);
+
+			// The filtered rows in stripes, deflated one after the other
+			{
+				Stage& deflate = find("deflate");
+				deflate.bytes = static_cast<double>(filtered.size());
+				deflate.outputBytes = 0;
+				const double start = NowMs();
+				for (std::size_t begin = 0; begin < filtered.size(); begin += STBIW__HDR_PNG_STRIPE_BYTES) {
+					stbiw__hdr_png_stripe stripe = {};
+					stripe.data = filtered.data();
+					stripe.begin = static_cast<int>(begin);
+					stripe.end = static_cast<int>(std::min<std::size_t>(begin + STBIW__HDR_PNG_STRIPE_BYTES, filtered.size()));
+					stripe.quality = 8;
+					stripe.last = stripe.end == static_cast<int>(filtered.size());
+					stbiw__hdr_png_deflate_stripe(&stripe);
+					deflate.outputBytes += static_cast<std::size_t>(stripe.compressed_size);
+					STBIW_FREE(stripe.compressed);
+				}
+				record(deflate, NowMs() - start);
+			}
+
+			const std::pair<const char*, Screenshot::Compression> encodes[] = {
+				{ "png_fastest", Screenshot::Compression::kFastest },
+				{ "png_balanced", Screenshot::Compression::kBalanced },
+				{ "png_smallest", Screenshot::Compression::kSmallest }
+			};
+			for (const auto& [name, compression] : encodes) {
+				Stage&       stage = find(name);
+				std::size_t  size = 0;
+				const double start = NowMs();
+				Screenshot::WriteHDR10PNG(a_image, compression, CountingWrite, IgnorePatch, &size, nullptr);
+				record(stage, NowMs() - start);
+				stage.outputBytes = size;
+			}
+
+			{
+				Stage&                  stage = find("sdr_bgra8");
+				Screenshot::Downsampler sdrThumbnail(width, height, 640, 360, Screenshot::Downsampler::Filter::kTent);
+				const double            start = NowMs();
+				Screenshot::ConvertToBGRA8(a_image, bgra.data(), width * 4, &sdrThumbnail);
+				record(stage, NowMs() - start);
+				stage.outputBytes = bgra.size();
+			}
+
+			{
+				Stage&       stage = find("raw");
+				std::size_t  size = 0;
+				const double start = NowMs();
+				Screenshot::WriteRaw(a_image, {}, CountingWrite, &size);
+				record(stage, NowMs() - start);
+				stage.outputBytes = size;
+			}
+
+			{
+				Stage&       stage = find("exr");
+				std::size_t  size = 0;
+				const double start = NowMs();
+				Screenshot::WriteLinearEXR(a_image, CountingWrite, &size);
+				record(stage, NowMs() - start);
+				stage.outputBytes = size;
+			}
+		}
+
+		return stages;
+	}
+
+	void Append(std::string& a_json, const char* a_format, auto... a_args)
+	{
+		char buffer[512];
+		std::snprintf(buffer, sizeof(buffer), a_format, a_args...);
+		a_json += buffer;
+	}
+
+	// 1, 2, 4... and the hardware thread count
+	std::vector<int> GetStripeCounts()
+	{
+		const int        hardwareThreads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+		std::vector<int> counts;
+		for (int count = 1; count < hardwareThreads; count *= 2) {
+			counts.push_back(count);
+		}
+		counts.push_back(hardwareThreads);
+		return counts;
+	}
+
+	// Encodes "a_image" once per stripe count and appends the results to "a_json" as an array
+	void MeasureStripeScaling(const Screenshot::Image& a_image, int a_iterations, std::string& a_json)
+	{
+		const double frameMegabytes = static_cast<double>(a_image.width * a_image.height * Screenshot::GetBytesPerPixel(a_image.format)) / (1024.0 * 1024.0);
+		double       singleStripeMs = 0.0;
+		bool         bFirst = true;
+		for (const int stripes : GetStripeCounts()) {
+			double      bestMs = std::numeric_limits<double>::max();
+			std::size_t size = 0;
+			for (int iteration = 0; iteration < a_iterations; ++iteration) {
+				size = 0;
+				const double start = NowMs();
+				Screenshot::WriteHDR10PNG(a_image, Screenshot::Compression::kBalanced, CountingWrite, IgnorePatch, &size, nullptr, stripes);
+				bestMs = std::min(bestMs, NowMs() - start);
+			}
+			if (stripes == 1) {
+				singleStripeMs = bestMs;
+			}
+
+			const double megabytesPerSecond = frameMegabytes / (bestMs / 1000.0);
+			const double speedup = singleStripeMs / bestMs;
+			std::printf(" %d: %.0f MB/s (x%.2f)", stripes, megabytesPerSecond, speedup);
+			Append(a_json, "%s\n\t\t\t\t{ \"stripes\": %d, \"ms\": %.3f, \"MBps\": %.1f, \"speedup\": %.2f, \"outputBytes\": %zu }",
+				bFirst ? "" : ",", stripes, bestMs, megabytesPerSecond, speedup, size);
+			bFirst = false;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool        bQuick = false;
+	bool        bStripes = false;
+	int         iterations = 3;
+	std::string outputPath = "screenshot_benchmark.json";
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--quick") {
+			bQuick = true;
+		} else if (argument == "--stripes") {
+			bStripes = true;
+		} else if (argument == "--iterations" && i + 1 < argc) {
+			iterations = std::max(std::atoi(argv[++i]), 1);
+		} else if (argument == "--output" && i + 1 < argc) {
+			outputPath = argv[++i];
+		} else {
+			std::fprintf(stderr, "Usage: %s [--quick] [--stripes] [--iterations <count>] [--output <report.json>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const Resolution resolutions[] = {
+		{ "1080p", 1920, 1080 },
+		{ "1440p", 2560, 1440 },
+		{ "4k", 3840, 2160 },
+		{ "8k", 7680, 4320 }
+	};
+	const Screenshot::PixelFormat formats[] = { Screenshot::PixelFormat::kR16G16B16A16_FLOAT, Screenshot::PixelFormat::kR10G10B10A2_UNORM };
+	const Pattern                 patterns[] = { Pattern::kGradient, Pattern::kNoise, Pattern::kHighlights };
+
+	std::string json;
+	Append(json, "{\n\t\"version\": 1,\n\t\"avx2\": %s,\n\t\"hardwareThreads\": %u,\n\t\"iterations\": %d,\n\t\"%s\": [",
+		Screenshot::HasAVX2() ? "true" : "false", std::thread::hardware_concurrency(), iterations, bStripes ? "stripeScaling" : "cases");
+
+	bool bFirstCase = true;
+	for (const auto& resolution : resolutions) {
+		if (bQuick && resolution.height > 1080) {
+			break;
+		}
+		if (bStripes) {
+			for (const auto pattern : patterns) {
+				constexpr auto          format = Screenshot::PixelFormat::kR16G16B16A16_FLOAT;
+				const auto              pixels = MakeFrame(pattern, format, resolution.width, resolution.height);
+				const Screenshot::Image image{ pixels.data(), resolution.width, resolution.height, resolution.width * Screenshot::GetBytesPerPixel(format), format };
+
+				std::printf("%-5s %-10s", resolution.name, GetPatternName(pattern));
+				Append(json, "%s\n\t\t{\n\t\t\t\"resolution\": \"%s\",\n\t\t\t\"width\": %zu,\n\t\t\t\"height\": %zu,\n\t\t\t\"format\": \"%s\",\n\t\t\t\"pattern\": \"%s\",\n\t\t\t\"results\": [",
+					bFirstCase ? "" : ",", resolution.name, resolution.width, resolution.height, GetFormatName(format), GetPatternName(pattern));
+				MeasureStripeScaling(image, iterations, json);
+				std::printf("\n");
+				std::fflush(stdout);
+				json += "\n\t\t\t]\n\t\t}";
+				bFirstCase = false;
+			}
+			continue;
+		}
+		for (const auto format : formats) {
+			for (const auto pattern : patterns) {
+				PeakRSSMeter            peakRSSMeter;
+				const auto              pixels = MakeFrame(pattern, format, resolution.width, resolution.height);
+				const Screenshot::Image image{ pixels.data(), resolution.width, resolution.height, resolution.width * Screenshot::GetBytesPerPixel(format), format };
+				const auto              stages = Measure(image, iterations);
+				const double            peakRSS = peakRSSMeter.Stop();
+
+				std::printf("%-5s %-18s %-10s", resolution.name, GetFormatName(format), GetPatternName(pattern));
+				Append(json, "%s\n\t\t{\n\t\t\t\"resolution\": \"%s\",\n\t\t\t\"width\": %zu,\n\t\t\t\"height\": %zu,\n\t\t\t\"format\": \"%s\",\n\t\t\t\"pattern\": \"%s\",\n\t\t\t\"peakRSSMB\": %.1f,\n\t\t\t\"stages\": {",
+					bFirstCase ? "" : ",", resolution.name, resolution.width, resolution.height, GetFormatName(format), GetPatternName(pattern), peakRSS);
+				for (std::size_t i = 0; i < stages.size(); ++i) {
+					const Stage& stage = stages[i];
+					const double megabytesPerSecond = stage.bytes / (1024.0 * 1024.0) / (stage.bestMs / 1000.0);
+					std::printf(" %s %.2fms", stage.name, stage.bestMs);
+					Append(json, "%s\n\t\t\t\t\"%s\": { \"ms\": %.3f, \"MBps\": %.1f, \"outputBytes\": %zu }",
+						i ? "," : "", stage.name, stage.bestMs, megabytesPerSecond, stage.outputBytes);
+				}
+				std::printf(" | peak RSS %.0f MB\n", peakRSS);
+				std::fflush(stdout);
+				json += "\n\t\t\t}\n\t\t}";
+				bFirstCase = false;
+			}
+		}
+	}
+	json += "\n\t]\n}\n";
+
+	FILE* file = std::fopen(outputPath.c_str(), "wb");
+	if (!file) {
+		std::fprintf(stderr, "%s: can't create\n", outputPath.c_str());
+		return 1;
+	}
+	std::fwrite(json.data(), 1, json.size(), file);
+	std::fclose(file);
+	std::printf("Report written to %s\n", outputPath.c_str());
+	return 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Checks of "Screenshot.h", each prints what it measured and returns false if anything is past its limit
+namespace Checks
+{
+	bool TransformColor();
+	bool HDRPNG();
+	bool WorkerPool();
+	bool ReadbackPool();
+	bool CompletionTracker();
+	bool Downsampler();
+	bool LinearEXR();
+	bool HDRPNGFuzz();
+
+	// Prints a measured value next to its limit, true if it's within it
+	inline bool Expect(const char* a_name, double a_value, double a_limit)
+	{
+		const bool bPassed = a_value <= a_limit;
+		std::printf("  %-60s %s: %.3g (max %.3g)\n", a_name, bPassed ? "passed" : "FAILED", a_value, a_limit);
+		return bPassed;
+	}
+
+	inline bool Expect(const char* a_name, bool a_condition)
+	{
+		std::printf("  %-60s %s\n", a_name, a_condition ? "passed" : "FAILED");
+		return a_condition;
+	}
+
+	inline double NowMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// PNG written to memory through "stb_image_write_hdr_png.h" callbacks, "Patch()" fills in the cLLi chunk once the frame is done
+	struct MemoryFile
+	{
+		std::vector<unsigned char> bytes;
+
+		static void Write(void* a_context, void* a_data, int a_size)
+		{
+			auto& bytes = static_cast<MemoryFile*>(a_context)->bytes;
+			bytes.insert(bytes.end(), static_cast<unsigned char*>(a_data), static_cast<unsigned char*>(a_data) + a_size);
+		}
+
+		static void Patch(void* a_context, long long a_offset, const void* a_data, int a_size)
+		{
+			auto& bytes = static_cast<MemoryFile*>(a_context)->bytes;
+			if (a_offset >= 0 && static_cast<std::size_t>(a_offset) + a_size <= bytes.size()) {
+				std::memcpy(bytes.data() + a_offset, a_data, a_size);
+			}
+		}
+	};
+
+	// xorshift64, so inputs are identical on every platform and standard library
+	class Random
+	{
+	public:
+		explicit Random(std::uint64_t a_seed) :
+			state(a_seed)
+		{}
+
+		std::uint64_t NextBits()
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+
+		// In [0, 1)
+		float Next() { return static_cast<float>(NextBits() >> 40) * (1.f / 16777216.f); }
+
+	private:
+		std::uint64_t state;
+	};
+}
@@ -0,0 +1,195 @@
+#include "Checks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "Screenshot.h"
+
+// "CompletionTracker" on a fake GPU queue that runs copies and fence signals in submission order, a few at a time.
+// Every callback checks that the copy it was added for has run, which holds as long as the signal is queued after the copy's
+// submission (what the ExecuteCommandLists hook ensures), and a signal queued before it is shown to complete too early.
+// Also: callbacks in fence order and, on one value, in the order they were added, failed signals and the completion time.
+namespace Checks
+{
+	namespace
+	{
+		class FakeQueue
+		{
+		public:
+			struct Command
+			{
+				int           copy = -1;  // id of a copy, or -1 for a signal
+				std::uint64_t value = 0;
+			};
+
+			void Submit(const Command& a_command) { commands.push_back(a_command); }
+
+			// Runs the next "a_count" commands
+			void Advance(std::size_t a_count)
+			{
+				for (; a_count > 0 && executed < commands.size(); --a_count) {
+					const auto& command = commands[executed++];
+					if (command.copy >= 0) {
+						copiesDone.push_back(command.copy);
+					} else {
+						completedValue = command.value;
+					}
+				}
+			}
+
+			bool IsCopyDone(int a_copy) const { return std::ranges::find(copiesDone, a_copy) != copiesDone.end(); }
+
+			std::uint64_t completedValue = 0;
+
+		private:
+			std::vector<Command> commands;
+			std::size_t          executed = 0;
+			std::vector<int>     copiesDone;
+		};
+
+		class FakeFence : public Screenshot::CompletionFence
+		{
+		public:
+			explicit FakeFence(FakeQueue& a_queue) :
+				queue(a_queue)
+			{}
+
+			bool Signal(std::uint64_t a_value) override
+			{
+				if (bFailSignals) {
+					return false;
+				}
+				queue.Submit({ -1, a_value });
+				return true;
+			}
+
+			std::uint64_t GetCompletedValue() override { return queue.completedValue; }
+
+			bool bFailSignals = false;
+
+		private:
+			FakeQueue& queue;
+		};
+
+		class FakeClock : public Screenshot::CompletionClock
+		{
+		public:
+			double NowMs() override { return nowMs; }
+
+			double nowMs = 1000.0;
+		};
+	}
+
+	bool CompletionTracker()
+	{
+		bool bPassed = true;
+
+		// Frames of captures: copies recorded in a command list, submitted at the end of the frame, then signalled like the hook does.
+		// The GPU runs behind, one command per frame.
+		{
+			FakeQueue                     queue;
+			FakeFence                     fence(queue);
+			FakeClock                     clock;
+			Screenshot::CompletionTracker tracker(fence, clock);
+
+			std::vector<int> order;
+			bool             bCopiesDone = true;
+			int              nextCopy = 0;
+			for (int frame = 0; frame < 40; ++frame) {
+				std::vector<int> recorded;
+				for (int i = 0; i < frame % 3; ++i) {
+					recorded.push_back(nextCopy++);
+				}
+				for (const int copy : recorded) {
+					queue.Submit({ copy, 0 });
+				}
+				if (!recorded.empty()) {
+					const auto fenceValue = tracker.Signal();
+					for (const int copy : recorded) {
+						tracker.Add(fenceValue, [&, copy] {
+							bCopiesDone &= queue.IsCopyDone(copy);
+							order.push_back(copy);
+						});
+					}
+				}
+				queue.Advance(1);
+				clock.nowMs += 16.0;
+				tracker.Poll();
+			}
+			queue.Advance(1000);
+			tracker.Poll();
+
+			bPassed &= Expect("every callback ran after its copy", bCopiesDone && static_cast<int>(order.size()) == nextCopy);
+			bPassed &= Expect("callbacks in submission order", std::ranges::is_sorted(order));
+			bPassed &= Expect("nothing left pending", tracker.GetPendingCount() == 0);
+		}
+
+		// A signal queued before the command list with the copy is submitted, what the tracker can't catch by itself
+		{
+			FakeQueue                     queue;
+			FakeFence                     fence(queue);
+			FakeClock                     clock;
+			Screenshot::CompletionTracker tracker(fence, clock);
+
+			bool bCopyDone = true;
+			tracker.Add(tracker.Signal(), [&] { bCopyDone = queue.IsCopyDone(0); });
+			queue.Submit({ 0, 0 });
+			queue.Advance(1);
+			tracker.Poll();
+			bPassed &= Expect("early signal completes before the copy", !bCopyDone);
+		}
+
+		// Fence order, and add order on the same value
+		{
+			FakeQueue                     queue;
+			FakeFence                     fence(queue);
+			FakeClock                     clock;
+			Screenshot::CompletionTracker tracker(fence, clock);
+
+			const auto  first = tracker.Signal();
+			const auto  second = tracker.Signal();
+			std::string order;
+			tracker.Add(second, [&] { order += 'c'; });
+			tracker.Add(first, [&] { order += 'a'; });
+			tracker.Add(second, [&] { order += 'd'; });
+			tracker.Add(first, [&] { order += 'b'; });
+
+			queue.Advance(1);
+			const auto ranFirst = tracker.Poll();
+			bPassed &= Expect("only the completed value's callbacks run", ranFirst == 2 && order == "ab" && tracker.GetPendingCount() == 2);
+			queue.Advance(1);
+			tracker.Poll();
+			bPassed &= Expect("fence order, then add order", order == "abcd");
+			bPassed &= Expect("poll with nothing pending runs nothing", tracker.Poll() == 0);
+		}
+
+		// Failed signal, and the completion time
+		{
+			FakeQueue                     queue;
+			FakeFence                     fence(queue);
+			FakeClock                     clock;
+			Screenshot::CompletionTracker tracker(fence, clock);
+
+			fence.bFailSignals = true;
+			bPassed &= Expect("failed signal returns 0", tracker.Signal() == 0);
+			fence.bFailSignals = false;
+			const auto value = tracker.Signal();
+			bPassed &= Expect("value not used up by the failed signal", value == 1);
+
+			bool bRan = false;
+			tracker.Add(value, [&] { bRan = true; });
+			clock.nowMs += 25.0;
+			tracker.Poll();
+			bPassed &= Expect("not run before the GPU gets there", !bRan);
+			clock.nowMs += 25.0;
+			queue.Advance(1);
+			tracker.Poll();
+			bPassed &= Expect("run once the GPU gets there", bRan);
+			bPassed &= Expect("completion time from the signal", std::abs(tracker.GetLastCompletionMs() - 50.0), 0.0);
+		}
+
+		return bPassed;
+	}
+}
@@ -0,0 +1,179 @@
+#include "Checks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Screenshot.h"
+
+// "Downsampler" fed random frames row by row, against a reference resize that evaluates each output pixel directly in 2D and in double
+// precision, from the filter definitions of "Screenshot.h" (box: area of the footprint, tent: triangle over twice the footprint)
+// and the same center crop. Integer box ratios are also compared with plain block averages.
+// Sizes cover integer and fractional ratios, crops on either axis, upscaling, and empty sources, which must leave a black output.
+namespace Checks
+{
+	namespace
+	{
+		// Float weights and sums of values in [0, 1], measured up to 1.9e-7
+		constexpr double kMaxError = 5e-7;
+
+		using Filter = Screenshot::Downsampler::Filter;
+
+		struct Frame
+		{
+			std::size_t        width;
+			std::size_t        height;
+			std::vector<float> values;  // RGBA
+		};
+
+		Frame MakeFrame(std::size_t a_width, std::size_t a_height, Random& a_random)
+		{
+			Frame frame{ a_width, a_height, std::vector<float>(a_width * a_height * 4) };
+			for (auto& value : frame.values) {
+				value = a_random.Next();
+			}
+			return frame;
+		}
+
+		std::vector<float> Downsample(const Frame& a_frame, std::size_t a_width, std::size_t a_height, Filter a_filter)
+		{
+			Screenshot::Downsampler downsampler(a_frame.width, a_frame.height, a_width, a_height, a_filter);
+			Screenshot::PixelBuffer row(a_frame.width);
+			for (std::size_t y = 0; y < a_frame.height; ++y) {
+				for (std::size_t x = 0; x < a_frame.width; ++x) {
+					row[x] = DirectX::XMLoadFloat4A(reinterpret_cast<const DirectX::XMFLOAT4A*>(a_frame.values.data() + (y * a_frame.width + x) * 4));
+				}
+				downsampler.AddRow(row.data());
+			}
+
+			std::vector<float> output(a_width * a_height * 4);
+			for (std::size_t i = 0; i < a_width * a_height; ++i) {
+				DirectX::XMStoreFloat4A(reinterpret_cast<DirectX::XMFLOAT4A*>(output.data() + i * 4), downsampler.GetPixels()[i]);
+			}
+			return output;
+		}
+
+		// Weight of the source pixel [a_pixel, a_pixel + 1] for an output pixel centered on "a_center"
+		double GetWeight(double a_pixel, double a_center, double a_scale, Filter a_filter)
+		{
+			if (a_filter == Filter::kBox) {
+				const double radius = std::max(a_scale, 1.0) * 0.5;
+				return std::max(std::min(a_pixel + 1.0, a_center + radius) - std::max(a_pixel, a_center - radius), 0.0);
+			}
+			const double radius = std::max(a_scale, 1.0);
+			return std::max(1.0 - std::abs(a_pixel + 0.5 - a_center) / radius, 0.0);
+		}
+
+		std::vector<double> ResizeReference(const Frame& a_frame, std::size_t a_width, std::size_t a_height, Filter a_filter)
+		{
+			std::vector<double> output(a_width * a_height * 4, 0.0);
+			if (a_frame.width == 0 || a_frame.height == 0) {
+				return output;
+			}
+
+			// Largest centered part of the source with the output aspect ratio, rounded to the nearest pixel
+			std::size_t cropWidth = a_frame.width, cropHeight = a_frame.height;
+			if (a_frame.width * a_height > a_frame.height * a_width) {
+				cropWidth = std::max<std::size_t>((a_frame.height * a_width + a_height / 2) / a_height, 1);
+			} else {
+				cropHeight = std::max<std::size_t>((a_frame.width * a_height + a_width / 2) / a_width, 1);
+			}
+			const std::size_t cropX = (a_frame.width - cropWidth) / 2, cropY = (a_frame.height - cropHeight) / 2;
+			const double      scaleX = static_cast<double>(cropWidth) / a_width, scaleY = static_cast<double>(cropHeight) / a_height;
+
+			for (std::size_t y = 0; y < a_height; ++y) {
+				for (std::size_t x = 0; x < a_width; ++x) {
+					const double centerX = (x + 0.5) * scaleX, centerY = (y + 0.5) * scaleY;
+					double       sum[4] = {}, totalWeight = 0.0;
+					for (std::size_t sy = 0; sy < cropHeight; ++sy) {
+						const double weightY = GetWeight(static_cast<double>(sy), centerY, scaleY, a_filter);
+						if (weightY == 0.0) {
+							continue;
+						}
+						for (std::size_t sx = 0; sx < cropWidth; ++sx) {
+							const double weight = weightY * GetWeight(static_cast<double>(sx), centerX, scaleX, a_filter);
+							const float* source = a_frame.values.data() + ((cropY + sy) * a_frame.width + cropX + sx) * 4;
+							for (int c = 0; c < 4; ++c) {
+								sum[c] += weight * source[c];
+							}
+							totalWeight += weight;
+						}
+					}
+					for (int c = 0; c < 4; ++c) {
+						output[(y * a_width + x) * 4 + c] = totalWeight > 0.0 ? sum[c] / totalWeight : 0.0;
+					}
+				}
+			}
+			return output;
+		}
+
+		template <class T>
+		double GetMaxError(const std::vector<float>& a_values, const std::vector<T>& a_reference)
+		{
+			double maxError = a_values.size() == a_reference.size() ? 0.0 : 1e30;
+			for (std::size_t i = 0; i < std::min(a_values.size(), a_reference.size()); ++i) {
+				maxError = std::max(maxError, std::abs(a_values[i] - static_cast<double>(a_reference[i])));
+			}
+			return maxError;
+		}
+	}
+
+	bool Downsampler()
+	{
+		Random random(0xA4093822299F31D0ull);
+		bool   bPassed = true;
+
+		// Box filter on an integer ratio is a plain average of 6x6 blocks
+		{
+			const Frame frame = MakeFrame(1920, 1080, random);
+			std::vector<double> blocks(320 * 180 * 4, 0.0);
+			for (std::size_t y = 0; y < 1080; ++y) {
+				for (std::size_t x = 0; x < 1920; ++x) {
+					for (int c = 0; c < 4; ++c) {
+						blocks[((y / 6) * 320 + x / 6) * 4 + c] += frame.values[(y * 1920 + x) * 4 + c] / 36.0;
+					}
+				}
+			}
+			bPassed &= Expect("box 1920x1080 to 320x180 against 6x6 block averages", GetMaxError(Downsample(frame, 320, 180, Filter::kBox), blocks), kMaxError);
+		}
+
+		struct Case
+		{
+			std::size_t sourceWidth, sourceHeight, width, height;
+		};
+		constexpr Case kCases[] = {
+			{ 1280, 720, 320, 180 },  // integer ratio
+			{ 1923, 1081, 160, 90 },  // fractional ratio, odd sizes
+			{ 1000, 1000, 160, 90 },  // cropped vertically
+			{ 800, 200, 160, 90 },    // cropped horizontally
+			{ 64, 40, 160, 90 },      // upscaled
+			{ 7, 1, 3, 1 }            // single row
+		};
+		for (const auto& [sourceWidth, sourceHeight, width, height] : kCases) {
+			const Frame frame = MakeFrame(sourceWidth, sourceHeight, random);
+			for (const auto filter : { Filter::kBox, Filter::kTent }) {
+				char name[96];
+				std::snprintf(name, sizeof(name), "%s %zux%zu to %zux%zu against the reference", filter == Filter::kBox ? "box" : "tent", sourceWidth, sourceHeight, width, height);
+				bPassed &= Expect(name, GetMaxError(Downsample(frame, width, height, filter), ResizeReference(frame, width, height, filter)), kMaxError);
+			}
+		}
+
+		// Empty sources, rows of a zero width source must not be read
+		{
+			Screenshot::Downsampler noColumns(0, 1080, 160, 90, Filter::kTent);
+			for (int y = 0; y < 1080; ++y) {
+				noColumns.AddRow(nullptr);
+			}
+			Screenshot::Downsampler noRows(1920, 0, 160, 90, Filter::kTent);
+			noRows.AddRow(nullptr);
+
+			bool bBlack = true;
+			for (std::size_t i = 0; i < 160 * 90; ++i) {
+				bBlack &= DirectX::XMVector4Equal(noColumns.GetPixels()[i], DirectX::g_XMZero) && DirectX::XMVector4Equal(noRows.GetPixels()[i], DirectX::g_XMZero);
+			}
+			bPassed &= Expect("empty sources give a black output", bBlack);
+		}
+
+		return bPassed;
+	}
+}
@@ -0,0 +1,133 @@
+#include "Checks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <stb_image_write_hdr_png.h>
+
+#include "Screenshot.h"
+
+// "WriteHDR10PNG()" on a random FP16 frame, big enough to be deflated in several stripes, in each compression mode.
+// The PNG is decoded again and every sample compared with a double precision PQ encoding of the frame, and the same frame encoded
+// on the calling thread and on the writer's threads must give the same bytes.
+namespace Checks
+{
+	namespace
+	{
+		constexpr std::size_t kWidth = 1920;
+		constexpr std::size_t kHeight = 1080;
+
+		// Half a code of rounding to 10 bits, plus the 16 bit rounding before it (0.008 code) and the PQ error of "TransformColor_HDR10()" (1e-5, 0.01 code)
+		constexpr double kMaxCodeError = 0.52;
+
+		constexpr double kPQMaxWhitePoint = 10000.0 / 80.0;
+
+		double HalfToDouble(std::uint16_t a_half)
+		{
+			const int    exponent = (a_half >> 10) & 0x1F;
+			const int    mantissa = a_half & 0x3FF;
+			const double magnitude = exponent ? std::ldexp(1024 + mantissa, exponent - 25) : std::ldexp(mantissa, -24);
+			return a_half & 0x8000 ? -magnitude : magnitude;
+		}
+
+		// 10 bit PQ code of each BT.2020 channel of a scRGB color
+		void EncodeReference(const double (&a_color)[3], double (&a_outCodes)[3])
+		{
+			constexpr double kBT709ToBT2020[3][3] = {
+				{ 0.627403895934699, 0.329283038377884, 0.043313065687417 },
+				{ 0.069097289358232, 0.919540395075459, 0.011362315566309 },
+				{ 0.016391438875150, 0.088013307877226, 0.895595253247624 }
+			};
+			for (int i = 0; i < 3; ++i) {
+				const double value = kBT709ToBT2020[i][0] * a_color[0] + kBT709ToBT2020[i][1] * a_color[1] + kBT709ToBT2020[i][2] * a_color[2];
+				const double colorPow = std::pow(std::clamp(value / kPQMaxWhitePoint, 0.0, 1.0), 0.1593017578125);
+				a_outCodes[i] = 1023.0 * std::pow((0.8359375 + 18.8515625 * colorPow) / (1.0 + 18.6875 * colorPow), 78.84375);
+			}
+		}
+
+		// Mostly positive halves from 2^-14 to 2^8 (past 10000 nits), with some slightly negative channels and exact blacks.
+		// Noise barely compresses, so the frame spans several stripes.
+		std::uint16_t MakeChannel(Random& a_random)
+		{
+			const std::uint64_t bits = a_random.NextBits();
+			const std::uint16_t mantissa = static_cast<std::uint16_t>(bits & 0x3FF);
+			switch ((bits >> 10) % 20) {
+			case 0:
+				return 0;
+			case 1:
+				return static_cast<std::uint16_t>(0x8000 | (8 << 10) | mantissa);  // down to -2^-7
+			default:
+				return static_cast<std::uint16_t>(((1 + (bits >> 16) % 22) << 10) | mantissa);
+			}
+		}
+
+		std::vector<unsigned char> Encode(const Screenshot::Image& a_image, Screenshot::Compression a_compression, int a_stripes)
+		{
+			MemoryFile file;
+			if (!Screenshot::WriteHDR10PNG(a_image, a_compression, MemoryFile::Write, MemoryFile::Patch, &file, nullptr, a_stripes)) {
+				file.bytes.clear();
+			}
+			return file.bytes;
+		}
+	}
+
+	bool HDRPNG()
+	{
+		Random                     random(0x13198A2E03707344ull);
+		std::vector<std::uint16_t> pixels(kWidth * kHeight * 4);
+		for (std::size_t i = 0; i < pixels.size(); ++i) {
+			pixels[i] = i % 4 == 3 ? 0x3C00 : MakeChannel(random);
+		}
+		const Screenshot::Image image{ reinterpret_cast<const std::uint8_t*>(pixels.data()), kWidth, kHeight, kWidth * 8, Screenshot::PixelFormat::kR16G16B16A16_FLOAT };
+
+		std::vector<double> referenceCodes(kWidth * kHeight * 3);
+		for (std::size_t i = 0; i < kWidth * kHeight; ++i) {
+			const double color[3] = { HalfToDouble(pixels[i * 4 + 0]), HalfToDouble(pixels[i * 4 + 1]), HalfToDouble(pixels[i * 4 + 2]) };
+			double       codes[3];
+			EncodeReference(color, codes);
+			std::copy(codes, codes + 3, referenceCodes.begin() + i * 3);
+		}
+
+		constexpr std::pair<const char*, Screenshot::Compression> kModes[] = {
+			{ "fastest", Screenshot::Compression::kFastest },
+			{ "balanced", Screenshot::Compression::kBalanced },
+			{ "smallest", Screenshot::Compression::kSmallest }
+		};
+
+		bool bPassed = true;
+		for (const auto& [modeName, compression] : kModes) {
+			// 4 stripes at a time even on a single core, so the writer's threads are always used, and one stripe at a time on this thread
+			const auto png = Encode(image, compression, 4);
+			const auto serialPNG = Encode(image, compression, 1);
+
+			int  width = 0, height = 0, channels = 0;
+			auto decoded = stbi_load_16_from_memory(png.data(), static_cast<int>(png.size()), &width, &height, &channels, 3);
+
+			double maxCodeError = 0.0;
+			bool   bReplicated = true;
+			if (decoded && width == static_cast<int>(kWidth) && height == static_cast<int>(kHeight)) {
+				for (std::size_t i = 0; i < referenceCodes.size(); ++i) {
+					const std::uint16_t value = decoded[i];
+					maxCodeError = std::max(maxCodeError, std::abs((value >> 6) - referenceCodes[i]));
+					bReplicated &= (value & 0x3F) == value >> 10;
+				}
+			}
+			stbi_image_free(decoded);
+
+			char name[96];
+			std::snprintf(name, sizeof(name), "%s: decoded %zux%zu RGB16", modeName, kWidth, kHeight);
+			bPassed &= Expect(name, width == static_cast<int>(kWidth) && height == static_cast<int>(kHeight) && channels == 3);
+			std::snprintf(name, sizeof(name), "%s: max 10 bit code error against double precision", modeName);
+			bPassed &= Expect(name, maxCodeError, kMaxCodeError);
+			std::snprintf(name, sizeof(name), "%s: low bits replicate the 10 bit code", modeName);
+			bPassed &= Expect(name, bReplicated);
+			std::snprintf(name, sizeof(name), "%s: same bytes on the writer's threads (%zu KB)", modeName, png.size() / 1024);
+			bPassed &= Expect(name, !png.empty() && png == serialPNG);
+		}
+		return bPassed;
+	}
+}
@@ -0,0 +1,345 @@
+#include "Checks.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <stb_image_write_hdr_png.h>
+
+// Random round trips through "stb_image_write_hdr_png.h", the chunked writer under "WriteHDR10PNG()", with stb_image as the reference decoder.
+// Every case picks a size, a channel count, the filter mode, deflate quality and stripe count, the color code points, a content light
+// level (none, given before the rows or after them), whether there's a patch function, and rows mixing noise, gradients and runs.
+// Every PNG must decode to the exact samples it was given, and its chunks are walked separately from both: CRCs, order, IHDR, cICP,
+// the cLLi values, and the zlib stream's length and Adler-32, which stb_image doesn't verify.
+// A few fixed edge cases come first (single pixels, a row longer than a stripe, a single column). The seed is fixed, so a failing case
+// is printed with its index and parameters and fails the same way on every run.
+namespace Checks
+{
+	namespace
+	{
+		constexpr int kRandomCases = 300;
+
+		enum class LightLevel
+		{
+			kNone,
+			kBefore,
+			kAfter
+		};
+
+		struct Case
+		{
+			int           width = 1;
+			int           height = 1;
+			int           comp = 4;
+			int           filterMode = 1;
+			int           quality = 8;
+			int           stripes = 1;
+			unsigned char colorPrimaries = 9;
+			unsigned char transferFunction = 16;
+			LightLevel    lightLevel = LightLevel::kNone;
+			float         maxCLL = 0.f;
+			float         maxFALL = 0.f;
+			std::uint32_t maxCLLUnits = 0;  // what the cLLi chunk must hold, in 0.0001 nits
+			std::uint32_t maxFALLUnits = 0;
+			bool          bPatch = false;
+			bool          bOneShot = false;  // "stbi_write_hdr_png_to_func()", with its defaults
+		};
+
+		// Light levels whose 0.0001 nit units are exact in float and below 2^23, so the writer's rounding can't move them,
+		// and out of range ones, which are clamped to [0, 10000]
+		void MakeLightLevel(Random& a_random, float& a_outNits, std::uint32_t& a_outUnits)
+		{
+			const std::uint64_t bits = a_random.NextBits();
+			switch (bits % 8) {
+			case 0:
+				a_outNits = -3.f;
+				a_outUnits = 0;
+				break;
+			case 1:
+				a_outNits = 12000.f;
+				a_outUnits = 100000000;
+				break;
+			default:
+				{
+					const auto sixteenths = static_cast<std::uint32_t>((bits >> 3) % 13000);
+					a_outNits = sixteenths / 16.f;
+					a_outUnits = sixteenths * 625;
+					break;
+				}
+			}
+		}
+
+		Case MakeCase(Random& a_random, int a_index)
+		{
+			Case                test;
+			const std::uint64_t bits = a_random.NextBits();
+			if (a_index % 20 == 19) {
+				// Several stripes
+				test.width = 400 + static_cast<int>(bits % 1200);
+				test.height = 100 + static_cast<int>((bits >> 12) % 600);
+			} else {
+				test.width = 1 + static_cast<int>(bits % 300);
+				test.height = 1 + static_cast<int>((bits >> 12) % 300);
+			}
+			test.comp = 1 + static_cast<int>((bits >> 24) % 4);
+			test.stripes = static_cast<int>((bits >> 28) % 5);
+			if ((bits >> 32) % 2) {
+				test.colorPrimaries = 1;
+				test.transferFunction = 13;
+			}
+
+			test.bOneShot = (bits >> 33) % 8 == 0;
+			if (test.bOneShot) {
+				test.stripes = 0;
+			} else {
+				test.filterMode = static_cast<int>((bits >> 36) % 3);
+				test.quality = 1 + static_cast<int>((bits >> 38) % 9);
+				test.lightLevel = static_cast<LightLevel>((bits >> 42) % 3);
+				test.bPatch = (bits >> 44) % 2;
+				if (test.lightLevel != LightLevel::kNone) {
+					MakeLightLevel(a_random, test.maxCLL, test.maxCLLUnits);
+					MakeLightLevel(a_random, test.maxFALL, test.maxFALLUnits);
+				}
+			}
+			return test;
+		}
+
+		// Rows of noise, gradients, runs, and copies of the row above with a few changes, so every PNG filter gets picked
+		std::vector<std::uint16_t> MakePixels(const Case& a_case, Random& a_random)
+		{
+			const std::size_t          rowSamples = static_cast<std::size_t>(a_case.width) * a_case.comp;
+			std::vector<std::uint16_t> pixels(rowSamples * a_case.height);
+			for (int y = 0; y < a_case.height; ++y) {
+				std::uint16_t* row = pixels.data() + y * rowSamples;
+				const auto     bits = a_random.NextBits();
+				switch (y == 0 ? bits % 3 : bits % 4) {
+				case 0:
+					for (std::size_t i = 0; i < rowSamples; ++i) {
+						row[i] = static_cast<std::uint16_t>(a_random.NextBits());
+					}
+					break;
+				case 1:
+					for (std::size_t i = 0; i < rowSamples; ++i) {
+						row[i] = static_cast<std::uint16_t>((bits >> 16) + (i / a_case.comp) * ((bits >> 32) % 64) + (i % a_case.comp) * 4096);
+					}
+					break;
+				case 2:
+					for (std::size_t i = 0; i < rowSamples;) {
+						const auto run = a_random.NextBits();
+						const auto length = std::min<std::size_t>(1 + run % 200, rowSamples - i);
+						std::fill_n(row + i, length, static_cast<std::uint16_t>(run >> 16));
+						i += length;
+					}
+					break;
+				default:
+					std::copy_n(row - rowSamples, rowSamples, row);
+					for (int i = 0; i < 4; ++i) {
+						row[a_random.NextBits() % rowSamples] ^= static_cast<std::uint16_t>(a_random.NextBits());
+					}
+					break;
+				}
+			}
+			return pixels;
+		}
+
+		std::vector<unsigned char> Encode(const Case& a_case, const std::vector<std::uint16_t>& a_pixels, bool& a_outWritten)
+		{
+			MemoryFile file;
+			if (a_case.bOneShot) {
+				a_outWritten = stbi_write_hdr_png_to_func(MemoryFile::Write, &file, a_case.width, a_case.height, a_case.comp, a_pixels.data(), 0, a_case.colorPrimaries, a_case.transferFunction) != 0;
+			} else {
+				const auto writer = stbi_write_hdr_png_begin(MemoryFile::Write, &file, a_case.width, a_case.height, a_case.comp, a_case.colorPrimaries, a_case.transferFunction, a_case.stripes);
+				stbi_write_hdr_png_compression(writer, a_case.filterMode, a_case.quality);
+				if (a_case.bPatch) {
+					stbi_write_hdr_png_patch(writer, MemoryFile::Patch);
+				}
+				if (a_case.lightLevel == LightLevel::kBefore) {
+					stbi_write_hdr_png_content_light_level(writer, a_case.maxCLL, a_case.maxFALL);
+				}
+
+				// Every row goes through the same buffer, scribbled over once it's passed, so the writer must not keep pointers to it
+				const std::size_t          rowSamples = static_cast<std::size_t>(a_case.width) * a_case.comp;
+				std::vector<std::uint16_t> row(rowSamples);
+				bool                       bRowsWritten = true;
+				for (int y = 0; y < a_case.height; ++y) {
+					std::copy_n(a_pixels.data() + y * rowSamples, rowSamples, row.data());
+					bRowsWritten &= stbi_write_hdr_png_row(writer, row.data()) != 0;
+					std::ranges::fill(row, static_cast<std::uint16_t>(0xA5A5));
+				}
+
+				if (a_case.lightLevel == LightLevel::kAfter) {
+					stbi_write_hdr_png_content_light_level(writer, a_case.maxCLL, a_case.maxFALL);
+				}
+				a_outWritten = stbi_write_hdr_png_end(writer) != 0 && bRowsWritten;
+			}
+			return file.bytes;
+		}
+
+		std::uint32_t ReadBigEndian(const unsigned char* a_bytes)
+		{
+			return (static_cast<std::uint32_t>(a_bytes[0]) << 24) | (a_bytes[1] << 16) | (a_bytes[2] << 8) | a_bytes[3];
+		}
+
+		// Bit by bit, nothing like the writer's tables
+		std::uint32_t GetCRC32(const unsigned char* a_bytes, std::size_t a_size)
+		{
+			std::uint32_t crc = 0xFFFFFFFF;
+			for (std::size_t i = 0; i < a_size; ++i) {
+				crc ^= a_bytes[i];
+				for (int bit = 0; bit < 8; ++bit) {
+					crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+				}
+			}
+			return ~crc;
+		}
+
+		std::uint32_t GetAdler32(const unsigned char* a_bytes, std::size_t a_size)
+		{
+			std::uint32_t a = 1, b = 0;
+			for (std::size_t i = 0; i < a_size; ++i) {
+				a = (a + a_bytes[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+			return (b << 16) | a;
+		}
+
+		// Empty if the PNG is valid and holds "a_pixels", else what's wrong with it
+		std::string CheckPNG(const Case& a_case, const std::vector<std::uint16_t>& a_pixels, const std::vector<unsigned char>& a_png)
+		{
+			constexpr unsigned char kSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+			if (a_png.size() < 8 || !std::equal(kSignature, kSignature + 8, a_png.begin())) {
+				return "no PNG signature";
+			}
+
+			// Chunks
+			std::vector<std::string>   chunks;
+			std::vector<unsigned char> stream;
+			std::size_t                position = 8;
+			int                        cLLiCount = 0;
+			std::uint32_t              maxCLLUnits = 0, maxFALLUnits = 0;
+			while (position < a_png.size()) {
+				if (a_png.size() - position < 12 || a_png.size() - position - 12 < ReadBigEndian(&a_png[position])) {
+					return "chunk past the end of the file";
+				}
+				const std::uint32_t  length = ReadBigEndian(&a_png[position]);
+				const unsigned char* type = &a_png[position + 4];
+				const unsigned char* data = type + 4;
+				const std::string    name(reinterpret_cast<const char*>(type), 4);
+				if (GetCRC32(type, length + 4) != ReadBigEndian(data + length)) {
+					return "bad CRC in " + name;
+				}
+				if (!chunks.empty() && chunks.back() == "IEND") {
+					return "chunk after IEND";
+				}
+				if (!chunks.empty() && chunks.back() == "IDAT" && name != "IDAT" && name != "IEND") {
+					return name + " after the image data";
+				}
+
+				if (name == "IHDR") {
+					const unsigned char ctype[5] = { 0, 0, 4, 2, 6 };
+					if (!chunks.empty() || length != 13 || ReadBigEndian(data) != static_cast<std::uint32_t>(a_case.width) ||
+						ReadBigEndian(data + 4) != static_cast<std::uint32_t>(a_case.height) || data[8] != 16 || data[9] != ctype[a_case.comp] ||
+						data[10] || data[11] || data[12]) {
+						return "bad IHDR";
+					}
+				} else if (name == "cICP") {
+					if (length != 4 || data[0] != a_case.colorPrimaries || data[1] != a_case.transferFunction || data[2] != 0 || data[3] != 1) {
+						return "bad cICP";
+					}
+				} else if (name == "cLLi") {
+					if (length != 8) {
+						return "bad cLLi";
+					}
+					++cLLiCount;
+					maxCLLUnits = ReadBigEndian(data);
+					maxFALLUnits = ReadBigEndian(data + 4);
+				} else if (name == "IDAT") {
+					stream.insert(stream.end(), data, data + length);
+				} else if (name == "IEND" && length != 0) {
+					return "bad IEND";
+				}
+				chunks.push_back(name);
+				position += 12 + length;
+			}
+			if (chunks.empty() || chunks.front() != "IHDR" || chunks.back() != "IEND" || std::ranges::count(chunks, "cICP") != 1 || stream.empty()) {
+				return "missing IHDR, cICP, IDAT or IEND";
+			}
+
+			// A light level given before the rows, or with a patch function, is always there. One given after the rows, without one,
+			// only makes it if the headers were still held back, and is right when it does.
+			const bool bExpectLightLevel = a_case.lightLevel == LightLevel::kBefore || a_case.bPatch;
+			if (cLLiCount > 1 || (bExpectLightLevel && cLLiCount == 0) || (a_case.lightLevel == LightLevel::kNone && !a_case.bPatch && cLLiCount != 0)) {
+				return "cLLi missing or repeated";
+			}
+			if (cLLiCount == 1 && (maxCLLUnits != a_case.maxCLLUnits || maxFALLUnits != a_case.maxFALLUnits)) {
+				return "wrong cLLi values";
+			}
+
+			// zlib stream of the filtered rows
+			const std::size_t rowBytes = static_cast<std::size_t>(a_case.width) * a_case.comp * 2;
+			int               inflatedSize = 0;
+			const auto        inflated = reinterpret_cast<unsigned char*>(stbi_zlib_decode_malloc(reinterpret_cast<const char*>(stream.data()), static_cast<int>(stream.size()), &inflatedSize));
+			const bool        bStreamValid = inflated && static_cast<std::size_t>(inflatedSize) == (rowBytes + 1) * a_case.height &&
+			                          stream.size() >= 6 && GetAdler32(inflated, inflatedSize) == ReadBigEndian(&stream[stream.size() - 4]);
+			stbi_image_free(inflated);
+			if (!bStreamValid) {
+				return "bad zlib stream length or Adler-32";
+			}
+
+			// Samples
+			int        width = 0, height = 0, channels = 0;
+			const auto decoded = stbi_load_16_from_memory(a_png.data(), static_cast<int>(a_png.size()), &width, &height, &channels, 0);
+			const bool bSamplesEqual = decoded && width == a_case.width && height == a_case.height && channels == a_case.comp &&
+			                           std::equal(a_pixels.begin(), a_pixels.end(), decoded);
+			stbi_image_free(decoded);
+			if (!bSamplesEqual) {
+				return decoded ? "decoded samples differ" : "not decoded";
+			}
+			return {};
+		}
+
+		void PrintFailure(int a_index, const Case& a_case, const std::string& a_reason)
+		{
+			constexpr const char* kLightLevels[] = { "none", "before the rows", "after the rows" };
+			std::printf("  case %d: %dx%d, %d channels, filter mode %d, quality %d, %d stripes, code points %d/%d, light level %s, %s%s: %s\n",
+				a_index, a_case.width, a_case.height, a_case.comp, a_case.filterMode, a_case.quality, a_case.stripes, a_case.colorPrimaries,
+				a_case.transferFunction, kLightLevels[static_cast<int>(a_case.lightLevel)], a_case.bPatch ? "patched" : "not patched",
+				a_case.bOneShot ? ", one shot" : "", a_reason.c_str());
+		}
+	}
+
+	bool HDRPNGFuzz()
+	{
+		Random random(0x452821E638D01377ull);
+
+		std::vector<Case> cases;
+		cases.push_back({ .width = 1, .height = 1, .comp = 1 });
+		cases.push_back({ .width = 1, .height = 1, .comp = 4, .lightLevel = LightLevel::kAfter, .maxCLL = 1000.f, .maxFALL = 250.f, .maxCLLUnits = 10000000, .maxFALLUnits = 2500000, .bPatch = true });
+		cases.push_back({ .width = 180000, .height = 2, .comp = 4, .filterMode = 2, .stripes = 4 });  // every row past the ~1MB stripe size
+		cases.push_back({ .width = 1, .height = 20000, .comp = 2, .filterMode = 0, .stripes = 0, .lightLevel = LightLevel::kBefore, .maxCLL = 400.f, .maxCLLUnits = 4000000 });
+		for (int i = 0; i < kRandomCases; ++i) {
+			cases.push_back(MakeCase(random, i));
+		}
+
+		int         failures = 0;
+		std::size_t totalBytes = 0;
+		const auto  startMs = NowMs();
+		for (int i = 0; i < static_cast<int>(cases.size()); ++i) {
+			const auto pixels = MakePixels(cases[i], random);
+			bool       bWritten = false;
+			const auto png = Encode(cases[i], pixels, bWritten);
+			const auto reason = bWritten ? CheckPNG(cases[i], pixels, png) : std::string("writer failed");
+			totalBytes += png.size();
+			if (!reason.empty()) {
+				if (++failures <= 10) {
+					PrintFailure(i, cases[i], reason);
+				}
+			}
+		}
+		std::printf("  %zu cases, %zu MB of PNGs in %.0f ms\n", cases.size(), totalBytes >> 20, NowMs() - startMs);
+
+		return Expect("every PNG valid and decoded to its exact samples", failures == 0);
+	}
+}
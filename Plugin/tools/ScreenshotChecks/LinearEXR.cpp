@@ -0,0 +1,240 @@
+#include "Checks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Screenshot.h"
+
+// "WriteLinearEXR()" on frames of random bits in every capture format, padded rows included, read back by a scanline EXR reader
+// written from the OpenEXR file layout: the header attributes it relies on, the line offset table, and every line found through it.
+// Half and float frames must come back with their exact bits (NaNs and infinities too), 10 bit frames as the nearest half of each
+// normalized code, ties to even.
+namespace Checks
+{
+	namespace
+	{
+		constexpr std::size_t kWidth = 333;
+		constexpr std::size_t kHeight = 77;
+		constexpr std::size_t kRowPadding = 40;
+
+		struct EXRImage
+		{
+			std::size_t                             width = 0;
+			std::size_t                             height = 0;
+			std::int32_t                            pixelType = -1;  // same for every channel
+			std::vector<std::vector<std::uint32_t>> planes;          // B, G and R samples, halfs widened to 32 bits
+		};
+
+		template <class T>
+		T Read(const std::vector<unsigned char>& a_bytes, std::size_t a_position)
+		{
+			T value{};
+			if (a_position <= a_bytes.size() && a_bytes.size() - a_position >= sizeof(T)) {
+				std::memcpy(&value, a_bytes.data() + a_position, sizeof(T));
+			}
+			return value;
+		}
+
+		std::string ReadString(const std::vector<unsigned char>& a_bytes, std::size_t& a_position)
+		{
+			std::string value;
+			while (a_position < a_bytes.size() && a_bytes[a_position]) {
+				value += static_cast<char>(a_bytes[a_position++]);
+			}
+			++a_position;
+			return value;
+		}
+
+		// Empty if the file is valid, else what's wrong with it
+		std::string ReadEXR(const std::vector<unsigned char>& a_bytes, EXRImage& a_outImage)
+		{
+			if (Read<std::uint32_t>(a_bytes, 0) != 20000630 || Read<std::uint32_t>(a_bytes, 4) != 2) {
+				return "not a single part scanline EXR";
+			}
+
+			std::map<std::string, std::vector<unsigned char>> attributes;
+			std::size_t                                       position = 8;
+			while (position < a_bytes.size() && a_bytes[position]) {
+				const auto name = ReadString(a_bytes, position);
+				ReadString(a_bytes, position);
+				const auto size = Read<std::int32_t>(a_bytes, position);
+				position += sizeof(std::int32_t);
+				if (size < 0 || a_bytes.size() - std::min(position, a_bytes.size()) < static_cast<std::size_t>(size)) {
+					return "attribute past the end of the file";
+				}
+				attributes[name].assign(a_bytes.begin() + position, a_bytes.begin() + position + size);
+				position += size;
+			}
+			++position;
+			for (const char* required : { "channels", "compression", "dataWindow", "displayWindow", "lineOrder", "pixelAspectRatio", "screenWindowCenter", "screenWindowWidth" }) {
+				if (!attributes.contains(required)) {
+					return std::string("no ") + required + " attribute";
+				}
+			}
+			if (attributes["compression"] != std::vector<unsigned char>{ 0 } || attributes["lineOrder"] != std::vector<unsigned char>{ 0 }) {
+				return "compressed or not in increasing Y";
+			}
+
+			const auto& window = attributes["dataWindow"];
+			if (window.size() != 16 || Read<std::int32_t>(window, 0) != 0 || Read<std::int32_t>(window, 4) != 0) {
+				return "bad data window";
+			}
+			a_outImage.width = static_cast<std::size_t>(Read<std::int32_t>(window, 8)) + 1;
+			a_outImage.height = static_cast<std::size_t>(Read<std::int32_t>(window, 12)) + 1;
+
+			// Channel list: name, pixel type, pLinear and 3 reserved bytes, x and y sampling
+			const auto&              channelList = attributes["channels"];
+			std::vector<std::string> channels;
+			for (std::size_t channel = 0; channel < channelList.size() && channelList[channel];) {
+				channels.push_back(ReadString(channelList, channel));
+				const auto pixelType = Read<std::int32_t>(channelList, channel);
+				if ((a_outImage.pixelType >= 0 && pixelType != a_outImage.pixelType) || Read<std::int32_t>(channelList, channel + 8) != 1 || Read<std::int32_t>(channelList, channel + 12) != 1) {
+					return "mixed pixel types or subsampled channels";
+				}
+				a_outImage.pixelType = pixelType;
+				channel += 16;
+			}
+			if (channels != std::vector<std::string>{ "B", "G", "R" } || (a_outImage.pixelType != 1 && a_outImage.pixelType != 2)) {
+				return "channels aren't B, G and R halfs or floats";
+			}
+
+			// Lines, found through the offset table
+			const std::size_t sampleSize = a_outImage.pixelType == 2 ? 4 : 2;
+			const std::size_t planeSize = a_outImage.width * sampleSize;
+			a_outImage.planes.assign(3, std::vector<std::uint32_t>(a_outImage.width * a_outImage.height));
+			for (std::size_t y = 0; y < a_outImage.height; ++y) {
+				const auto offset = Read<std::uint64_t>(a_bytes, position + y * sizeof(std::uint64_t));
+				if (offset > a_bytes.size() || a_bytes.size() - offset < 8 + 3 * planeSize) {
+					return "line past the end of the file";
+				}
+				if (Read<std::int32_t>(a_bytes, offset) != static_cast<std::int32_t>(y) || Read<std::int32_t>(a_bytes, offset + 4) != static_cast<std::int32_t>(3 * planeSize)) {
+					return "bad line y or size";
+				}
+				for (std::size_t plane = 0; plane < 3; ++plane) {
+					for (std::size_t x = 0; x < a_outImage.width; ++x) {
+						const std::size_t sample = offset + 8 + plane * planeSize + x * sampleSize;
+						a_outImage.planes[plane][y * a_outImage.width + x] = sampleSize == 4 ? Read<std::uint32_t>(a_bytes, sample) : Read<std::uint16_t>(a_bytes, sample);
+					}
+				}
+			}
+			const auto end = position + a_outImage.height * sizeof(std::uint64_t) + a_outImage.height * (8 + 3 * planeSize);
+			return end == a_bytes.size() ? std::string() : std::string("trailing or missing bytes");
+		}
+
+		double HalfToDouble(std::uint16_t a_half)
+		{
+			const int    exponent = (a_half >> 10) & 0x1F;
+			const int    mantissa = a_half & 0x3FF;
+			const double magnitude = exponent ? std::ldexp(1024 + mantissa, exponent - 25) : std::ldexp(mantissa, -24);
+			return a_half & 0x8000 ? -magnitude : magnitude;
+		}
+
+		// Nearest half of every 10 bit code divided by 1023, found among all the halfs in [0, 1]
+		std::vector<std::uint16_t> MakeCodeHalfs()
+		{
+			std::vector<double> values(0x3C01);
+			for (std::uint16_t half = 0; half <= 0x3C00; ++half) {
+				values[half] = HalfToDouble(half);
+			}
+
+			std::vector<std::uint16_t> halfs(1024);
+			for (int code = 0; code < 1024; ++code) {
+				const double  value = code / 1023.0;
+				std::uint16_t nearest = 0;
+				for (std::uint16_t half = 1; half <= 0x3C00; ++half) {
+					const double error = std::abs(values[half] - value), nearestError = std::abs(values[nearest] - value);
+					if (error < nearestError || (error == nearestError && !(half & 1))) {
+						nearest = half;
+					}
+				}
+				halfs[code] = nearest;
+			}
+			return halfs;
+		}
+
+		// Bits of channel "a_channel" (R, G, B) of a source pixel, as the EXR should hold them
+		std::uint32_t GetExpectedBits(const std::uint8_t* a_pixel, Screenshot::PixelFormat a_format, int a_channel, const std::vector<std::uint16_t>& a_codeHalfs)
+		{
+			switch (a_format) {
+			case Screenshot::PixelFormat::kR16G16B16A16_FLOAT:
+				{
+					std::uint16_t half;
+					std::memcpy(&half, a_pixel + a_channel * 2, 2);
+					return half;
+				}
+			case Screenshot::PixelFormat::kR32G32B32A32_FLOAT:
+				{
+					std::uint32_t bits;
+					std::memcpy(&bits, a_pixel + a_channel * 4, 4);
+					return bits;
+				}
+			case Screenshot::PixelFormat::kR10G10B10A2_UNORM:
+				{
+					std::uint32_t packed;
+					std::memcpy(&packed, a_pixel, 4);
+					return a_codeHalfs[(packed >> (a_channel * 10)) & 0x3FF];
+				}
+			}
+			return 0;
+		}
+	}
+
+	bool LinearEXR()
+	{
+		Random     random(0xBE5466CF34E90C6Cull);
+		const auto codeHalfs = MakeCodeHalfs();
+		bool       bPassed = true;
+
+		constexpr std::pair<const char*, Screenshot::PixelFormat> kFormats[] = {
+			{ "R16G16B16A16_FLOAT", Screenshot::PixelFormat::kR16G16B16A16_FLOAT },
+			{ "R32G32B32A32_FLOAT", Screenshot::PixelFormat::kR32G32B32A32_FLOAT },
+			{ "R10G10B10A2_UNORM", Screenshot::PixelFormat::kR10G10B10A2_UNORM }
+		};
+		for (const auto& [formatName, format] : kFormats) {
+			const std::size_t         pixelSize = format == Screenshot::PixelFormat::kR32G32B32A32_FLOAT ? 16 : format == Screenshot::PixelFormat::kR16G16B16A16_FLOAT ? 8 : 4;
+			const std::size_t         rowPitch = kWidth * pixelSize + kRowPadding;
+			std::vector<std::uint8_t> pixels(rowPitch * kHeight);
+			for (auto& byte : pixels) {
+				byte = static_cast<std::uint8_t>(random.NextBits());
+			}
+			const Screenshot::Image image{ pixels.data(), kWidth, kHeight, rowPitch, format };
+
+			MemoryFile file;
+			const bool bWritten = Screenshot::WriteLinearEXR(image, MemoryFile::Write, &file);
+
+			EXRImage    exr;
+			const auto  error = bWritten ? ReadEXR(file.bytes, exr) : std::string("writer failed");
+			std::size_t mismatches = 0;
+			if (error.empty() && exr.width == kWidth && exr.height == kHeight) {
+				for (std::size_t y = 0; y < kHeight; ++y) {
+					for (std::size_t x = 0; x < kWidth; ++x) {
+						const std::uint8_t* pixel = pixels.data() + y * rowPitch + x * pixelSize;
+						for (int channel = 0; channel < 3; ++channel) {
+							// Planes are B, G, R
+							mismatches += exr.planes[2 - channel][y * kWidth + x] != GetExpectedBits(pixel, format, channel, codeHalfs);
+						}
+					}
+				}
+			}
+
+			char name[96];
+			std::snprintf(name, sizeof(name), "%s: read back as %zux%zu %s (%s)", formatName, exr.width, exr.height, exr.pixelType == 2 ? "FLOAT" : "HALF", error.empty() ? "valid" : error.c_str());
+			bPassed &= Expect(name, error.empty() && exr.width == kWidth && exr.height == kHeight && exr.pixelType == (format == Screenshot::PixelFormat::kR32G32B32A32_FLOAT ? 2 : 1));
+			std::snprintf(name, sizeof(name), "%s: samples with different bits", formatName);
+			bPassed &= Expect(name, static_cast<double>(mismatches), 0.0);
+		}
+
+		// Nothing to write
+		{
+			MemoryFile              file;
+			const Screenshot::Image empty{ nullptr, 0, 0, 0, Screenshot::PixelFormat::kR16G16B16A16_FLOAT };
+			bPassed &= Expect("empty frame rejected", !Screenshot::WriteLinearEXR(empty, MemoryFile::Write, &file) && file.bytes.empty());
+		}
+
+		return bPassed;
+	}
+}
@@ -0,0 +1,242 @@
+#include "Checks.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "Screenshot.h"
+
+// "ReadbackPool" on a fake device: buffers reused across captures of the same key, the budget (idle buffers evicted to make room,
+// in use ones never), device failures, Trim() by idle frames and idle count, the destructor, and releases coming from worker threads.
+namespace Checks
+{
+	namespace
+	{
+		// Buffers of "width * height * format" bytes in system memory, "format" stands for the bytes per pixel.
+		// Counts what the pool asked for and flags frees of buffers it doesn't own.
+		class FakeReadbackDevice : public Screenshot::ReadbackDevice
+		{
+		public:
+			std::size_t allocations = 0;
+			std::size_t badFrees = 0;
+			bool        bFailAllocations = false;
+
+			~FakeReadbackDevice() override
+			{
+				for (const auto* memory : live) {
+					delete[] memory;
+				}
+			}
+
+			std::size_t GetAllocationSize(const Screenshot::ReadbackKey& a_key) override
+			{
+				return static_cast<std::size_t>(a_key.width) * a_key.height * a_key.format;
+			}
+
+			bool Allocate(const Screenshot::ReadbackKey& a_key, Screenshot::ReadbackAllocation& a_outAllocation) override
+			{
+				if (bFailAllocations) {
+					return false;
+				}
+				const std::size_t size = GetAllocationSize(a_key);
+				auto              memory = new std::uint8_t[size];
+				live.insert(memory);
+				++allocations;
+
+				a_outAllocation.resource = memory;
+				a_outAllocation.mapped = memory;
+				a_outAllocation.rowPitch = static_cast<std::size_t>(a_key.width) * a_key.format;
+				a_outAllocation.size = size;
+				return true;
+			}
+
+			void Free(const Screenshot::ReadbackAllocation& a_allocation) override
+			{
+				const auto memory = static_cast<std::uint8_t*>(a_allocation.resource);
+				if (live.erase(memory) == 0) {
+					++badFrees;
+					return;
+				}
+				delete[] memory;
+			}
+
+			std::size_t GetLiveCount() const { return live.size(); }
+
+		private:
+			std::set<std::uint8_t*> live;
+		};
+
+		// 1 KB each
+		constexpr Screenshot::ReadbackKey kKeyA{ 16, 16, 4 };
+		constexpr Screenshot::ReadbackKey kKeyB{ 32, 8, 4 };
+		constexpr Screenshot::ReadbackKey kKeyC{ 16, 8, 8 };
+		// 2 KB
+		constexpr Screenshot::ReadbackKey kKeyLarge{ 32, 16, 4 };
+	}
+
+	bool ReadbackPool()
+	{
+		bool bPassed = true;
+
+		// Reuse
+		{
+			FakeReadbackDevice       device;
+			Screenshot::ReadbackPool pool(device, 100, 4, 1 << 20);
+
+			const auto first = pool.Acquire(kKeyA, 1);
+			pool.Release(first);
+			const auto second = pool.Acquire(kKeyA, 2);
+			bPassed &= Expect("released buffer reused for the same key", first && second == first && device.allocations == 1);
+
+			const auto other = pool.Acquire(kKeyB, 3);
+			bPassed &= Expect("other key gets its own buffer", other && other != first && device.allocations == 2);
+			const auto concurrent = pool.Acquire(kKeyA, 3);
+			bPassed &= Expect("buffer in use is never handed out twice", concurrent && concurrent != second && device.allocations == 3);
+			bPassed &= Expect("allocated bytes of 3 buffers", pool.GetAllocatedBytes() == 3 * 1024 && pool.GetBufferCount() == 3 && pool.GetIdleBufferCount() == 0);
+
+			const auto& allocation = concurrent->allocation;
+			bPassed &= Expect("mapped buffer of the key's size", allocation.mapped && allocation.size == 1024 && allocation.rowPitch == 64 && concurrent->key == kKeyA);
+		}
+
+		// Budget of 3 KB
+		{
+			FakeReadbackDevice       device;
+			Screenshot::ReadbackPool pool(device, 100, 4, 3 * 1024);
+
+			const auto a = pool.Acquire(kKeyA, 1);
+			const auto b = pool.Acquire(kKeyB, 1);
+			const auto c = pool.Acquire(kKeyC, 1);
+			pool.Release(a);
+			pool.Release(b);
+
+			const auto large = pool.Acquire(kKeyLarge, 2);
+			bPassed &= Expect("idle buffers evicted to fit a new one", large && device.GetLiveCount() == 2 && pool.GetAllocatedBytes() == 3 * 1024);
+			bPassed &= Expect("buffer in use kept", pool.GetBufferCount() == 2 && pool.GetIdleBufferCount() == 0 && c->key == kKeyC);
+
+			const std::size_t allocations = device.allocations;
+			bPassed &= Expect("nothing past the budget when every buffer is in use", pool.Acquire(kKeyA, 3) == nullptr && device.allocations == allocations);
+			bPassed &= Expect("budget unchanged by the failed acquire", pool.GetAllocatedBytes() == 3 * 1024 && pool.GetBufferCount() == 2);
+
+			pool.Release(c);
+			device.bFailAllocations = true;
+			bPassed &= Expect("device failure returns nullptr", pool.Acquire(kKeyA, 4) == nullptr && pool.GetAllocatedBytes() + 1024 <= 3 * 1024);
+			device.bFailAllocations = false;
+			bPassed &= Expect("acquire works again after the device recovers", pool.Acquire(kKeyA, 5) != nullptr);
+			bPassed &= Expect("no buffer freed twice", device.badFrees == 0);
+		}
+
+		// Trim() by idle frames, counted from the release
+		{
+			FakeReadbackDevice       device;
+			Screenshot::ReadbackPool pool(device, 10, 4, 1 << 20);
+
+			const auto buffer = pool.Acquire(kKeyA, 1);
+			pool.Trim(100);
+			bPassed &= Expect("buffer in use never trimmed", pool.GetBufferCount() == 1);
+			pool.Release(buffer);
+			pool.Trim(110);
+			bPassed &= Expect("idle buffer kept for the idle frames", pool.GetBufferCount() == 1 && pool.GetIdleBufferCount() == 1);
+			pool.Trim(111);
+			bPassed &= Expect("idle buffer freed past the idle frames", pool.GetBufferCount() == 0 && device.GetLiveCount() == 0 && pool.GetAllocatedBytes() == 0);
+		}
+
+		// Trim() by idle count, the newest idle buffers are kept
+		{
+			FakeReadbackDevice       device;
+			Screenshot::ReadbackPool pool(device, 100, 2, 1 << 20);
+
+			Screenshot::ReadbackPool::Buffer* buffers[4];
+			for (auto& buffer : buffers) {
+				buffer = pool.Acquire(kKeyA, 1);
+			}
+			for (const auto buffer : buffers) {
+				pool.Release(buffer);
+			}
+			pool.Trim(2);
+			bPassed &= Expect("idle buffers trimmed to the max idle count", pool.GetBufferCount() == 2 && device.GetLiveCount() == 2);
+			const auto reused = pool.Acquire(kKeyA, 3);
+			bPassed &= Expect("newest idle buffers kept", reused == buffers[2] || reused == buffers[3]);
+		}
+
+		// Destructor, with a buffer still in use
+		{
+			FakeReadbackDevice device;
+			{
+				Screenshot::ReadbackPool pool(device, 100, 4, 1 << 20);
+				pool.Release(pool.Acquire(kKeyA, 1));
+				std::ignore = pool.Acquire(kKeyB, 1);
+			}
+			bPassed &= Expect("destructor frees every buffer", device.GetLiveCount() == 0 && device.allocations == 2 && device.badFrees == 0);
+		}
+
+		// Captures acquired and trimmed on the render thread, released from workers like the screenshot jobs do
+		{
+			constexpr int kFrames = 2000;
+
+			FakeReadbackDevice       device;
+			Screenshot::ReadbackPool pool(device, 30, 4, 8 * 1024);
+
+			std::mutex                                     mutex;
+			std::vector<Screenshot::ReadbackPool::Buffer*> toRelease;
+			std::atomic<bool>                              bDone = false;
+			std::vector<std::thread>                       workers;
+			for (int i = 0; i < 2; ++i) {
+				workers.emplace_back([&] {
+					while (true) {
+						Screenshot::ReadbackPool::Buffer* buffer = nullptr;
+						{
+							std::scoped_lock lock(mutex);
+							if (!toRelease.empty()) {
+								buffer = toRelease.back();
+								toRelease.pop_back();
+							} else if (bDone) {
+								return;
+							}
+						}
+						if (buffer) {
+							buffer->allocation.mapped[0] = 1;
+							pool.Release(buffer);
+						} else {
+							std::this_thread::yield();
+						}
+					}
+				});
+			}
+
+			constexpr Screenshot::ReadbackKey kKeys[] = { kKeyA, kKeyB, kKeyC, kKeyLarge };
+			std::size_t                       dropped = 0;
+			for (std::uint64_t frame = 1; frame <= kFrames; ++frame) {
+				pool.Trim(frame);
+				if (frame % 3 == 0) {
+					if (const auto buffer = pool.Acquire(kKeys[frame / 3 % 4], frame)) {
+						std::scoped_lock lock(mutex);
+						toRelease.push_back(buffer);
+					} else {
+						++dropped;
+					}
+				}
+				if (pool.GetAllocatedBytes() > 8 * 1024) {
+					break;
+				}
+				// Gives the workers time to write, most captures would be dropped otherwise when there's a single core
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+			bDone = true;
+			for (auto& worker : workers) {
+				worker.join();
+			}
+
+			bPassed &= Expect("budget held with releases from other threads", pool.GetAllocatedBytes() <= 8 * 1024);
+			bPassed &= Expect("every buffer released", pool.GetIdleBufferCount() == pool.GetBufferCount() && pool.GetBufferCount() == device.GetLiveCount());
+			std::printf("  %zu of %d captures dropped, %zu allocations\n", dropped, kFrames / 3, device.allocations);
+			pool.Trim(kFrames + 100);
+			bPassed &= Expect("everything freed once idle", device.GetLiveCount() == 0 && device.badFrees == 0);
+		}
+
+		return bPassed;
+	}
+}
@@ -0,0 +1,176 @@
+#include "Checks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Screenshot.h"
+
+// "TransformColor_HDR10()" on rows of random scRGB pixels, from below black to past 10000 nits, with a width that leaves a partial group of 4.
+// Its PQ values are compared with a double precision evaluation of the same conversion, and with the scalar std::pow() version it replaced,
+// which is also the baseline of the speedup. A few NaN pixels must encode to PQ(0) and count as black in the light level stats.
+namespace Checks
+{
+	namespace
+	{
+		constexpr std::size_t kWidth = 1923;
+		constexpr std::size_t kHeight = 512;
+
+		// PQ table error (4.6e-6, see "ColorLUT.h") with some room for the float gamut conversion
+		constexpr double kMaxError = 1e-5;
+		// The scalar version's own error is 1.4e-5
+		constexpr double kMaxScalarDifference = 2.5e-5;
+		constexpr double kMaxStatsRelativeError = 1e-5;
+
+		constexpr double kPQMaxWhitePoint = 10000.0 / 80.0;
+
+		double LinearToPQ(double a_value)
+		{
+			const double colorPow = std::pow(std::clamp(a_value / kPQMaxWhitePoint, 0.0, 1.0), 0.1593017578125);
+			return std::pow((0.8359375 + 18.8515625 * colorPow) / (1.0 + 18.6875 * colorPow), 78.84375);
+		}
+
+		void TransformReference(const DirectX::XMFLOAT4A& a_color, double (&a_outPQ)[3], double (&a_outNits)[3])
+		{
+			constexpr double kBT709ToBT2020[3][3] = {
+				{ 0.627403895934699, 0.329283038377884, 0.043313065687417 },
+				{ 0.069097289358232, 0.919540395075459, 0.011362315566309 },
+				{ 0.016391438875150, 0.088013307877226, 0.895595253247624 }
+			};
+			for (int i = 0; i < 3; ++i) {
+				double value = kBT709ToBT2020[i][0] * a_color.x + kBT709ToBT2020[i][1] * a_color.y + kBT709ToBT2020[i][2] * a_color.z;
+				if (std::isnan(value)) {
+					value = 0.0;
+				}
+				a_outPQ[i] = LinearToPQ(value);
+				a_outNits[i] = std::clamp(value * 80.0, 0.0, 10000.0);
+			}
+		}
+
+		// The per pixel version before the SIMD one, with six std::pow() calls per pixel. Like it, values past 10000 nits aren't clamped and
+		// go past PQ 1, the conversion to 16 bit UNORM that came next saturated them.
+		void TransformColorScalar(DirectX::XMVECTOR* a_outPixels, const DirectX::XMVECTOR* a_inPixels, std::size_t a_width)
+		{
+			constexpr float kFromBT709ToBT2020[3][3] = {
+				{ 0.6274039149284363f, 0.3292830288410187f, 0.04331306740641594f },
+				{ 0.06909728795289993f, 0.9195404052734375f, 0.01136231515556574f },
+				{ 0.0163914393633604f, 0.08801330626010895f, 0.8955952525138855f }
+			};
+
+			const auto linearToPQ = [](float a_value) {
+				constexpr float pqMaxWhitePoint = 10000.f / 80.f;
+				const float     colorPow = std::pow(std::max(a_value, 0.f) / pqMaxWhitePoint, 0.1593017578125f);
+				return std::pow((0.8359375f + 18.8515625f * colorPow) / (1.f + 18.6875f * colorPow), 78.84375f);
+			};
+
+			for (std::size_t i = 0; i < a_width; ++i) {
+				DirectX::XMFLOAT4A color;
+				DirectX::XMStoreFloat4A(&color, a_inPixels[i]);
+				float pq[3];
+				for (int c = 0; c < 3; ++c) {
+					pq[c] = linearToPQ(kFromBT709ToBT2020[c][0] * color.x + kFromBT709ToBT2020[c][1] * color.y + kFromBT709ToBT2020[c][2] * color.z);
+				}
+				a_outPixels[i] = DirectX::XMVectorSet(pq[0], pq[1], pq[2], 1.f);
+			}
+		}
+
+		// Mostly log uniform from 2^-20 to ~150 (past 10000 nits), with some slightly negative channels and a few exact black and PQ max pixels
+		float MakeChannel(Random& a_random)
+		{
+			const float selector = a_random.Next();
+			if (selector < 0.05f) {
+				return -0.05f * a_random.Next();
+			}
+			if (selector < 0.06f) {
+				return a_random.Next() < 0.5f ? 0.f : static_cast<float>(kPQMaxWhitePoint);
+			}
+			return std::exp2(-20.f + 27.25f * a_random.Next());
+		}
+	}
+
+	bool TransformColor()
+	{
+		Random                               random(0x243F6A8885A308D3ull);
+		std::vector<Screenshot::PixelBuffer> frame(kHeight, Screenshot::PixelBuffer(kWidth));
+		for (auto& row : frame) {
+			for (std::size_t x = 0; x < kWidth; ++x) {
+				row[x] = DirectX::XMVectorSet(MakeChannel(random), MakeChannel(random), MakeChannel(random), 1.f);
+			}
+		}
+		// One in a full group and one in the partial group at the end of a row
+		constexpr float kNaN = std::numeric_limits<float>::quiet_NaN();
+		frame[kHeight / 2][5] = DirectX::XMVectorSet(kNaN, 0.5f, 0.5f, 1.f);
+		frame[kHeight / 2][kWidth - 1] = DirectX::XMVectorSet(kNaN, kNaN, kNaN, 1.f);
+
+		double                      maxError = 0.0, maxScalarDifference = 0.0, maxAlphaError = 0.0;
+		double                      referenceMaxCLL = 0.0, referenceSumMaxComponent = 0.0;
+		Screenshot::LightLevelStats stats;
+		Screenshot::PixelBuffer     output(kWidth), scalarOutput(kWidth);
+		for (const auto& row : frame) {
+			Screenshot::TransformColor_HDR10(output.data(), row.data(), kWidth, &stats);
+			TransformColorScalar(scalarOutput.data(), row.data(), kWidth);
+			for (std::size_t x = 0; x < kWidth; ++x) {
+				DirectX::XMFLOAT4A input, value, scalarValue;
+				DirectX::XMStoreFloat4A(&input, row[x]);
+				DirectX::XMStoreFloat4A(&value, output[x]);
+				DirectX::XMStoreFloat4A(&scalarValue, scalarOutput[x]);
+
+				double pq[3], nits[3];
+				TransformReference(input, pq, nits);
+				const float channels[3] = { value.x, value.y, value.z };
+				const float scalarChannels[3] = { std::min(scalarValue.x, 1.f), std::min(scalarValue.y, 1.f), std::min(scalarValue.z, 1.f) };  // saturated
+				const bool bNaN = std::isnan(input.x) || std::isnan(input.y) || std::isnan(input.z);
+				for (int i = 0; i < 3; ++i) {
+					maxError = std::max(maxError, std::abs(channels[i] - pq[i]));
+					if (bNaN) {
+						continue;  // the scalar version doesn't handle them
+					}
+					maxScalarDifference = std::max(maxScalarDifference, static_cast<double>(std::abs(channels[i] - scalarChannels[i])));
+				}
+				maxAlphaError = std::max(maxAlphaError, std::abs(value.w - 1.0));
+
+				const double maxComponent = std::max({ nits[0], nits[1], nits[2] });
+				referenceMaxCLL = std::max(referenceMaxCLL, maxComponent);
+				referenceSumMaxComponent += maxComponent;
+			}
+		}
+		const double maxCLLError = std::abs(stats.maxCLL - referenceMaxCLL) / referenceMaxCLL;
+		const double maxFALLError = std::abs(stats.GetMaxFALL() - referenceSumMaxComponent / (kWidth * kHeight)) / (referenceSumMaxComponent / (kWidth * kHeight));
+
+		bool bPassed = true;
+		bPassed &= Expect("max PQ error against double precision", maxError, kMaxError);
+		bPassed &= Expect("max PQ difference to the scalar std::pow() version", maxScalarDifference, kMaxScalarDifference);
+		bPassed &= Expect("max alpha error", maxAlphaError, 0.0);
+		bPassed &= Expect("MaxCLL relative error", maxCLLError, kMaxStatsRelativeError);
+		bPassed &= Expect("MaxFALL relative error", maxFALLError, kMaxStatsRelativeError);
+		bPassed &= Expect("every pixel counted in the stats", stats.pixelCount == kWidth * kHeight);
+
+		// A row of NaNs only, it must not reach MaxCLL, MaxFALL or the top histogram bin
+		Screenshot::PixelBuffer nanRow(6), nanOutput(6);
+		for (std::size_t x = 0; x < nanRow.size(); ++x) {
+			nanRow[x] = DirectX::XMVectorSet(kNaN, x & 1 ? kNaN : 1.f, 1.f, 1.f);
+		}
+		Screenshot::LightLevelStats nanStats;
+		Screenshot::TransformColor_HDR10(nanOutput.data(), nanRow.data(), nanRow.size(), &nanStats);
+		bPassed &= Expect("NaN pixels counted as black", nanStats.maxCLL == 0.f && nanStats.GetMaxFALL() == 0.f && nanStats.histogram[0] == nanRow.size());
+
+		// Best of a few runs over the frame, without stats like the scalar version
+		double simdMs = 1e30, scalarMs = 1e30;
+		for (int iteration = 0; iteration < 3; ++iteration) {
+			double start = NowMs();
+			for (const auto& row : frame) {
+				Screenshot::TransformColor_HDR10(output.data(), row.data(), kWidth, nullptr);
+			}
+			simdMs = std::min(simdMs, NowMs() - start);
+
+			start = NowMs();
+			for (const auto& row : frame) {
+				TransformColorScalar(scalarOutput.data(), row.data(), kWidth);
+			}
+			scalarMs = std::min(scalarMs, NowMs() - start);
+		}
+		std::printf("  %zux%zu frame: SIMD %.2f ms, scalar std::pow() %.2f ms, speedup x%.1f\n", kWidth, kHeight, simdMs, scalarMs, scalarMs / simdMs);
+		return bPassed;
+	}
+}
@@ -0,0 +1,111 @@
+#include "Checks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "Screenshot.h"
+
+// "WorkerPool" with mock jobs: the queue bound and the stats while a job blocks the only worker, draining on "Shutdown()",
+// rejection after it, and a burst of short jobs on several workers, which must never run more jobs at once than there are workers.
+namespace Checks
+{
+	bool WorkerPool()
+	{
+		bool bPassed = true;
+
+		// One worker held by the first job, so the queue fills up behind it
+		{
+			Screenshot::WorkerPool pool(1, 2);
+			std::promise<void>     started, release;
+			auto                   releaseFuture = release.get_future().share();
+			std::atomic<int>       completed = 0;
+#ifndef _WIN32
+			std::atomic<int> workerNice = 0;
+#endif
+
+			bPassed &= Expect("blocking job accepted", pool.TryEnqueue([&] {
+#ifndef _WIN32
+				workerNice = getpriority(PRIO_PROCESS, 0);
+#endif
+				started.set_value();
+				releaseFuture.wait();
+				++completed;
+			}));
+			started.get_future().wait();
+			bPassed &= Expect("jobs accepted up to the capacity", pool.TryEnqueue([&] { ++completed; }) && pool.TryEnqueue([&] { ++completed; }));
+			bPassed &= Expect("job rejected past the capacity", !pool.TryEnqueue([&] { ++completed; }));
+
+			auto stats = pool.GetStats();
+			bPassed &= Expect("stats: 1 running, 2 queued, 1 rejected", stats.runningJobs == 1 && stats.queueDepth == 2 && stats.peakQueueDepth == 2 && stats.rejectedJobs == 1);
+#ifndef _WIN32
+			bPassed &= Expect("worker runs below normal priority", workerNice > 0);
+#endif
+
+			// Shutdown() waits for the queued jobs, so it's released from another thread
+			std::thread releaser([&] {
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				release.set_value();
+			});
+			pool.Shutdown();
+			releaser.join();
+
+			stats = pool.GetStats();
+			bPassed &= Expect("queued jobs drained by Shutdown()", completed == 3 && stats.completedJobs == 3 && stats.queueDepth == 0 && stats.runningJobs == 0);
+			bPassed &= Expect("latency of the blocked job measured", stats.maxLatencyMs >= 20.0 && stats.averageLatencyMs <= stats.maxLatencyMs);
+			bPassed &= Expect("job rejected after Shutdown()", !pool.TryEnqueue([&] { ++completed; }) && pool.GetStats().rejectedJobs == 2);
+			pool.Shutdown();
+			bPassed &= Expect("second Shutdown() is a no-op", completed == 3);
+		}
+
+		// Bursts of short jobs, retried like the render thread does when the queue is full
+		{
+			constexpr std::size_t kWorkers = 3;
+			constexpr int         kJobs = 2000;
+
+			std::atomic<int>       completed = 0, running = 0, maxRunning = 0;
+			Screenshot::WorkerPool pool(kWorkers, 8);
+			for (int i = 0; i < kJobs; ++i) {
+				const auto job = [&] {
+					const int nowRunning = ++running;
+					int       previousMax = maxRunning;
+					while (nowRunning > previousMax && !maxRunning.compare_exchange_weak(previousMax, nowRunning)) {}
+					std::this_thread::yield();
+					--running;
+					++completed;
+				};
+				while (!pool.TryEnqueue(job)) {
+					std::this_thread::yield();
+				}
+			}
+			pool.Shutdown();
+
+			const auto stats = pool.GetStats();
+			bPassed &= Expect("every job of the burst ran once", completed == kJobs && stats.completedJobs == kJobs);
+			bPassed &= Expect("never more jobs at once than workers", maxRunning <= static_cast<int>(kWorkers));
+			bPassed &= Expect("queue never past its capacity", stats.peakQueueDepth <= 8);
+		}
+
+		// Destroyed without Shutdown(), the destructor drains the queue too
+		{
+			std::atomic<int> completed = 0;
+			{
+				Screenshot::WorkerPool pool(2, 4);
+				for (int i = 0; i < 4; ++i) {
+					pool.TryEnqueue([&] {
+						std::this_thread::sleep_for(std::chrono::milliseconds(5));
+						++completed;
+					});
+				}
+			}
+			bPassed &= Expect("destructor drains the queue", completed == 4);
+		}
+
+		return bPassed;
+	}
+}
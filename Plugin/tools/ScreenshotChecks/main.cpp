@@ -0,0 +1,69 @@
+// Checks the screenshot pipeline of "Screenshot.h" on synthetic frames and mock jobs.
+// Usage: ScreenshotChecks [<check>...]
+// Runs the named checks (all of them by default) and exits with 1 if any fails:
+// - transform_color: "TransformColor_HDR10()" against double precision and the scalar std::pow() version it replaced, and its speedup over it.
+// - hdr_png: "WriteHDR10PNG()" decoded again and compared with double precision, in every compression mode, on one thread and several.
+// - worker_pool: "WorkerPool" with mock jobs, its queue bound, stats, priority and draining on shutdown.
+// - readback_pool: "ReadbackPool" on a fake device, buffer reuse, the budget, Trim() and releases from other threads.
+// - completion_tracker: "CompletionTracker" on a fake GPU queue, callbacks only after their copies and in fence order.
+// - downsampler: "Downsampler" against a direct 2D resize in double precision, and on empty sources.
+// - linear_exr: "WriteLinearEXR()" on random bits in every capture format, read back and compared bit for bit.
+// - hdr_png_fuzz: the chunked HDR PNG writer on random sizes, channels, settings and rows, decoded again by stb_image bit for bit.
+
+#include <cstdio>
+#include <string_view>
+#include <utility>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <stb_image_write_hdr_png.h>
+
+#include "Checks.h"
+
+int main(int argc, char** argv)
+{
+	constexpr std::pair<std::string_view, bool (*)()> checks[] = {
+		{ "transform_color", Checks::TransformColor },
+		{ "hdr_png", Checks::HDRPNG },
+		{ "worker_pool", Checks::WorkerPool },
+		{ "readback_pool", Checks::ReadbackPool },
+		{ "completion_tracker", Checks::CompletionTracker },
+		{ "downsampler", Checks::Downsampler },
+		{ "linear_exr", Checks::LinearEXR },
+		{ "hdr_png_fuzz", Checks::HDRPNGFuzz }
+	};
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		bool                   bKnown = false;
+		for (const auto& check : checks) {
+			bKnown |= check.first == argument;
+		}
+		if (!bKnown) {
+			std::fprintf(stderr, "Usage: %s [<check>...]\nChecks:", argv[0]);
+			for (const auto& check : checks) {
+				std::fprintf(stderr, " %s", check.first.data());
+			}
+			std::fprintf(stderr, "\n");
+			return 1;
+		}
+	}
+
+	bool bFailed = false;
+	for (const auto& [name, run] : checks) {
+		bool bSelected = argc == 1;
+		for (int i = 1; i < argc; ++i) {
+			bSelected |= name == argv[i];
+		}
+		if (bSelected) {
+			std::printf("%s\n", name.data());
+			const bool bPassed = run();
+			std::printf("%s %s\n\n", name.data(), bPassed ? "passed" : "FAILED");
+			std::fflush(stdout);
+			bFailed |= !bPassed;
+		}
+	}
+	return bFailed ? 1 : 0;
+}
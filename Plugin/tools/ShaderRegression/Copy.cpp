@@ -0,0 +1,98 @@
+#include "Copy.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <DirectXPackedVector.h>
+
+namespace Copy
+{
+	namespace
+	{
+		// Lets film grain go a bit beyond the user peak brightness, but not much further ("PEAK_BRIGHTNESS_THRESHOLD")
+		constexpr float kPeakBrightnessThreshold = 1.05f;
+		constexpr float kPeakBrightnessThresholdScRGB = kPeakBrightnessThreshold / Color::kWhiteNits_sRGB;
+
+		float Saturate(float a_value)
+		{
+			// HLSL's saturate() returns 0 for NaN
+			return a_value > 0.f ? std::min(a_value, 1.f) : 0.f;
+		}
+
+		Float3 LimitPeakBrightness(const Float3& a_color, float a_peakBrightness)
+		{
+			return a_color * Saturate((a_peakBrightness * kPeakBrightnessThresholdScRGB) / Color::Luminance(a_color));
+		}
+	}
+
+	bool SetDefine(Permutation& a_permutation, std::string_view a_define)
+	{
+		if (a_define == "OUTPUT_TO_R10G10B10A2") {
+			a_permutation.bOutputToR10G10B10A2 = true;
+		} else if (a_define == "OUTPUT_TO_R16G16B16A16_SFLOAT") {
+			a_permutation.bOutputToR16G16B16A16 = true;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	// "CLAMP_INPUT_OUTPUT_TYPE" 1, "SDR_USE_GAMMA_2_2" and "SDR_LINEAR_INTERMEDIARY" on
+	Float3 Shade(const Float3& a_color, const HDRComposite::ShaderConstants& a_constants, const Permutation& a_permutation)
+	{
+		if (!a_constants.bIsAtEndOfFrame) {
+			return a_color;
+		}
+
+		Float3 color = a_color;
+		if (a_permutation.bOutputToR16G16B16A16) {
+			if (a_constants.DisplayMode == 2) {  // HDR scRGB
+				color = LimitPeakBrightness(color, a_constants.PeakBrightness);
+				// Gamut mapped to BT.2020, as Windows would otherwise likely clip it by channel
+				color = Color::BT2020_To_BT709(Color::SimpleGamutClip(Color::BT709_To_BT2020(color), true));
+			} else if (a_constants.DisplayMode == -1) {  // SDR on scRGB HDR
+				color = Color::SimpleGamutClip(color, false);
+				color = Apply(color, Saturate);
+				color *= a_constants.GamePaperWhite / Color::kWhiteNits_sRGB;
+			}
+		}
+		if (a_permutation.bOutputToR10G10B10A2) {
+			if (a_constants.DisplayMode == 1) {  // HDR10 PQ BT.2020
+				color = LimitPeakBrightness(color, a_constants.PeakBrightness);
+				color = Color::BT709_To_BT2020(color);
+				color = Color::SimpleGamutClip(color, true);
+				color = Apply(color, [](float a_channel) { return Color::LinearToPQ(a_channel, Color::kPQMaxWhitePoint); });
+			} else if (a_constants.DisplayMode == 0) {  // SDR, linear to gamma 2.2
+				color = Color::SimpleGamutClip(color, false);
+				color = Apply(color, [](float a_channel) { return Color::LinearToGamma(std::max(a_channel, 0.f)); });
+			}
+		}
+		return color;
+	}
+
+	Float3 Store(const Float3& a_color, const Permutation& a_permutation)
+	{
+		if (a_permutation.bOutputToR10G10B10A2) {
+			return Apply(a_color, [](float a_channel) { return std::round(Saturate(a_channel) * 1023.f) / 1023.f; });
+		}
+		if (a_permutation.bOutputToR16G16B16A16) {
+			return Apply(a_color, [](float a_channel) {
+				return DirectX::PackedVector::XMConvertHalfToFloat(DirectX::PackedVector::XMConvertFloatToHalf(a_channel));
+			});
+		}
+		return a_color;
+	}
+
+	Float3 Decode(const Float3& a_color, const HDRComposite::ShaderConstants& a_constants, const Permutation& a_permutation)
+	{
+		if (a_constants.bIsAtEndOfFrame && a_permutation.bOutputToR10G10B10A2) {
+			if (a_constants.DisplayMode == 1) {
+				return Color::BT2020_To_BT709(Apply(a_color, [](float a_channel) { return Color::PQToLinear(a_channel, Color::kPQMaxWhitePoint); }));
+			}
+			if (a_constants.DisplayMode == 0) {
+				return Apply(a_color, [](float a_channel) { return Color::GammaToLinear(a_channel); });
+			}
+		}
+		return a_color;
+	}
+}
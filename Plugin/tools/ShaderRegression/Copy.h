@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string_view>
+
+#include "HDRComposite.h"
+
+// CPU reference of "shaders/Copy/Copy_ps.hlsl", the final copy to the swapchain that encodes the output for the display mode.
+// The copy covers the whole target at the source resolution, so both samplers read the source texels as they are.
+namespace Copy
+{
+	using Color::Float3;
+
+	struct Permutation
+	{
+		bool bOutputToR10G10B10A2 = false;
+		bool bOutputToR16G16B16A16 = false;
+	};
+
+	// Turns on the permutation flag of a define ("OUTPUT_TO_R10G10B10A2", ...), returns false for defines the shader doesn't have
+	bool SetDefine(Permutation& a_permutation, std::string_view a_define);
+
+	// Runs the pixel shader on one color (alpha isn't tracked)
+	Float3 Shade(const Float3& a_color, const HDRComposite::ShaderConstants& a_constants, const Permutation& a_permutation);
+
+	// What storing to the permutation's render target does to the shader output: unorm clipping and quantization, or half float rounding
+	Float3 Store(const Float3& a_color, const Permutation& a_permutation);
+
+	// Linear BT.709 of what the display shows for a stored color, 1 being 80 nits (like scRGB)
+	Float3 Decode(const Float3& a_color, const HDRComposite::ShaderConstants& a_constants, const Permutation& a_permutation);
+}
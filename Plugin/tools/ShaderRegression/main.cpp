@@ -0,0 +1,563 @@
+// Golden image regression test of the CPU shader references, over every technique permutation listed in "manifest.json".
+// Usage: ShaderRegression [--manifest <manifest.json>] [--filter <text>] [--threads <count>] [--update]
+// Every technique runs every configuration (a set of constants) of its shader on a synthetic corpus of HDR frames,
+// and its output is compared to "goldens/<shader>_<id>_<configuration>.lumaraw" next to the manifest.
+// ColorGradingMerge instead blends the synthetic game LUTs of the corpus, its output is the mixed LUT as a 256x16 strip (like the game's LUTs).
+// Techniques of "compile_all_shaders.ps1" that have no CPU reference are listed under "uncovered" with the reason, the test ignores them.
+// Outputs are compared as what the display would show: PSNR of ITP (ICtCp with half of Ct) and the 99.9th percentile of BT.2124 Delta E ITP,
+// both need to be within thresholds.
+// --filter only runs the cases whose name contains the text, --update (re)writes their goldens instead of comparing.
+// Cases run in parallel, one per thread, the exit code is 1 if any of them failed.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <stb_image_write_hdr_png.h>
+
+#include <nlohmann/json.hpp>
+
+#include "ColorGradingMerge.h"
+#include "Copy.h"
+#include "HDRComposite.h"
+#include "Metrics.h"
+#include "Screenshot.h"
+
+namespace
+{
+	using Color::Float3;
+
+	// 50 dB is a RMS Delta E ITP of ~4: it catches the rare large errors the percentile ignores, while still letting a pixel or two
+	// land on the other side of one of the shader's branches (e.g. with FMA contraction, which the plugin builds with)
+	struct Thresholds
+	{
+		double minPSNR = 50.0;
+		double maxDeltaEITP = 1.0;
+	};
+
+	struct Case
+	{
+		std::string                                 name;  // "<shader>_<id>_<configuration>"
+		std::string                                 shader;
+		std::vector<std::string>                    defines;
+		std::vector<std::pair<std::string, double>> constants;
+		Thresholds                                  thresholds;
+	};
+
+	struct Result
+	{
+		bool        bPassed = false;
+		std::string message;
+	};
+
+	// Inputs shared by all cases
+	struct Corpus
+	{
+		HDRComposite::Texture2D                 scene;
+		HDRComposite::Texture2D                 bloom;
+		HDRComposite::Texture3D                 lut;
+		std::vector<ColorGradingMerge::GameLUT> gameLUTs;  // "LUT1" to "LUT4" of ColorGradingMerge
+	};
+
+	// xorshift64, so frames are identical on every platform and standard library
+	class Random
+	{
+	public:
+		explicit Random(std::uint64_t a_seed) :
+			state(a_seed ? a_seed : 1)
+		{}
+
+		// In [0, 1)
+		float Next()
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return static_cast<float>(state >> 40) * (1.f / 16777216.f);
+		}
+
+	private:
+		std::uint64_t state;
+	};
+
+	// Fully saturated BT.709 hue, "a_hue" in [0, 1)
+	Float3 Hue(float a_hue)
+	{
+		const auto channel = [&](float a_offset) {
+			const float distance = std::abs(std::fmod(a_hue * 6.f + a_offset, 6.f) - 3.f);
+			return std::clamp(distance - 1.f, 0.f, 1.f);
+		};
+		return { channel(0.f), channel(4.f), channel(2.f) };
+	}
+
+	// Fills a "a_width" x "a_height" band of the scene, starting at row "a_top"
+	bool GeneratePattern(HDRComposite::Texture2D& a_scene, std::size_t a_top, std::size_t a_height, const nlohmann::json& a_frame)
+	{
+		const std::string pattern = a_frame.value("pattern", "");
+		const std::size_t width = a_scene.width;
+		Random            random(a_frame.value("seed", 1ull));
+
+		for (std::size_t y = 0; y < a_height; ++y) {
+			for (std::size_t x = 0; x < width; ++x) {
+				const float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+				const float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(a_height);
+				Float3      color;
+				if (pattern == "ramps") {
+					// Gray, red, green and blue ramps from 1/1024 to 128 (~10 to 10000 nits for the game's usual exposures)
+					const std::size_t ramp = y * 4 / a_height;
+					const float       value = std::exp2(-10.f + 17.f * u);
+					color = ramp == 0 ? Float3{ value, value, value } : Float3{ ramp == 1 ? value : 0.f, ramp == 2 ? value : 0.f, ramp == 3 ? value : 0.f };
+				} else if (pattern == "hues") {
+					color = Hue(u) * std::exp2(-6.f + 12.f * v);
+				} else if (pattern == "wideGamut") {
+					// BT.2020 hues, which are partly negative in BT.709 (scRGB), plus a row of all negative colors
+					color = y + 1 == a_height ? Hue(u) * -0.1f : Color::BT2020_To_BT709(Hue(u)) * std::exp2(-4.f + 10.f * v);
+				} else if (pattern == "noise") {
+					color = { std::exp2(-8.f + 14.f * random.Next()), std::exp2(-8.f + 14.f * random.Next()), std::exp2(-8.f + 14.f * random.Next()) };
+				} else {
+					return false;
+				}
+				a_scene.texels[(a_top + y) * width + x] = color;
+			}
+		}
+		return true;
+	}
+
+	// A game LUT (gamma space) from a function of the neutral gamma space coordinates
+	template <class F>
+	ColorGradingMerge::GameLUT MakeGameLUT(F a_function)
+	{
+		using ColorGradingMerge::kLUTSize;
+
+		ColorGradingMerge::GameLUT lut;
+		for (std::size_t b = 0; b < kLUTSize; ++b) {
+			for (std::size_t g = 0; g < kLUTSize; ++g) {
+				for (std::size_t r = 0; r < kLUTSize; ++r) {
+					const Float3 neutral = Float3{ static_cast<float>(r), static_cast<float>(g), static_cast<float>(b) } / static_cast<float>(kLUTSize - 1);
+					lut.texels[g * kLUTSize * kLUTSize + b * kLUTSize + r] = a_function(neutral);
+				}
+			}
+		}
+		return lut;
+	}
+
+	// The frames of the corpus stacked top to bottom, the bloom (a box filtered quarter resolution copy), a LUT that does a warm, saturated grade,
+	// and the game LUTs ColorGradingMerge blends: raised blacks and lowered whites, a teal and orange grade with clipped colors, a cold
+	// desaturated one and an inverted one (white darker than black, which the LUT correction leaves as it is)
+	bool GenerateCorpus(const nlohmann::json& a_manifest, Corpus& a_outCorpus)
+	{
+		const std::size_t frameWidth = a_manifest.value("frameWidth", 32ull);
+		const std::size_t frameHeight = a_manifest.value("frameHeight", 32ull);
+		const auto&       frames = a_manifest.at("corpus");
+
+		a_outCorpus.scene = HDRComposite::Texture2D(frameWidth, frameHeight * frames.size());
+		for (std::size_t i = 0; i < frames.size(); ++i) {
+			if (!GeneratePattern(a_outCorpus.scene, i * frameHeight, frameHeight, frames[i])) {
+				std::fprintf(stderr, "unknown pattern \"%s\"\n", frames[i].value("pattern", "").c_str());
+				return false;
+			}
+		}
+
+		constexpr std::size_t kBloomScale = 4;
+		const auto&           scene = a_outCorpus.scene;
+		a_outCorpus.bloom = HDRComposite::Texture2D(std::max<std::size_t>(scene.width / kBloomScale, 1), std::max<std::size_t>(scene.height / kBloomScale, 1));
+		for (std::size_t y = 0; y < a_outCorpus.bloom.height; ++y) {
+			for (std::size_t x = 0; x < a_outCorpus.bloom.width; ++x) {
+				Float3 sum = { 0.f, 0.f, 0.f };
+				for (std::size_t i = 0; i < kBloomScale * kBloomScale; ++i) {
+					sum += scene.Load(static_cast<std::ptrdiff_t>(x * kBloomScale + i % kBloomScale), static_cast<std::ptrdiff_t>(y * kBloomScale + i / kBloomScale));
+				}
+				a_outCorpus.bloom.texels[y * a_outCorpus.bloom.width + x] = sum / static_cast<float>(kBloomScale * kBloomScale);
+			}
+		}
+
+		a_outCorpus.lut = HDRComposite::MakeNeutralLUT();
+		for (auto& texel : a_outCorpus.lut.texels) {
+			texel = Color::Saturation(texel * Float3{ 1.06f, 1.f, 0.88f }, 1.2f);
+			texel = { std::max(texel.x, 0.f), std::max(texel.y, 0.f), std::max(texel.z, 0.f) };
+		}
+
+		const auto clamp = [](const Float3& a_color) {
+			return Float3{ std::clamp(a_color.x, 0.f, 1.f), std::clamp(a_color.y, 0.f, 1.f), std::clamp(a_color.z, 0.f, 1.f) };
+		};
+		a_outCorpus.gameLUTs = {
+			MakeGameLUT([](const Float3& a_neutral) { return Float3{ 0.12f, 0.1f, 0.08f } + a_neutral * Float3{ 0.8f, 0.8f, 0.78f }; }),
+			MakeGameLUT([&](const Float3& a_neutral) { return clamp(Color::Saturation(a_neutral * Float3{ 1.1f, 0.98f, 0.85f } + Float3{ 0.02f, 0.04f, 0.06f }, 1.4f)); }),
+			MakeGameLUT([&](const Float3& a_neutral) { return clamp(Color::Saturation(a_neutral * Float3{ 0.9f, 0.97f, 1.05f }, 0.6f)); }),
+			MakeGameLUT([](const Float3& a_neutral) { return 1.f - a_neutral; }),
+		};
+		return true;
+	}
+
+	bool LoadGolden(const std::filesystem::path& a_path, std::vector<Float3>& a_outPixels, std::size_t& a_outWidth, std::size_t& a_outHeight)
+	{
+		std::ifstream input(a_path, std::ios::binary);
+		if (!input) {
+			return false;
+		}
+		const std::vector<std::uint8_t> data{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+
+		Screenshot::RawHeader header;
+		Screenshot::Image     image;
+		if (!Screenshot::ParseRaw(data.data(), data.size(), header, image)) {
+			return false;
+		}
+
+		a_outWidth = image.width;
+		a_outHeight = image.height;
+		a_outPixels.resize(image.width * image.height);
+		Screenshot::PixelBuffer row(image.width);
+		for (std::size_t y = 0; y < image.height; ++y) {
+			Screenshot::DecodeRow(row.data(), image.pixels + y * image.rowPitch, image.width, image.format);
+			for (std::size_t x = 0; x < image.width; ++x) {
+				DirectX::XMFLOAT4A pixel;
+				DirectX::XMStoreFloat4A(&pixel, row[x]);
+				a_outPixels[y * image.width + x] = { pixel.x, pixel.y, pixel.z };
+			}
+		}
+		return true;
+	}
+
+	// Goldens are stored as 32 bit floats, so a run on the same platform matches them exactly
+	bool WriteGolden(const std::filesystem::path& a_path, const std::vector<Float3>& a_pixels, std::size_t a_width, std::size_t a_height)
+	{
+		std::vector<float> rgba(a_pixels.size() * 4);
+		for (std::size_t i = 0; i < a_pixels.size(); ++i) {
+			rgba[i * 4 + 0] = a_pixels[i].x;
+			rgba[i * 4 + 1] = a_pixels[i].y;
+			rgba[i * 4 + 2] = a_pixels[i].z;
+			rgba[i * 4 + 3] = 1.f;
+		}
+
+		Screenshot::Image image;
+		image.pixels = reinterpret_cast<const std::uint8_t*>(rgba.data());
+		image.width = a_width;
+		image.height = a_height;
+		image.rowPitch = a_width * 4 * sizeof(float);
+		image.format = Screenshot::PixelFormat::kR32G32B32A32_FLOAT;
+
+		FILE* file = std::fopen(a_path.string().c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		const auto writeCallback = [](void* context, void* data, int size) {
+			std::fwrite(data, 1, size, static_cast<FILE*>(context));
+		};
+		const bool bWritten = Screenshot::WriteRaw(image, {}, writeCallback, file);
+		return std::fclose(file) == 0 && bWritten;
+	}
+
+	// "PushConstantWrapper_ColorGradingMerge" by name, returns false for unknown names
+	bool SetMergePushConstant(ColorGradingMerge::PushConstants& a_pushConstants, std::string_view a_name, double a_value)
+	{
+		constexpr std::string_view kLUTPercentages[ColorGradingMerge::kMaxLUTs] = { "LUT1Percentage", "LUT2Percentage", "LUT3Percentage", "LUT4Percentage" };
+		for (std::size_t i = 0; i < ColorGradingMerge::kMaxLUTs; ++i) {
+			if (a_name == kLUTPercentages[i]) {
+				a_pushConstants.LUTPercentages[i] = static_cast<float>(a_value);
+				return true;
+			}
+		}
+		if (a_name == "neutralLUTPercentage") {
+			a_pushConstants.neutralLUTPercentage = static_cast<float>(a_value);
+			return true;
+		}
+		return false;
+	}
+
+	// Runs the shader of the case over the corpus, into a "a_outWidth" x "a_outHeight" image.
+	// "a_outDisplayPixels" is the output decoded to what the display would show (linear BT.709, 1 is 80 nits).
+	bool Render(const Case& a_case, const Corpus& a_corpus, std::vector<Float3>& a_outPixels, std::vector<Float3>& a_outDisplayPixels, std::size_t& a_outWidth, std::size_t& a_outHeight,
+		std::string& a_outError)
+	{
+		HDRComposite::Constants          constants;
+		ColorGradingMerge::PushConstants mergePushConstants;
+		for (const auto& [name, value] : a_case.constants) {
+			const bool bMergePushConstant = a_case.shader == "ColorGradingMerge" && SetMergePushConstant(mergePushConstants, name, value);
+			if (!bMergePushConstant && !HDRComposite::SetConstant(constants, name, value)) {
+				a_outError = "unknown constant \"" + name + "\"";
+				return false;
+			}
+		}
+
+		const auto& scene = a_corpus.scene;
+		a_outWidth = scene.width;
+		a_outHeight = scene.height;
+		a_outPixels.resize(scene.texels.size());
+		if (a_case.shader == "HDRComposite") {
+			HDRComposite::Permutation permutation;
+			for (const auto& define : a_case.defines) {
+				if (!HDRComposite::SetDefine(permutation, define)) {
+					a_outError = "unknown define \"" + define + "\"";
+					return false;
+				}
+			}
+
+			HDRComposite::Inputs inputs;
+			inputs.scene = &scene;
+			inputs.bloom = &a_corpus.bloom;
+			inputs.lut = &a_corpus.lut;
+			HDRComposite::Renderer(constants, permutation).Render(inputs, a_outPixels.data(), 1);
+			a_outDisplayPixels = a_outPixels;
+		} else if (a_case.shader == "Copy") {
+			Copy::Permutation permutation;
+			for (const auto& define : a_case.defines) {
+				if (!Copy::SetDefine(permutation, define)) {
+					a_outError = "unknown define \"" + define + "\"";
+					return false;
+				}
+			}
+
+			a_outDisplayPixels.resize(scene.texels.size());
+			for (std::size_t i = 0; i < scene.texels.size(); ++i) {
+				a_outPixels[i] = Copy::Store(Copy::Shade(scene.texels[i], constants.plugin, permutation), permutation);
+				a_outDisplayPixels[i] = Copy::Decode(a_outPixels[i], constants.plugin, permutation);
+			}
+		} else if (a_case.shader == "ColorGradingMerge") {
+			using ColorGradingMerge::kLUTSize;
+
+			// The shader has no permutation defines
+			if (!a_case.defines.empty()) {
+				a_outError = "unknown define \"" + a_case.defines.front() + "\"";
+				return false;
+			}
+
+			ColorGradingMerge::MergeInputs inputs;
+			for (std::size_t i = 0; i < ColorGradingMerge::kMaxLUTs; ++i) {
+				inputs.luts[i] = &a_corpus.gameLUTs[i];
+			}
+			inputs.pushConstants = mergePushConstants;
+			inputs.pluginConstants = { constants.plugin.Saturation, constants.plugin.LUTCorrectionStrength, constants.plugin.GammaCorrectionStrength };
+			const auto lut = std::make_unique<ColorGradingMerge::MixedLUT>();
+			ColorGradingMerge::Merge(inputs, *lut, 1);
+
+			// The blue slices side by side, like the game's LUTs (the mixed LUT is linear SDR, 1 is 80 nits)
+			a_outWidth = kLUTSize * kLUTSize;
+			a_outHeight = kLUTSize;
+			a_outPixels.resize(ColorGradingMerge::kLUTTexels);
+			for (std::size_t b = 0; b < kLUTSize; ++b) {
+				for (std::size_t g = 0; g < kLUTSize; ++g) {
+					for (std::size_t r = 0; r < kLUTSize; ++r) {
+						a_outPixels[g * a_outWidth + b * kLUTSize + r] = lut->At(r, g, b);
+					}
+				}
+			}
+			a_outDisplayPixels = a_outPixels;
+		} else {
+			a_outError = "unknown shader \"" + a_case.shader + "\"";
+			return false;
+		}
+		return true;
+	}
+
+	// Converts stored golden pixels the same way "Render()" decodes the case output
+	void DecodeGolden(const Case& a_case, std::vector<Float3>& a_pixels)
+	{
+		if (a_case.shader != "Copy") {
+			return;
+		}
+		HDRComposite::Constants constants;
+		for (const auto& [name, value] : a_case.constants) {
+			HDRComposite::SetConstant(constants, name, value);
+		}
+		Copy::Permutation permutation;
+		for (const auto& define : a_case.defines) {
+			Copy::SetDefine(permutation, define);
+		}
+		for (auto& pixel : a_pixels) {
+			pixel = Copy::Decode(pixel, constants.plugin, permutation);
+		}
+	}
+
+	bool IsFinite(const Float3& a_color)
+	{
+		return std::isfinite(a_color.x) && std::isfinite(a_color.y) && std::isfinite(a_color.z);
+	}
+
+	Result Compare(const Case& a_case, const std::vector<Float3>& a_pixels, const std::vector<Float3>& a_goldenPixels)
+	{
+		double              squaredErrorSum = 0.0;
+		std::vector<double> deltaEITPs;
+		std::size_t         invalidPixels = 0;
+		for (std::size_t i = 0; i < a_pixels.size(); ++i) {
+			if (!IsFinite(a_pixels[i]) || !IsFinite(a_goldenPixels[i])) {
+				invalidPixels += IsFinite(a_pixels[i]) != IsFinite(a_goldenPixels[i]);
+				continue;
+			}
+
+			// PSNR uses the same ITP error as Delta E ITP, per channel PQ would blow up on tiny differences of the near zero channels of saturated colors
+			const double squaredError = Metrics::SquaredITPError(a_pixels[i], a_goldenPixels[i]);
+			squaredErrorSum += squaredError;
+			deltaEITPs.push_back(720.0 * std::sqrt(squaredError));
+		}
+
+		// The threshold applies to the 99.9th percentile, Delta E ITP is ill-conditioned on the few out of gamut colors that have an LMS channel near zero
+		const Metrics::ErrorStats deltaEITP = Metrics::GetErrorStats(deltaEITPs);
+
+		const double meanSquaredError = squaredErrorSum / static_cast<double>(a_pixels.size() * 3);
+		const double psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(1.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+
+		Result result;
+		result.bPassed = invalidPixels == 0 && psnr >= a_case.thresholds.minPSNR && deltaEITP.percentile999 <= a_case.thresholds.maxDeltaEITP;
+
+		char message[256];
+		std::snprintf(message, sizeof(message), "PSNR %.1f dB (min %.1f), Delta E ITP mean %.3f, 99.9%% %.3f (max %.3f), max %.3f",
+			psnr, a_case.thresholds.minPSNR, deltaEITP.mean, deltaEITP.percentile999, a_case.thresholds.maxDeltaEITP, deltaEITP.max);
+		result.message = message;
+		if (invalidPixels) {
+			result.message += ", " + std::to_string(invalidPixels) + " pixels are NaN/inf in only one of the two";
+		}
+		return result;
+	}
+
+	Result RunCase(const Case& a_case, const Corpus& a_corpus, const std::filesystem::path& a_goldensDirectory, bool a_update)
+	{
+		std::vector<Float3> pixels, displayPixels;
+		std::size_t         width = 0, height = 0;
+		std::string         error;
+		if (!Render(a_case, a_corpus, pixels, displayPixels, width, height, error)) {
+			return { false, error };
+		}
+
+		const auto goldenPath = a_goldensDirectory / (a_case.name + ".lumaraw");
+		if (a_update) {
+			if (!WriteGolden(goldenPath, pixels, width, height)) {
+				return { false, "can't write " + goldenPath.string() };
+			}
+			return { true, "updated" };
+		}
+
+		std::vector<Float3> goldenPixels;
+		std::size_t         goldenWidth = 0, goldenHeight = 0;
+		if (!LoadGolden(goldenPath, goldenPixels, goldenWidth, goldenHeight)) {
+			return { false, "missing golden " + goldenPath.string() + " (run with --update)" };
+		}
+		if (goldenWidth != width || goldenHeight != height) {
+			return { false, "the golden is " + std::to_string(goldenWidth) + "x" + std::to_string(goldenHeight) + ", the corpus changed? (run with --update)" };
+		}
+		DecodeGolden(a_case, goldenPixels);
+		return Compare(a_case, displayPixels, goldenPixels);
+	}
+
+	Thresholds ReadThresholds(const nlohmann::json& a_json, const Thresholds& a_defaults)
+	{
+		Thresholds thresholds = a_defaults;
+		if (a_json.contains("thresholds")) {
+			thresholds.minPSNR = a_json["thresholds"].value("minPSNR", a_defaults.minPSNR);
+			thresholds.maxDeltaEITP = a_json["thresholds"].value("maxDeltaEITP", a_defaults.maxDeltaEITP);
+		}
+		return thresholds;
+	}
+
+	// Every technique times every configuration of its shader. Thresholds can be overridden by shader, configuration and technique, in that order.
+	std::vector<Case> GetCases(const nlohmann::json& a_manifest)
+	{
+		const Thresholds  thresholds = ReadThresholds(a_manifest, {});
+		std::vector<Case> cases;
+		for (const auto& technique : a_manifest.at("techniques")) {
+			const std::string shaderName = technique.at("shader");
+			const auto&       shader = a_manifest.at("shaders").at(shaderName);
+			const Thresholds  shaderThresholds = ReadThresholds(shader, thresholds);
+			for (const auto& [configurationName, configuration] : shader.at("configurations").items()) {
+				Case testCase;
+				testCase.name = shaderName + "_" + technique.at("id").get<std::string>() + "_" + configurationName;
+				testCase.shader = shaderName;
+				testCase.defines = technique.value("defines", std::vector<std::string>{});
+				for (const auto& [name, value] : configuration.items()) {
+					if (name != "thresholds") {
+						testCase.constants.emplace_back(name, value.get<double>());
+					}
+				}
+				testCase.thresholds = ReadThresholds(technique, ReadThresholds(configuration, shaderThresholds));
+				cases.push_back(std::move(testCase));
+			}
+		}
+		return cases;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path manifestPath = std::filesystem::path(SHADER_REGRESSION_DIRECTORY) / "manifest.json";
+	std::string           filter;
+	std::size_t           threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	bool                  bUpdate = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--manifest" && i + 1 < argc) {
+			manifestPath = argv[++i];
+		} else if (argument == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (argument == "--threads" && i + 1 < argc) {
+			threadCount = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 1));
+		} else if (argument == "--update") {
+			bUpdate = true;
+		} else {
+			std::fprintf(stderr, "Usage: %s [--manifest <manifest.json>] [--filter <text>] [--threads <count>] [--update]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const auto        start = std::chrono::steady_clock::now();
+	Corpus            corpus;
+	std::vector<Case> cases;
+	try {
+		std::ifstream input(manifestPath);
+		if (!input) {
+			std::fprintf(stderr, "%s: can't open\n", manifestPath.string().c_str());
+			return 1;
+		}
+		const auto manifest = nlohmann::json::parse(input);
+		if (!GenerateCorpus(manifest, corpus)) {
+			return 1;
+		}
+		cases = GetCases(manifest);
+	} catch (const nlohmann::json::exception& e) {
+		std::fprintf(stderr, "%s: %s\n", manifestPath.string().c_str(), e.what());
+		return 1;
+	}
+	std::erase_if(cases, [&](const Case& a_case) { return a_case.name.find(filter) == std::string::npos; });
+
+	const auto goldensDirectory = manifestPath.parent_path() / "goldens";
+	if (bUpdate) {
+		std::filesystem::create_directories(goldensDirectory);
+	}
+
+	// Cases are handed out one at a time, results are printed in manifest order at the end
+	std::vector<Result>      results(cases.size());
+	std::atomic<std::size_t> nextCase = 0;
+	const auto               worker = [&]() {
+		for (std::size_t i = nextCase++; i < cases.size(); i = nextCase++) {
+			results[i] = RunCase(cases[i], corpus, goldensDirectory, bUpdate);
+		}
+	};
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < std::min(threadCount, cases.size()); ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	std::size_t failed = 0;
+	for (std::size_t i = 0; i < cases.size(); ++i) {
+		std::printf("%-4s %s: %s\n", results[i].bPassed ? "ok" : "FAIL", cases[i].name.c_str(), results[i].message.c_str());
+		failed += !results[i].bPassed;
+	}
+	std::printf("%zu cases, %zu failed, in %.2f s\n", cases.size(), failed, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	return failed ? 1 : 0;
+}
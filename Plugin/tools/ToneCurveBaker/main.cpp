@@ -0,0 +1,183 @@
+// Measures how far the baked tone curves of "ToneCurve.h" are from the analytic ones, and how long baking takes.
+// Usage: ToneCurveBaker [--samples <count>]
+// Every configuration (tonemapper and the settings its curve depends on) is baked, then both of its tables are compared against the analytic
+// curve on "--samples" inputs spread logarithmically from 2^-24 to 2^14 (so also below and above the range of the tables).
+// Errors are reported in absolute output values and in 10 bit code values of the encoded output: gamma 2.2 for SDR curves (0-1),
+// PQ of the display nits for OpenDRT's HDR tonescale. The same comparison is also run on tables of other resolutions, to show what the default one buys.
+// Exits with 1 if a table's max code error is above the limit of its configuration, so a change to a curve or to the tables fails the test.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "ToneCurve.h"
+
+namespace
+{
+	using namespace ToneMapping;
+
+	struct Configuration
+	{
+		const char*     name;
+		ToneCurveInputs inputs;
+		double          maxSDRCodes;  // limits of the max errors, in 10 bit code values
+		double          maxHDRCodes;  // only for OpenDRT, the other tonemappers have no separate hdr curve
+	};
+
+	// Limits are 2.3-4x the max errors measured on 2^27 samples, rounded up: ACES fitted 0.020, ACES parametric 0.0024, OpenDRT 0.0068
+	// (gamma 2.2), 0.0085 (PQ), 0.017 at 4000 nits and 0.099 with contrast 0.5. The tables' error is smooth and the same from 2^20 samples on,
+	// so a real regression is a multiple of it, past the margin.
+	// Hable is the exception at 0.70-0.80: that's the staircase of the analytic curve's shoulder (see "ToneCurve.h"), at most one step of
+	// ~4.5e-4 in output, 0.8 codes. Its limit is a code, more than a step but less than two.
+	constexpr double kOpenDRTSDRCodes = 0.02;  // the reference display's tonescale, the same in every OpenDRT configuration
+
+	std::vector<Configuration> GetConfigurations()
+	{
+		std::vector<Configuration> configurations;
+		const auto                 add = [&](const char* a_name, double a_maxSDRCodes, double a_maxHDRCodes, auto a_setup) {
+			ToneCurveInputs inputs;
+			a_setup(inputs);
+			configurations.push_back({ a_name, inputs, a_maxSDRCodes, a_maxHDRCodes });
+		};
+
+		add("ACES fitted", 0.05, 0.0, [](ToneCurveInputs& a_inputs) { a_inputs.Tmo = 1; });
+		add("ACES parametric", 0.01, 0.0, [](ToneCurveInputs& a_inputs) { a_inputs.Tmo = 2; });
+		add("Hable", 1.0, 0.0, [](ToneCurveInputs& a_inputs) { a_inputs.Tmo = 3; });
+		add("Hable, shadows 0.2", 1.0, 0.0, [](ToneCurveInputs& a_inputs) { a_inputs.Tmo = 3; a_inputs.Shadows = 0.2f; });
+		add("Hable, shadows 0.8", 1.0, 0.0, [](ToneCurveInputs& a_inputs) { a_inputs.Tmo = 3; a_inputs.Shadows = 0.8f; });
+		add("Hable, no toe", 1.0, 0.0, [](ToneCurveInputs& a_inputs) { a_inputs.Tmo = 3; a_inputs.hable.toeLength = 0.f; });
+		add("OpenDRT, SDR", kOpenDRTSDRCodes, 0.02, [](ToneCurveInputs& a_inputs) { a_inputs.ToneMapperType = 1; a_inputs.DisplayMode = 0; });
+		add("OpenDRT, 400 nits", kOpenDRTSDRCodes, 0.02, [](ToneCurveInputs& a_inputs) { a_inputs.ToneMapperType = 1; a_inputs.PeakBrightness = 400.f; });
+		add("OpenDRT, 1000 nits", kOpenDRTSDRCodes, 0.02, [](ToneCurveInputs& a_inputs) { a_inputs.ToneMapperType = 1; a_inputs.PeakBrightness = 1000.f; });
+		add("OpenDRT, 4000 nits", kOpenDRTSDRCodes, 0.05, [](ToneCurveInputs& a_inputs) { a_inputs.ToneMapperType = 1; a_inputs.PeakBrightness = 4000.f; });
+		add("OpenDRT, 1000 nits, contrast 0.5", kOpenDRTSDRCodes, 0.25, [](ToneCurveInputs& a_inputs) { a_inputs.ToneMapperType = 1; a_inputs.Contrast = 0.5f; });
+		add("OpenDRT, 1000 nits, contrast 1.5", kOpenDRTSDRCodes, 0.02, [](ToneCurveInputs& a_inputs) { a_inputs.ToneMapperType = 1; a_inputs.Contrast = 1.5f; });
+		return configurations;
+	}
+
+	struct Error
+	{
+		double maxAbsolute = 0.0;
+		double maxCode = 0.0;   // 10 bit code values
+		double meanCode = 0.0;  // 10 bit code values
+	};
+
+	// "a_encode" maps an output of the curve to 0-1 before it's scaled to 10 bit code values
+	template <class Table, class Analytic, class Encode>
+	Error MeasureError(const Table& a_table, Analytic a_analytic, Encode a_encode, std::size_t a_samples)
+	{
+		constexpr double kMinExponent = -24.0;
+		constexpr double kMaxExponent = 14.0;
+
+		Error error;
+		for (std::size_t i = 0; i < a_samples; ++i) {
+			const float  input = static_cast<float>(std::exp2(kMinExponent + (kMaxExponent - kMinExponent) * (static_cast<double>(i) + 0.5) / static_cast<double>(a_samples)));
+			const float  baked = a_table.Sample(input);
+			const float  analytic = a_analytic(input);
+			const double codeError = std::abs(static_cast<double>(a_encode(baked)) - static_cast<double>(a_encode(analytic))) * 1023.0;
+			error.maxAbsolute = std::max(error.maxAbsolute, std::abs(static_cast<double>(baked) - static_cast<double>(analytic)));
+			error.maxCode = std::max(error.maxCode, codeError);
+			error.meanCode += codeError;
+		}
+		error.meanCode /= static_cast<double>(a_samples);
+		return error;
+	}
+
+	void PrintError(const char* a_label, const Error& a_error)
+	{
+		std::printf("  %-22s max %.2e, max %.4f codes, mean %.6f codes\n", a_label, a_error.maxAbsolute, a_error.maxCode, a_error.meanCode);
+	}
+
+	// Returns false if the max code error is above "a_maxCodes"
+	bool CheckError(const char* a_label, const Error& a_error, double a_maxCodes)
+	{
+		PrintError(a_label, a_error);
+		if (!(a_error.maxCode <= a_maxCodes)) {
+			std::printf("  FAILED: max %.4f codes, limit %.4f\n", a_error.maxCode, a_maxCodes);
+			return false;
+		}
+		return true;
+	}
+
+	// Compares the "hdr" curve of "a_inputs" baked in a table of "MantissaBits" segments per octave, which is all the default table changes
+	template <int MantissaBits>
+	void PrintResolution(const ToneCurveInputs& a_inputs, std::size_t a_samples)
+	{
+		using Table = Color::LogTable<-20, MantissaBits, 12>;
+
+		const HableCurve           hableCurve = MakeHableCurve(a_inputs.hable, a_inputs.Shadows);
+		const ACESParametricParams acesParams = MakeACESParametricParams(a_inputs.AcesParam0, a_inputs.AcesParam1);
+		const auto                 analytic = [&](float a_value) { return EvaluateHDRToneCurve(a_value, a_inputs, hableCurve, acesParams); };
+		const auto                 table = std::make_unique<Table>(Table::Make([&](double a_value) { return analytic(static_cast<float>(a_value)); }));
+
+		const bool bPQ = a_inputs.ToneMapperType == 1 && a_inputs.DisplayMode > 0;
+		const auto encode = [&](float a_value) { return bPQ ? Color::LinearToPQ(a_value * a_inputs.PeakBrightness / 10000.f) : Color::LinearToGamma(std::max(a_value, 0.f)); };
+
+		char label[64];
+		std::snprintf(label, sizeof(label), "%zu segments", Table::kSegments);
+		PrintError(label, MeasureError(*table, analytic, encode, a_samples));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::size_t samples = 1 << 20;
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument = argv[i];
+		if (argument == "--samples" && i + 1 < argc) {
+			samples = static_cast<std::size_t>(std::max(std::atoi(argv[++i]), 1));
+		} else {
+			std::fprintf(stderr, "Usage: %s [--samples <count>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::printf("Tables of %zu segments (%zu bytes each), %zu samples from 2^-24 to 2^14\n\n", ToneCurveTable::kSegments, sizeof(ToneCurveTable), samples);
+
+	const auto configurations = GetConfigurations();
+	bool       bPassed = true;
+	for (const auto& configuration : configurations) {
+		const ToneCurveInputs& inputs = configuration.inputs;
+
+		// Averaged over a few bakes, one only takes microseconds
+		constexpr int kBakes = 64;
+		const auto    curves = std::make_unique<ToneCurves>();
+		const auto    start = std::chrono::steady_clock::now();
+		for (int i = 0; i < kBakes; ++i) {
+			BakeToneCurves(inputs, *curves);
+		}
+		const double bakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / kBakes;
+
+		const HableCurve           hableCurve = MakeHableCurve(inputs.hable, inputs.Shadows);
+		const ACESParametricParams acesParams = MakeACESParametricParams(inputs.AcesParam0, inputs.AcesParam1);
+		const auto                 sdrAnalytic = [&](float a_value) { return EvaluateSDRToneCurve(a_value, inputs, hableCurve, acesParams); };
+		const auto                 hdrAnalytic = [&](float a_value) { return EvaluateHDRToneCurve(a_value, inputs, hableCurve, acesParams); };
+		const auto                 gamma = [](float a_value) { return Color::LinearToGamma(std::max(a_value, 0.f)); };
+		const auto                 pq = [&](float a_value) { return Color::LinearToPQ(a_value * inputs.PeakBrightness / 10000.f); };
+
+		std::printf("%s: baked in %.3f ms\n", configuration.name, bakeMs);
+		bPassed &= CheckError("sdr (gamma 2.2)", MeasureError(curves->sdr, sdrAnalytic, gamma, samples), configuration.maxSDRCodes);
+		if (inputs.ToneMapperType == 1 && inputs.DisplayMode > 0) {
+			bPassed &= CheckError("hdr (PQ)", MeasureError(curves->hdr, hdrAnalytic, pq, samples), configuration.maxHDRCodes);
+		} else if (inputs.ToneMapperType == 1) {
+			bPassed &= CheckError("hdr (gamma 2.2)", MeasureError(curves->hdr, hdrAnalytic, gamma, samples), configuration.maxHDRCodes);
+		}
+	}
+
+	std::printf("\nResolution of the hdr curve (Hable, OpenDRT 1000 nits)\n");
+	for (const auto* configuration : { &configurations[2], &configurations[8] }) {
+		std::printf("%s\n", configuration->name);
+		PrintResolution<5>(configuration->inputs, samples);
+		PrintResolution<6>(configuration->inputs, samples);
+		PrintResolution<7>(configuration->inputs, samples);
+		PrintResolution<8>(configuration->inputs, samples);
+	}
+
+	std::printf("\n%s\n", bPassed ? "passed" : "FAILED");
+	return bPassed ? 0 : 1;
+}
@@ -3,6 +3,8 @@
 #include "../math.hlsl"
 #include "RootSignature.hlsl"
 
+// The plugin's "ColorGradingMerge.h" is a CPU port of this shader (for offline LUT correction and testing, see "tools/LUTMerger"), changes here should be mirrored there.
+
 // 0 None, 1 Scale with Black Linear, 2 Remove Black sRGB Values
 #define LUT_IMPROVEMENT_TYPE (FORCE_VANILLA_LOOK ? 0 : 2)
 // Determines how multiple LUTs blend between themseleves (e.g. the game can have up to 4 loaded, and each has a different intensity).